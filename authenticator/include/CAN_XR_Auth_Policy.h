@@ -0,0 +1,206 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* This header contains the authentication policy shared by the
+   sender, the authenticator and the receivers.  The policy tells,
+   for each CBFF identifier, whether frames carrying it are
+   authenticated and, if so, the rule that applies to them: the length
+   of the data MAC and the index of the source key.  It is consulted
+   once, when the identifier is complete.  CEFF frames follow the rule
+   of their base identifier, see CAN_XR_Auth_Policy_Key().
+*/
+
+#ifndef CAN_XR_AUTH_POLICY_H
+#define CAN_XR_AUTH_POLICY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CAN_XR_AUTH_POLICY_IDS 2048   /* 11-bit identifiers */
+#define CAN_XR_AUTH_POLICY_RULES 8
+#define CAN_XR_AUTH_NO_RULE 0xFF
+
+/* Length in bytes of the data MAC appended to the payload, unless a
+   rule says otherwise.
+*/
+#define CAN_XR_AUTH_MAC_LEN_DEFAULT 3
+
+/* Longest data MAC a rule can ask for.  The MAC bytes are the last
+   ones of the bpmac tag, so it must not exceed MAC_LEN (bpmac.h) and
+   the CBFF payload.
+*/
+#ifndef CAN_XR_AUTH_MAC_LEN_MAX
+#define CAN_XR_AUTH_MAC_LEN_MAX 4
+#endif
+
+#if CAN_XR_AUTH_MAC_LEN_MAX < 1 || CAN_XR_AUTH_MAC_LEN_MAX > 8
+#error "CAN_XR_AUTH_MAC_LEN_MAX must be in [1, 8]"
+#endif
+
+/* Longest message covered by a data MAC, in bytes, as max_size for
+   bpmac_init(): 29 identifier bits (CEFF) and up to 7 payload bytes.
+*/
+#define CAN_XR_AUTH_MSG_MAX_SIZE 11
+
+/* Aggregated mode.  When .aggregate is at least 2, the sender
+   carries a cumulative tag, the XOR of the bpmac tags of the frames
+   of the rule since the previous checkpoint and of its own, in one
+   frame out of .aggregate: the checkpoint, with .mac_len MAC bytes.
+   The other frames only carry the last .mac_len_short bytes of their
+   own tag.  Payload length is fixed to .payload_len, so checkpoints
+   are told apart by the DLC alone and nodes need no shared frame
+   counter.  Receivers and authenticator keep one rolling accumulator
+   per rule, cleared at every checkpoint.  Only one sender per
+   aggregated rule.
+*/
+struct CAN_XR_Auth_Rule
+{
+    uint8_t mac_len;    /* Data MAC bytes at the end of the payload, [1, CAN_XR_AUTH_MAC_LEN_MAX] */
+    uint8_t key_index;  /* Source key (authenticator key slot) */
+    uint8_t aggregate;  /* Frames per cumulative tag, 0 if not aggregated */
+    uint8_t mac_len_short;  /* Aggregated: MAC bytes of non-checkpoint frames */
+    uint8_t payload_len;    /* Aggregated: payload bytes of all frames */
+};
+
+struct CAN_XR_Auth_Policy
+{
+    /* One bit per identifier, set if authenticated */
+    uint32_t bitmap[CAN_XR_AUTH_POLICY_IDS / 32];
+
+    /* Rule of each authenticated identifier, index into .rule[] */
+    uint8_t rule_of_id[CAN_XR_AUTH_POLICY_IDS];
+    struct CAN_XR_Auth_Rule rule[CAN_XR_AUTH_POLICY_RULES];
+};
+
+/* Clear 'policy', no identifier is authenticated afterwards. */
+void CAN_XR_Auth_Policy_Init(struct CAN_XR_Auth_Policy *policy);
+
+/* Set rule number 'rule' of 'policy'.  Returns 0 on success, -1 if
+   any argument is out of range.
+*/
+int CAN_XR_Auth_Policy_Set_Rule(
+    struct CAN_XR_Auth_Policy *policy, int rule,
+    uint8_t mac_len, uint8_t key_index);
+
+/* Turn on the aggregated mode for 'rule' of 'policy', which must
+   have been set with CAN_XR_Auth_Policy_Set_Rule() before.  'k' frames
+   per cumulative tag, at least 2, 'mac_len_short' MAC bytes in
+   non-checkpoint frames, in [1, mac_len), 'payload_len' payload bytes
+   in all frames.  Returns 0 on success, -1 if any argument is out of
+   range.
+*/
+int CAN_XR_Auth_Policy_Set_Aggregation(
+    struct CAN_XR_Auth_Policy *policy, int rule,
+    uint8_t k, uint8_t mac_len_short, uint8_t payload_len);
+
+/* Authenticate identifiers in [first, last] according to 'rule' of
+   'policy'.  CAN_XR_AUTH_NO_RULE as 'rule' makes them
+   unauthenticated.
+*/
+void CAN_XR_Auth_Policy_Map(
+    struct CAN_XR_Auth_Policy *policy,
+    uint32_t first, uint32_t last, int rule);
+
+/* Return the policy used by default by all MACs: identifiers [0, 255]
+   authenticated with CAN_XR_AUTH_MAC_LEN_DEFAULT MAC bytes and source
+   key 0, all the others reserved for signalling and not
+   authenticated.  It is built on first use and can be modified by the
+   application before the controller is started.
+*/
+struct CAN_XR_Auth_Policy *CAN_XR_Auth_Policy_Default(void);
+
+/* Report on stderr the rules of 'policy' and, for each data MAC
+   length and DLC, the frame length, the payload efficiency and the
+   throughput at 'bit_rate' (usually CAN_XR_BIT_RATE).  Aggregated
+   rules also get their goodput gain and added authentication latency.
+*/
+void CAN_XR_Auth_Policy_Report(
+    const char *desc, const struct CAN_XR_Auth_Policy *policy,
+    unsigned long bit_rate);
+
+/* Identifier to look 'policy' up with for a frame with 'identifier',
+   29 bits long if 'extended' (CEFF).  A CEFF frame shares the entry of
+   its base identifier, the 11 bits before SRR and IDE, so that
+   receivers know the key and the rule of a frame before they know
+   its format.
+*/
+static inline uint32_t CAN_XR_Auth_Policy_Key(uint32_t identifier, int extended)
+{
+    return extended ? identifier >> 18 : identifier;
+}
+
+/* Constant-time lookups, for use on the bit processing path.
+   CAN_XR_Auth_Policy_Rule() returns NULL for unauthenticated
+   identifiers.
+*/
+static inline int CAN_XR_Auth_Policy_Is_Authenticated(
+    const struct CAN_XR_Auth_Policy *policy, uint32_t identifier)
+{
+    identifier &= CAN_XR_AUTH_POLICY_IDS - 1;
+    return (policy->bitmap[identifier >> 5] >> (identifier & 31)) & 1;
+}
+
+static inline const struct CAN_XR_Auth_Rule *CAN_XR_Auth_Policy_Rule(
+    const struct CAN_XR_Auth_Policy *policy, uint32_t identifier)
+{
+    identifier &= CAN_XR_AUTH_POLICY_IDS - 1;
+    if(!((policy->bitmap[identifier >> 5] >> (identifier & 31)) & 1))
+        return NULL;
+    return &policy->rule[policy->rule_of_id[identifier]];
+}
+
+/* Number of data MAC bytes of a frame with 'identifier' and 'dlc'.
+   The MAC is shortened when needed to leave at least one payload
+   byte; frames with less than two data bytes and unauthenticated
+   frames have none, 0 is returned for them.  In aggregated mode the
+   DLC must match either a checkpoint or a non-checkpoint frame.  All
+   nodes must use this function to agree on the frame layout.
+*/
+static inline int CAN_XR_Auth_Policy_MAC_Len(
+    const struct CAN_XR_Auth_Policy *policy, uint32_t identifier, int dlc)
+{
+    const struct CAN_XR_Auth_Rule *rule =
+        CAN_XR_Auth_Policy_Rule(policy, identifier);
+
+    if(rule == NULL || dlc < 2)
+        return 0;
+    if(dlc > 8)
+        dlc = 8;
+    if(rule->aggregate)
+    {
+        int len = dlc - rule->payload_len;
+        return (len == rule->mac_len || len == rule->mac_len_short) ? len : 0;
+    }
+    return (rule->mac_len < dlc) ? rule->mac_len : dlc - 1;
+}
+
+/* Tell whether a frame of 'rule' with 'mac_len' MAC bytes, as
+   returned by CAN_XR_Auth_Policy_MAC_Len(), closes an aggregation
+   window.  Always true when the rule is not aggregated.
+*/
+static inline int CAN_XR_Auth_Policy_Is_Checkpoint(
+    const struct CAN_XR_Auth_Rule *rule, int mac_len)
+{
+    return !rule->aggregate || mac_len == rule->mac_len;
+}
+
+#endif
@@ -33,6 +33,7 @@
 #define CAN_XR_MAC_H
 
 #include <stdint.h>
+#include <CAN_XR_Auth_Policy.h>
 #include "CAN_XR_LLC.h" /* For enum CAN_XR_Format */
 //#include <bpmac.h>
 #include "../../lib/bpmac/bpmac.h"
@@ -58,17 +59,23 @@ enum CAN_XR_MAC_RX_FSM_State
     CAN_XR_MAC_RX_FSM_BUS_INTEGRATION, /* [1], 10.9.4 */ // used for synchronization
     CAN_XR_MAC_RX_FSM_IDLE,
     CAN_XR_MAC_RX_FSM_RX_IDENTIFIER,   /* [1], Figure 12 */
-    CAN_XR_MAC_RX_FSM_RX_RTR,
+    CAN_XR_MAC_RX_FSM_RX_RTR,          /* Or SRR, until IDE tells */
     CAN_XR_MAC_RX_FSM_RX_IDE,
+    CAN_XR_MAC_RX_FSM_RX_ID_EXT,       /* [1], Figure 13 */
     CAN_XR_MAC_RX_FSM_RX_FDF,
+    CAN_XR_MAC_RX_FSM_RX_R0,           /* CEFF, res in FD frames */
+    CAN_XR_MAC_RX_FSM_RX_BRS,          /* [1], Figures 14-15 */
+    CAN_XR_MAC_RX_FSM_RX_ESI,
     CAN_XR_MAC_RX_FSM_RX_DLC,
     CAN_XR_MAC_RX_FSM_RX_DATA,
     CAN_XR_MAC_RX_FSM_RX_DATA_MAC,  // MAC over data
     CAN_XR_MAC_RX_FSM_RX_CRC,
+    CAN_XR_MAC_RX_FSM_RX_FD_CRC,       /* Stuff count and CRC, FD */
     CAN_XR_MAC_RX_FSM_RX_CDEL,
     CAN_XR_MAC_RX_FSM_RX_ACK,
     CAN_XR_MAC_RX_FSM_RX_ADEL,
     CAN_XR_MAC_RX_FSM_RX_EOF,
+    CAN_XR_MAC_RX_FSM_INTERMISSION,    /* [1], 10.4.5 */
     CAN_XR_MAC_RX_FSM_ERROR
 };
 
@@ -77,9 +84,12 @@ enum CAN_XR_MAC_TX_FSM_State
 {
     CAN_XR_MAC_TX_FSM_IDLE,
     CAN_XR_MAC_TX_FSM_TX_IDENTIFIER,    /* Mimic the RX_FSM ones */
+    CAN_XR_MAC_TX_FSM_TX_SRR,
     CAN_XR_MAC_TX_FSM_TX_RTR,
     CAN_XR_MAC_TX_FSM_TX_IDE,
+    CAN_XR_MAC_TX_FSM_TX_ID_EXT,
     CAN_XR_MAC_TX_FSM_TX_FDF,
+    CAN_XR_MAC_TX_FSM_TX_R0,
     CAN_XR_MAC_TX_FSM_TX_DLC,
     CAN_XR_MAC_TX_FSM_TX_DATA,
     CAN_XR_MAC_TX_FSM_TX_CRC_LATCH,
@@ -95,15 +105,86 @@ enum CAN_XR_MAC_TX_FSM_State
     CAN_XR_MAC_TX_FSM_ERROR
 };
 
-struct CAN_XR_DATA_MAC_Storage
+/* Number of key slots, that is, of senders with distinct source keys
+   and nonce counters the authenticator can serve on the same bus.
+*/
+#ifndef CAN_XR_MAC_KEY_SLOTS
+#define CAN_XR_MAC_KEY_SLOTS 4
+#endif
+
+/* Source keys, nonce counter and bpmac context of a key slot.  The
+   masking tag of the next frame is precomputed by bpmac_pre() in
+   .ctx, so that switching between slots costs nothing.  Key slots are
+   selected by the key_index of the authentication policy rules.
+*/
+struct CAN_XR_Key_Slot
 {
     bpmac_ctx_t ctx;
     uint64_t src_nonce[2];
     uint8_t src_nonce_key[16];
     uint8_t src_mac_key[16];
+    uint32_t resync_id; /* Nonce resynchronization frame of this slot */
+    uint8_t late;       /* Frames not authenticated in time, their nonces are still to be skipped */
+};
+
+/* Nonce resynchronization in progress, performed as deferred work
+   because it needs up to two masking tags.  The frame is copied,
+   since the next one may arrive before it is complete.  A
+   resynchronization frame received while another one is in progress
+   waits in .next_*, and only the last one waits.
+*/
+struct CAN_XR_Resync
+{
+    int phase;  /* 0 if none is in progress */
+    struct CAN_XR_Key_Slot *slot;
+    uint32_t identifier;
+    uint8_t data[8];
+    uint64_t backup_nonce[2];
+    uint8_t tag[16];
+
+    struct CAN_XR_Key_Slot *next_slot;  /* NULL if none is waiting */
+    uint32_t next_identifier;
+    uint8_t next_data[8];
+};
+
+struct CAN_XR_DATA_MAC_Storage
+{
+    struct CAN_XR_Key_Slot slot[CAN_XR_MAC_KEY_SLOTS];
+    uint8_t agg_src_mac[CAN_XR_AUTH_POLICY_RULES][16]; /* Aggregated mode accumulators, one per rule */
     uint64_t res_nonce[2];
+    struct CAN_XR_Resync resync;
 };
 
+struct CAN_XR_MAC;
+
+/* Deferred work.  Work that does not fit in a bit time, like the AES
+   encryption of a masking tag, is split into slices and queued.  One
+   slice is executed at each sample point in which the receive
+   automaton has slack, that is, everywhere but in the data field.
+   'fn' performs the next slice of the work described by 'arg' and
+   returns nonzero when there is nothing left to do; it must also do
+   so when invoked again after that.
+*/
+typedef int (* CAN_XR_MAC_Work_t)(struct CAN_XR_MAC *mac, void *arg);
+
+struct CAN_XR_MAC_Work
+{
+    CAN_XR_MAC_Work_t fn;
+    void *arg;
+};
+
+#ifndef CAN_XR_MAC_WORK_QUEUE_LEN
+#define CAN_XR_MAC_WORK_QUEUE_LEN 4
+#endif
+
+/* AES rounds of a masking tag still pending that may be completed in
+   the bit time in which the key slot of a frame is selected.  If more
+   are left, the frame is not authenticated.
+*/
+#ifndef CAN_XR_MAC_LATE_ROUNDS
+#define CAN_XR_MAC_LATE_ROUNDS 2
+#endif
+
 /* Overall MAC state.  Made up of an implementation-independent part
    (defined directly in this structure) and an
    implementation-dependent part (members of the id union).
@@ -111,13 +192,14 @@ struct CAN_XR_DATA_MAC_Storage
 struct CAN_XR_MAC_State
 {
     enum CAN_XR_MAC_RX_FSM_State rx_fsm_state;  // current state of finite state machine (FSM) of the MAC layer
+    enum CAN_XR_MAC_RX_FSM_State rx_fsm_entry;  // rx_fsm_state at the last pcs_data_ind, for PMA overruns
 
     int bus_integration_counter; /* Bus integration */
 
     int nc_bits; /* De-stuffing and CRC calculation - counter of bits with same length */
     int nc_pol; // polarity of nc_bits
     uint16_t crc;   // the current CRC sum, used by receiver AND transmitter of this CAN node
-    uint8_t field_bits; // indicates the current length of the current field (e.g. 11 bit length for identifier)
+    int field_bits;     // indicates the current length of the current field (e.g. 11 bit length for identifier)
     int bus_bits;
     int de_stuffed_bits;
 
@@ -125,10 +207,16 @@ struct CAN_XR_MAC_State
     int rx_rtr;
     int rx_ide;
     int rx_fdf;
+    int rx_brs;
+    int rx_esi;
     int rx_dlc;
+    int rx_len;         // data bytes, from rx_dlc
+    unsigned long rx_sof_ts;    // nodeclock_ts of SOF, end of payload and end of data field
+    unsigned long rx_data_ts;
+    unsigned long rx_mac_ts;
     uint8_t rx_byte;
     int rx_byte_index;
-    uint8_t rx_data[8]; // always fixed to maximum size, independent of value in DLC
+    uint8_t rx_data[CAN_XR_DATA_LEN_MAX]; // always fixed to maximum size, independent of value in DLC
 
     enum CAN_XR_MAC_TX_FSM_State tx_fsm_state;
 
@@ -144,18 +232,27 @@ struct CAN_XR_MAC_State
 
     /* DATA MAC STUFF */
     uint8_t tx_src_mac[16]; // two byte of data mac
-    uint8_t *src_key;
-    uint8_t *src_nonce_key;
-    uint64_t src_nonce[2];
+    struct CAN_XR_Key_Slot *key_slot;   // key slot of the frame being received, selected by its identifier
     bpmac_ctx_t *mac_ctx;
     uint32_t tx_mac_shift_reg;
     uint8_t skip_mac;
+    uint8_t rx_late;        // the masking tag was not ready in time, the frame is not authenticated
     uint8_t mac_byte_index; // defines the byte of the MAC in the tx_data_mac that will be transmitted next. Is increased after each usage
+    uint8_t rx_mac_len;     // data MAC bytes of the frame being received, they are overwritten on the bus
+    uint8_t *rx_agg_mac;    // accumulator of the frame being received, NULL if its rule is not aggregated
+    uint8_t rx_checkpoint;  // the frame carries a cumulative tag
+    uint8_t nonce_delta; // source nonce values skipped by the sender, as indicated by the nonce hint
+
+    /* Deferred work queue, work[work_head] is being executed */
+    struct CAN_XR_MAC_Work work[CAN_XR_MAC_WORK_QUEUE_LEN];
+    int work_head;
+    int work_tail;
 
     union CAN_XR_MAC_ID_State id;
 };
 
 struct CAN_XR_MAC;
+struct CAN_XR_Latency;
 struct CAN_XR_LLC;
 
 enum CAN_XR_MAC_Tx_Status {
@@ -218,6 +315,12 @@ struct CAN_XR_MAC
     struct CAN_XR_LLC *llc; /* Link to the upper protocol layer. */
     struct CAN_XR_PCS *pcs; /* Link to the lower protocol layer. */
 
+    /* Authentication policy, shared with the other nodes. */
+    const struct CAN_XR_Auth_Policy *policy;
+
+    /* Latency histograms, NULL if not kept. */
+    struct CAN_XR_Latency *latency;
+
     struct CAN_XR_MAC_State state;
     struct CAN_XR_MAC_Primitives primitives;
     struct CAN_XR_DATA_MAC_Storage storage;
@@ -241,6 +344,17 @@ void CAN_XR_MAC_Bare_Bones_Init(
 /* Set the pointer to the upper layer in 'mac' */
 void CAN_XR_MAC_Set_LLC(struct CAN_XR_MAC *mac, struct CAN_XR_LLC *llc);
 
+/* Set the authentication policy of 'mac'.  By default it is
+   CAN_XR_Auth_Policy_Default().
+*/
+void CAN_XR_MAC_Set_Auth_Policy(
+    struct CAN_XR_MAC *mac, const struct CAN_XR_Auth_Policy *policy);
+
+/* Keep the latency histograms of the frames 'mac' receives in 'lat',
+   see CAN_XR_Latency.h.  NULL, the default, keeps none.
+*/
+void CAN_XR_MAC_Set_Latency(struct CAN_XR_MAC *mac, struct CAN_XR_Latency *lat);
+
 /* Register the data_ind and data_conf upcall primitives in 'mac'. */
 void CAN_XR_MAC_Set_Data_Ind(
     struct CAN_XR_MAC *mac, CAN_XR_MAC_Data_Ind_t data_ind);
@@ -252,6 +366,23 @@ void CAN_XR_MAC_Set_Data_Conf(
 void CAN_XR_MAC_Set_Ext_Tx_Data_Ind(
     struct CAN_XR_MAC *mac, CAN_XR_MAC_Ext_Tx_Data_Ind_t ext_tx_data_ind);
 
+/* Load the source MAC key 'src_key' and nonce key 'src_key_nonce'
+   (16 bytes each) into key slot 'slot' of 'mac' and reset its nonce
+   counter.  The slot is not used until a rule of the authentication
+   policy refers to it.  Returns 0 on success, -1 if 'slot' is out
+   of range.
+*/
+int CAN_XR_MAC_Set_Key_Slot(
+    struct CAN_XR_MAC *mac, int slot,
+    const uint8_t *src_key, const uint8_t *src_key_nonce);
+
+/* Make 'identifier' the nonce resynchronization frame of key slot
+   'slot' of 'mac'.  Returns 0 on success, -1 if 'slot' is out of
+   range.
+*/
+int CAN_XR_MAC_Map_Resync_Id(
+    struct CAN_XR_MAC *mac, uint32_t identifier, int slot);
+
 /* Invoke the data_req primitive in 'mac'. */
 void CAN_XR_MAC_Data_Req(
     struct CAN_XR_MAC *mac,
@@ -34,7 +34,9 @@
 
 #include <stdint.h>
 
-/* [1], Table 8. */
+/* [1], Table 8, nominal bit time.  The same structure holds the data
+   bit time of FD frames, [1] Table 9, whose ranges are wider.
+*/
 struct CAN_XR_PCS_Bit_Time_Parameters
 {
     int prescaler_m; /* [ 1, 32] -- [1], Table 8. */
@@ -56,6 +58,7 @@ struct CAN_XR_PCS_State
     int prev_sample; /* Bus @ previous sample point for edge detection and sync compensation */
     int sync_inhibit; /* Sync inhibit per [1] 11.3.2.1 a) */
     int hard_sync_allowed; /* Set by MAC to allow/forbid hard sync */
+    int data_phase; /* Set by MAC, data bit time in use */
     int output_unit_buf; /* Buffer for output_unit to be / being sent */
     uint8_t fast_pass;  /* Set by MAC to allow/forbid passing of bus state during prop_state */
     /* we need an additional flag to reset the fast_pass after a quantum. Otherwise, the fast_pass flag is reset
@@ -93,7 +96,9 @@ struct CAN_XR_PCS
     struct CAN_XR_MAC *mac; /* Link to the upper protocol layer. */
     struct CAN_XR_PMA *pma; /* Link to the lower protocol layer. */
 
-    struct CAN_XR_PCS_Bit_Time_Parameters parameters;
+    struct CAN_XR_PCS_Bit_Time_Parameters parameters; /* In use */
+    struct CAN_XR_PCS_Bit_Time_Parameters nominal_parameters;
+    struct CAN_XR_PCS_Bit_Time_Parameters data_parameters;
     struct CAN_XR_PCS_State state;
     struct CAN_XR_PCS_Primitives primitives;
 };
@@ -107,6 +112,14 @@ void CAN_XR_PCS_Init(
     const struct CAN_XR_PCS_Bit_Time_Parameters *parameters,
     struct CAN_XR_PMA *pma);
 
+/* Set the data bit time of 'pcs', used in the data phase of FD frames
+   with BRS set.  By default it is the same as the nominal bit time
+   passed to CAN_XR_PCS_Init().
+*/
+void CAN_XR_PCS_Set_Data_Bit_Time(
+    struct CAN_XR_PCS *pcs,
+    const struct CAN_XR_PCS_Bit_Time_Parameters *parameters);
+
 /* Set the pointer to the upper layer in 'pcs'. */
 void CAN_XR_PCS_Set_MAC(struct CAN_XR_PCS *pcs, struct CAN_XR_MAC *mac);
 
@@ -140,4 +153,15 @@ void CAN_XR_PCS_Set_Fast_Pass(
 void CAN_XR_PCS_Reset_Fast_Pass(
         struct CAN_XR_PCS *pcs);
 
+/* Switch 'pcs' to the data bit time if 'data_phase' is set, back to
+   the nominal one otherwise.  Like CAN_XR_PCS_Hard_Sync_Allowed_Req(),
+   this is not a primitive of the standard.  The MAC invokes it from
+   PCS_Data.Indicate, because the bit rate switches at the sample
+   point of BRS and back at the sample point of the CRC delimiter, or
+   when an error is detected.  The rest of the current bit takes the
+   phase_seg2 of the new bit time.
+*/
+void CAN_XR_PCS_Bit_Rate_Switch_Req(
+    struct CAN_XR_PCS *pcs, int data_phase);
+
 #endif
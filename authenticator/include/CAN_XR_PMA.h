@@ -53,6 +53,13 @@ typedef  void (* CAN_XR_PMA_Data_Mac_Req_t)(
 /* Reset transceiver to Recessive after quantum */
 typedef void (* CAN_XR_PMA_Tx_Reset_t)();
 
+/* PMA primitive invoked upon an overrun, see CAN_XR_PMA_Overrun(),
+   to get the state of the upper layers to account it to.  Arguments
+   are the target PCS data structure.  It returns the receive FSM
+   state of the MAC.
+*/
+typedef int (* CAN_XR_PMA_State_Ind_t)(struct CAN_XR_PCS *pcs);
+
 /* PMA state, it depends on the PMA implementation.
 */
 struct CAN_XR_PMA_Sim_State
@@ -82,10 +89,36 @@ struct CAN_XR_PMA_Primitives
 {
     CAN_XR_PMA_NodeClock_Ind_t nodeclock_ind;
     CAN_XR_PMA_Data_Req_t data_req;
+    CAN_XR_PMA_State_Ind_t state_ind;
     CAN_XR_PMA_Data_Mac_Req_t data_mac_req;
     CAN_XR_PMA_Tx_Reset_t tx_reset;
 };
 
+/* Upper layer states the overruns are accounted to, the others share
+   the last entry.  Enough for enum CAN_XR_MAC_RX_FSM_State.
+*/
+#define CAN_XR_PMA_OVERRUN_STATES 32
+
+/* Overruns of the chain of nodeclock indication callbacks, common to
+   all PMAs.  .record keeps the first overrun after
+   CAN_XR_PMA_Latch_Overrun().
+*/
+struct CAN_XR_PMA_Overrun
+{
+    unsigned long overruns;     /* Periods that overran */
+    unsigned long ticks;        /* Nodeclock ticks lost */
+    unsigned long state[CAN_XR_PMA_OVERRUN_STATES];
+
+    int latch;                  /* Fill .record at the next overrun */
+    struct
+    {
+        int valid;
+        int state;
+        unsigned long nodeclock; /* When it was detected */
+        unsigned long ticks;
+    } record;
+};
+
 struct CAN_XR_PMA
 {
     struct CAN_XR_PCS *pcs; /* Link to the upper protocol layer. */
@@ -93,6 +126,7 @@ struct CAN_XR_PMA
 
     union  CAN_XR_PMA_State state;
     struct CAN_XR_PMA_Primitives primitives;
+    struct CAN_XR_PMA_Overrun overrun;
 };
 
 /* Set the pointer to the upper layer in 'pma' */
@@ -105,6 +139,23 @@ void CAN_XR_PMA_Set_NodeClock_Ind(
 /* Invoke the data_req primitive in 'pma' */
 void CAN_XR_PMA_Data_Req(struct CAN_XR_PMA *pma, int bus_level);
 
+/* Register the state_ind upcall primitive in 'pma' */
+void CAN_XR_PMA_Set_State_Ind(
+    struct CAN_XR_PMA *pma, CAN_XR_PMA_State_Ind_t state_ind);
+
+/* Account an overrun of the chain of nodeclock indication callbacks
+   of 'pma', detected at nodeclock 'nodeclock', that made the PMA lose
+   or delay 'ticks' nodeclock ticks.  Called by the PMA
+   implementations.
+*/
+void CAN_XR_PMA_Overrun(
+    struct CAN_XR_PMA *pma, unsigned long nodeclock, unsigned long ticks);
+
+/* Clear the overrun record of 'pma' and latch the next overrun into
+   it.
+*/
+void CAN_XR_PMA_Latch_Overrun(struct CAN_XR_PMA *pma);
+
 void CAN_XR_PMA_Data_Mac_Req(struct CAN_XR_PMA *pma, int bus_level);
 
 void CAN_XR_PMA_Tx_Reset(struct CAN_XR_PMA *pma);
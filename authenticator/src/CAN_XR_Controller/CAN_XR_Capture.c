@@ -0,0 +1,116 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Software logic analyzer, see CAN_XR_Capture.h. */
+
+#include <string.h>
+#include <CAN_XR_Capture.h>
+
+#ifdef ENABLE_CAPTURE
+
+#if (CAN_XR_CAPTURE_RECORDS & (CAN_XR_CAPTURE_RECORDS - 1)) != 0
+#error "CAN_XR_CAPTURE_RECORDS must be a power of two"
+#endif
+
+struct CAN_XR_Capture CAN_XR_Capture_Data = { .left = CAN_XR_CAPTURE_RUNNING };
+uint32_t CAN_XR_Capture_Clock;
+
+/* Header of CAN_XR_Capture_Dump(), followed by .channels channel
+   descriptions and then by the records, up to the end of the
+   stream.  All in the byte order of the board.
+*/
+struct dump_header
+{
+    char magic[4];      /* "CXCA" */
+    uint32_t hz;
+    uint32_t channels;
+};
+
+struct dump_channel
+{
+    char name[12];
+    uint32_t width;     /* Bits, 0 for events */
+};
+
+static const struct dump_channel channel[CAN_XR_CAPTURE_CHANNELS] = {
+    { "debug1", 1 }, { "debug2", 1 }, { "debug3", 1 }, { "rx_state", 8 },
+    { "sof", 0 }, { "frame_ok", 0 }, { "bit_err", 0 }, { "stuff_err", 0 },
+    { "form_err", 0 }, { "crc_err", 0 }, { "ack_err", 0 }, { "arb_lost", 0 },
+    { "mac_bad", 0 }, { "overrun", 0 }
+};
+
+void CAN_XR_Capture_Init(uint32_t hz)
+{
+    struct CAN_XR_Capture *c = &CAN_XR_Capture_Data;
+
+#ifdef __arm__
+    *(volatile uint32_t *)0xE000EDFC |= 1UL << 24;  /* DEMCR.TRCENA */
+    *(volatile uint32_t *)0xE0001000 |= 1UL;        /* DWT_CTRL.CYCCNTENA */
+#endif
+
+    /* Stop producers while clearing */
+    __atomic_store_n(&c->left, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    memset(c->record, 0, sizeof(c->record));
+    c->head = 0;
+    c->trigger = 0;
+    c->post = 0;
+    c->hz = hz;
+
+    __atomic_store_n(&c->left, CAN_XR_CAPTURE_RUNNING, __ATOMIC_RELEASE);
+}
+
+void CAN_XR_Capture_Trigger(uint32_t mask, uint32_t post)
+{
+    struct CAN_XR_Capture *c = &CAN_XR_Capture_Data;
+
+    /* A trigger firing after .post is set finds the right value */
+    c->post = post;
+    __atomic_store_n(&c->trigger, mask, __ATOMIC_RELEASE);
+}
+
+int CAN_XR_Capture_Stopped(void)
+{
+    return __atomic_load_n(&CAN_XR_Capture_Data.left, __ATOMIC_ACQUIRE) == 0;
+}
+
+int CAN_XR_Capture_Dump(FILE *f)
+{
+    const struct CAN_XR_Capture *c = &CAN_XR_Capture_Data;
+    struct dump_header header = {
+        { 'C', 'X', 'C', 'A' }, c->hz, CAN_XR_CAPTURE_CHANNELS
+    };
+    uint32_t head = __atomic_load_n(&c->head, __ATOMIC_ACQUIRE);
+    uint32_t pos = (head > CAN_XR_CAPTURE_RECORDS) ? head - CAN_XR_CAPTURE_RECORDS : 0;
+    int n = 0;
+
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(channel, sizeof(channel), 1, f);
+
+    for(; pos != head; pos++, n++)
+        fwrite(&c->record[pos & (CAN_XR_CAPTURE_RECORDS - 1)], sizeof(uint64_t), 1, f);
+
+    return n;
+}
+
+#endif
@@ -32,13 +32,24 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <CAN_XR_Config.h>
 #include <LED_Config.h>
+#include <CAN_XR_PMA.h>
 #include <CAN_XR_PCS.h>
 #include <CAN_XR_MAC.h>
+#define CAN_XR_TRACE_MODULE MAC
 #include <CAN_XR_Trace.h>
+#include <CAN_XR_Profile.h>
+#include <CAN_XR_Metrics.h>
+#include <CAN_XR_Capture.h>
+#include <CAN_XR_Latency.h>
 //#include <bpmac.h>
 #include "../../lib/bpmac/bpmac.h"
 
+#if CAN_XR_AUTH_MAC_LEN_MAX > MAC_LEN
+#error "Data MAC longer than the bpmac tag"
+#endif
+
 
 
 #define shift_in(v, b) (((v) << 1) | ((b) & 0x1))
@@ -84,9 +95,10 @@ static void mac_data_req(
         switch(format)
         {
         case CAN_XR_FORMAT_CBFF:
+        case CAN_XR_FORMAT_CEFF:
             /* Save arguments in MAC state for later use. */
             mac->state.tx_identifier = identifier;
-            mac->state.tx_format = format; /* TBD: We'll support more */
+            mac->state.tx_format = format;
             mac->state.tx_dlc = dlc;
             /* Clear tx_data completely, then fill the right amount */
             memset(mac->state.tx_data, 0, sizeof(mac->state.tx_data));
@@ -122,36 +134,382 @@ static uint16_t crc_nxtbit(uint16_t crc, uint16_t nxtbit)
     return crc;
 }
 
-static void resynchronize_nonce(struct CAN_XR_MAC_State *state)
+/* Advance a 128-bit nonce by n, propagating the carry into the upper
+   half.
+*/
+static void advance_nonce(uint64_t nonce[2], uint64_t n)
 {
-    /* set new nonce */
-    uint64_t backup_nonce[2] = {state->src_nonce[0], state->src_nonce[1]};
-    memcpy(((uint8_t *) &state->src_nonce[1]) + 3, state->rx_data, 5);
-    state->src_nonce[0] = 0;
+    if ((nonce[0] += n) < n)
+    {
+        nonce[1]++;
+    }
+}
+
+/* Execute one slice of the deferred work at the head of the queue,
+   if any.
+*/
+static void run_work_slice(struct CAN_XR_MAC *mac)
+{
+    struct CAN_XR_MAC_State *state = &mac->state;
+
+    if (state->work_head == state->work_tail)
+        return;
 
-    /* validate MAC */
-    bpmac_pre(state->mac_ctx, (uint8_t *) state->src_nonce, (char *) state->tx_src_mac);
+    struct CAN_XR_MAC_Work *work = &state->work[state->work_head];
+    int done;
+
+    PROFILE_ENTER(CAN_XR_PROFILE_BPMAC);
+    done = work->fn(mac, work->arg);
+    PROFILE_EXIT(CAN_XR_PROFILE_BPMAC);
+
+    if (done)
+    {
+        state->work_head = (state->work_head + 1) % CAN_XR_MAC_WORK_QUEUE_LEN;
+        METRIC_SET(CAN_XR_METRIC_WORK_QUEUE,
+                   (state->work_tail - state->work_head + CAN_XR_MAC_WORK_QUEUE_LEN) % CAN_XR_MAC_WORK_QUEUE_LEN);
+    }
+}
+
+/* Queue 'fn', 'arg' for execution at the next sample points with
+   slack.  If the queue is full, the work at its head is completed
+   immediately to make room for it.
+*/
+static void defer_work(struct CAN_XR_MAC *mac, CAN_XR_MAC_Work_t fn, void *arg)
+{
+    struct CAN_XR_MAC_State *state = &mac->state;
+    int next = (state->work_tail + 1) % CAN_XR_MAC_WORK_QUEUE_LEN;
 
-    for(int8_t i = 10; i >= 0; i--) {
-        bpmac_update(state->mac_ctx, (state->rx_identifier & (1 << i)), (char *) state->tx_src_mac);
+    while (next == state->work_head)
+    {
+        TRACE(9, "MAC deferred work queue full");
+        run_work_slice(mac);
     }
-    bpmac_sign(state->mac_ctx, (char *) state->rx_data, 5, (char *) state->tx_src_mac);
 
-    if (!(state->rx_data[5] == state->tx_src_mac[1] && state->rx_data[6] == state->tx_src_mac[2] && state->rx_data[7] == state->tx_src_mac[3]))
+    state->work[state->work_tail].fn = fn;
+    state->work[state->work_tail].arg = arg;
+    state->work_tail = next;
+    METRIC_SET(CAN_XR_METRIC_WORK_QUEUE,
+               (state->work_tail - state->work_head + CAN_XR_MAC_WORK_QUEUE_LEN) % CAN_XR_MAC_WORK_QUEUE_LEN);
+}
+
+/* Deferred work: one AES round of the masking tag of key slot 'arg',
+   started by bpmac_pre_begin().
+*/
+static int precompute_slice(struct CAN_XR_MAC *mac, void *arg)
+{
+    struct CAN_XR_Key_Slot *key_slot = arg;
+
+    (void) mac;
+
+    return bpmac_pre_step(&key_slot->ctx, NULL);
+}
+
+/* Deferred work: skip the nonces of the frames of key slot 'arg'
+   that were not authenticated in time, once its pending masking tag
+   is complete, and precompute the one of the next frame.
+*/
+static int late_slice(struct CAN_XR_MAC *mac, void *arg)
+{
+    struct CAN_XR_Key_Slot *key_slot = arg;
+
+    (void) mac;
+
+    if (!bpmac_pre_step(&key_slot->ctx, NULL))
+        return 0;
+
+    if (key_slot->late == 0)
+        return 1;
+
+    advance_nonce(key_slot->src_nonce, key_slot->late);
+    key_slot->late = 0;
+    return bpmac_pre_begin(&key_slot->ctx, (uint8_t *) key_slot->src_nonce, NULL);
+}
+
+/* Account, at EOF, 'n' nonces of 'key_slot' the sender used for a
+   frame that was not authenticated in time, or that could not move
+   the nonce forward.  They are skipped as soon as the slot has no
+   work pending.
+*/
+static void skip_late_nonce(struct CAN_XR_MAC *mac, struct CAN_XR_Key_Slot *key_slot, int n)
+{
+    if (key_slot->late == 0)
+        defer_work(mac, late_slice, key_slot);
+    key_slot->late += n;
+}
+
+#if CAN_XR_NONCE_HINT_BITS > 0
+/* Realign the source nonce with the hint carried in the first data
+   byte of the frame being received.  The data bits received so far
+   are already accumulated in the tag; since they do not depend on the
+   nonce, replacing the nonce contribution is enough.  This can only
+   be done when the new nonce falls in the block cached by bpmac_pre,
+   otherwise the frame cannot be authenticated in time and it is lost,
+   but the new nonce is adopted anyway at EOF.
+*/
+static void apply_nonce_hint(struct CAN_XR_MAC_State *state)
+{
+    uint64_t *src_nonce = state->key_slot->src_nonce;
+    uint64_t nonce[2] = {src_nonce[0], src_nonce[1]};
+
+    state->nonce_delta = CAN_XR_NONCE_HINT_DELTA(
+        CAN_XR_NONCE_HINT_SRC(state->rx_data[0]), src_nonce[0]);
+
+    METRIC_SET(CAN_XR_METRIC_NONCE_DELTA, state->nonce_delta);
+    if (state->nonce_delta == 0)
+        return;
+
+    advance_nonce(nonce, state->nonce_delta);
+    PROFILE_ENTER(CAN_XR_PROFILE_BPMAC);
+    int remasked = bpmac_remask(state->mac_ctx, (uint8_t *) src_nonce, (uint8_t *) nonce, (char *) state->tx_src_mac);
+    PROFILE_EXIT(CAN_XR_PROFILE_BPMAC);
+    if (!remasked)
     {
-        /* if MAC incorrect, reset nonce to old value */
-        led_on(led2);
-        memcpy(&state->src_nonce, &backup_nonce, 16);
+        TRACE(9, "MAC nonce hint out of cached block (%d)", state->nonce_delta);
+        METRIC_INC(CAN_XR_METRIC_NONCE_CACHE_MISSES);
     }
     else
     {
-        led_on(led4);
-        if (++state->src_nonce[0] == 0)
+        METRIC_INC(CAN_XR_METRIC_NONCE_CACHE_HITS);
+    }
+}
+#endif
+
+/* Look up the base identifier just received in the authentication
+   policy and select its key slot, in constant time.  Unauthenticated
+   frames skip all bpmac work.  Otherwise the bpmac computation is
+   started from the masking tag precomputed in the slot.  The
+   identifier bits are accumulated later, by accumulate_identifier(),
+   once the format tells how many of them there are.
+*/
+static void select_key_slot(struct CAN_XR_MAC *mac)
+{
+    struct CAN_XR_MAC_State *state = &mac->state;
+    const struct CAN_XR_Auth_Rule *rule =
+        CAN_XR_Auth_Policy_Rule(mac->policy, state->rx_identifier);
+
+    if (rule == NULL || rule->key_index >= CAN_XR_MAC_KEY_SLOTS)
+    {
+        state->skip_mac = 1;
+        return;
+    }
+
+    struct CAN_XR_Key_Slot *key_slot = &mac->storage.slot[rule->key_index];
+    struct CAN_XR_Resync *resync = &mac->storage.resync;
+
+    state->key_slot = key_slot;
+    state->mac_ctx = &key_slot->ctx;
+
+    /* The masking tag must be ready now.  At full bus load there is
+       enough slack between EOF and here to compute it.  If frames of
+       several slots or a resynchronization queued more work than
+       that, at most CAN_XR_MAC_LATE_ROUNDS rounds are completed here,
+       out of order, and if the tag is still not ready the frame is
+       not authenticated.  Its nonce is skipped at EOF.
+    */
+    if (resync->phase == 0 || resync->slot != key_slot)
+    {
+        PROFILE_ENTER(CAN_XR_PROFILE_BPMAC);
+        for (int n = 0; n < CAN_XR_MAC_LATE_ROUNDS && bpmac_pre_pending(state->mac_ctx); n++)
+            bpmac_pre_step(state->mac_ctx, NULL);
+        PROFILE_EXIT(CAN_XR_PROFILE_BPMAC);
+    }
+
+    if ((resync->phase != 0 && resync->slot == key_slot)
+        || resync->next_slot == key_slot
+        || key_slot->late != 0
+        || bpmac_pre_pending(state->mac_ctx))
+    {
+        TRACE(9, "MAC masking tag not ready, frame not authenticated");
+        METRIC_INC(CAN_XR_METRIC_LATE_TAGS);
+        state->skip_mac = 1;
+        state->rx_late = 1;
+        return;
+    }
+
+    PROFILE_ENTER(CAN_XR_PROFILE_BPMAC);
+    bpmac_reset(state->mac_ctx, (char *) state->tx_src_mac);
+    PROFILE_EXIT(CAN_XR_PROFILE_BPMAC);
+}
+
+/* Accumulate the identifier of the frame being received, 11 bits in
+   CBFF and 29 in CEFF, into its tag in one go, with the identifier
+   tables of bpmac.  This costs the same few XORs whatever the format.
+*/
+static void accumulate_identifier(struct CAN_XR_MAC *mac)
+{
+    struct CAN_XR_MAC_State *state = &mac->state;
+
+    if (!state->skip_mac)
+    {
+        PROFILE_ENTER(CAN_XR_PROFILE_BPMAC);
+        bpmac_update_id(state->mac_ctx, state->rx_identifier,
+                        state->rx_ide ? 29 : 11, (char *) state->tx_src_mac);
+        PROFILE_EXIT(CAN_XR_PROFILE_BPMAC);
+    }
+}
+
+/* Select the aggregated mode accumulator of the frame being received,
+   once the MAC length, hence the checkpoint, is known.
+*/
+static void select_accumulator(struct CAN_XR_MAC *mac)
+{
+    const struct CAN_XR_Auth_Rule *rule = CAN_XR_Auth_Policy_Rule(
+        mac->policy,
+        CAN_XR_Auth_Policy_Key(mac->state.rx_identifier, mac->state.rx_ide));
+
+    mac->state.rx_agg_mac = rule->aggregate ?
+        mac->storage.agg_src_mac[rule - mac->policy->rule] : NULL;
+    mac->state.rx_checkpoint =
+        CAN_XR_Auth_Policy_Is_Checkpoint(rule, mac->state.rx_mac_len);
+}
+
+/* Deferred work: nonce resynchronization of storage.resync, one
+   slice at a time.
+
+   Phase 1 sets the new nonce and starts computing its masking tag,
+   phase 2 completes it, phase 3 validates the frame and starts
+   computing the masking tag of the next frame, with the new nonce if
+   the frame is correct and with the old one otherwise, and phase 4
+   completes it.  Then the resynchronization frame waiting, if any,
+   starts over from phase 1.
+*/
+static int resync_slice(struct CAN_XR_MAC *mac, void *arg)
+{
+    struct CAN_XR_Resync *resync = &mac->storage.resync;
+    bpmac_ctx_t *ctx = &resync->slot->ctx;
+    uint64_t *src_nonce = resync->slot->src_nonce;
+
+    (void) arg;
+
+    switch (resync->phase)
+    {
+    case 1:
+        /* A masking tag of the slot still being computed is completed
+           first, one round per slice, bpmac_pre_begin() would refuse
+           to start another one.
+        */
+        if (!bpmac_pre_step(ctx, NULL))
+            break;
+
+        /* set new nonce */
+        memcpy(resync->backup_nonce, src_nonce, 16);
+        memcpy(((uint8_t *) &src_nonce[1]) + 3, resync->data, 5);
+        src_nonce[0] = 0;
+
+        resync->phase = bpmac_pre_begin(ctx, (uint8_t *) src_nonce, (char *) resync->tag) ? 3 : 2;
+        break;
+
+    case 2:
+    case 4:
+        if (bpmac_pre_step(ctx, (char *) resync->tag))
+            resync->phase = (resync->phase == 2) ? 3 : 0;
+        break;
+
+    case 3:
+        /* validate MAC */
+        bpmac_update_id(ctx, resync->identifier, 11, (char *) resync->tag);
+        bpmac_sign(ctx, (char *) resync->data, 5, (char *) resync->tag);
+
+        if (memcmp(resync->data + 5, resync->tag + MAC_LEN - 3, 3) != 0)
         {
-            state->src_nonce[1]++;
+            /* if MAC incorrect, reset nonce to old value.  The
+               context holds the masking tag of the new nonce,
+               recompute the one of the old nonce.
+            */
+            led_on(led2);
+            memcpy(src_nonce, resync->backup_nonce, 16);
         }
-        bpmac_pre(state->mac_ctx, (uint8_t *) state->src_nonce, (char *) state->tx_src_mac);
+        else
+        {
+            led_on(led4);
+            METRIC_INC(CAN_XR_METRIC_RESYNCS);
+            advance_nonce(src_nonce, 1);
+        }
+        resync->phase = bpmac_pre_begin(ctx, (uint8_t *) src_nonce, (char *) resync->tag) ? 0 : 4;
+        break;
+
+    default:
+        break;
+    }
+
+    if (resync->phase == 0 && resync->next_slot != NULL)
+    {
+        resync->slot = resync->next_slot;
+        resync->identifier = resync->next_identifier;
+        memcpy(resync->data, resync->next_data, 8);
+        resync->next_slot = NULL;
+        resync->phase = 1;
+    }
+
+    return resync->phase == 0;
+}
+
+/* Start the nonce resynchronization of 'key_slot' carried by the
+   frame just received.
+*/
+static void resynchronize_nonce(struct CAN_XR_MAC *mac, struct CAN_XR_Key_Slot *key_slot)
+{
+    struct CAN_XR_Resync *resync = &mac->storage.resync;
+
+    /* Back-to-back resynchronization frames, the last one waits for
+       the first to complete.
+    */
+    if (resync->phase != 0)
+    {
+        if (resync->next_slot != NULL)
+            TRACE(9, "MAC nonce resynchronization superseded");
+        resync->next_slot = key_slot;
+        resync->next_identifier = mac->state.rx_identifier;
+        memcpy(resync->next_data, mac->state.rx_data, 8);
+        return;
     }
+
+    resync->slot = key_slot;
+    resync->identifier = mac->state.rx_identifier;
+    memcpy(resync->data, mac->state.rx_data, 8);
+    resync->phase = 1;
+    defer_work(mac, resync_slice, NULL);
+}
+
+/* Start receiving the CRC field of an FD frame, made of the stuff
+   count and a 17- or 21-bit CRC.  It is not dynamically stuffed;
+   instead, a fixed stuff bit comes first and then after every fourth
+   bit [1] 10.5.  .nc_bits counts the bits since the last one, see
+   pcs_data_ind().  As for classical frames, the CRC is not checked.
+*/
+static void rx_fd_crc_field(struct CAN_XR_MAC_State *state)
+{
+    state->field_bits = 4 + ((state->rx_len > 16) ? 21 : 17) - 1;
+    state->nc_bits = 4;
+    state->rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_FD_CRC;
+}
+
+/* Identifier class of the frame being received, for the latency
+   histograms.  FD frames are not authenticated.
+*/
+static int latency_class(const struct CAN_XR_MAC *mac)
+{
+    if(mac->state.rx_fdf)
+        return CAN_XR_LATENCY_UNAUTHENTICATED;
+    return CAN_XR_Latency_Class(
+        mac->policy,
+        CAN_XR_Auth_Policy_Key(mac->state.rx_identifier, mac->state.rx_ide));
+}
+
+/* A frame has been validated at EOF.  Account the time its payload,
+   data field and the whole frame took since SOF.
+*/
+static void rx_latency(struct CAN_XR_MAC *mac, unsigned long ts)
+{
+    struct CAN_XR_MAC_State *state = &mac->state;
+    int cls = latency_class(mac);
+
+    CAN_XR_Latency_Record(mac->latency, cls, CAN_XR_LATENCY_DATA,
+                          state->rx_data_ts - state->rx_sof_ts);
+    CAN_XR_Latency_Record(mac->latency, cls, CAN_XR_LATENCY_MAC,
+                          state->rx_mac_ts - state->rx_sof_ts);
+    CAN_XR_Latency_Record(mac->latency, cls, CAN_XR_LATENCY_EOF,
+                          ts - state->rx_sof_ts);
 }
 
 /* Static primitive invoked on all de-stuffed bits after SOF while the
@@ -161,10 +519,8 @@ static void resynchronize_nonce(struct CAN_XR_MAC_State *state)
 
    TBD:
 
-   - We currently support only CBFF
    - We don't implement OF
-   - We don't handle intermission
-   - We allow hard synchronization even in the first bit of intermission
+   - FD frames: the protocol exception state is unsupported
 */
 static void de_stuffed_data_ind(
     struct CAN_XR_MAC *mac, unsigned long ts, int input_unit)
@@ -182,12 +538,16 @@ static void de_stuffed_data_ind(
            because they must consider the de-stuffed data stream.
         */
         TRACE(2, "MAC @%lu SOF received (%d)", ts, input_unit);
+        CAPTURE_EVENT(CAN_XR_CAPTURE_SOF);
+        mac->state.rx_sof_ts = ts;
 
         /* Disable hard synchronization per [1] 11.3.2.1 c) */
         CAN_XR_PCS_Hard_Sync_Allowed_Req(mac->pcs, 0);
         /* As we do no CRC check, we do not need to initialize and compute it */
         mac->state.field_bits = 10;
         mac->state.rx_identifier = 0;
+        mac->state.rx_ide = 0;
+        mac->state.rx_fdf = 0;
         mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_IDENTIFIER;
         break;
 
@@ -202,20 +562,10 @@ static void de_stuffed_data_ind(
         mac->state.rx_identifier =
             shift_in(mac->state.rx_identifier, input_unit);
 
-        /* in this implementation, all identifier share the same key, so we can start to precompute the MAC here, just
-           in case that the identifier indicates an authenticated message. If we have different keys for different
-           identifier, it will not work here, but could be precomputed and moved into the bpmac_pre() function.
-         */
-        bpmac_update(mac->state.mac_ctx, input_unit, (char *) mac->state.tx_src_mac);
-
         /* Update CRC and switch to the control field if needed. */
         if(mac->state.field_bits-- == 0)
         {
-            if (mac->state.rx_identifier > 256)
-            {
-                mac->state.skip_mac = 1;
-                bpmac_reset(mac->state.mac_ctx, (char *) mac->state.tx_src_mac);
-            }
+            select_key_slot(mac);
 
             mac->state.field_bits = 1;
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_RTR;
@@ -224,40 +574,69 @@ static void de_stuffed_data_ind(
 
     case CAN_XR_MAC_RX_FSM_RX_RTR:
 
-        /* TBD: RTR bit unchecked, shall be dominant because we do not
+        /* RTR in CBFF, SRR in CEFF until IDE tells.  The CEFF RTR bit
+           comes back here after the identifier extension, with
+           .rx_ide already set.
+
+           TBD: RTR bit unchecked, shall be dominant because we do not
            support RTR frames at this time.
         */
         mac->state.rx_rtr = input_unit;
-        mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_IDE;
+        if(mac->state.rx_ide != 0)
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_FDF;
+        else
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_IDE;
         break;
 
     case CAN_XR_MAC_RX_FSM_RX_IDE:
         mac->state.rx_ide = input_unit;
 
-        /* TBD: We currently support only CBFF, it must be IDE=0. */
         if(mac->state.rx_ide != 0)
         {
-            TRACE(2, "MAC @%lu xEFF formats unsupported", ts);
-            mac->state.field_bits = 11;
-            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR;
+            /* CEFF, the 18-bit identifier extension follows */
+            mac->state.field_bits = 17;
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_ID_EXT;
         }
 
         else
         {
+            accumulate_identifier(mac);
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_FDF;
         }
 
         break;
 
+    case CAN_XR_MAC_RX_FSM_RX_ID_EXT:
+        mac->state.rx_identifier =
+            shift_in(mac->state.rx_identifier, input_unit);
+
+        if(mac->state.field_bits-- == 0)
+        {
+            accumulate_identifier(mac);
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_RTR;
+        }
+        break;
+
     case CAN_XR_MAC_RX_FSM_RX_FDF:
         mac->state.rx_fdf = input_unit;
 
-        /* TBD: We currently support only CBFF, it must be FDF=0. */
-        if(mac->state.rx_ide != 0)
+        /* FD frames are not authenticated.  Their data phase may
+           be faster than the bpmac computation can follow, and the
+           policy covers classical frames only.  We just follow them
+           to the end.
+
+           CEFF has one more reserved bit, r0, and FD frames have res
+           before BRS and ESI.
+        */
+        if(mac->state.rx_fdf != 0)
         {
-            TRACE(2, "MAC @%lu FBFF format unsupported", ts);
-            mac->state.field_bits = 11;
-            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR;
+            mac->state.skip_mac = 1;
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_R0;
+        }
+
+        else if(mac->state.rx_ide != 0)
+        {
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_R0;
         }
 
         else
@@ -269,33 +648,79 @@ static void de_stuffed_data_ind(
 
         break;
 
+    case CAN_XR_MAC_RX_FSM_RX_R0:
+        if(mac->state.rx_fdf != 0)
+        {
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_BRS;
+            break;
+        }
+        mac->state.field_bits= 3;
+        mac->state.rx_dlc = 0;
+        mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_DLC;
+        break;
+
+    case CAN_XR_MAC_RX_FSM_RX_BRS:
+        /* The data phase goes from this sample point to the one of
+           CDEL, or until an error is detected.
+        */
+        mac->state.rx_brs = input_unit;
+        if(mac->state.rx_brs != 0)
+            CAN_XR_PCS_Bit_Rate_Switch_Req(mac->pcs, 1);
+        mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_ESI;
+        break;
+
+    case CAN_XR_MAC_RX_FSM_RX_ESI:
+        mac->state.rx_esi = input_unit;
+        mac->state.field_bits= 3;
+        mac->state.rx_dlc = 0;
+        mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_DLC;
+        break;
+
     case CAN_XR_MAC_RX_FSM_RX_DLC:
 
         mac->state.rx_dlc = shift_in(mac->state.rx_dlc, input_unit);
         if(mac->state.field_bits-- == 0)
         {
+            /* The length of the data MAC depends on the policy and is
+               bounded by the DLC, frames too short to carry one are
+               not authenticated.
+            */
+            mac->state.rx_mac_len = mac->state.skip_mac ? 0 :
+                CAN_XR_Auth_Policy_MAC_Len(
+                    mac->policy,
+                    CAN_XR_Auth_Policy_Key(mac->state.rx_identifier, mac->state.rx_ide),
+                    mac->state.rx_dlc);
+            if (mac->state.rx_mac_len == 0)
+                mac->state.skip_mac = 1;
+            else
+                select_accumulator(mac);
+
             /* Calculate how many bits the data field has.  It may be
                empty, skip directly to the CRC in that case, and
-               8 byte at a max.
+               8 byte at a max, 64 in FD frames.
             */
+            mac->state.rx_len = CAN_XR_DLC_Len(
+                mac->state.rx_fdf ? CAN_XR_FORMAT_FBFF : CAN_XR_FORMAT_CBFF,
+                mac->state.rx_dlc);
+
+            /* Latency marks, they stay here if the data field is empty */
+            mac->state.rx_data_ts = mac->state.rx_mac_ts = ts;
             if (mac->state.rx_dlc > 0)
             {
                 /* dlc will transmit the whole length of the payload, we
-                * reduce it here by 3 byte, as it will be handled as data MAC.
+                * reduce it here by the data MAC length, as it will be handled as data MAC.
                 */
-                if (mac->state.skip_mac)
-                {
-                    mac->state.field_bits = 8 * ((mac->state.rx_dlc > 8) ? 8: mac->state.rx_dlc) - 1;
-                }
-                else
-                {
-                    mac->state.field_bits = 8 * ((mac->state.rx_dlc > 8) ? 5: mac->state.rx_dlc - 3) - 1;
-                }
+                mac->state.field_bits =
+                    8 * (mac->state.rx_len - mac->state.rx_mac_len) - 1;
                 memset(mac->state.rx_data, 0, sizeof(mac->state.rx_data));
                 mac->state.rx_byte = 0;
                 mac->state.rx_byte_index = 0;
                 mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_DATA;
             }
+            else if (mac->state.rx_fdf != 0)
+            {
+                rx_fd_crc_field(&mac->state);
+            }
             else
             {
                 mac->state.field_bits = 14;
@@ -309,7 +734,9 @@ static void de_stuffed_data_ind(
         mac->state.rx_byte = shift_in(mac->state.rx_byte, input_unit);
 
         if (!mac->state.skip_mac) {
+            PROFILE_ENTER(CAN_XR_PROFILE_BPMAC);
             bpmac_update(mac->state.mac_ctx, input_unit, (char *) mac->state.tx_src_mac);
+            PROFILE_EXIT(CAN_XR_PROFILE_BPMAC);
         }
 
         if(mac->state.field_bits % 8 == 0)
@@ -319,30 +746,49 @@ static void de_stuffed_data_ind(
                within a byte are transmitted big-endian, bytes within
                the data field are transmitted little-endian.  See [1],
                Figures 12-17.Interesting.
-
-               TBD: Are we sure we don't read rx_data[8] in this way?
             */
             mac->state.rx_data[mac->state.rx_byte_index++] = mac->state.rx_byte;
 
             mac->state.rx_byte = 0;
+
+#if CAN_XR_NONCE_HINT_BITS > 0
+            /* The nonce synchronization frame carries no hint. */
+            if(mac->state.rx_byte_index == 1 && !mac->state.skip_mac
+               && (mac->state.rx_ide || mac->state.rx_identifier != 200))
+            {
+                apply_nonce_hint(&mac->state);
+            }
+#endif
         }
 
         if(mac->state.field_bits-- == 0)
         {
-            if (mac->state.skip_mac)
+            mac->state.rx_data_ts = mac->state.rx_mac_ts = ts;
+            if (mac->state.rx_fdf != 0)
+            {
+                rx_fd_crc_field(&mac->state);
+            }
+            else if (mac->state.skip_mac)
             {
                 mac->state.field_bits = 14;
                 mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_CRC;
             }
             else
             {
+                PROFILE_ENTER(CAN_XR_PROFILE_BPMAC);
                 bpmac_finish(mac->state.mac_ctx, (char *) mac->state.tx_src_mac);
+                PROFILE_EXIT(CAN_XR_PROFILE_BPMAC);
 
-                mac->state.mac_byte_index = 1;
+                /* Checkpoint: cumulative tag, committed at EOF */
+                if (mac->state.rx_agg_mac && mac->state.rx_checkpoint)
+                    xor_tags(mac->state.tx_src_mac, mac->state.rx_agg_mac);
+
+                /* Overwrite window: the last .rx_mac_len bytes of the tag */
+                mac->state.mac_byte_index = MAC_LEN - mac->state.rx_mac_len;
                 mac->state.tx_mac_shift_reg = shift_prepare(mac->state.tx_src_mac[mac->state.mac_byte_index++], 8);
 
                 CAN_XR_PCS_Set_Fast_Pass(mac->pcs, 1);
-                mac->state.field_bits = 23;
+                mac->state.field_bits = 8 * mac->state.rx_mac_len - 1;
                 mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_DATA_MAC;
             }
         }
@@ -354,6 +800,7 @@ static void de_stuffed_data_ind(
 
         if(mac->state.field_bits == 0)
         {
+            mac->state.rx_mac_ts = ts;
             CAN_XR_PCS_Reset_Fast_Pass(mac->pcs);
             mac->state.field_bits = 14;
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_CRC;
@@ -388,11 +835,23 @@ static void de_stuffed_data_ind(
         }
         break;
 
+    case CAN_XR_MAC_RX_FSM_RX_FD_CRC:
+        /* Stuff count and CRC, unchecked as above */
+        if(mac->state.field_bits-- == 0)
+        {
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_CDEL;
+        }
+        break;
+
     case CAN_XR_MAC_RX_FSM_RX_CDEL:
+        /* End of the data phase of FD frames */
+        CAN_XR_PCS_Bit_Rate_Switch_Req(mac->pcs, 0);
 
         if(input_unit != 1)
         {
             TRACE(9, ">>> MAC @%lu CDEL form error", ts);
+            METRIC_INC(CAN_XR_METRIC_FORM_ERRORS);
+            CAPTURE_EVENT(CAN_XR_CAPTURE_FORM_ERROR);
             mac->state.field_bits = 11;
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR;
             led_on(led2);
@@ -419,6 +878,8 @@ static void de_stuffed_data_ind(
 
         if(input_unit != 0)
         {
+            METRIC_INC(CAN_XR_METRIC_ACK_ERRORS);
+            CAPTURE_EVENT(CAN_XR_CAPTURE_ACK_ERROR);
             mac->state.field_bits = 11;
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR;
             led_on(led2);
@@ -436,6 +897,8 @@ static void de_stuffed_data_ind(
 
         if(input_unit != 1)
         {
+            METRIC_INC(CAN_XR_METRIC_FORM_ERRORS);
+            CAPTURE_EVENT(CAN_XR_CAPTURE_FORM_ERROR);
             mac->state.field_bits = 11;
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR;
             led_on(led2);
@@ -443,7 +906,7 @@ static void de_stuffed_data_ind(
 
         else
         {
-            mac->state.field_bits = 2;  // reduced EOF length, to buy some time
+            mac->state.field_bits = 6;
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_EOF;
         }
         break;
@@ -461,6 +924,8 @@ static void de_stuffed_data_ind(
         */
         if(input_unit != 1 && mac->state.field_bits != 0)
         {
+            METRIC_INC(CAN_XR_METRIC_FORM_ERRORS);
+            CAPTURE_EVENT(CAN_XR_CAPTURE_FORM_ERROR);
             mac->state.field_bits = 11;
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR;
             led_on(led2);
@@ -468,29 +933,82 @@ static void de_stuffed_data_ind(
 
         else if(mac->state.field_bits-- == 0)
         {
-            if (mac->state.skip_mac) {
-                if (mac->state.rx_identifier == 385)
+            METRIC_INC(CAN_XR_METRIC_RX_FRAMES);
+            CAPTURE_EVENT(CAN_XR_CAPTURE_FRAME_OK);
+            if (mac->latency)
+                rx_latency(mac, ts);
+            if (mac->state.rx_late) {
+                /* The sender used a nonce, unless the frame is too
+                   short to carry a data MAC.
+                */
+                if (!mac->state.rx_fdf
+                    && CAN_XR_Auth_Policy_MAC_Len(
+                        mac->policy,
+                        CAN_XR_Auth_Policy_Key(mac->state.rx_identifier, mac->state.rx_ide),
+                        mac->state.rx_dlc) != 0)
+                    skip_late_nonce(mac, mac->state.key_slot, 1);
+            }
+            else if (mac->state.skip_mac) {
+                /* nonce_resync message?  Few slots, scan them.  They
+                   are CBFF frames.
+                */
+                for (int i = 0;
+                     i < CAN_XR_MAC_KEY_SLOTS && !mac->state.rx_ide && !mac->state.rx_fdf;
+                     i++)
                 {
-                    /* nonce_resync message */
-                    led_on(led3);
-                    resynchronize_nonce(&mac->state);
+                    if (mac->storage.slot[i].resync_id == mac->state.rx_identifier)
+                    {
+                        led_on(led3);
+                        resynchronize_nonce(mac, &mac->storage.slot[i]);
+                        break;
+                    }
                 }
             }
             else
             {
                 reset_leds();
-                if (++mac->state.src_nonce[0] == 0)
+                if (mac->state.rx_agg_mac)
                 {
-                    mac->state.src_nonce[1]++;
+                    if (mac->state.rx_checkpoint)
+                        memset(mac->state.rx_agg_mac, 0, 16);
+                    else
+                        xor_tags(mac->state.rx_agg_mac, mac->state.tx_src_mac);
+                }
+
+                /* select_key_slot() only lets the frame through with no
+                   masking tag being computed for its slot, and nothing
+                   starts one until here.  Should one be in progress
+                   anyway, the nonces are moved forward by the deferred
+                   work of the late frames, once it is complete.
+                */
+                if (bpmac_pre_pending(mac->state.mac_ctx))
+                {
+                    skip_late_nonce(mac, mac->state.key_slot, 1 + mac->state.nonce_delta);
+                }
+                else
+                {
+                    advance_nonce(mac->state.key_slot->src_nonce, 1 + mac->state.nonce_delta);
+
+                    /* On a nonce cache miss, the AES encryption is
+                       spread over the next sample points with slack.
+                    */
+                    PROFILE_ENTER(CAN_XR_PROFILE_BPMAC);
+                    int cached = bpmac_pre_begin(mac->state.mac_ctx, (uint8_t *) mac->state.key_slot->src_nonce, (char *) mac->state.tx_src_mac);
+                    PROFILE_EXIT(CAN_XR_PROFILE_BPMAC);
+                    if (!cached)
+                    {
+                        METRIC_INC(CAN_XR_METRIC_NONCE_CACHE_MISSES);
+                        defer_work(mac, precompute_slice, mac->state.key_slot);
+                    }
+                    else
+                    {
+                        METRIC_INC(CAN_XR_METRIC_NONCE_CACHE_HITS);
+                    }
                 }
-                bpmac_pre(mac->state.mac_ctx, (uint8_t *) mac->state.src_nonce, (char *) mac->state.tx_src_mac);
             }
-            /* TBD: We don't handle intermission properly.  Moreover,
-               we shouldn't allow hard synchronization in the first
-               bit of intermission 11.3.2.1 c)
-            */
-            CAN_XR_PCS_Hard_Sync_Allowed_Req(mac->pcs, 1);
-            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_IDLE;
+            /* Intermission follows, see pcs_data_ind() */
+            mac->state.field_bits = 2;
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_INTERMISSION;
         }
         break;
 
@@ -503,12 +1021,16 @@ static void de_stuffed_data_ind(
    This is the starting point for MAC-layer processing.
 
    Bus off condition unchecked / recovery unsupported.
-   FD tolerant / FD enabled MAC unsupported.
 */
 static void pcs_data_ind(
     struct CAN_XR_MAC *mac, unsigned long ts, int input_unit)
 {
     TRACE(2, "MAC @%lu Common::pcs_data_ind(%d)", ts, input_unit);
+    /* The receive FSM changed state at the previous bit */
+    if(mac->state.rx_fsm_state != mac->state.rx_fsm_entry)
+        CAPTURE(CAN_XR_CAPTURE_RX_STATE, mac->state.rx_fsm_state);
+    mac->state.rx_fsm_entry = mac->state.rx_fsm_state;
+    PROFILE_STATE(mac->state.rx_fsm_state);
 
     /* Handle rx FSM first */
     switch(mac->state.rx_fsm_state)
@@ -541,6 +1063,37 @@ static void pcs_data_ind(
         }
         break;
 
+    case CAN_XR_MAC_RX_FSM_INTERMISSION:
+        /* Intermission, 3 recessive bits after EOF [1] 10.4.5.  Hard
+           synchronization is allowed again after the first one [1]
+           11.3.2.1 c).  A dominant bit at the third bit is a SOF, [1]
+           10.4.2.2, and a node with a pending frame transmits it from the
+           first identifier bit on.  A dominant bit at the first or second
+           bit calls for an OF, which we don't implement.  We handle it like
+           an error, an OF has the same form as an error frame.
+        */
+        if(input_unit == 1)
+        {
+            if(mac->state.field_bits == 2)
+                CAN_XR_PCS_Hard_Sync_Allowed_Req(mac->pcs, 1);
+
+            if(mac->state.field_bits-- == 0)
+                mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_IDLE;
+            break;
+        }
+
+        if(mac->state.field_bits != 0)
+        {
+            TRACE(9, ">>> MAC @%lu overload condition", ts);
+            mac->state.field_bits = 11;
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR;
+            led_on(led2);
+            break;
+        }
+
+        TRACE(2, ">>> MAC @%lu SOF in intermission", ts);
+        mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_IDLE;
+        /* Fall through */
     case CAN_XR_MAC_RX_FSM_IDLE:
         if(input_unit == 0)
         {
@@ -551,6 +1104,8 @@ static void pcs_data_ind(
             mac->state.bus_bits = 1;
             mac->state.de_stuffed_bits = 1;
             mac->state.skip_mac = 0;
+            mac->state.rx_late = 0;
+            mac->state.nonce_delta = 0;
 
             de_stuffed_data_ind(mac, ts, input_unit);
         }
@@ -559,7 +1114,11 @@ static void pcs_data_ind(
     case CAN_XR_MAC_RX_FSM_RX_IDENTIFIER:
     case CAN_XR_MAC_RX_FSM_RX_RTR:
     case CAN_XR_MAC_RX_FSM_RX_IDE:
+    case CAN_XR_MAC_RX_FSM_RX_ID_EXT:
     case CAN_XR_MAC_RX_FSM_RX_FDF:
+    case CAN_XR_MAC_RX_FSM_RX_R0:
+    case CAN_XR_MAC_RX_FSM_RX_BRS:
+    case CAN_XR_MAC_RX_FSM_RX_ESI:
     case CAN_XR_MAC_RX_FSM_RX_DLC:
     case CAN_XR_MAC_RX_FSM_RX_DATA:
     case CAN_XR_MAC_RX_FSM_RX_CRC:
@@ -583,6 +1142,8 @@ static void pcs_data_ind(
             /* Expecting a stuff bit, must be the opposite of nc_pol. */
             if(input_unit == mac->state.nc_pol)
             {
+                METRIC_INC(CAN_XR_METRIC_STUFF_ERRORS);
+                CAPTURE_EVENT(CAN_XR_CAPTURE_STUFF_ERROR);
                 mac->state.field_bits = 11;
                 mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR;
             }
@@ -627,6 +1188,8 @@ static void pcs_data_ind(
             if(input_unit == mac->state.nc_pol)
             {
                 /* Current bit is same polarity as last 5 bits -> Stuff Error */
+                METRIC_INC(CAN_XR_METRIC_STUFF_ERRORS);
+                CAPTURE_EVENT(CAN_XR_CAPTURE_STUFF_ERROR);
                 CAN_XR_PCS_Reset_Fast_Pass(mac->pcs);
                 mac->state.field_bits = 11;
                 mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR;
@@ -666,6 +1229,37 @@ static void pcs_data_ind(
         }
 
         break;
+
+    case CAN_XR_MAC_RX_FSM_RX_FD_CRC:
+        /* Fixed stuff bits, see rx_fd_crc_field().  One with the
+           wrong value is a form error.
+        */
+        mac->state.bus_bits++;
+        if(mac->state.nc_bits == 4)
+        {
+            if(input_unit == mac->state.nc_pol)
+            {
+                METRIC_INC(CAN_XR_METRIC_FORM_ERRORS);
+                CAPTURE_EVENT(CAN_XR_CAPTURE_FORM_ERROR);
+                mac->state.field_bits = 11;
+                mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR;
+                led_on(led2);
+            }
+            else
+            {
+                mac->state.nc_bits = 0;
+                mac->state.nc_pol = input_unit;
+            }
+        }
+        else
+        {
+            mac->state.nc_bits++;
+            mac->state.nc_pol = input_unit;
+            mac->state.de_stuffed_bits++;
+            de_stuffed_data_ind(mac, ts, input_unit);
+        }
+        break;
+
     case CAN_XR_MAC_RX_FSM_RX_ACK:
         /* TBD: This is probably a good place to detect ACK errors.
            The transmitter transmits a recessive bit, we should sample
@@ -700,6 +1294,28 @@ static void pcs_data_ind(
         mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_IDLE;
         break;
     }
+
+    /* Back to the nominal bit rate as soon as an error is detected */
+    if(mac->state.rx_fsm_state == CAN_XR_MAC_RX_FSM_ERROR)
+        CAN_XR_PCS_Bit_Rate_Switch_Req(mac->pcs, 0);
+
+    /* The data field, in which the data MAC is computed and
+       overwritten bit by bit, has no slack for deferred work.
+    */
+    if(mac->state.rx_fsm_state != CAN_XR_MAC_RX_FSM_RX_DATA
+       && mac->state.rx_fsm_state != CAN_XR_MAC_RX_FSM_RX_DATA_MAC)
+    {
+        run_work_slice(mac);
+    }
+}
+
+/* state_ind primitive of the PMA, see CAN_XR_PMA_Overrun().  The PMA
+   detects an overrun after the chain of callbacks that caused it, so
+   this returns the state the MAC was in when it was last invoked.
+*/
+static int rx_state_ind(struct CAN_XR_PCS *pcs)
+{
+    return pcs->mac->state.rx_fsm_entry;
 }
 
 void CAN_XR_MAC_Common_Init(
@@ -717,33 +1333,45 @@ void CAN_XR_MAC_Common_Init(
 
     */
     mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_BUS_INTEGRATION;
+    mac->state.rx_fsm_entry = CAN_XR_MAC_RX_FSM_BUS_INTEGRATION;
     mac->state.bus_integration_counter = 0;
 
     mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_IDLE;
     mac->state.data_req_pending = 0;
 
     mac->state.skip_mac = 0;
-
-    /* load keys and nonce into DATA_MAC_Storage
-     * Additionally set state pointer, which would be
-     * done depending on frame ID */
+    mac->state.rx_late = 0;
+    mac->state.nonce_delta = 0;
+
+    mac->state.work_head = 0;
+    mac->state.work_tail = 0;
+    mac->storage.resync.phase = 0;
+    mac->storage.resync.next_slot = NULL;
+
+    /* Load the keys of the evaluation sender into key slot 0, which
+       is resynchronized by identifier 385 and is the one used by the
+       default authentication policy.  Further slots are loaded by the
+       application.
+    */
     uint8_t src_key[] = {0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07};
     uint8_t src_key_nonce[] = {0x22, 0x11, 0x27, 0x09, 0x22, 0x11, 0x27, 0x09,0x22, 0x11, 0x27, 0x09 ,0x22, 0x11, 0x27, 0x09};
 
-    memcpy(mac->storage.src_mac_key, src_key, 16);
-    mac->state.src_key = mac->storage.src_mac_key;
+    memset(mac->storage.res_nonce, 0, 16);
+    memset(mac->storage.agg_src_mac, 0, sizeof(mac->storage.agg_src_mac));
+    mac->state.rx_agg_mac = NULL;
+    memset(mac->state.tx_src_mac, 0, 16);
 
-    memcpy(mac->storage.src_nonce_key, src_key_nonce, 16);
-    mac->state.src_nonce_key = mac->storage.src_nonce_key;
+    for (int i = 0; i < CAN_XR_MAC_KEY_SLOTS; i++)
+        mac->storage.slot[i].resync_id = CAN_XR_AUTH_POLICY_IDS; /* None */
 
-    memset(mac->storage.res_nonce, 0, 16);
-    memset(mac->storage.src_nonce, 0, 16);
+    CAN_XR_MAC_Set_Key_Slot(mac, 0, src_key, src_key_nonce);
+    CAN_XR_MAC_Map_Resync_Id(mac, 385, 0);
 
-    memset(mac->state.tx_src_mac, 0, 16);
-    mac->state.mac_ctx = &(mac->storage.ctx);
+    mac->state.key_slot = &mac->storage.slot[0];
+    mac->state.mac_ctx = &mac->storage.slot[0].ctx;
 
-    bpmac_init((char *) mac->state.src_key, (char *) mac->state.src_nonce_key, 8, mac->state.mac_ctx);
-    bpmac_pre(mac->state.mac_ctx, (uint8_t *) mac->state.src_nonce, (char *) mac->state.tx_src_mac);
+    mac->policy = CAN_XR_Auth_Policy_Default();
+    mac->latency = NULL;
 
     /* No data_ind, data_conf for now.  Link the common, static
        data_req, may be overridden by implementation-specific
@@ -757,6 +1385,45 @@ void CAN_XR_MAC_Common_Init(
     /* Link PCS to MAC, register the common, static data_ind */
     CAN_XR_PCS_Set_MAC(pcs, mac);
     CAN_XR_PCS_Set_Data_Ind(pcs, pcs_data_ind);
+
+    /* Account the overruns of the PMA to the receive states */
+    if(pcs->pma)
+        CAN_XR_PMA_Set_State_Ind(pcs->pma, rx_state_ind);
+}
+
+int CAN_XR_MAC_Set_Key_Slot(
+    struct CAN_XR_MAC *mac, int slot,
+    const uint8_t *src_key, const uint8_t *src_key_nonce)
+{
+    struct CAN_XR_Key_Slot *key_slot;
+
+    if(slot < 0 || slot >= CAN_XR_MAC_KEY_SLOTS)
+        return -1;
+
+    key_slot = &mac->storage.slot[slot];
+
+    memcpy(key_slot->src_mac_key, src_key, 16);
+    memcpy(key_slot->src_nonce_key, src_key_nonce, 16);
+    memset(key_slot->src_nonce, 0, 16);
+    key_slot->late = 0;
+
+    /* Precompute the masking tag of the first frame, bpmac_pre() keeps
+       it in the context.  The tag itself is not needed here.
+    */
+    uint8_t tag[16];
+    bpmac_init((char *) key_slot->src_mac_key, (char *) key_slot->src_nonce_key, CAN_XR_AUTH_MSG_MAX_SIZE, &key_slot->ctx);
+    bpmac_pre(&key_slot->ctx, (uint8_t *) key_slot->src_nonce, (char *) tag);
+    return 0;
+}
+
+int CAN_XR_MAC_Map_Resync_Id(
+    struct CAN_XR_MAC *mac, uint32_t identifier, int slot)
+{
+    if(slot < 0 || slot >= CAN_XR_MAC_KEY_SLOTS)
+        return -1;
+
+    mac->storage.slot[slot].resync_id = identifier;
+    return 0;
 }
 
 void CAN_XR_MAC_Set_LLC(struct CAN_XR_MAC *mac, struct CAN_XR_LLC *llc)
@@ -764,6 +1431,17 @@ void CAN_XR_MAC_Set_LLC(struct CAN_XR_MAC *mac, struct CAN_XR_LLC *llc)
     mac->llc = llc;
 }
 
+void CAN_XR_MAC_Set_Auth_Policy(
+    struct CAN_XR_MAC *mac, const struct CAN_XR_Auth_Policy *policy)
+{
+    mac->policy = policy;
+}
+
+void CAN_XR_MAC_Set_Latency(struct CAN_XR_MAC *mac, struct CAN_XR_Latency *lat)
+{
+    mac->latency = lat;
+}
+
 void CAN_XR_MAC_Set_Data_Ind(
     struct CAN_XR_MAC *mac, CAN_XR_MAC_Data_Ind_t data_ind)
 {
@@ -792,3 +1470,40 @@ void CAN_XR_MAC_Data_Req(
         mac->primitives.data_req(mac, identifier, format, dlc, data);
     }
 }
+
+#ifdef ENABLE_PROFILE
+/* Names of the receive FSM states, for CAN_XR_Profile_Dump().  They
+   are what ties the rows of a dump to a state, the values of the
+   states differ from one node to another.
+*/
+static const char *const rx_fsm_state_name[] = {
+    [CAN_XR_MAC_RX_FSM_BUS_INTEGRATION] = "BUS_INTEGRATION",
+    [CAN_XR_MAC_RX_FSM_IDLE]            = "IDLE",
+    [CAN_XR_MAC_RX_FSM_RX_IDENTIFIER]   = "RX_IDENTIFIER",
+    [CAN_XR_MAC_RX_FSM_RX_RTR]          = "RX_RTR",
+    [CAN_XR_MAC_RX_FSM_RX_IDE]          = "RX_IDE",
+    [CAN_XR_MAC_RX_FSM_RX_ID_EXT]       = "RX_ID_EXT",
+    [CAN_XR_MAC_RX_FSM_RX_FDF]          = "RX_FDF",
+    [CAN_XR_MAC_RX_FSM_RX_R0]           = "RX_R0",
+    [CAN_XR_MAC_RX_FSM_RX_BRS]          = "RX_BRS",
+    [CAN_XR_MAC_RX_FSM_RX_ESI]          = "RX_ESI",
+    [CAN_XR_MAC_RX_FSM_RX_DLC]          = "RX_DLC",
+    [CAN_XR_MAC_RX_FSM_RX_DATA]         = "RX_DATA",
+    [CAN_XR_MAC_RX_FSM_RX_DATA_MAC]     = "RX_DATA_MAC",
+    [CAN_XR_MAC_RX_FSM_RX_CRC]          = "RX_CRC",
+    [CAN_XR_MAC_RX_FSM_RX_FD_CRC]       = "RX_FD_CRC",
+    [CAN_XR_MAC_RX_FSM_RX_CDEL]         = "RX_CDEL",
+    [CAN_XR_MAC_RX_FSM_RX_ACK]          = "RX_ACK",
+    [CAN_XR_MAC_RX_FSM_RX_ADEL]         = "RX_ADEL",
+    [CAN_XR_MAC_RX_FSM_RX_EOF]          = "RX_EOF",
+    [CAN_XR_MAC_RX_FSM_INTERMISSION]    = "INTERMISSION",
+    [CAN_XR_MAC_RX_FSM_ERROR]           = "ERROR"
+};
+
+const char *CAN_XR_Profile_State_Name(int state)
+{
+    if(state < 0 || state >= (int)(sizeof(rx_fsm_state_name) / sizeof(rx_fsm_state_name[0])))
+        return "OTHER";
+    return rx_fsm_state_name[state];
+}
+#endif
@@ -0,0 +1,145 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Cycle budget profiler of the nodeclock callback chain, see
+   CAN_XR_Profile.h.
+
+   CAN_XR_Profile_Period() runs at the end of every nodeclock period,
+   in the Timer 0 interrupt on the board, so it only does additions
+   and comparisons.  Divisions are left to CAN_XR_Profile_Dump().
+*/
+
+#include <string.h>
+#include <CAN_XR_Profile.h>
+
+#ifdef CAN_XR_PROFILE_CLOCK
+#include <time.h>
+#endif
+
+#ifdef ENABLE_PROFILE
+
+struct CAN_XR_Profile CAN_XR_Profile_Data;
+
+static const char *const layer_name[CAN_XR_PROFILE_LAYERS] = {
+    "PMA", "PCS", "MAC", "bpmac"
+};
+
+void CAN_XR_Profile_Init(uint32_t budget)
+{
+    struct CAN_XR_Profile *p = &CAN_XR_Profile_Data;
+    int s, l;
+
+#ifdef __arm__
+    *(volatile uint32_t *)0xE000EDFC |= 1UL << 24;  /* DEMCR.TRCENA */
+    *(volatile uint32_t *)0xE0001000 |= 1UL;        /* DWT_CTRL.CYCCNTENA */
+#endif
+
+    memset(p, 0, sizeof(*p));
+    p->budget = budget;
+    for(s = 0; s < CAN_XR_PROFILE_STATES; s++)
+        for(l = 0; l < CAN_XR_PROFILE_LAYERS; l++)
+            p->stat[s][l].min = UINT32_MAX;
+}
+
+void CAN_XR_Profile_Period(void)
+{
+    struct CAN_XR_Profile *p = &CAN_XR_Profile_Data;
+    int s = (p->state < CAN_XR_PROFILE_STATES) ? p->state : CAN_XR_PROFILE_STATES - 1;
+    uint32_t t, limit;
+    int l, b;
+
+    if(p->entered & (1U << CAN_XR_PROFILE_PMA))
+    {
+        /* At most 7 comparisons, cheaper than a division */
+        t = p->spent[CAN_XR_PROFILE_PMA];
+        limit = p->budget / 4;
+        for(b = 0; b < CAN_XR_PROFILE_BUCKETS - 1 && t >= limit; b++)
+            limit += p->budget / 4;
+        p->histogram[s][b]++;
+    }
+
+    for(l = 0; l < CAN_XR_PROFILE_LAYERS; l++)
+    {
+        struct CAN_XR_Profile_Stat *st = &p->stat[s][l];
+
+        if(!(p->entered & (1U << l)))
+            continue;
+
+        t = p->spent[l];
+        if(t < st->min)
+            st->min = t;
+        if(t > st->max)
+            st->max = t;
+        st->count++;
+        st->sum += t;
+        p->spent[l] = 0;
+    }
+
+    p->entered = 0;
+}
+
+void CAN_XR_Profile_Dump(FILE *f)
+{
+    const struct CAN_XR_Profile *p = &CAN_XR_Profile_Data;
+    int s, l, b;
+
+    fprintf(f, "Profile, budget %lu per nodeclock period\n",
+            (unsigned long)p->budget);
+    fprintf(f, "state name             layer      periods      min      avg      max  histogram (quarters of budget)\n");
+
+    for(s = 0; s < CAN_XR_PROFILE_STATES; s++)
+    {
+        for(l = 0; l < CAN_XR_PROFILE_LAYERS; l++)
+        {
+            const struct CAN_XR_Profile_Stat *st = &p->stat[s][l];
+
+            if(st->count == 0)
+                continue;
+
+            fprintf(f, "%5d %-16s %-5s %12lu %8lu %8lu %8lu",
+                    s, (s < CAN_XR_PROFILE_STATES - 1) ? CAN_XR_Profile_State_Name(s) : "OTHER",
+                    layer_name[l], (unsigned long)st->count,
+                    (unsigned long)st->min,
+                    (unsigned long)(st->sum / st->count),
+                    (unsigned long)st->max);
+            if(l == CAN_XR_PROFILE_PMA)
+            {
+                fputc(' ', f);
+                for(b = 0; b < CAN_XR_PROFILE_BUCKETS; b++)
+                    fprintf(f, " %lu", (unsigned long)p->histogram[s][b]);
+            }
+            fputc('\n', f);
+        }
+    }
+}
+
+#ifdef CAN_XR_PROFILE_CLOCK
+uint32_t CAN_XR_Profile_Clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+#endif
+
+#endif
@@ -51,8 +51,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <CAN_XR_PMA_GPIO.h>
+#define CAN_XR_TRACE_MODULE PMA
 #include <CAN_XR_Trace.h>
+#include <CAN_XR_Profile.h>
 #include <LED_Config.h>
 
 
@@ -259,8 +262,15 @@ void CAN_XR_PMA_GPIO_Init(struct CAN_XR_PMA *pma, int prescaler)
     /* Set up nodeclock for use. */
     setup_ts(prescaler);
 
+    /* Timer 0 counts CCLK periods, a nodeclock period lasts
+       'prescaler' cycles.
+    */
+    PROFILE_INIT(prescaler);
+
     pma->primitives.nodeclock_ind = NULL; /* Set by upper layer. */
     pma->primitives.data_req = data_req;
+    pma->primitives.state_ind = NULL; /* Set by the MAC. */
+    memset(&pma->overrun, 0, sizeof(pma->overrun));
     pma->primitives.data_mac_req = data_mac_req;
     pma->primitives.tx_reset = tx_reset;    /* called to reset both transceivers */
 
@@ -275,7 +285,7 @@ void CAN_XR_PMA_GPIO_Set_App_NodeClock_Ind(
 
 void CAN_XR_PMA_GPIO_NodeClock_Ind(struct CAN_XR_PMA *pma)
 {
-    uint32_t x;
+    uint32_t x, now;
 
     TRACE(0, "CAN_XR_PMA_GPIO_NodeClock_Ind");
 
@@ -288,17 +298,30 @@ void CAN_XR_PMA_GPIO_NodeClock_Ind(struct CAN_XR_PMA *pma)
     {
         /* Synchronize with TIMER0, which is the source of nodeclock */
         while(x == read_ts());
+        PROFILE_ENTER(CAN_XR_PROFILE_PMA);
 
         /* Sample bus level and generate a nodeclock indication for
            the upper layer.  We assume that the whole chain of
-           indication callbacks takes less than one nodeclock period.
+           indication callbacks takes less than one nodeclock period,
+           the check below tells when it does not.
         */
         if(pma->primitives.nodeclock_ind)
         {
             pma->primitives.nodeclock_ind(pma->pcs, gpio_rx_pin());
         }
 
+        PROFILE_EXIT(CAN_XR_PROFILE_PMA);
+        PROFILE_PERIOD();
         x++;
 
+        /* Timer 0 must not have advanced past the tick just handled,
+           otherwise the chain of indication callbacks took longer
+           than one nodeclock period.  The ticks in between are not
+           skipped, they are replayed late, back to back, with the bus
+           level sampled at the wrong time.
+        */
+        now = read_ts();
+        if(now != x)
+            CAN_XR_PMA_Overrun(pma, now, now - x);
     }
 }
@@ -35,6 +35,7 @@
 #include <CAN_XR_PCS.h>
 #include <CAN_XR_MAC.h>
 #include <CAN_XR_Trace.h>
+#include <CAN_XR_Capture.h>
 #include <stdbool.h>
 
 #define configCPU_CLOCK_HZ 96000000    // 96 MHz is used clock speed at Mbed development board
@@ -61,15 +62,15 @@ const struct CAN_XR_PCS_Bit_Time_Parameters pcs_parameters = {
 #define GPIO_NODECLOCK_PER_BIT (pcs_parameters.sync_seg + pcs_parameters.prop_seg + pcs_parameters.phase_seg1 + pcs_parameters.phase_seg2)
 #define GPIO_PRESCALER configCPU_CLOCK_HZ/(GPIO_BIT_RATE*GPIO_NODECLOCK_PER_BIT)
 
+/* Not on the stack, the key slots of the MAC are too large for it. */
+struct CAN_XR_MAC mac;
+struct CAN_XR_PCS pcs;
+struct CAN_XR_PMA pma;
 
 int main(int argc, char *argv[])
 {
     enable_leds();
 
-    struct CAN_XR_MAC mac;
-    struct CAN_XR_PCS pcs;
-    struct CAN_XR_PMA pma;
-
     CAN_XR_PMA_GPIO_Init(&pma, GPIO_PRESCALER);
     CAN_XR_PCS_Init(&pcs, &pcs_parameters, &pma);
 
@@ -78,7 +79,16 @@ int main(int argc, char *argv[])
     CAN_XR_MAC_Common_Init(&mac, &pcs);
 
     /* Start the controller, feeding it with nodeclock indications. */
+    TRACE_INIT();
     SET_TRACE_TRESHOLD(3);
+
+    /* The bit engine never returns here, read CAN_XR_Capture_Data
+       with the debugger once the capture has stopped */
+    CAPTURE_INIT(configCPU_CLOCK_HZ);
+    CAPTURE_TRIGGER(CAN_XR_CAPTURE_MASK(CAN_XR_CAPTURE_STUFF_ERROR)
+                    | CAN_XR_CAPTURE_MASK(CAN_XR_CAPTURE_FORM_ERROR),
+                    CAN_XR_CAPTURE_RECORDS / 2);
+
     CAN_XR_PMA_GPIO_NodeClock_Ind(&pma);
 
     return EXIT_SUCCESS;
@@ -0,0 +1,177 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* This header defines the CAPTURE macros, a software logic analyzer
+   that takes the place of the debug pins of LED_Config.h.
+
+   With ENABLE_CAPTURE, CAPTURE(channel, value) stores a timestamp and
+   the new value of 'channel' into a RAM ring of CAN_XR_CAPTURE_RECORDS
+   records, with a single 64-bit store once the record is reserved.
+   The MAC records the state of its receive FSM, SOF, the frames
+   validated at EOF and its errors, the PMA its overruns; the
+   application has the DEBUG channels, where it used dbug_on() and
+   dbug_off(), and records the data MACs it rejects.
+
+   The ring runs free and keeps the last records until
+   CAN_XR_Capture_Trigger() arms a trigger on some channels: the first
+   record of one of them is followed by a given number of others,
+   then the ring stops, holding what came before the trigger and
+   after it.  CAN_XR_Capture_Dump() writes it in binary form and the
+   host tool tools/capture_vcd.c turns it into a VCD file.
+
+   The timestamps are those of CAN_XR_CAPTURE_TIMESTAMP, the cycle
+   counter of the Cortex-M3 on the board; Timer 0 restarts at every
+   nodeclock period and cannot be used.  On the host, it is
+   CAN_XR_Capture_Clock, that the simulator advances.  Without
+   ENABLE_CAPTURE the macros expand to nothing.
+*/
+
+#ifndef CAN_XR_CAPTURE_H
+#define CAN_XR_CAPTURE_H
+
+#include <stdio.h> /* For FILE */
+#include <stdint.h>
+
+/* Channels, at most 32.  Up to CAN_XR_CAPTURE_FIRST_EVENT they keep
+   their value until the next record, the others are instant events.
+*/
+enum CAN_XR_Capture_Channel
+{
+    CAN_XR_CAPTURE_DEBUG1,          /* Free for the application */
+    CAN_XR_CAPTURE_DEBUG2,
+    CAN_XR_CAPTURE_DEBUG3,
+    CAN_XR_CAPTURE_RX_STATE,        /* Receive FSM state, at the bit after the change */
+
+    CAN_XR_CAPTURE_SOF,
+    CAN_XR_CAPTURE_FRAME_OK,        /* Frame validated at EOF */
+    CAN_XR_CAPTURE_BIT_ERROR,
+    CAN_XR_CAPTURE_STUFF_ERROR,
+    CAN_XR_CAPTURE_FORM_ERROR,
+    CAN_XR_CAPTURE_CRC_ERROR,
+    CAN_XR_CAPTURE_ACK_ERROR,
+    CAN_XR_CAPTURE_ARBITRATION_LOST,
+    CAN_XR_CAPTURE_MAC_MISMATCH,    /* Data MAC rejected by the application */
+    CAN_XR_CAPTURE_OVERRUN,         /* See CAN_XR_PMA_Overrun() */
+
+    CAN_XR_CAPTURE_CHANNELS
+};
+
+#define CAN_XR_CAPTURE_FIRST_EVENT CAN_XR_CAPTURE_SOF
+
+#define CAN_XR_CAPTURE_MASK(channel) (1UL << (channel))
+
+#ifdef ENABLE_CAPTURE
+
+/* Ring length, in records of 8 bytes.  Must be a power of two. */
+#ifndef CAN_XR_CAPTURE_RECORDS
+#define CAN_XR_CAPTURE_RECORDS 1024
+#endif
+
+#ifndef CAN_XR_CAPTURE_TIMESTAMP
+#ifdef __arm__
+#define CAN_XR_CAPTURE_TIMESTAMP() (*(volatile uint32_t *)0xE0001004) /* DWT_CYCCNT */
+#else
+#define CAN_XR_CAPTURE_TIMESTAMP() CAN_XR_Capture_Clock
+#endif
+#endif
+
+/* .left while no trigger has fired */
+#define CAN_XR_CAPTURE_RUNNING UINT32_MAX
+
+/* Records hold the timestamp in the least significant word, the
+   channel and the 24 least significant bits of the value in the
+   other one.
+*/
+struct CAN_XR_Capture
+{
+    uint32_t head;      /* Next record, free-running */
+    uint32_t left;      /* Records before stopping */
+    uint32_t trigger;   /* Channels that trigger, one bit each */
+    uint32_t post;      /* Records after the trigger */
+    uint32_t hz;        /* Timestamp frequency */
+    uint64_t record[CAN_XR_CAPTURE_RECORDS];
+};
+
+extern struct CAN_XR_Capture CAN_XR_Capture_Data;
+extern uint32_t CAN_XR_Capture_Clock;
+
+/* Empty the ring and let it run free, with timestamps at 'hz'.  On
+   the board, also start the cycle counter.
+*/
+void CAN_XR_Capture_Init(uint32_t hz);
+
+/* Stop the ring 'post' records after the first record of the
+   channels in 'mask', see CAN_XR_CAPTURE_MASK().  One shot, the
+   ring runs free again after CAN_XR_Capture_Init().
+*/
+void CAN_XR_Capture_Trigger(uint32_t mask, uint32_t post);
+
+/* Whether the ring has stopped after a trigger. */
+int CAN_XR_Capture_Stopped(void);
+
+/* Write the ring on 'f', oldest record first, for
+   tools/capture_vcd.c.  After the ring has stopped or with the
+   controller stopped, the last records may be incomplete otherwise.
+   Returns the number of records.
+*/
+int CAN_XR_Capture_Dump(FILE *f);
+
+/* Any context, the interrupt handler of the bit engine included.
+   The count of the records after the trigger is not atomic, a
+   preempted record may be taken twice.
+*/
+static inline void CAN_XR_Capture_Put(
+    enum CAN_XR_Capture_Channel channel, uint32_t value)
+{
+    struct CAN_XR_Capture *c = &CAN_XR_Capture_Data;
+    uint32_t pos;
+
+    if(c->left == 0)
+        return;
+
+    pos = __atomic_fetch_add(&c->head, 1, __ATOMIC_RELAXED);
+    c->record[pos & (CAN_XR_CAPTURE_RECORDS - 1)] =
+        ((uint64_t)(((uint32_t)channel << 24) | (value & 0xFFFFFF)) << 32)
+        | CAN_XR_CAPTURE_TIMESTAMP();
+
+    if(c->trigger & CAN_XR_CAPTURE_MASK(channel))
+    {
+        c->trigger = 0;
+        c->left = c->post;
+    }
+    else if(c->left != CAN_XR_CAPTURE_RUNNING)
+        c->left--;
+}
+
+#define CAPTURE_INIT(hz) CAN_XR_Capture_Init(hz)
+#define CAPTURE_TRIGGER(mask, post) CAN_XR_Capture_Trigger(mask, post)
+#define CAPTURE(channel, value) CAN_XR_Capture_Put(channel, value)
+#define CAPTURE_EVENT(channel) CAN_XR_Capture_Put(channel, 1)
+
+#else
+#define CAPTURE_INIT(hz)
+#define CAPTURE_TRIGGER(mask, post)
+#define CAPTURE(channel, value) do {} while(0)
+#define CAPTURE_EVENT(channel) do {} while(0)
+
+#endif
+#endif
@@ -38,6 +38,55 @@
    #define CAN_XR_BIT_RATE 50000 and 8 quanta per bit is one of the
     standard CANopen bit rates and is used for the paper about Boolean
     binary functions (Mueller's protocol).  TRACE must be disabled.
+
+   The binary backend of TRACE (-DENABLE_TRACE_BINARY as well, see
+    CAN_XR_Trace.h) does no formatting on the board and is meant to
+    stay enabled at these bit rates, with a threshold that leaves out
+    the per-bit PCS and MAC messages.  The CAN_XR_TRACE_LEVEL_<module>
+    macros of that header do the same at compile time, so that those
+    messages cost nothing at all.
+
+   Rather than by trial, the bit rate a configuration sustains can be
+    computed by tools/bitrate_find.c from the profile of each node
+    (-DENABLE_PROFILE, see CAN_XR_Profile.h), for a given CPU clock and
+    number of quanta per bit, and checked in tools/bus_sim.c.
 */
 
 #define CAN_XR_BIT_RATE 40000
+
+/* Implicit nonce hints.  When CAN_XR_NONCE_HINT_BITS is not zero, the
+   sender prepends a hint byte to the payload of every authenticated
+   frame, except the nonce synchronization frame (id 200) that has no
+   room for it.  The upper nibble of the hint carries the
+   CAN_XR_NONCE_HINT_BITS low-order bits of the source nonce used to
+   sign the frame, the lower nibble those of the group nonce.  Being
+   part of the payload, the hint is covered by both MACs.
+
+   Receivers and authenticator use the hint to move their nonce
+   forward by up to 2^CAN_XR_NONCE_HINT_BITS - 1 frames without the
+   384 -> 385 -> 200 resynchronization, which is still used as a
+   fallback when realignment does not help.  The price is one payload
+   byte per authenticated frame.
+
+   Must be in the range [0, 4], 0 disables the hints.  All nodes must
+   agree on it.  tools/caiba_sim.c checks the realignment when built
+   with -DCAN_XR_NONCE_HINT_BITS=N, see -s there.
+*/
+#ifndef CAN_XR_NONCE_HINT_BITS
+#define CAN_XR_NONCE_HINT_BITS 0
+#endif
+
+#define CAN_XR_NONCE_HINT_MASK ((1 << CAN_XR_NONCE_HINT_BITS) - 1)
+
+/* Build the hint byte from the low-order words of the source and
+   group nonces, and take it apart again.
+*/
+#define CAN_XR_NONCE_HINT(src, grp) \
+    ((uint8_t)((((src) & CAN_XR_NONCE_HINT_MASK) << 4) | ((grp) & CAN_XR_NONCE_HINT_MASK)))
+#define CAN_XR_NONCE_HINT_SRC(hint) (((hint) >> 4) & CAN_XR_NONCE_HINT_MASK)
+#define CAN_XR_NONCE_HINT_GRP(hint) ((hint) & CAN_XR_NONCE_HINT_MASK)
+
+/* Number of frames the low-order word n of a nonce must be moved
+   forward to match the hint bits h.
+*/
+#define CAN_XR_NONCE_HINT_DELTA(h, n) (((h) - (n)) & CAN_XR_NONCE_HINT_MASK)
@@ -0,0 +1,155 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* This header defines the PROFILE macros, which measure how much of
+   each nodeclock period the chain of indication callbacks takes.
+
+   With ENABLE_PROFILE, every layer of the chain timestamps its entry
+   and exit with PROFILE_ENTER and PROFILE_EXIT, the MAC tells the
+   state of its receive FSM with PROFILE_STATE, and the PMA closes the
+   period with PROFILE_PERIOD.  The time of each layer includes that
+   of the layers it calls and is accounted to the receive state:
+   minimum, average and maximum per layer, and a histogram of the
+   whole chain in quarters of the budget, the length of a nodeclock
+   period.  CAN_XR_Profile_Dump() prints them.
+
+   The unit is the CPU cycle, from the DWT cycle counter on the board
+   and the time-stamp counter on x86 hosts, the nanosecond elsewhere.
+   Without ENABLE_PROFILE the macros expand to nothing.
+*/
+
+#ifndef CAN_XR_PROFILE_H
+#define CAN_XR_PROFILE_H
+
+#include <stdio.h> /* For FILE */
+#include <stdint.h>
+
+#ifdef ENABLE_PROFILE
+
+/* Receive FSM states accounted separately, the others share the last
+   entry.  Enough for enum CAN_XR_MAC_RX_FSM_State.
+*/
+#ifndef CAN_XR_PROFILE_STATES
+#define CAN_XR_PROFILE_STATES 32
+#endif
+
+/* Histogram buckets, a quarter of the budget each, the last one
+   takes all longer periods.
+*/
+#define CAN_XR_PROFILE_BUCKETS 8
+
+#ifndef CAN_XR_PROFILE_TIMESTAMP
+#if defined(__arm__)
+#define CAN_XR_PROFILE_TIMESTAMP() (*(volatile uint32_t *)0xE0001004) /* DWT_CYCCNT */
+#elif defined(__x86_64__) || defined(__i386__)
+#define CAN_XR_PROFILE_TIMESTAMP() ((uint32_t)__builtin_ia32_rdtsc())
+#else
+#define CAN_XR_PROFILE_CLOCK
+#define CAN_XR_PROFILE_TIMESTAMP() CAN_XR_Profile_Clock()
+#endif
+#endif
+
+enum CAN_XR_Profile_Layer
+{
+    CAN_XR_PROFILE_PMA,     /* The whole period, app_nodeclock_ind included */
+    CAN_XR_PROFILE_PCS,
+    CAN_XR_PROFILE_MAC,
+    CAN_XR_PROFILE_BPMAC,   /* bpmac calls made by the MAC */
+    CAN_XR_PROFILE_LAYERS
+};
+
+struct CAN_XR_Profile_Stat
+{
+    uint32_t min;
+    uint32_t max;
+    uint32_t count;     /* Periods in which the layer was entered */
+    uint64_t sum;
+};
+
+struct CAN_XR_Profile
+{
+    uint32_t budget;    /* Length of a nodeclock period */
+    int state;          /* Last state given by PROFILE_STATE */
+    unsigned entered;   /* Layers entered in this period, one bit each */
+    uint32_t enter[CAN_XR_PROFILE_LAYERS];
+    uint32_t spent[CAN_XR_PROFILE_LAYERS];
+
+    struct CAN_XR_Profile_Stat stat[CAN_XR_PROFILE_STATES][CAN_XR_PROFILE_LAYERS];
+    uint32_t histogram[CAN_XR_PROFILE_STATES][CAN_XR_PROFILE_BUCKETS];
+};
+
+extern struct CAN_XR_Profile CAN_XR_Profile_Data;
+
+/* Clear all statistics and set the budget.  On the board, also start
+   the cycle counter.
+*/
+void CAN_XR_Profile_Init(uint32_t budget);
+
+/* Account the period just ended and start a new one. */
+void CAN_XR_Profile_Period(void);
+
+/* Print the statistics on 'f'.  From the foreground loop the numbers
+   of a state may be one period apart from each other, which does not
+   matter here.
+*/
+void CAN_XR_Profile_Dump(FILE *f);
+
+/* Name of receive FSM state 'state', for the dump, "OTHER" if
+   unknown.  Defined by the MAC.
+*/
+const char *CAN_XR_Profile_State_Name(int state);
+
+#ifdef CAN_XR_PROFILE_CLOCK
+/* Fallback of CAN_XR_PROFILE_TIMESTAMP, in nanoseconds. */
+uint32_t CAN_XR_Profile_Clock(void);
+#endif
+
+#define PROFILE_INIT(budget) CAN_XR_Profile_Init(budget)
+
+#define PROFILE_ENTER(layer)						\
+    do {								\
+	CAN_XR_Profile_Data.enter[layer] = CAN_XR_PROFILE_TIMESTAMP();	\
+    } while(0)
+
+#define PROFILE_EXIT(layer)						\
+    do {								\
+	CAN_XR_Profile_Data.spent[layer] +=				\
+	    CAN_XR_PROFILE_TIMESTAMP() - CAN_XR_Profile_Data.enter[layer]; \
+	CAN_XR_Profile_Data.entered |= 1U << (layer);			\
+    } while(0)
+
+#define PROFILE_STATE(s)						\
+    do {								\
+	CAN_XR_Profile_Data.state = (s);				\
+    } while(0)
+
+#define PROFILE_PERIOD() CAN_XR_Profile_Period()
+
+#else
+#define PROFILE_INIT(budget)
+#define PROFILE_ENTER(layer) do {} while(0)
+#define PROFILE_EXIT(layer) do {} while(0)
+#define PROFILE_STATE(s) do {} while(0)
+#define PROFILE_PERIOD() do {} while(0)
+
+#endif
+#endif
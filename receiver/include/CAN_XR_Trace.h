@@ -24,23 +24,164 @@
     http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
 +*/
 
-/* This header defines the TRACE macro on the board. */
+/* This header defines the TRACE macro on the board.
+
+   With ENABLE_TRACE, TRACE formats its message on stderr on the spot,
+   which is too slow for the bit engine at nominal bit rates.  With
+   ENABLE_TRACE_BINARY as well, it only stores the address of its
+   format and its arguments, as 32-bit integers, into a RAM ring of
+   CAN_XR_TRACE_RECORDS records, see CAN_XR_Trace.c.  The formats are
+   put in the can_xr_trace section, which is never read at run time:
+   CAN_XR_Trace_Dump() writes the ring in binary form and the host tool
+   tools/trace_decode.c renders it, taking the formats from the ELF
+   file of the program.
+
+   Each source file names its module by defining CAN_XR_TRACE_MODULE
+   as PMA, PCS, MAC, BPMAC or APP (the default) before including this
+   header.  A TRACE whose level is below CAN_XR_TRACE_LEVEL_<module>
+   compiles to nothing; the others are still compared with the runtime
+   threshold set by SET_TRACE_TRESHOLD, unless CAN_XR_TRACE_RUNTIME is
+   0.  For instance, -DCAN_XR_TRACE_LEVEL_PCS=10
+   -DCAN_XR_TRACE_LEVEL_MAC=9 keeps only the errors of the MAC, and no
+   per-bit call costs anything.
+*/
 
 #ifndef CAN_XR_TRACE_H
 #define CAN_XR_TRACE_H
 
 #include <stdio.h> /* For fputc, fprintf. */
+#include <stdint.h>
 
 #ifdef ENABLE_TRACE
 /* Fortunately this goes into a common block and not into data or bss,
    otherwise the linker would complain about multiple definitions is
-   this file is included more than once.
+   this file is included more than once.  Compilers that no longer do
+   so by default (-fno-common) must be told.
 */
-int CAN_XR_TRACE_Threshold;
+__attribute__((common)) int CAN_XR_TRACE_Threshold;
 
 #define SET_TRACE_TRESHOLD(x)	\
     CAN_XR_TRACE_Threshold = x;	\
 
+#ifndef CAN_XR_TRACE_MODULE
+#define CAN_XR_TRACE_MODULE APP
+#endif
+
+/* Compile-time minimum levels, see above. */
+#ifndef CAN_XR_TRACE_LEVEL_PMA
+#define CAN_XR_TRACE_LEVEL_PMA 0
+#endif
+#ifndef CAN_XR_TRACE_LEVEL_PCS
+#define CAN_XR_TRACE_LEVEL_PCS 0
+#endif
+#ifndef CAN_XR_TRACE_LEVEL_MAC
+#define CAN_XR_TRACE_LEVEL_MAC 0
+#endif
+#ifndef CAN_XR_TRACE_LEVEL_BPMAC
+#define CAN_XR_TRACE_LEVEL_BPMAC 0
+#endif
+#ifndef CAN_XR_TRACE_LEVEL_APP
+#define CAN_XR_TRACE_LEVEL_APP 0
+#endif
+
+/* Whether the runtime threshold is checked as well. */
+#ifndef CAN_XR_TRACE_RUNTIME
+#define CAN_XR_TRACE_RUNTIME 1
+#endif
+
+/* Two steps, so that CAN_XR_TRACE_MODULE is expanded before pasting.
+   The first comparison is between constants and, when false, lets the
+   compiler drop the whole call.
+*/
+#define CAN_XR_TRACE_LEVEL_OF(module) CAN_XR_TRACE_LEVEL_OF_(module)
+#define CAN_XR_TRACE_LEVEL_OF_(module) CAN_XR_TRACE_LEVEL_##module
+
+#define CAN_XR_TRACE_ON(level)						\
+    ((level) >= CAN_XR_TRACE_LEVEL_OF(CAN_XR_TRACE_MODULE)		\
+     && (!CAN_XR_TRACE_RUNTIME || (level) >= CAN_XR_TRACE_Threshold))
+
+#ifdef ENABLE_TRACE_BINARY
+
+/* Ring length, in records.  Must be a power of two. */
+#ifndef CAN_XR_TRACE_RECORDS
+#define CAN_XR_TRACE_RECORDS 128
+#endif
+
+/* Arguments kept per record, the others are dropped. */
+#ifndef CAN_XR_TRACE_ARGS
+#define CAN_XR_TRACE_ARGS 4
+#endif
+
+/* Timestamp of the records.  The cycle counter of the Cortex-M3 on
+   the board, enabled by CAN_XR_Trace_Init(); none on the host, where
+   the timestamps the messages carry suffice.
+*/
+#ifndef CAN_XR_TRACE_TIMESTAMP
+#ifdef __arm__
+#define CAN_XR_TRACE_TIMESTAMP() (*(volatile uint32_t *)0xE0001004) /* DWT_CYCCNT */
+#else
+#define CAN_XR_TRACE_TIMESTAMP() 0
+#endif
+#endif
+
+/* One record.  .seq is written last, a record whose .seq is not the
+   one expected at its position is being written or has been
+   overwritten.
+*/
+struct CAN_XR_Trace_Record
+{
+    uint32_t seq;       /* Position in the ring + 1 */
+    uint32_t ts;
+    uint32_t format;    /* Offset in the can_xr_trace section */
+    uint8_t level;
+    uint8_t nargs;
+    uint16_t reserved;
+    uint32_t arg[CAN_XR_TRACE_ARGS];
+};
+
+struct CAN_XR_Trace_Ring
+{
+    uint32_t tail;      /* Next record, free-running */
+    struct CAN_XR_Trace_Record record[CAN_XR_TRACE_RECORDS];
+};
+
+extern struct CAN_XR_Trace_Ring CAN_XR_Trace_Buffer;
+
+/* Start the timestamp counter, see above. */
+void CAN_XR_Trace_Init(void);
+
+#define TRACE_INIT() CAN_XR_Trace_Init()
+
+/* Add a record to the ring, overwriting the oldest one when it is
+   full.  Any context, the interrupt handler of the bit engine
+   included, may call it at any time.
+*/
+void CAN_XR_Trace_Put(
+    int level, const char *format, const uint32_t *arg, int nargs);
+
+/* Write the records in the ring on 'f', oldest first, for
+   tools/trace_decode.c.  From the foreground loop, or when the
+   controller is stopped.  Returns the number of records.
+*/
+int CAN_XR_Trace_Dump(FILE *f);
+
+/* The extra 0 keeps the array valid when there are no arguments. */
+#define TRACE(level, format, ...)					\
+    do {								\
+	if(CAN_XR_TRACE_ON(level))				\
+	{								\
+	    static const char trace_format[]				\
+		__attribute__((section("can_xr_trace"))) = format;	\
+	    const uint32_t trace_arg[] = { 0, ##__VA_ARGS__ };		\
+	    CAN_XR_Trace_Put(level, trace_format, trace_arg + 1,	\
+			     sizeof(trace_arg) / sizeof(trace_arg[0]) - 1); \
+	}								\
+    } while(0)
+
+#else
+
+#define TRACE_INIT()
+
 /* Yes, if you are wondering, this is a variadic macro, and is
    perfectly standard.  Note the implicit literal concatenation and
    the use of ## to suppress the preceding comma when varargs are
@@ -50,7 +191,7 @@ int CAN_XR_TRACE_Threshold;
 
 #define TRACE(level, format, ...)				\
     do {							\
-	if(level >= CAN_XR_TRACE_Threshold)			\
+	if(CAN_XR_TRACE_ON(level))			\
 	{							\
 	    int i;						\
 	    for(i=0; i<level*4; i++) fputc(' ', stderr);	\
@@ -58,9 +199,11 @@ int CAN_XR_TRACE_Threshold;
 	}							\
     } while(0)
 
+#endif
+
 #define TRACE_FUNCTION(level, function, ...)			\
     do {							\
-	if(level >= CAN_XR_TRACE_Threshold)			\
+	if(CAN_XR_TRACE_ON(level))			\
 	{							\
 	    function(__VA_ARGS__);				\
 	}							\
@@ -68,6 +211,7 @@ int CAN_XR_TRACE_Threshold;
 
 #else
 #define SET_TRACE_TRESHOLD(x)
+#define TRACE_INIT()
 #define TRACE(level, format, ...) do {} while(0)
 #define TRACE_FUNCTION(level, function, ...) do {} while(0)
 
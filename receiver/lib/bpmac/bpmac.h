@@ -1,14 +1,28 @@
 #pragma once
 
+/* Tag length in bytes: 4, 8, 12 or 16.  Data MACs longer than 4
+   bytes on the bus need a longer tag, e.g. -DMAC_LEN=8 in build_flags.
+*/
+#ifndef MAC_LEN
 #define MAC_LEN 4
+#endif
 #define INT_SIZE sizeof(int)
 
+/* Identifier bits at the start of the message, MSb first.  CBFF
+   identifiers use the first 11 of them, CEFF ones all 29.  Their bit
+   tags are combined in advance, one table per 4 bits, so that
+   bpmac_update_id() costs one XOR per 4 bits, see bpmac_init().
+*/
+#define BPMAC_ID_BITS 29
+#define BPMAC_ID_NIBBLES ((BPMAC_ID_BITS + 3) / 4)
+
 typedef struct pre_ctx_t{
 
     unsigned char mac_key[16];
     int default_msg[MAC_LEN/INT_SIZE];
     int res[MAC_LEN/INT_SIZE];
     int* bit_flips;
+    int* id_flips;  /* [BPMAC_ID_NIBBLES][16] tags of identifier bits */
     int max_len;
     int bit_index;
 
@@ -16,15 +30,26 @@ typedef struct pre_ctx_t{
     uint8_t prev_nonce[16];
     uint8_t nonce_key[32];
 
+    /* Masking tag computed one AES round at a time, see bpmac_pre_begin() */
+    uint8_t nonce_round_key[176];
+    uint8_t pre_block[16];
+    int pre_round;  /* next AES round, 0 if none is pending */
+    int pre_index;
+
 } bpmac_ctx_t;
 
 void bpmac_init(char* key, char* nonce_key, int max_size, bpmac_ctx_t* ctx);
 void bpmac_start(bpmac_ctx_t* ctx, char* tag);
 void bpmac_update(bpmac_ctx_t* ctx, uint8_t input_bit, char* tag);
+void bpmac_update_id(bpmac_ctx_t* ctx, uint32_t id, int bits, char* tag);
 void bpmac_finish(bpmac_ctx_t* ctx, char* tag);
 void bpmac_reset(bpmac_ctx_t* ctx, char* tag);
 void bpmac_sign( bpmac_ctx_t* ctx, char* msg, int size, char* output) __attribute__ ((optimize(3)));
 void bpmac_pre(bpmac_ctx_t* ctx, uint8_t nonce[16], char* tag);
+int bpmac_pre_begin(bpmac_ctx_t* ctx, uint8_t nonce[16], char* tag);
+int bpmac_pre_step(bpmac_ctx_t* ctx, char* tag);
+int bpmac_pre_pending(bpmac_ctx_t* ctx);
+int bpmac_remask(bpmac_ctx_t* ctx, uint8_t old_nonce[16], uint8_t nonce[16], char* tag);
 int bpmac_vrfy(char* msg, int size, char* sig, int mac_size, bpmac_ctx_t* ctx);
 void bpmac_deinit(bpmac_ctx_t* ctx);
 
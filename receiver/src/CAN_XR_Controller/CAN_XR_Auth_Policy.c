@@ -0,0 +1,110 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Authentication policy table, see CAN_XR_Auth_Policy.h. */
+
+#include <string.h>
+#include <CAN_XR_Auth_Policy.h>
+#define CAN_XR_TRACE_MODULE MAC
+#include <CAN_XR_Trace.h>
+
+void CAN_XR_Auth_Policy_Init(struct CAN_XR_Auth_Policy *policy)
+{
+    memset(policy->bitmap, 0, sizeof(policy->bitmap));
+    memset(policy->rule_of_id, CAN_XR_AUTH_NO_RULE, sizeof(policy->rule_of_id));
+
+    for(int i = 0; i < CAN_XR_AUTH_POLICY_RULES; i++)
+    {
+        policy->rule[i].mac_len = CAN_XR_AUTH_MAC_LEN_DEFAULT;
+        policy->rule[i].key_index = 0;
+        policy->rule[i].aggregate = 0;
+    }
+}
+
+int CAN_XR_Auth_Policy_Set_Rule(
+    struct CAN_XR_Auth_Policy *policy, int rule,
+    uint8_t mac_len, uint8_t key_index)
+{
+    if(rule < 0 || rule >= CAN_XR_AUTH_POLICY_RULES
+       || mac_len < 1 || mac_len > CAN_XR_AUTH_MAC_LEN_MAX)
+    {
+        TRACE(9, "CAN_XR_Auth_Policy_Set_Rule: bad rule %d (%d)", rule, mac_len);
+        return -1;
+    }
+
+    policy->rule[rule].mac_len = mac_len;
+    policy->rule[rule].key_index = key_index;
+    policy->rule[rule].aggregate = 0;
+    return 0;
+}
+
+int CAN_XR_Auth_Policy_Set_Aggregation(
+    struct CAN_XR_Auth_Policy *policy, int rule,
+    uint8_t k, uint8_t mac_len_short, uint8_t payload_len)
+{
+    if(rule < 0 || rule >= CAN_XR_AUTH_POLICY_RULES || k < 2
+       || mac_len_short < 1 || mac_len_short >= policy->rule[rule].mac_len
+       || payload_len < 1 || payload_len + policy->rule[rule].mac_len > 8)
+    {
+        TRACE(9, "CAN_XR_Auth_Policy_Set_Aggregation: bad rule %d", rule);
+        return -1;
+    }
+
+    policy->rule[rule].aggregate = k;
+    policy->rule[rule].mac_len_short = mac_len_short;
+    policy->rule[rule].payload_len = payload_len;
+    return 0;
+}
+
+void CAN_XR_Auth_Policy_Map(
+    struct CAN_XR_Auth_Policy *policy,
+    uint32_t first, uint32_t last, int rule)
+{
+    for(uint32_t id = first; id <= last && id < CAN_XR_AUTH_POLICY_IDS; id++)
+    {
+        if(rule == CAN_XR_AUTH_NO_RULE)
+        {
+            policy->bitmap[id >> 5] &= ~(1UL << (id & 31));
+            policy->rule_of_id[id] = CAN_XR_AUTH_NO_RULE;
+        }
+        else
+        {
+            policy->bitmap[id >> 5] |= 1UL << (id & 31);
+            policy->rule_of_id[id] = rule;
+        }
+    }
+}
+
+struct CAN_XR_Auth_Policy *CAN_XR_Auth_Policy_Default(void)
+{
+    static struct CAN_XR_Auth_Policy policy;
+    static int initialized = 0;
+
+    if(!initialized)
+    {
+        CAN_XR_Auth_Policy_Init(&policy);
+        CAN_XR_Auth_Policy_Map(&policy, 0, 255, 0);
+        initialized = 1;
+    }
+
+    return &policy;
+}
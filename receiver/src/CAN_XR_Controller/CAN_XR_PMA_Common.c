@@ -29,7 +29,10 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 #include <CAN_XR_PMA.h>
+#include <CAN_XR_Metrics.h>
+#include <CAN_XR_Capture.h>
 
 /* Link the PCS pointer of 'pma' to point to 'pcs'. */
 void CAN_XR_PMA_Set_PCS(struct CAN_XR_PMA *pma, struct CAN_XR_PCS *pcs)
@@ -50,3 +53,48 @@ void CAN_XR_PMA_Data_Req(struct CAN_XR_PMA *pma, int bus_level)
     if(pma->primitives.data_req)
 	pma->primitives.data_req(pma, bus_level);
 }
+
+/* Set the state_ind callback of 'pma' to 'state_ind'. */
+void CAN_XR_PMA_Set_State_Ind(
+    struct CAN_XR_PMA *pma, CAN_XR_PMA_State_Ind_t state_ind)
+{
+    pma->primitives.state_ind = state_ind;
+}
+
+/* Account an overrun of 'pma'.  This only runs when the chain of
+   callbacks has already overrun, so it is not worth avoiding the
+   state_ind upcall.
+*/
+void CAN_XR_PMA_Overrun(
+    struct CAN_XR_PMA *pma, unsigned long nodeclock, unsigned long ticks)
+{
+    struct CAN_XR_PMA_Overrun *o = &pma->overrun;
+    int state = 0;
+
+    if(pma->primitives.state_ind)
+	state = pma->primitives.state_ind(pma->pcs);
+    if(state < 0 || state >= CAN_XR_PMA_OVERRUN_STATES)
+	state = CAN_XR_PMA_OVERRUN_STATES - 1;
+
+    o->overruns++;
+    o->ticks += ticks;
+    o->state[state]++;
+    METRIC_INC(CAN_XR_METRIC_OVERRUNS);
+    CAPTURE_EVENT(CAN_XR_CAPTURE_OVERRUN);
+
+    if(o->latch)
+    {
+	o->record.valid = 1;
+	o->record.state = state;
+	o->record.nodeclock = nodeclock;
+	o->record.ticks = ticks;
+	o->latch = 0;
+    }
+}
+
+/* Latch the next overrun of 'pma' into its overrun record. */
+void CAN_XR_PMA_Latch_Overrun(struct CAN_XR_PMA *pma)
+{
+    memset(&pma->overrun.record, 0, sizeof(pma->overrun.record));
+    pma->overrun.latch = 1;
+}
@@ -33,7 +33,11 @@
 #include <CAN_XR_PMA_GPIO.h>
 #include <CAN_XR_PCS.h>
 #include <CAN_XR_MAC.h>
+#include <CAN_XR_MAC_Queue.h>
 #include <CAN_XR_Trace.h>
+#include <CAN_XR_Metrics.h>
+#include <CAN_XR_Latency.h>
+#include <CAN_XR_Capture.h>
 //#include <bpmac.h>
 #include "../../lib/bpmac/bpmac.h"
 #include <stdbool.h>
@@ -67,25 +71,40 @@ const struct CAN_XR_PCS_Bit_Time_Parameters pcs_parameters = {
 struct CAN_XR_MAC mac;
 struct CAN_XR_PCS pcs;
 struct CAN_XR_PMA pma;
+struct CAN_XR_MAC_Queue queue;
 // MAC stuff
 bpmac_ctx_t ctx_grp;
 uint64_t grp_nonce[2] = {0, 0};
 uint8_t grp_key[] = {0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00};
 uint8_t grp_key_nonce[] = {0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF};
 
-uint16_t correct = 0;
-uint16_t incorrect = 0;
 uint16_t signaling_state = 0;
-uint8_t unauth_cnt = 0;
+uint8_t agg_grp_mac[CAN_XR_AUTH_POLICY_RULES][16];    /* aggregated mode accumulators, one per policy rule */
 int signal_cnt = 5;
 int msg_limit = 10005;
 int msg_cnt = 0;
 
+/* Latency histograms of the frames received, sent to the bus after
+   each round in frames LATENCY_REPORT_ID, see CAN_XR_Latency_Pack().
+*/
+#define LATENCY_REPORT_ID 0x7E0
+struct CAN_XR_Latency latency;
+int report_cls = 0;
+int report_stage = CAN_XR_LATENCY_EOF;
+int report_first = 0;
+
 void dummy_data_ind(
     struct CAN_XR_LLC *llc, unsigned long ts, uint32_t identifier,
     enum CAN_XR_Format format, int dlc, uint8_t *data)
 {
-    switch (identifier) {
+    /* CEFF frames follow the policy of their base identifier */
+    uint32_t policy_id = CAN_XR_Auth_Policy_Key(identifier, format == CAN_XR_FORMAT_CEFF);
+
+    /* data MAC bytes at the end of the payload, 0 if not authenticated */
+    int mac_len = CAN_XR_Auth_Policy_MAC_Len(mac.policy, policy_id, dlc);
+
+    /* signalling frames are all CBFF */
+    switch ((format == CAN_XR_FORMAT_CBFF) ? identifier : CAN_XR_AUTH_POLICY_IDS) {
         case 555:   /* (1) 10k message signal */
             signaling_state = 383;
             break;
@@ -107,12 +126,10 @@ void dummy_data_ind(
             uint8_t grp_mac[16] = {0};
             bpmac_pre(&ctx_grp, (uint8_t *) grp_nonce, (char *) grp_mac);
 
-            for(int8_t i = 10; i >= 0; i--) {
-                bpmac_update(&ctx_grp, (identifier & (1 << i)), (char *) grp_mac);
-            }
+            bpmac_update_id(&ctx_grp, identifier, 11, (char *) grp_mac);
             bpmac_sign(&ctx_grp, (char *) data, 5, (char *) grp_mac);
 
-            if (!(data[5] == grp_mac[1] && data[6] == grp_mac[2] && data[7] == grp_mac[3]))
+            if (memcmp(data + 5, grp_mac + MAC_LEN - 3, 3) != 0)
             {
                 /* if MAC incorrect */
                 led_on(led2);
@@ -129,41 +146,58 @@ void dummy_data_ind(
                 {
                     grp_nonce[1]++;
                 }
-                unauth_cnt = 0;
+                METRIC_SET(CAN_XR_METRIC_AUTH_FAIL_RUN, 0);
                 signaling_state = 0;
+                METRIC_INC(CAN_XR_METRIC_RESYNCS);
 
             }
             break;
 
         default:    /* check for CAIBA authenticated message and validate*/
-            if (signaling_state == 0 && identifier <= 256)
+            if (signaling_state == 0 && mac_len > 0)
             {
                 led_off(led2);
                 led_off(led4);
 
                 uint8_t grp_mac[16] = {0};
-
-                bpmac_pre(&ctx_grp, (uint8_t *) grp_nonce, (char *) grp_mac);
-
-                /* msg id is covered by MAC */
-                for(int8_t i = 10; i >= 0; i--) {
-                    bpmac_update(&ctx_grp, (identifier & (1 << i)), (char *) grp_mac);
+                uint64_t nonce[2] = {grp_nonce[0], grp_nonce[1]};
+
+#if CAN_XR_NONCE_HINT_BITS > 0
+                /* realign with the nonce hint carried in the first payload byte, the new nonce is only kept if
+                 * the MAC is correct */
+                uint64_t delta = CAN_XR_NONCE_HINT_DELTA(CAN_XR_NONCE_HINT_GRP(data[0]), nonce[0]);
+                METRIC_SET(CAN_XR_METRIC_NONCE_DELTA, delta);
+                if ((nonce[0] += delta) < delta)
+                {
+                    nonce[1]++;
                 }
+#endif
 
-                bpmac_sign(&ctx_grp, (char *) data, dlc - 3, (char *) grp_mac);
+                bpmac_pre(&ctx_grp, (uint8_t *) nonce, (char *) grp_mac);
 
+                /* msg id is covered by MAC, all 29 bits of it in CEFF */
+                bpmac_update_id(&ctx_grp, identifier, (format == CAN_XR_FORMAT_CEFF) ? 29 : 11, (char *) grp_mac);
 
+                bpmac_sign(&ctx_grp, (char *) data, dlc - mac_len, (char *) grp_mac);
 
-                if (++grp_nonce[0] == 0)
+                /* aggregated mode: a checkpoint carries the cumulative tag of the frames of its rule since the
+                 * previous one, the other frames only a short tag of their own */
+                const struct CAN_XR_Auth_Rule *rule = CAN_XR_Auth_Policy_Rule(mac.policy, policy_id);
+                uint8_t *agg_mac = rule->aggregate ? agg_grp_mac[rule - mac.policy->rule] : NULL;
+                int checkpoint = CAN_XR_Auth_Policy_Is_Checkpoint(rule, mac_len);
+
+                if (agg_mac && checkpoint)
                 {
-                    grp_nonce[1]++;
+                    xor_tags(grp_mac, agg_mac);
                 }
 
                 /* VALIDATION */
                 static uint8_t on = 0;
 
                 /* correct MAC received */
-                if (data[dlc - 3] == grp_mac[1] && data[dlc - 2] == grp_mac[2] && data[dlc - 1] == grp_mac[3]) {
+                if (memcmp(data + dlc - mac_len, grp_mac + MAC_LEN - mac_len, mac_len) == 0) {
+                    grp_nonce[0] = nonce[0];
+                    grp_nonce[1] = nonce[1];
                     if (!on) {
                         led_on(led1);
                         on = 1;
@@ -173,21 +207,47 @@ void dummy_data_ind(
                     }
                     led_off(led4);
                     led_off(led2);
-                    correct += 1;
-                    unauth_cnt = 0;
+                    METRIC_INC(CAN_XR_METRIC_AUTH_OK);
+                    METRIC_SET(CAN_XR_METRIC_AUTH_FAIL_RUN, 0);
+
+                    /* The frame is still in the receive ring */
+                    CAN_XR_Latency_Record(
+                        &latency, CAN_XR_Latency_Class(mac.policy, policy_id),
+                        CAN_XR_LATENCY_VERIFIED,
+                        pcs.state.nodeclock_ts - CAN_XR_MAC_Queue_Rx_Frame(&queue)->sof_ts);
                 }
                 /* MAC incorrect */
                 else
                 {
-                    unauth_cnt++;
+                    uint32_t fail_run = CAN_XR_Metrics_Get(CAN_XR_METRIC_AUTH_FAIL_RUN) + 1;
+
+                    METRIC_SET(CAN_XR_METRIC_AUTH_FAIL_RUN, fail_run);
                     reset_leds();
                     led_on(led4);
                     led_on(led2);
-                    if (unauth_cnt == 5)    /* trigger nonce reset */
+                    if (fail_run == 5)    /* trigger nonce reset */
                     {
                         signaling_state = 384;
                     }
-                    incorrect += 1;
+                    METRIC_INC(CAN_XR_METRIC_AUTH_FAIL);
+                    CAPTURE_EVENT(CAN_XR_CAPTURE_MAC_MISMATCH);
+                }
+
+                if (agg_mac)
+                {
+                    if (checkpoint)
+                    {
+                        memset(agg_mac, 0, 16);
+                    }
+                    else
+                    {
+                        xor_tags(agg_mac, grp_mac);
+                    }
+                }
+
+                if (++grp_nonce[0] == 0)
+                {
+                    grp_nonce[1]++;
                 }
 
                 if (++msg_cnt >= msg_limit) {
@@ -198,61 +258,105 @@ void dummy_data_ind(
     }
 }
 
-void app_nodeclock_ind(
-        struct CAN_XR_PCS *pcs, int bus_level)
+/* Application task, invoked by the foreground loop in main() every
+   APP_TASK_PERIOD nodeclock cycles.  Like dummy_data_ind, which is
+   dispatched by the same loop, it does not run in the bit engine.
+*/
+#define APP_TASK_PERIOD 6000    // for one message every ~25 ms @ 40 kbs
+
+void app_task(void)
 {
+    uint16_t count;
 
-    static int msg_intervals = 0;
+    switch (signaling_state) {
+        case 384:   /* trigger nonce reset on all nodes */
+            led_on(led3);   /* nonce reset lec */
+            led_off(led2);  /* reset wrong MAC leds */
+            led_off(led4);
 
-    if (msg_intervals++ % 6000 == 0) {      // for one message every ~25 ms @ 40 kbs
-        switch (signaling_state) {
-            case 384:   /* trigger nonce reset on all nodes */
-                led_on(led3);   /* nonce reset lec */
-                led_off(led2);  /* reset wrong MAC leds */
-                led_off(led4);
+            count = CAN_XR_Metrics_Get(CAN_XR_METRIC_AUTH_FAIL_RUN);
+            CAN_XR_MAC_Queue_Data_Req(&queue, 384, CAN_XR_FORMAT_CBFF, 1, (uint8_t *) &count);
+            signaling_state = 999;
+            break;
 
-                CAN_XR_MAC_Data_Req(&mac, 384, CAN_XR_FORMAT_CBFF, 1, (uint8_t *) unauth_cnt);
-                signaling_state = 999;
-                break;
+        case 383:   /* (2) answer to 10k message signal -> send #correct MACs received */
+            count = CAN_XR_Metrics_Get(CAN_XR_METRIC_AUTH_OK);
+            CAN_XR_MAC_Queue_Data_Req(&queue, 383, CAN_XR_FORMAT_CBFF, 2, (uint8_t *) &count);
+            signaling_state = 0;
+            break;
 
-            case 383:   /* (2) answer to 10k message signal -> send #correct MACs received */
-                CAN_XR_MAC_Data_Req(&mac, 383, CAN_XR_FORMAT_CBFF, 2, (uint8_t *) &correct);
-                signaling_state = 0;
-                break;
+        case 525:   /* (4) answer to #transmission attempts -> send #incorrect MACs received */
+            count = CAN_XR_Metrics_Get(CAN_XR_METRIC_AUTH_FAIL);
+            CAN_XR_MAC_Queue_Data_Req(&queue, 525, CAN_XR_FORMAT_CBFF, 2, (uint8_t *) &count);
+            led_set_all();
+            if (--signal_cnt == 0) {    /* repeat 5 times */
+                signaling_state = 418;
+            } else {
+                signaling_state = 383;
+            }
+            break;
 
-            case 525:   /* (4) answer to #transmission attempts -> send #incorrect MACs received */
-                CAN_XR_MAC_Data_Req(&mac, 525, CAN_XR_FORMAT_CBFF, 2, (uint8_t *) &incorrect);
-                led_set_all();
-                if (--signal_cnt == 0) {    /* repeat 5 times */
-                    signaling_state = 418;
-                } else {
-                    signaling_state = 383;
+        case 418:   /* (5) signalize continue */
+            msg_cnt = 0;
+            signal_cnt = 5;
+            CAN_XR_Metrics_Clear(CAN_XR_METRIC_AUTH_OK);
+            CAN_XR_Metrics_Clear(CAN_XR_METRIC_AUTH_FAIL);
+            uint8_t data = 0xFF;
+            CAN_XR_MAC_Queue_Data_Req(&queue, 418, CAN_XR_FORMAT_CBFF, 1, (uint8_t *) &data);
+            reset_leds();
+            signaling_state = LATENCY_REPORT_ID;
+            break;
+
+        case LATENCY_REPORT_ID:     /* (6) latency histograms, one frame per task */
+            /* Only the stages from SOF to EOF and to the verification
+               of the data MAC, skipping the empty histograms.
+            */
+            while (report_cls < CAN_XR_LATENCY_CLASSES
+                   && latency.hist[report_cls][report_stage].count == 0)
+            {
+                if (report_stage++ == CAN_XR_LATENCY_VERIFIED)
+                {
+                    report_stage = CAN_XR_LATENCY_EOF;
+                    report_cls++;
                 }
-                break;
+            }
 
-            case 418:   /* (5) signalize continue */
-                msg_cnt = 0;
+            if (report_cls == CAN_XR_LATENCY_CLASSES)
+            {
+                report_cls = 0;
                 signaling_state = 0;
-                signal_cnt = 5;
-                correct = 0;
-                incorrect = 0;
-                uint8_t data = 0xFF;
-                CAN_XR_MAC_Data_Req(&mac, 418, CAN_XR_FORMAT_CBFF, 1, (uint8_t *) &data);
-                reset_leds();
                 break;
+            }
 
-            default:
-                // noop
-                break;
-        }
+            uint8_t buf[8];
+            int next = CAN_XR_Latency_Pack(&latency, report_cls, report_stage, report_first, buf);
+            if (!CAN_XR_MAC_Queue_Data_Req(&queue, LATENCY_REPORT_ID, CAN_XR_FORMAT_CBFF, 8, buf))
+                break;  /* Retry at the next task */
+
+            report_first = next;
+            if (report_first == 0 && report_stage++ == CAN_XR_LATENCY_VERIFIED)
+            {
+                report_stage = CAN_XR_LATENCY_EOF;
+                report_cls++;
+            }
+            break;
+
+        default:
+            // noop
+            break;
     }
 }
 
 int main(int argc, char *argv[])
 {
+    unsigned long last_task = 0;
+#ifdef ENABLE_CAPTURE
+    int capture_sent = 0;
+#endif
+
     enable_leds();
 
-    bpmac_init((char *) grp_key, (char *) grp_key_nonce, 8, &ctx_grp);
+    bpmac_init((char *) grp_key, (char *) grp_key_nonce, CAN_XR_AUTH_MSG_MAX_SIZE, &ctx_grp);
 
     CAN_XR_PMA_GPIO_Init(&pma, GPIO_PRESCALER);
     CAN_XR_PCS_Init(&pcs, &pcs_parameters, &pma);
@@ -261,15 +365,62 @@ int main(int argc, char *argv[])
        function when there's one. */
     CAN_XR_MAC_Common_Init(&mac, &pcs);
 
-    /* Register app_nodeclock_ind to trigger the transmission */
-    CAN_XR_PMA_GPIO_Set_App_NodeClock_Ind(&pma, app_nodeclock_ind);
+    CAN_XR_Latency_Init(&latency);
+    CAN_XR_MAC_Set_Latency(&mac, &latency);
+
+    /* Accept only the frames dummy_data_ind looks at: those
+       authenticated by the default policy, [0, 255] in CBFF and CEFF,
+       which include the nonce frame 200, and the signals 555 and 279.
+       The others are neither buffered nor queued. */
+    CAN_XR_MAC_Set_Filter(&mac, 0, CAN_XR_FORMAT_CBFF, 0x000, 0x700);
+    CAN_XR_MAC_Set_Filter(&mac, 1, CAN_XR_FORMAT_CEFF, 0x000, 0x700UL << 18);
+    CAN_XR_MAC_Set_Filter(&mac, 2, CAN_XR_FORMAT_CBFF, 555, 0x7FF);
+    CAN_XR_MAC_Set_Filter(&mac, 3, CAN_XR_FORMAT_CBFF, 279, 0x7FF);
+
+    /* Connect the MAC to the foreground loop, the queue feeds it with
+       transmission requests on every nodeclock cycle. */
+    CAN_XR_MAC_Queue_Init(&queue, &mac);
+    CAN_XR_PMA_GPIO_Set_App_NodeClock_Ind(&pma, CAN_XR_MAC_Queue_NodeClock_Ind);
+
+    /* Register a dummy data_ind primitive in 'queue'.  MACs are
+       verified in the foreground loop. */
+    CAN_XR_MAC_Queue_Set_Data_Ind(&queue, dummy_data_ind);
+
+    /* Start the controller, feeding it with nodeclock indications
+       from the Timer 0 interrupt. */
+    TRACE_INIT();
+    SET_TRACE_TRESHOLD(3);
 
-    /* Register a dummy data_ind primitive in 'mac'. */
-    CAN_XR_MAC_Set_Data_Ind(&mac, dummy_data_ind);
+    /* Stop the capture in the middle of the ring after the first
+       wrong data MAC or stuff error */
+    CAPTURE_INIT(configCPU_CLOCK_HZ);
+    CAPTURE_TRIGGER(CAN_XR_CAPTURE_MASK(CAN_XR_CAPTURE_MAC_MISMATCH)
+                    | CAN_XR_CAPTURE_MASK(CAN_XR_CAPTURE_STUFF_ERROR),
+                    CAN_XR_CAPTURE_RECORDS / 2);
 
-    /* Start the controller, feeding it with nodeclock indications. */
-    SET_TRACE_TRESHOLD(3);
-    CAN_XR_PMA_GPIO_NodeClock_Ind(&pma);
+    CAN_XR_PMA_GPIO_Start(&pma);
+
+    /* Foreground loop */
+    while (1)
+    {
+        CAN_XR_MAC_Queue_Dispatch(&queue);
+
+        if (CAN_XR_PMA_GPIO_NodeClocks(&pma) - last_task >= APP_TASK_PERIOD)
+        {
+            last_task += APP_TASK_PERIOD;
+            app_task();
+        }
+
+#ifdef ENABLE_CAPTURE
+        /* Send the capture around the trigger to the host, once,
+           see tools/capture_vcd.c */
+        if (!capture_sent && CAN_XR_Capture_Stopped())
+        {
+            CAN_XR_Capture_Dump(stderr);
+            capture_sent = 1;
+        }
+#endif
+    }
 
     return EXIT_SUCCESS;
 }
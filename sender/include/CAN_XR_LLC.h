@@ -32,6 +32,8 @@
    shared between LLC and MAC.
 */
 
+#ifndef CAN_XR_LLC_H
+#define CAN_XR_LLC_H
 
 /* LLC frame format, [1] Table 4, also used by MAC.  Generally, data
    types are defined in the header of the highest layer that uses them
@@ -40,7 +42,41 @@
 */
 enum CAN_XR_Format {
     CAN_XR_FORMAT_CBFF, /* Classical Base (11b) */
-    CAN_XR_FORMAT_CEFF, /* Classical Extended (29b), unsupported */
-    CAN_XR_FORMAT_FBFF, /* FD Base (11b), unsupported */
-    CAN_XR_FORMAT_FEFF  /* FD Extended (29b), unsupported */
+    CAN_XR_FORMAT_CEFF, /* Classical Extended (29b) */
+    CAN_XR_FORMAT_FBFF, /* FD Base (11b) */
+    CAN_XR_FORMAT_FEFF  /* FD Extended (29b) */
 };
+
+/* Maximum length of the data field, in bytes, of FD frames.
+   Classical frames carry at most 8.
+*/
+#define CAN_XR_DATA_LEN_MAX 64
+
+/* Nonzero if 'format' is an FD one. */
+static inline int CAN_XR_Format_Is_FD(enum CAN_XR_Format format)
+{
+    return format == CAN_XR_FORMAT_FBFF || format == CAN_XR_FORMAT_FEFF;
+}
+
+/* Nonzero if 'format' has a 29-bit identifier. */
+static inline int CAN_XR_Format_Is_Extended(enum CAN_XR_Format format)
+{
+    return format == CAN_XR_FORMAT_CEFF || format == CAN_XR_FORMAT_FEFF;
+}
+
+/* Number of data bytes conveyed by 'dlc' in a frame of the given
+   'format', [1] Table 5.  Classical frames saturate at 8 bytes, FD
+   frames use the codes 9-15 for 12, 16, 20, 24, 32, 48 and 64 bytes.
+*/
+static inline int CAN_XR_DLC_Len(enum CAN_XR_Format format, int dlc)
+{
+    static const unsigned char fd_len[16] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64
+    };
+
+    if(CAN_XR_Format_Is_FD(format))
+        return fd_len[dlc & 0xF];
+    return (dlc > 8) ? 8 : dlc;
+}
+
+#endif
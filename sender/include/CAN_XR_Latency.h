@@ -0,0 +1,114 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* This header defines the latency histograms of a MAC, registered
+   with CAN_XR_MAC_Set_Latency().
+
+   Latencies are in nodeclock periods, taken from the nodeclock_ts of
+   the PCS, and go into histograms with logarithmic buckets: bucket
+   0 holds 0 and 1, bucket b > 0 holds [2^b, 2^(b+1)), the last one
+   everything longer.  There is one histogram per stage and per
+   identifier class, the rule of the authentication policy that
+   applies to the frame or CAN_XR_LATENCY_UNAUTHENTICATED.
+
+   The MAC measures the stages it sees on the bus at EOF; the
+   application adds CAN_XR_LATENCY_VERIFIED when it has checked the
+   data MAC of a received frame, from the .sof_ts of the frame, see
+   struct CAN_XR_MAC_Rx_Frame.
+*/
+
+#ifndef CAN_XR_LATENCY_H
+#define CAN_XR_LATENCY_H
+
+#include <stdio.h> /* For FILE */
+#include <stdint.h>
+#include <CAN_XR_Auth_Policy.h>
+
+#define CAN_XR_LATENCY_BUCKETS 16
+
+#define CAN_XR_LATENCY_UNAUTHENTICATED CAN_XR_AUTH_POLICY_RULES
+#define CAN_XR_LATENCY_CLASSES (CAN_XR_AUTH_POLICY_RULES + 1)
+
+enum CAN_XR_Latency_Stage
+{
+    CAN_XR_LATENCY_DATA,        /* SOF to end of payload, data MAC excluded */
+    CAN_XR_LATENCY_MAC,         /* SOF to end of data field, data MAC included */
+    CAN_XR_LATENCY_EOF,         /* SOF to frame validation at EOF */
+    CAN_XR_LATENCY_VERIFIED,    /* SOF to data MAC verified by the application */
+    CAN_XR_LATENCY_TX,          /* Transmission request to frame validation */
+    CAN_XR_LATENCY_STAGES
+};
+
+struct CAN_XR_Latency_Hist
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t bucket[CAN_XR_LATENCY_BUCKETS];
+};
+
+struct CAN_XR_Latency
+{
+    struct CAN_XR_Latency_Hist hist[CAN_XR_LATENCY_CLASSES][CAN_XR_LATENCY_STAGES];
+};
+
+/* Clear all histograms of 'lat'. */
+void CAN_XR_Latency_Init(struct CAN_XR_Latency *lat);
+
+/* Identifier class of the frames whose policy entry is 'key', see
+   CAN_XR_Auth_Policy_Key().  Constant time.
+*/
+static inline int CAN_XR_Latency_Class(
+    const struct CAN_XR_Auth_Policy *policy, uint32_t key)
+{
+    key &= CAN_XR_AUTH_POLICY_IDS - 1;
+    if(!CAN_XR_Auth_Policy_Is_Authenticated(policy, key))
+        return CAN_XR_LATENCY_UNAUTHENTICATED;
+    return policy->rule_of_id[key];
+}
+
+/* Account a latency of 'nodeclocks' to 'stage' of class 'cls'.  A
+   few comparisons and a count of leading zeros, it is called by the
+   bit engine once per stage and frame.
+*/
+void CAN_XR_Latency_Record(
+    struct CAN_XR_Latency *lat, int cls, enum CAN_XR_Latency_Stage stage,
+    unsigned long nodeclocks);
+
+/* Store into 'buf', 8 bytes, the buckets of 'stage' of class 'cls'
+   from 'first' on, for a debug frame: the class and the stage in the
+   first byte, 4 bits each, 'first' in the second one and three
+   buckets as 16-bit values, least significant byte first, saturated.
+   Return the first bucket of the next frame, 0 after the last one.
+*/
+int CAN_XR_Latency_Pack(
+    const struct CAN_XR_Latency *lat, int cls, enum CAN_XR_Latency_Stage stage,
+    int first, uint8_t *buf);
+
+/* Print on 'f' the histograms of 'lat' that are not empty, with
+   their count, minimum, maximum and the upper bound of the buckets
+   holding the median and the 99th percentile.  'desc' comes first.
+*/
+void CAN_XR_Latency_Dump(
+    FILE *f, const char *desc, const struct CAN_XR_Latency *lat);
+
+#endif
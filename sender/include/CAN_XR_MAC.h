@@ -33,6 +33,8 @@
 #define CAN_XR_MAC_H
 
 #include <stdint.h>
+#include <CAN_XR_Auth_Policy.h>
+#include <CAN_XR_SPSC.h>
 #include "CAN_XR_LLC.h" /* For enum CAN_XR_Format */
 
 /* Implementation-dependent part of the MAC state.  Currently we have
@@ -56,17 +58,23 @@ enum CAN_XR_MAC_RX_FSM_State
     CAN_XR_MAC_RX_FSM_BUS_INTEGRATION, /* [1], 10.9.4 */ // used for synchronization
     CAN_XR_MAC_RX_FSM_IDLE,
     CAN_XR_MAC_RX_FSM_RX_IDENTIFIER,   /* [1], Figure 12 */
-    CAN_XR_MAC_RX_FSM_RX_RTR,
+    CAN_XR_MAC_RX_FSM_RX_RTR,          /* Or SRR, until IDE tells */
     CAN_XR_MAC_RX_FSM_RX_IDE,
+    CAN_XR_MAC_RX_FSM_RX_ID_EXT,       /* [1], Figure 13 */
     CAN_XR_MAC_RX_FSM_RX_FDF,
+    CAN_XR_MAC_RX_FSM_RX_R0,           /* CEFF, res in FD frames */
+    CAN_XR_MAC_RX_FSM_RX_BRS,          /* [1], Figures 14-15 */
+    CAN_XR_MAC_RX_FSM_RX_ESI,
     CAN_XR_MAC_RX_FSM_RX_DLC,
     CAN_XR_MAC_RX_FSM_RX_DATA,
     CAN_XR_MAC_RX_FSM_RX_DATA_MAC,
     CAN_XR_MAC_RX_FSM_RX_CRC,
+    CAN_XR_MAC_RX_FSM_RX_FD_CRC,       /* Stuff count and CRC, FD */
     CAN_XR_MAC_RX_FSM_RX_CDEL,
     CAN_XR_MAC_RX_FSM_RX_ACK,
     CAN_XR_MAC_RX_FSM_RX_ADEL,
     CAN_XR_MAC_RX_FSM_RX_EOF,
+    CAN_XR_MAC_RX_FSM_INTERMISSION,    /* [1], 10.4.5 */
     CAN_XR_MAC_RX_FSM_ERROR,
     CAN_XR_MAC_RX_FSM_ERROR_FLAG,
     CAN_XR_MAC_RX_FSM_ERROR_DEL
@@ -77,14 +85,20 @@ enum CAN_XR_MAC_TX_FSM_State
 {
     CAN_XR_MAC_TX_FSM_IDLE,
     CAN_XR_MAC_TX_FSM_TX_IDENTIFIER,    /* Mimic the RX_FSM ones */
+    CAN_XR_MAC_TX_FSM_TX_SRR,
     CAN_XR_MAC_TX_FSM_TX_RTR,
     CAN_XR_MAC_TX_FSM_TX_IDE,
+    CAN_XR_MAC_TX_FSM_TX_ID_EXT,
     CAN_XR_MAC_TX_FSM_TX_FDF,
+    CAN_XR_MAC_TX_FSM_TX_R0,
+    CAN_XR_MAC_TX_FSM_TX_BRS,
+    CAN_XR_MAC_TX_FSM_TX_ESI,
     CAN_XR_MAC_TX_FSM_TX_DLC,
     CAN_XR_MAC_TX_FSM_TX_DATA,
     CAN_XR_MAC_TX_FSM_TX_DATA_MAC,  // for two bytes of message authentication code
     CAN_XR_MAC_TX_FSM_TX_CRC_LATCH,
     CAN_XR_MAC_TX_FSM_TX_CRC,
+    CAN_XR_MAC_TX_FSM_TX_FD_CRC,
     CAN_XR_MAC_TX_FSM_TX_CDEL,
     CAN_XR_MAC_TX_FSM_TX_ACK,
     CAN_XR_MAC_TX_FSM_TX_ADEL,
@@ -95,6 +109,65 @@ enum CAN_XR_MAC_TX_FSM_State
     CAN_XR_MAC_TX_FSM_ERROR
 };
 
+/* Number of transmit mailboxes.  The occupancy of the mailboxes is
+   kept in a 32-bit map, so there can be at most 32 of them.
+*/
+#ifndef CAN_XR_MAC_MAILBOXES
+#define CAN_XR_MAC_MAILBOXES 8
+#endif
+
+#if CAN_XR_MAC_MAILBOXES < 1 || CAN_XR_MAC_MAILBOXES > 32
+#error "CAN_XR_MAC_MAILBOXES must be between 1 and 32"
+#endif
+
+#define CAN_XR_MAC_MAILBOX_ALL \
+    ((uint32_t)(0xFFFFFFFFUL >> (32 - CAN_XR_MAC_MAILBOXES)))
+
+/* Number of acceptance filter banks.  As for the mailboxes, the banks
+   that may still accept the frame being received are kept in a 32-bit
+   map, so there can be at most 32 of them.
+*/
+#ifndef CAN_XR_MAC_FILTERS
+#define CAN_XR_MAC_FILTERS 8
+#endif
+
+#if CAN_XR_MAC_FILTERS < 1 || CAN_XR_MAC_FILTERS > 32
+#error "CAN_XR_MAC_FILTERS must be between 1 and 32"
+#endif
+
+/* Identifier bits of CEFF frames, base identifier first */
+#define CAN_XR_MAC_ID_BITS 29
+
+/* Transmit mailbox, filled by MAC_Data.Request and loaded into the
+   transmit automaton at SOF.  The contents are already in the form
+   the transmit automaton wants them.
+*/
+struct CAN_XR_MAC_Mailbox
+{
+    uint32_t identifier;
+    enum CAN_XR_Format format;
+    int dlc;
+    uint8_t data[CAN_XR_DATA_LEN_MAX];
+    uint8_t data_mac[CAN_XR_AUTH_MAC_LEN_MAX];
+    int mac_len;        // 0 if the frame is not authenticated
+    uint32_t seq;       // request order
+    unsigned long req_ts;   // nodeclock_ts of the request
+};
+
+/* Received frame, committed into the receive ring at EOF, see
+   CAN_XR_MAC_Set_Rx_Ring().
+*/
+struct CAN_XR_MAC_Rx_Frame
+{
+    unsigned long ts;   /* EOF */
+    unsigned long sof_ts;   /* SOF */
+    uint32_t identifier;
+    enum CAN_XR_Format format;
+    int dlc;
+    int mac_len;        /* Data MAC bytes at the end of .data[] per the policy, 0 if not authenticated */
+    uint8_t data[CAN_XR_DATA_LEN_MAX];
+};
+
 /* Overall MAC state.  Made up of an implementation-independent part
    (defined directly in this structure) and an
    implementation-dependent part (members of the id union).
@@ -102,12 +175,16 @@ enum CAN_XR_MAC_TX_FSM_State
 struct CAN_XR_MAC_State
 {
     enum CAN_XR_MAC_RX_FSM_State rx_fsm_state;  // current state of finite state machine (FSM) of the MAC layer
+    enum CAN_XR_MAC_RX_FSM_State rx_fsm_entry;  // rx_fsm_state at the last pcs_data_ind, for PMA overruns
 
     int bus_integration_counter; /* Bus integration */
 
     int nc_bits; /* De-stuffing and CRC calculation */
     int nc_pol;
     uint16_t crc;
+    uint32_t crc17;     // CRCs of FD frames, over the stuffed bit stream
+    uint32_t crc21;
+    int stuff_bits;     // dynamic stuff bits, for the stuff count of FD frames
     int field_bits;
     int bus_bits;
     int de_stuffed_bits;
@@ -116,28 +193,55 @@ struct CAN_XR_MAC_State
     int rx_rtr;
     int rx_ide;
     int rx_fdf;
+    int rx_brs;
+    int rx_esi;
     int rx_dlc;
+    int rx_len;         // data bytes, from .rx_dlc
+    int rx_payload_bits; // data field bits left at the last payload bit, before the data MAC
+    unsigned long rx_sof_ts;    // nodeclock_ts of SOF, end of payload and end of data field
+    unsigned long rx_data_ts;
+    unsigned long rx_mac_ts;
+    int rx_stuff_count; // stuff count field of FD frames, as received
     uint8_t rx_byte;
     int rx_byte_index;
-    uint8_t rx_data[8];
+    uint8_t rx_data[CAN_XR_DATA_LEN_MAX];
+
+    uint32_t filter_enabled;    // bit i set when filter bank i is set
+    uint32_t filter_reject[2][CAN_XR_MAC_ID_BITS]; // banks rejecting a 0/1 at identifier bit #n
+    uint32_t filter_reject_ide[2];  // banks rejecting a 0/1 IDE
+    uint32_t rx_filter_match;   // banks that may still accept the frame being received
+    uint8_t *rx_buf;            // data field being received, .rx_data[] or .rx_slot->data[]
+    struct CAN_XR_MAC_Rx_Frame *rx_slot; // receive ring slot being filled, NULL if none
+    int rx_accept;              // buffer and indicate the frame being received
 
     enum CAN_XR_MAC_TX_FSM_State tx_fsm_state;
 
-    int data_req_pending;
+    int data_req_pending;   // at least one mailbox is full
+    struct CAN_XR_MAC_Mailbox mailbox[CAN_XR_MAC_MAILBOXES];
+    uint32_t mailbox_full;  // bit i set when mailbox[i] is full
+    int tx_next;            // mailbox to be transmitted at the next SOF, -1 if none
+    int tx_mailbox;         // mailbox being transmitted
+    uint32_t tx_seq;        // sequence number of the next request
     uint32_t tx_identifier;
     enum CAN_XR_Format tx_format;
     int tx_dlc;
-    uint8_t tx_data[7];
-    uint8_t tx_data_mac[3];
+    uint8_t tx_data[CAN_XR_DATA_LEN_MAX];
+    uint8_t tx_data_mac[CAN_XR_AUTH_MAC_LEN_MAX];
+    int tx_mac_len;     // data MAC bytes of the frame being transmitted, 0 if it is not authenticated
     int tx_byte_index;
     int tx_bit_count;   // will be set to the number of data bits that will be transmitted and will be decreased. Indicates that all data was transmitted
     uint32_t tx_shift_reg;
     uint8_t mac_byte_index;
+    int tx_level;       // level requested by the tx automaton for the current bit, for bit monitoring
+    int tx_monitor;     // whether that bit is subject to bit monitoring
+    unsigned long arbitration_lost; // frames that lost arbitration, to be transmitted again
+    int brs;            // BRS of the FD frames we transmit, see CAN_XR_MAC_Set_Bit_Rate_Switch()
 
     union CAN_XR_MAC_ID_State id;
 };
 
 struct CAN_XR_MAC;
+struct CAN_XR_Latency;
 struct CAN_XR_LLC;
 
 enum CAN_XR_MAC_Tx_Status {
@@ -199,6 +303,15 @@ struct CAN_XR_MAC
     struct CAN_XR_LLC *llc; /* Link to the upper protocol layer. */
     struct CAN_XR_PCS *pcs; /* Link to the lower protocol layer. */
 
+    /* Authentication policy, shared with the other nodes. */
+    const struct CAN_XR_Auth_Policy *policy;
+
+    /* Received frames, NULL to use data_ind instead. */
+    struct CAN_XR_SPSC *rx_ring;
+
+    /* Latency histograms, NULL if not kept. */
+    struct CAN_XR_Latency *latency;
+
     struct CAN_XR_MAC_State state;
     struct CAN_XR_MAC_Primitives primitives;
 };
@@ -220,6 +333,52 @@ void CAN_XR_MAC_Bare_Bones_Init(
 /* Set the pointer to the upper layer in 'mac' */
 void CAN_XR_MAC_Set_LLC(struct CAN_XR_MAC *mac, struct CAN_XR_LLC *llc);
 
+/* Set the authentication policy of 'mac'.  By default it is
+   CAN_XR_Auth_Policy_Default().
+*/
+void CAN_XR_MAC_Set_Auth_Policy(
+    struct CAN_XR_MAC *mac, const struct CAN_XR_Auth_Policy *policy);
+
+/* Keep the latency histograms of the frames 'mac' receives and
+   transmits in 'lat', see CAN_XR_Latency.h.  NULL, the default, keeps
+   none.
+*/
+void CAN_XR_MAC_Set_Latency(struct CAN_XR_MAC *mac, struct CAN_XR_Latency *lat);
+
+/* Set or clear BRS in the FD frames transmitted by 'mac'.  When it is
+   set, their data phase goes at the data bit time of the PCS, see
+   CAN_XR_PCS_Set_Data_Bit_Time().  Clear by default.
+*/
+void CAN_XR_MAC_Set_Bit_Rate_Switch(struct CAN_XR_MAC *mac, int brs);
+
+/* Set acceptance filter bank 'bank' of 'mac'.  The bank accepts the
+   frames with the identifier format of 'format', standard or extended
+   (FDF does not matter), whose identifier bits set in 'mask' are equal
+   to those of 'identifier'.  The banks are evaluated as the identifier
+   bits arrive.  When at least one bank is set, the frames no bank
+   accepts are still received, checked and acknowledged, but neither
+   buffered nor indicated.  No bank is set by default, so that all
+   frames are indicated.  To be called before the controller is
+   started.  Returns 0 on success, -1 if 'bank' is out of range.
+*/
+int CAN_XR_MAC_Set_Filter(
+    struct CAN_XR_MAC *mac, int bank,
+    enum CAN_XR_Format format, uint32_t identifier, uint32_t mask);
+
+/* Clear acceptance filter bank 'bank' of 'mac'.  Returns 0 on
+   success, -1 if 'bank' is out of range.
+*/
+int CAN_XR_MAC_Clear_Filter(struct CAN_XR_MAC *mac, int bank);
+
+/* Make 'mac' commit the frames it receives into 'rx_ring', a queue
+   of struct CAN_XR_MAC_Rx_Frame, instead of invoking data_ind from
+   the bit engine.  The data field is received in place into the next
+   free slot, which is committed at EOF and consumed outside the bit
+   engine.  A frame that finds 'rx_ring' full is lost and counted in
+   its .overflows.  NULL, the default, goes back to data_ind.
+*/
+void CAN_XR_MAC_Set_Rx_Ring(struct CAN_XR_MAC *mac, struct CAN_XR_SPSC *rx_ring);
+
 /* Register the data_ind and data_conf upcall primitives in 'mac'. */
 void CAN_XR_MAC_Set_Data_Ind(
     struct CAN_XR_MAC *mac, CAN_XR_MAC_Data_Ind_t data_ind);
@@ -236,6 +395,14 @@ void CAN_XR_MAC_Data_Req(
     struct CAN_XR_MAC *mac,
     uint32_t identifier, enum CAN_XR_Format format, int dlc, uint8_t *data, uint8_t *data_mac);
 
+/* Bit engine.  Empty the mailboxes of 'mac' that hold authenticated
+   frames, for instance signed with nonces that have just been reset,
+   and confirm each of them with CAN_XR_MAC_TX_STATUS_NO_SUCCESS.  Only
+   to be invoked while the transmit automaton is idle, when no mailbox
+   is being transmitted.  Return the number of frames dropped.
+*/
+int CAN_XR_MAC_Flush_Auth(struct CAN_XR_MAC *mac);
+
 /* Dump the MAC state on stderr. */
 void CAN_XR_MAC_Dump(
     const char *desc, const struct CAN_XR_MAC *mac);
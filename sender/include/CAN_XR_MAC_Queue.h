@@ -0,0 +1,156 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* This header contains the bridge between the bit engine and the
+   foreground loop, when the GPIO PMA runs in interrupt-driven mode
+   (CAN_XR_PMA_GPIO_Start()).  The bridge stands in for the LLC of the
+   MAC: transmission requests made by the foreground loop, the frames
+   received by the MAC and its confirmations go through three
+   lock-free queues, so that neither side ever waits for the other and
+   the application can take its time, for instance to compute MACs,
+   without stealing it from the bit engine.
+
+   Received frames are not copied: the MAC receives them in place in
+   the slots of the receive ring, and the foreground loop looks at
+   them there, see CAN_XR_MAC_Set_Rx_Ring().
+*/
+
+#ifndef CAN_XR_MAC_QUEUE_H
+#define CAN_XR_MAC_QUEUE_H
+
+#include <stdint.h>
+#include <CAN_XR_MAC.h>
+#include <CAN_XR_SPSC.h>
+
+/* Queue length, in frames.  Must be a power of two. */
+#ifndef CAN_XR_MAC_QUEUE_LEN
+#define CAN_XR_MAC_QUEUE_LEN 8
+#endif
+
+/* Transmission request, foreground loop -> bit engine */
+struct CAN_XR_MAC_Queue_Req
+{
+    uint32_t identifier;
+    enum CAN_XR_Format format;
+    int dlc;
+    int flushed;    /* Dropped by CAN_XR_MAC_Queue_Flush_Auth() */
+    uint8_t data[CAN_XR_DATA_LEN_MAX];
+    uint8_t data_mac[16];
+};
+
+/* Confirmation, bit engine -> foreground loop */
+struct CAN_XR_MAC_Queue_Event
+{
+    unsigned long ts;
+    uint32_t identifier;
+    enum CAN_XR_MAC_Tx_Status transmission_status;
+};
+
+struct CAN_XR_MAC_Queue
+{
+    struct CAN_XR_MAC *mac;
+
+    /* The .overflows of each queue count the requests refused
+       because .req was full, the received frames lost because .rx was
+       full and the confirmations lost because .event was full.
+    */
+    struct CAN_XR_SPSC req;
+    struct CAN_XR_SPSC rx;
+    struct CAN_XR_SPSC event;
+    struct CAN_XR_MAC_Queue_Req req_buf[CAN_XR_MAC_QUEUE_LEN];
+    struct CAN_XR_MAC_Rx_Frame rx_buf[CAN_XR_MAC_QUEUE_LEN];
+    struct CAN_XR_MAC_Queue_Event event_buf[CAN_XR_MAC_QUEUE_LEN];
+
+    /* Flushes requested by the foreground loop, up to .req index
+       .flush_tail, and done by the bit engine, see
+       CAN_XR_MAC_Queue_Flush_Auth().
+    */
+    uint32_t flush_req;
+    uint32_t flush_tail;
+    uint32_t flush_done;
+
+    /* Upcalls, invoked by CAN_XR_MAC_Queue_Dispatch() */
+    CAN_XR_MAC_Data_Ind_t data_ind;
+    CAN_XR_MAC_Data_Conf_t data_conf;
+};
+
+/* Initialize 'queue' and make it the LLC of 'mac'.  The receive ring
+   and the data_conf primitive of 'mac' are taken over by the queue;
+   register the upcalls with the setters below instead.
+*/
+void CAN_XR_MAC_Queue_Init(
+    struct CAN_XR_MAC_Queue *queue, struct CAN_XR_MAC *mac);
+
+/* Register the upcalls of 'queue'.  They are invoked in the
+   foreground loop, with 'queue' as LLC.
+*/
+void CAN_XR_MAC_Queue_Set_Data_Ind(
+    struct CAN_XR_MAC_Queue *queue, CAN_XR_MAC_Data_Ind_t data_ind);
+
+void CAN_XR_MAC_Queue_Set_Data_Conf(
+    struct CAN_XR_MAC_Queue *queue, CAN_XR_MAC_Data_Conf_t data_conf);
+
+/* Foreground loop.  Queue a transmission request for the MAC, with the
+   same arguments as CAN_XR_MAC_Data_Req().  Requests are handed to
+   the MAC in order, as soon as it has no pending one.  Return 1 on
+   success, 0 if the queue is full.
+*/
+int CAN_XR_MAC_Queue_Data_Req(
+    struct CAN_XR_MAC_Queue *queue,
+    uint32_t identifier, enum CAN_XR_Format format, int dlc, uint8_t *data, uint8_t *data_mac);
+
+/* Foreground loop.  Drop the authenticated frames queued so far and
+   those in the mailboxes of the MAC, for instance because they were
+   signed with nonces that have just been reset.  The bit engine does
+   it as soon as the MAC is not transmitting: a frame being transmitted
+   is not aborted, but if it fails it is not retransmitted.  The
+   frames dropped from the mailboxes are confirmed with
+   CAN_XR_MAC_TX_STATUS_NO_SUCCESS, and requests made afterwards wait
+   for the flush to be done.
+*/
+void CAN_XR_MAC_Queue_Flush_Auth(struct CAN_XR_MAC_Queue *queue);
+
+/* Foreground loop.  Return the oldest frame received, NULL if there is
+   none.  It stays valid, in place in the receive ring, until
+   CAN_XR_MAC_Queue_Rx_Release().
+*/
+const struct CAN_XR_MAC_Rx_Frame *CAN_XR_MAC_Queue_Rx_Frame(
+    struct CAN_XR_MAC_Queue *queue);
+
+/* Foreground loop.  Give the slot of the oldest frame received back
+   to the MAC.
+*/
+void CAN_XR_MAC_Queue_Rx_Release(struct CAN_XR_MAC_Queue *queue);
+
+/* Foreground loop.  Invoke the data_ind upcall for all the frames
+   received so far, then the data_conf upcall for all the
+   confirmations.  Return how many there were.
+*/
+int CAN_XR_MAC_Queue_Dispatch(struct CAN_XR_MAC_Queue *queue);
+
+/* Bit engine.  To be registered as app_nodeclock_ind of the GPIO PMA,
+   it hands the next queued request to the MAC of 'pcs', when
+   possible.
+*/
+int CAN_XR_MAC_Queue_NodeClock_Ind(struct CAN_XR_PCS *pcs);
+
+#endif
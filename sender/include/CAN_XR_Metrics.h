@@ -0,0 +1,127 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* This header defines the metrics registry of the node: a fixed slot
+   of 32 bits for each counter and gauge, in a single array.
+
+   Counters only go up, by METRIC_INC and METRIC_ADD, and wrap around.
+   Gauges hold the last value given by METRIC_SET.  All of them are
+   updated with relaxed atomic operations, a LDREX/STREX loop on the
+   Cortex-M3, so that the bit engine in the Timer 0 interrupt and the
+   foreground loop can update the same slot; this is cheap enough for
+   every frame and every error, not for every bit.
+
+   A reader takes a snapshot of all slots with
+   CAN_XR_Metrics_Snapshot(), whose values are each consistent but may
+   be a few updates apart from each other, and may pack part of it
+   into the data field of a frame with CAN_XR_Metrics_Pack().
+
+   There is one registry per program.  Host tools running several
+   nodes in the same program get their sum.
+*/
+
+#ifndef CAN_XR_METRICS_H
+#define CAN_XR_METRICS_H
+
+#include <stdio.h> /* For FILE */
+#include <stdint.h>
+
+enum CAN_XR_Metric
+{
+    /* Counters */
+    CAN_XR_METRIC_RX_FRAMES,        /* Frames received correctly, own ones too */
+    CAN_XR_METRIC_TX_FRAMES,        /* Frames transmitted successfully */
+    CAN_XR_METRIC_TX_ATTEMPTS,      /* Identifiers transmitted completely */
+    CAN_XR_METRIC_ARBITRATION_LOST,
+    CAN_XR_METRIC_BIT_ERRORS,
+    CAN_XR_METRIC_STUFF_ERRORS,
+    CAN_XR_METRIC_FORM_ERRORS,
+    CAN_XR_METRIC_CRC_ERRORS,
+    CAN_XR_METRIC_ACK_ERRORS,       /* Seen by nodes that do not acknowledge */
+    CAN_XR_METRIC_AUTH_OK,          /* Data MACs verified */
+    CAN_XR_METRIC_AUTH_FAIL,        /* Data MACs rejected */
+    CAN_XR_METRIC_NONCE_CACHE_HITS, /* Masking tags found in the bpmac cache */
+    CAN_XR_METRIC_NONCE_CACHE_MISSES,
+    CAN_XR_METRIC_RESYNCS,          /* Nonce resynchronizations accepted */
+    CAN_XR_METRIC_OVERRUNS,         /* Nodeclock overruns, see CAN_XR_PMA_Overrun() */
+    CAN_XR_METRIC_LATE_TAGS,        /* Frames not authenticated, masking tag not ready in time */
+
+    /* Gauges */
+    CAN_XR_METRIC_NONCE_DELTA,      /* Last nonce hint realignment */
+    CAN_XR_METRIC_WORK_QUEUE,       /* Deferred bpmac work pending */
+    CAN_XR_METRIC_AUTH_FAIL_RUN,    /* Data MACs rejected in a row */
+
+    CAN_XR_METRICS
+};
+
+#define CAN_XR_METRIC_FIRST_GAUGE CAN_XR_METRIC_NONCE_DELTA
+
+struct CAN_XR_Metrics
+{
+    uint32_t value[CAN_XR_METRICS];
+};
+
+struct CAN_XR_Metrics_Snapshot
+{
+    uint32_t value[CAN_XR_METRICS];
+};
+
+extern struct CAN_XR_Metrics CAN_XR_Metrics_Data;
+
+#define METRIC_ADD(m, n)						\
+    do {								\
+	__atomic_fetch_add(&CAN_XR_Metrics_Data.value[m], (uint32_t)(n), \
+			   __ATOMIC_RELAXED);				\
+    } while(0)
+
+#define METRIC_INC(m) METRIC_ADD(m, 1)
+
+#define METRIC_SET(m, v)						\
+    do {								\
+	__atomic_store_n(&CAN_XR_Metrics_Data.value[m], (uint32_t)(v),	\
+			 __ATOMIC_RELAXED);				\
+    } while(0)
+
+/* Current value of 'metric'. */
+uint32_t CAN_XR_Metrics_Get(enum CAN_XR_Metric metric);
+
+/* Set 'metric' back to zero.  CAN_XR_METRICS clears them all. */
+void CAN_XR_Metrics_Clear(enum CAN_XR_Metric metric);
+
+/* Copy all metrics into 's'. */
+void CAN_XR_Metrics_Snapshot(struct CAN_XR_Metrics_Snapshot *s);
+
+/* Store the metrics of 's' from 'first' on into 'buf', 4 bytes each,
+   least significant first, as many as fit into 'len' bytes.  Return
+   the number of metrics stored; a sequence of frames carrying 8 bytes
+   each takes two at a time.
+*/
+int CAN_XR_Metrics_Pack(const struct CAN_XR_Metrics_Snapshot *s,
+                        int first, uint8_t *buf, int len);
+
+/* Name of 'metric', for printing. */
+const char *CAN_XR_Metrics_Name(enum CAN_XR_Metric metric);
+
+/* Print 's' on 'f', one metric per line. */
+void CAN_XR_Metrics_Dump(FILE *f, const struct CAN_XR_Metrics_Snapshot *s);
+
+#endif
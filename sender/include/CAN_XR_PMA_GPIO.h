@@ -52,4 +52,19 @@ void CAN_XR_PMA_GPIO_Set_App_NodeClock_Ind(
 */
 void CAN_XR_PMA_GPIO_NodeClock_Ind(struct CAN_XR_PMA *pma);
 
+/* Start feeding 'pma' with nodeclock indications from the Timer 0
+   interrupt handler, then return.  This is the interrupt-driven
+   alternative to CAN_XR_PMA_GPIO_NodeClock_Ind(): the bit engine
+   (PCS, MAC and app_nodeclock_ind, which must be kept short) runs in
+   the interrupt handler and the caller goes on with a foreground
+   loop, communicating with it through lock-free queues, see
+   CAN_XR_MAC_Queue.h.  Only one PMA can be started this way.
+*/
+void CAN_XR_PMA_GPIO_Start(struct CAN_XR_PMA *pma);
+
+/* Return the number of nodeclock indications generated since
+   CAN_XR_PMA_GPIO_Start().  It wraps around.
+*/
+unsigned long CAN_XR_PMA_GPIO_NodeClocks(struct CAN_XR_PMA *pma);
+
 #endif
@@ -0,0 +1,147 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* This header contains a lock-free, single-producer, single-consumer
+   queue of fixed-size elements.  It passes data between the bit
+   engine, which runs in the timer interrupt handler, and the
+   foreground loop, in both directions, without disabling interrupts.
+
+   Only the producer writes .tail and only the consumer writes .head,
+   both are free-running and the capacity is a power of two, so no
+   slot needs to be sacrificed to tell a full queue from an empty one.
+   The GCC atomic builtins order the element copy with respect to the
+   index update, so the queue is also correct between two threads of
+   a multiprocessor host.
+*/
+
+#ifndef CAN_XR_SPSC_H
+#define CAN_XR_SPSC_H
+
+#include <stdint.h>
+#include <string.h>
+
+struct CAN_XR_SPSC
+{
+    uint8_t *buf;
+    uint32_t elem_size;
+    uint32_t mask;      /* Capacity - 1 */
+    uint32_t head;      /* Next element to get, written by the consumer */
+    uint32_t tail;      /* Next element to put, written by the producer */
+    uint32_t overflows; /* Put on a full queue, written by the producer */
+};
+
+/* Initialize 'q' on 'buf', which holds 'capacity' elements of
+   'elem_size' bytes.  'capacity' must be a power of two.
+*/
+static inline void CAN_XR_SPSC_Init(
+    struct CAN_XR_SPSC *q, void *buf, uint32_t elem_size, uint32_t capacity)
+{
+    q->buf = (uint8_t *)buf;
+    q->elem_size = elem_size;
+    q->mask = capacity - 1;
+    q->head = 0;
+    q->tail = 0;
+    q->overflows = 0;
+}
+
+/* Number of elements in 'q'.  Exact for the consumer and the
+   producer, a snapshot for anybody else.
+*/
+static inline uint32_t CAN_XR_SPSC_Count(const struct CAN_XR_SPSC *q)
+{
+    return __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE)
+        - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+}
+
+/* Producer side.  Copy 'elem' into 'q'.  Return 1 on success, 0 if
+   'q' is full; in this case the element is dropped and counted.
+*/
+static inline int CAN_XR_SPSC_Put(struct CAN_XR_SPSC *q, const void *elem)
+{
+    uint32_t tail = q->tail;
+
+    if(tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) > q->mask)
+    {
+        q->overflows++;
+        return 0;
+    }
+
+    memcpy(q->buf + (tail & q->mask) * q->elem_size, elem, q->elem_size);
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/* Producer side, zero-copy.  Return the slot of the next element, NULL
+   if 'q' is full.  The element is built in place and is handed to the
+   consumer by CAN_XR_SPSC_Commit(); until then, the slot is given back
+   just by not committing it.  Overflows are counted by the caller.
+*/
+static inline void *CAN_XR_SPSC_Slot(struct CAN_XR_SPSC *q)
+{
+    uint32_t tail = q->tail;
+
+    if(tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) > q->mask)
+        return NULL;
+
+    return q->buf + (tail & q->mask) * q->elem_size;
+}
+
+static inline void CAN_XR_SPSC_Commit(struct CAN_XR_SPSC *q)
+{
+    __atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Consumer side, zero-copy.  Return the oldest element of 'q', NULL if
+   'q' is empty.  The element stays in 'q', and the producer does not
+   reuse its slot, until CAN_XR_SPSC_Release().
+*/
+static inline void *CAN_XR_SPSC_Peek(struct CAN_XR_SPSC *q)
+{
+    uint32_t head = q->head;
+
+    if(head == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    return q->buf + (head & q->mask) * q->elem_size;
+}
+
+static inline void CAN_XR_SPSC_Release(struct CAN_XR_SPSC *q)
+{
+    __atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+}
+
+/* Consumer side.  Copy the oldest element of 'q' into 'elem' and
+   remove it.  Return 1 on success, 0 if 'q' is empty.
+*/
+static inline int CAN_XR_SPSC_Get(struct CAN_XR_SPSC *q, void *elem)
+{
+    uint32_t head = q->head;
+
+    if(head == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE))
+        return 0;
+
+    memcpy(elem, q->buf + (head & q->mask) * q->elem_size, q->elem_size);
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+#endif
@@ -0,0 +1,115 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* This header contains the signing pipeline of the sender.  Frames are
+   signed ahead of time, in the foreground loop: the group and source
+   nonces are assigned in order, both tags are computed and XORed and
+   the frame is put into a small ring of ready-to-send frames.  When
+   the application decides to transmit, it only has to release the
+   oldest frame to the MAC queue (CAN_XR_MAC_Queue.h), from which the
+   MAC pulls it as soon as it is done with the previous one.  Signing
+   latency is hidden behind the transmission of earlier frames.
+
+   Frames leave the ring, and the MAC queue, in the order they have
+   been signed, and the MAC retransmits a frame as it is until it
+   succeeds, so the nonce order seen on the bus is the signing order.
+*/
+
+#ifndef CAN_XR_SIGNER_H
+#define CAN_XR_SIGNER_H
+
+#include <stdint.h>
+#include <CAN_XR_Auth_Policy.h>
+#include <CAN_XR_MAC_Queue.h>
+#include <CAN_XR_SPSC.h>
+//#include <bpmac.h>
+#include "../../lib/bpmac/bpmac.h"
+
+/* Ready-to-send frames.  Must be a power of two. */
+#ifndef CAN_XR_SIGNER_LEN
+#define CAN_XR_SIGNER_LEN 4
+#endif
+
+struct CAN_XR_Signer_Frame
+{
+    uint32_t identifier;
+    enum CAN_XR_Format format;  /* CBFF or CEFF */
+    int dlc;                /* Payload and data MAC */
+    uint8_t data[8];
+    uint8_t data_mac[16];   /* Group tag XOR source tag */
+};
+
+struct CAN_XR_Signer
+{
+    const struct CAN_XR_Auth_Policy *policy;
+
+    bpmac_ctx_t ctx_grp;
+    bpmac_ctx_t ctx_src;
+    uint64_t nonce_grp[2];  /* Nonces of the next frame signed */
+    uint64_t nonce_src[2];
+
+    /* Aggregated mode: XOR of the tags since the last checkpoint and
+       number of frames, per rule */
+    uint8_t agg_mac[CAN_XR_AUTH_POLICY_RULES][16];
+    uint8_t agg_cnt[CAN_XR_AUTH_POLICY_RULES];
+
+    struct CAN_XR_SPSC ready;
+    struct CAN_XR_Signer_Frame ready_buf[CAN_XR_SIGNER_LEN];
+};
+
+/* Initialize 'signer' with the group and source keys (16 bytes
+   each), nonces at zero and no ready frames.
+*/
+void CAN_XR_Signer_Init(
+    struct CAN_XR_Signer *signer, const struct CAN_XR_Auth_Policy *policy,
+    const uint8_t *grp_key, const uint8_t *grp_key_nonce,
+    const uint8_t *src_key, const uint8_t *src_key_nonce);
+
+/* Sign a frame with 'identifier' in 'format' and 'len' payload bytes,
+   taken from 'data', and add it to the ready ring.  The data MAC length is given
+   by the authentication policy; frames it does not authenticate are
+   added as they are and use no nonce.  With nonce hints enabled, the
+   first payload byte is reserved for the hint and overwritten.
+   Return 1 on success, 0 if the ring is full or the frame does not
+   fit.
+*/
+int CAN_XR_Signer_Sign(
+    struct CAN_XR_Signer *signer,
+    uint32_t identifier, enum CAN_XR_Format format, int len, const uint8_t *data);
+
+/* Return the number of frames in the ready ring */
+int CAN_XR_Signer_Ready(struct CAN_XR_Signer *signer);
+
+/* Move the oldest ready frame to 'queue'.  Return 1 on success, 0 if
+   there is none or 'queue' is full, in which case the frame stays
+   where it is.
+*/
+int CAN_XR_Signer_Release(
+    struct CAN_XR_Signer *signer, struct CAN_XR_MAC_Queue *queue);
+
+/* Drop all ready frames and the aggregated mode state.  Their nonces
+   are lost, so this is only useful right before the nonces are
+   resynchronized.
+*/
+void CAN_XR_Signer_Flush(struct CAN_XR_Signer *signer);
+
+#endif
@@ -0,0 +1,124 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* This header contains the workload generator of the sender.  A
+   workload is a table of streams, each one a range of identifiers
+   released periodically, with jitter, in bursts and with a payload
+   length drawn from a distribution.  The generator merges the
+   streams into a single sequence of frames in release order, each
+   with the number of nodeclocks since the previous one, so that the
+   frames can be signed well before they are due (CAN_XR_Signer.h).
+
+   Every stream draws from its own PRNG, seeded from the seed of the
+   workload and its index in the table, so the sequence depends on
+   nothing but the table and the seed: it is the same on the board
+   and in the host simulators, on every run.  Adding a stream does not
+   change the frames of the others.
+
+   In saturating mode the frames are the same, in the same order, but
+   all of them are due at once: the sender keeps its queue full and
+   the bus sets the pace.
+*/
+
+#ifndef CAN_XR_WORKLOAD_H
+#define CAN_XR_WORKLOAD_H
+
+#include <stdint.h>
+#include <CAN_XR_MAC.h>
+#include <CAN_XR_Auth_Policy.h>
+
+/* Maximum number of streams of a workload */
+#ifndef CAN_XR_WORKLOAD_STREAMS
+#define CAN_XR_WORKLOAD_STREAMS 8
+#endif
+
+/* Payload lengths of CBFF and CEFF frames, 0 to 8 bytes */
+#define CAN_XR_WORKLOAD_LENS 9
+
+struct CAN_XR_Workload_Stream
+{
+    uint32_t identifier;        /* First identifier */
+    uint32_t identifiers;       /* Identifiers drawn from, at least 1 */
+    enum CAN_XR_Format format;  /* CBFF or CEFF */
+    unsigned long period;       /* Nodeclocks between releases, at least 1 */
+    unsigned long phase;        /* Nodeclock of the first release */
+    unsigned long jitter;       /* Releases late by up to this many nodeclocks */
+    int burst;                  /* Frames per release, at least 1 */
+
+    /* Relative weight of each payload length.  Lengths that do not
+       leave room for the data MAC are never drawn; if no length is
+       left, they are uniform from 1 to the longest that fits.
+    */
+    uint8_t len_weight[CAN_XR_WORKLOAD_LENS];
+};
+
+struct CAN_XR_Workload_Frame
+{
+    uint32_t identifier;
+    enum CAN_XR_Format format;
+    int len;                    /* Payload, data MAC excluded */
+    uint8_t data[8];
+    int stream;                 /* Index in the table */
+    unsigned long gap;          /* Nodeclocks since the previous frame */
+};
+
+struct CAN_XR_Workload
+{
+    const struct CAN_XR_Workload_Stream *streams;
+    int n_streams;
+    uint32_t seed;
+    int saturate;
+    const struct CAN_XR_Auth_Policy *policy;
+
+    unsigned long now;          /* Release of the previous frame */
+    struct
+    {
+        uint32_t prng;
+        unsigned long release;  /* Nominal release of the current burst */
+        unsigned long due;      /* Same, jitter included */
+        int left;               /* Frames of the current burst still to go */
+    } state[CAN_XR_WORKLOAD_STREAMS];
+};
+
+/* Initialize 'workload' with the first 'n_streams' streams of
+   'streams' and 'seed', in saturating mode if 'saturate'.  The data
+   MAC lengths are those of 'policy', none if it is NULL.  'streams'
+   is not copied and must outlive 'workload'.  Return 0 on success, -1
+   if any stream is out of range.
+*/
+int CAN_XR_Workload_Init(
+    struct CAN_XR_Workload *workload,
+    const struct CAN_XR_Workload_Stream *streams, int n_streams,
+    uint32_t seed, int saturate, const struct CAN_XR_Auth_Policy *policy);
+
+/* Go back to the first frame of 'workload', the same sequence
+   follows.
+*/
+void CAN_XR_Workload_Reset(struct CAN_XR_Workload *workload);
+
+/* Store the next frame of 'workload' into 'frame'.  Frames due at the
+   same nodeclock follow the order of the table.
+*/
+void CAN_XR_Workload_Next(
+    struct CAN_XR_Workload *workload, struct CAN_XR_Workload_Frame *frame);
+
+#endif
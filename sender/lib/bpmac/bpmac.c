@@ -14,20 +14,85 @@
 
 #define MAC_LEN_IN_INT (MAC_LEN/sizeof(int))
 
-static void pbuf(void *buf, int n, char *s)
+/* Minimal AES-128 encryption, used to compute masking tags one round
+ * at a time (see bpmac_pre_begin()).  The nonce key is expanded once,
+ * in bpmac_init().
+ */
+static const uint8_t aes_sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+#define AES_XTIME(x) ((uint8_t)(((x) << 1) ^ (((x) >> 7) * 0x1b)))
+
+static void aes_expand_key(const uint8_t key[16], uint8_t round_key[176])
 {
-    int i;
-    char *cp = (char *)buf;
+    static const uint8_t rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36};
+    int i, j;
+
+    memcpy(round_key, key, 16);
+    for(i=16; i<176; i+=4){
+        uint8_t t[4] = {round_key[i-4], round_key[i-3], round_key[i-2], round_key[i-1]};
+
+        if(i % 16 == 0){
+            uint8_t u = t[0];
+            t[0] = aes_sbox[t[1]] ^ rcon[i/16 - 1];
+            t[1] = aes_sbox[t[2]];
+            t[2] = aes_sbox[t[3]];
+            t[3] = aes_sbox[u];
+        }
+        for(j=0; j<4; j++){
+            round_key[i+j] = round_key[i-16+j] ^ t[j];
+        }
+    }
+}
 
-    if (n <= 0 || n >= 30)
-        n = 30;
+/* Round 'round' in [1, 10] of AES-128 encryption on 'state' */
+static void aes_round(uint8_t state[16], const uint8_t round_key[176], int round)
+{
+    uint8_t t[16];
+    int r, c;
 
-    if (s)
-        printf("%s: ", s);
+    /* SubBytes and ShiftRows, column-major state */
+    for(c=0; c<4; c++){
+        for(r=0; r<4; r++){
+            t[4*c + r] = aes_sbox[state[4*((c + r) & 3) + r]];
+        }
+    }
+
+    /* MixColumns, skipped in the last round */
+    if(round < 10){
+        for(c=0; c<4; c++){
+            uint8_t a0 = t[4*c], a1 = t[4*c + 1], a2 = t[4*c + 2], a3 = t[4*c + 3];
+            uint8_t e = a0 ^ a1 ^ a2 ^ a3;
+
+            state[4*c]     = a0 ^ e ^ AES_XTIME(a0 ^ a1);
+            state[4*c + 1] = a1 ^ e ^ AES_XTIME(a1 ^ a2);
+            state[4*c + 2] = a2 ^ e ^ AES_XTIME(a2 ^ a3);
+            state[4*c + 3] = a3 ^ e ^ AES_XTIME(a3 ^ a0);
+        }
+    }
+    else {
+        memcpy(state, t, 16);
+    }
 
-    for (i = 0; i < n; i++)
-        printf("%02X", (unsigned char)cp[i]);
-    printf("\n");
+    for(c=0; c<16; c++){
+        state[c] ^= round_key[16*round + c];
+    }
 }
 
 void bpmac_init( char* key,  char* nonce_key, int max_size, bpmac_ctx_t* ctx){
@@ -41,6 +106,8 @@ void bpmac_init( char* key,  char* nonce_key, int max_size, bpmac_ctx_t* ctx){
 
     memcpy( ctx->mac_key, key, 16 );
     memcpy( ctx->nonce_key, nonce_key, 16 );
+    aes_expand_key(ctx->nonce_key, ctx->nonce_round_key);
+    ctx->pre_round = 0;
 
     memset(ctx->prev_nonce, 0, 16);
     memset(ctx->nonce_cache, 0, 16);
@@ -61,7 +128,7 @@ void bpmac_init( char* key,  char* nonce_key, int max_size, bpmac_ctx_t* ctx){
         printf("Error: Could not allocate memory for bitflips MACs\n");
     }
 
-    for(i=0; i<max_size*8 +1; i++){
+    for(i=0; i<(uint32_t)(max_size*8 +1); i++){
 
         input[0] = 2*i;
 
@@ -78,6 +145,26 @@ void bpmac_init( char* key,  char* nonce_key, int max_size, bpmac_ctx_t* ctx){
         }
     }
 
+    /* Tags of all 16 values of each 4 identifier bits.  Nibble n holds
+       message bits 4n to 4n+3, the MSb of the value is bit 4n.
+    */
+    ctx->id_flips = (int*)malloc(BPMAC_ID_NIBBLES*16*MAC_LEN);
+    if(! ctx->id_flips){
+        printf("Error: Could not allocate memory for identifier MACs\n");
+    }
+    else{
+        memset(ctx->id_flips, 0, BPMAC_ID_NIBBLES*16*MAC_LEN);
+        for(i=0; i<BPMAC_ID_NIBBLES*16; i++){
+            for(j=0; j<4; j++){
+                int bit = (i/16)*4 + j;
+
+                if(bit < BPMAC_ID_BITS && bit < ctx->max_len && (i & (8 >> j))){
+                    xor_tags(&ctx->id_flips[i*MAC_LEN_IN_INT], &ctx->bit_flips[bit*MAC_LEN_IN_INT]);
+                }
+            }
+        }
+    }
+
     /* store XOR of all bit tags to reset default_msg for next masking tag */
     memcpy(ctx->res, ctx->default_msg, MAC_LEN);
     mbedtls_aes_free(&aes_ctx);
@@ -125,6 +212,26 @@ void bpmac_update(bpmac_ctx_t* ctx, uint8_t input_bit, char* tag) {
     ctx->bit_index += MAC_LEN_IN_INT;
 }
 
+/**
+ * Performs bpmac_update() on the 'bits' LSbs of an identifier, MSb first,
+ * using the tables built by bpmac_init().  Must be the first update after
+ * bpmac_pre() or bpmac_reset().
+ * @param ctx BPMAC context
+ * @param id identifier
+ * @param bits identifier length in bits, 11 or BPMAC_ID_BITS
+ * @param tag partial MAC value
+ */
+void bpmac_update_id(bpmac_ctx_t* ctx, uint32_t id, int bits, char* tag) {
+    uint32_t v = id << (32 - bits);
+    int n;
+
+    for(n=0; n < (bits + 3) / 4; n++){
+        xor_tags(tag, &ctx->id_flips[(n*16 + (v >> 28)) * MAC_LEN_IN_INT]);
+        v <<= 4;
+    }
+    ctx->bit_index = bits * MAC_LEN_IN_INT;
+}
+
 /**
  * Finalizes the BPMAC value with one padding bit
  * @param ctx BPMAC context
@@ -175,6 +282,22 @@ void bpmac_sign(bpmac_ctx_t* ctx, char* msg, int len,  char* tag) {
 
 }
 
+/* Initialize default_msg and tag with the XOR of bit tags and the masking tag in word 'index' of the nonce cache */
+static void pre_finish(bpmac_ctx_t* ctx, int index, char* tag)
+{
+    /* reset default_msg to XOR of bit tags before adding masking tag */
+    memcpy(ctx->default_msg, ctx->res, MAC_LEN);
+
+    size_t k;
+    for(k=0; k<MAC_LEN_IN_INT; k++){
+        ((int*)ctx->default_msg)[k] ^= ((int*)ctx->nonce_cache)[k+index*MAC_LEN_IN_INT];
+    }
+    ctx->bit_index = 0;
+    if(tag){
+        memcpy(tag, ctx->default_msg, MAC_LEN);
+    }
+}
+
 /**
  * Computes the masking tag based on the given nonce and initializes the MAC tag with XOR of bit tags and masking tag.
  * Has to be called one time for each BPMAC computation before bpmac_update() or bpmac_sign().
@@ -207,34 +330,151 @@ void bpmac_pre(bpmac_ctx_t* ctx, uint8_t nonce[16], char* tag)
     *(uint64_t *)tmp_nonce_lo = ((uint64_t *)nonce)[0];
     tmp_nonce_lo[0] &= ~LOW_BIT_MASK; /* zero last bit */
 
+    ctx->pre_round = 0; /* supersedes bpmac_pre_begin() */
+
     if ( (((uint64_t *)tmp_nonce_lo)[0] != ((uint64_t *)ctx->prev_nonce)[0]) ||
          (((uint64_t *)nonce)[1] != ((uint64_t *)ctx->prev_nonce)[1]) )
     {
         ((uint64_t *)ctx->prev_nonce)[1] = ((uint64_t *)nonce)[1];
         ((uint64_t *)ctx->prev_nonce)[0] = ((uint64_t *)tmp_nonce_lo)[0];
 
+        /* Encrypt the first nonce of the block, not the one that missed the cache, so that all nodes agree
+         * even when they do not go through the nonces one by one */
         mbedtls_aes_context aes_ctx;
         mbedtls_aes_init(&aes_ctx);
         mbedtls_aes_setkey_enc(&aes_ctx, (const uint8_t *) ctx->nonce_key, 128);
-        mbedtls_aes_crypt_ecb(&aes_ctx, MBEDTLS_AES_ENCRYPT, (const uint8_t *) nonce, ctx->nonce_cache );
+        mbedtls_aes_crypt_ecb(&aes_ctx, MBEDTLS_AES_ENCRYPT, (const uint8_t *) ctx->prev_nonce, ctx->nonce_cache );
         mbedtls_aes_free(&aes_ctx);
     }
 
-    /* reset default_msg to XOR of bit tags before adding masking tag */
-    memcpy(ctx->default_msg, ctx->res, MAC_LEN);
+    pre_finish(ctx, index, tag);
+}
 
+/**
+ * Same as bpmac_pre(), but on a nonce cache miss the AES encryption is not performed here. It is split into its 10
+ * rounds, performed by successive calls to bpmac_pre_step(), so that it can be interleaved with time-critical work.
+ * The context must not be used for anything else until the computation is complete.
+ * @param ctx BPMAC context
+ * @param nonce nonce used for masking tag
+ * @param tag MAC tag that shall contain the MAC value, when the computation is complete
+ * @return 1 if the tag is ready (nonce cache hit), 0 if bpmac_pre_step() must be called, -1 if a computation is
+ * still in progress: nothing is done then, the caller completes it with bpmac_pre_step() first
+ */
+int bpmac_pre_begin(bpmac_ctx_t* ctx, uint8_t nonce[16], char* tag)
+{
+    uint8_t tmp_nonce_lo[8];
     int k;
+
+    if(ctx->pre_round != 0){
+        return -1;
+    }
+
+#if (MAC_LEN < 12)
+    int index = nonce[0] & LOW_BIT_MASK;
+#else
+    int index = 0;
+#endif
+    *(uint64_t *)tmp_nonce_lo = ((uint64_t *)nonce)[0];
+    tmp_nonce_lo[0] &= ~LOW_BIT_MASK;
+
+    if ( (((uint64_t *)tmp_nonce_lo)[0] == ((uint64_t *)ctx->prev_nonce)[0]) &&
+         (((uint64_t *)nonce)[1] == ((uint64_t *)ctx->prev_nonce)[1]) )
+    {
+        pre_finish(ctx, index, tag);
+        return 1;
+    }
+
+    ((uint64_t *)ctx->prev_nonce)[1] = ((uint64_t *)nonce)[1];
+    ((uint64_t *)ctx->prev_nonce)[0] = ((uint64_t *)tmp_nonce_lo)[0];
+
+    /* AddRoundKey of round 0 */
+    for(k=0; k<16; k++){
+        ctx->pre_block[k] = ctx->prev_nonce[k] ^ ctx->nonce_round_key[k];
+    }
+    ctx->pre_index = index;
+    ctx->pre_round = 1;
+    return 0;
+}
+
+/**
+ * Performs one AES round of the computation started by bpmac_pre_begin().
+ * @param ctx BPMAC context
+ * @param tag MAC tag that shall contain the MAC value, may be NULL
+ * @return 1 if the computation is complete (or none was pending), 0 if more calls are needed
+ */
+int bpmac_pre_step(bpmac_ctx_t* ctx, char* tag)
+{
+    if(ctx->pre_round == 0){
+        return 1;
+    }
+
+    aes_round(ctx->pre_block, ctx->nonce_round_key, ctx->pre_round);
+    if(ctx->pre_round++ < 10){
+        return 0;
+    }
+
+    memcpy(ctx->nonce_cache, ctx->pre_block, 16);
+    ctx->pre_round = 0;
+    pre_finish(ctx, ctx->pre_index, tag);
+    return 1;
+}
+
+/**
+ * @param ctx BPMAC context
+ * @return 1 if a computation started by bpmac_pre_begin() is still in progress
+ */
+int bpmac_pre_pending(bpmac_ctx_t* ctx)
+{
+    return ctx->pre_round != 0;
+}
+
+/**
+ * Replaces the masking tag of old_nonce in the (partial) MAC tag with the masking tag of nonce, without any AES
+ * computation. This is only possible if nonce is served by the nonce cache, i.e., if it belongs to the same AES
+ * block as the nonce last passed to bpmac_pre(), which has to be old_nonce. The context keeps the masking tag of
+ * old_nonce, so that bpmac_reset() after an aborted frame restarts from it and the retransmission can be re-masked
+ * the same way.
+ * @param ctx BPMAC context
+ * @param old_nonce nonce last passed to bpmac_pre()
+ * @param nonce nonce that shall be used instead
+ * @param tag partial MAC value
+ * @return 1 if the tag was re-masked, 0 if nonce is not in the nonce cache and the tag was left untouched
+ */
+int bpmac_remask(bpmac_ctx_t* ctx, uint8_t old_nonce[16], uint8_t nonce[16], char* tag)
+{
+    uint8_t tmp_nonce_lo[8];
+
+#if (MAC_LEN < 12)
+    int old_index = old_nonce[0] & LOW_BIT_MASK;
+    int index = nonce[0] & LOW_BIT_MASK;
+#else
+    int old_index = 0;
+    int index = 0;
+#endif
+    *(uint64_t *)tmp_nonce_lo = ((uint64_t *)nonce)[0];
+    tmp_nonce_lo[0] &= ~LOW_BIT_MASK;
+
+    if ( (((uint64_t *)tmp_nonce_lo)[0] != ((uint64_t *)ctx->prev_nonce)[0]) ||
+         (((uint64_t *)nonce)[1] != ((uint64_t *)ctx->prev_nonce)[1]) )
+    {
+        return 0;
+    }
+
+    size_t k;
     for(k=0; k<MAC_LEN_IN_INT; k++){
-        ((int*)ctx->default_msg)[k] ^= ((int*)ctx->nonce_cache)[k+index*MAC_LEN_IN_INT];
+        int delta = ((int*)ctx->nonce_cache)[k+old_index*MAC_LEN_IN_INT] ^
+                    ((int*)ctx->nonce_cache)[k+index*MAC_LEN_IN_INT];
+        ((int*)tag)[k] ^= delta;
     }
-    ctx->bit_index = 0;
-    memcpy(tag, ctx->default_msg, MAC_LEN);
+    return 1;
 }
 
 int bpmac_vrfy( char* msg, int size, char* sig, int mac_size, bpmac_ctx_t* ctx){
 
     char output[32];
 
+    (void) mac_size;
+
     bpmac_sign(ctx, msg, size, output);
 
     return memcmp( sig, output, 16 );
@@ -243,5 +483,6 @@ int bpmac_vrfy( char* msg, int size, char* sig, int mac_size, bpmac_ctx_t* ctx){
 void bpmac_deinit(bpmac_ctx_t* ctx){
 
     free(ctx->bit_flips);
+    free(ctx->id_flips);
 
 }
@@ -0,0 +1,134 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* This file contains CAN_XR_Auth_Policy_Report() alone, to avoid
+   pulling it from the library when it is not needed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <CAN_XR_Auth_Policy.h>
+
+/* CBFF frame length in bits, including the 3-bit intermission, with
+   no stuff bits and with the worst-case number of them.  Stuffing
+   applies from SOF to the end of the CRC, 34 + 8 * dlc bits.
+*/
+#define FRAME_BITS(dlc) (47 + 8 * (dlc))
+#define FRAME_BITS_STUFFED(dlc) (FRAME_BITS(dlc) + (34 + 8 * (dlc) - 1) / 4)
+
+/* Aggregated mode of 'rule': goodput with the bus saturated by its
+   frames, gain over sending the full MAC in every frame, and the
+   authentication latency added by the mode, that is, how long the
+   first frame of a window waits for its checkpoint.  Evaluated for
+   some window lengths k besides the configured one, marked with '*'.
+*/
+static void report_aggregation(
+    int r, const struct CAN_XR_Auth_Rule *rule, unsigned long bit_rate)
+{
+    static const int window[] = {2, 4, 8, 16, 32};
+    int plain_bits = FRAME_BITS_STUFFED(rule->payload_len + rule->mac_len);
+    int short_bits = FRAME_BITS_STUFFED(rule->payload_len + rule->mac_len_short);
+    unsigned long plain = bit_rate * rule->payload_len / plain_bits;
+
+    fprintf(stderr,
+	    "  rule %d aggregated: payload=%d, mac_len=%d/%d, plain %lu B/s\n"
+	    "     k payload B/s gain%% latency(frames) latency(us)\n",
+	    r, rule->payload_len, rule->mac_len_short, rule->mac_len, plain);
+
+    for(int i = 0; i <= (int)(sizeof(window) / sizeof(window[0])); i++)
+    {
+        int k = (i < (int)(sizeof(window) / sizeof(window[0]))) ? window[i] : rule->aggregate;
+        unsigned long window_bits = (unsigned long)(k - 1) * short_bits + plain_bits;
+        unsigned long goodput = bit_rate * rule->payload_len * k / window_bits;
+
+        if(i < (int)(sizeof(window) / sizeof(window[0])) && k == rule->aggregate)
+            continue;   /* Printed last */
+
+        fprintf(stderr, " %c%4d %11lu %5lu %15d %11lu\n",
+		k == rule->aggregate ? '*' : ' ', k, goodput,
+		100 * (goodput - plain) / plain, k - 1,
+		(unsigned long)((1000000ULL * (window_bits - plain_bits)) / bit_rate));
+    }
+}
+
+void CAN_XR_Auth_Policy_Report(
+    const char *desc, const struct CAN_XR_Auth_Policy *policy,
+    unsigned long bit_rate)
+{
+    int ids[CAN_XR_AUTH_POLICY_RULES] = {0};
+    int n = 0;
+
+    for(uint32_t id = 0; id < CAN_XR_AUTH_POLICY_IDS; id++)
+    {
+        if(CAN_XR_Auth_Policy_Is_Authenticated(policy, id))
+        {
+            ids[policy->rule_of_id[id]]++;
+            n++;
+        }
+    }
+
+    fprintf(stderr,
+	    "struct CAN_XR_Auth_Policy %s: %d authenticated ids, %lu bit/s\n",
+	    desc, n, bit_rate);
+
+    for(int r = 0; r < CAN_XR_AUTH_POLICY_RULES; r++)
+    {
+        if(ids[r])
+            fprintf(stderr, "  rule %d: %d ids, mac_len=%d, key_index=%d\n",
+		    r, ids[r], policy->rule[r].mac_len, policy->rule[r].key_index);
+    }
+
+    /* One line for each MAC length and DLC.  Payload efficiency and
+       throughput are worst-case, that is, with maximum stuffing and
+       the bus saturated by frames of that kind.  Settings used by
+       some rule are marked with '*'.
+    */
+    fprintf(stderr,
+	    "  mac_len dlc payload bits(min) bits(max) payload%% frames/s payload B/s\n");
+
+    for(int mac_len = 1; mac_len <= CAN_XR_AUTH_MAC_LEN_MAX; mac_len++)
+    {
+        int used = 0;
+
+        for(int r = 0; r < CAN_XR_AUTH_POLICY_RULES; r++)
+            if(ids[r] && policy->rule[r].mac_len == mac_len)
+                used = 1;
+
+        for(int dlc = mac_len + 1; dlc <= 8; dlc++)
+        {
+            int payload = dlc - mac_len;
+            unsigned long frames = bit_rate / FRAME_BITS_STUFFED(dlc);
+
+            fprintf(stderr, " %c%7d %3d %7d %9d %9d %8d %8lu %11lu\n",
+		    used ? '*' : ' ', mac_len, dlc, payload,
+		    FRAME_BITS(dlc), FRAME_BITS_STUFFED(dlc),
+		    100 * 8 * payload / FRAME_BITS_STUFFED(dlc),
+		    frames, frames * payload);
+        }
+    }
+
+    for(int r = 0; r < CAN_XR_AUTH_POLICY_RULES; r++)
+    {
+        if(ids[r] && policy->rule[r].aggregate)
+            report_aggregation(r, &policy->rule[r], bit_rate);
+    }
+}
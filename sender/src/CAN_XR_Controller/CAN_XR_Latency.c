@@ -0,0 +1,132 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Latency histograms, see CAN_XR_Latency.h. */
+
+#include <string.h>
+#include <CAN_XR_Latency.h>
+
+static const char *const stage_name[CAN_XR_LATENCY_STAGES] = {
+    "data", "mac", "eof", "verified", "tx"
+};
+
+void CAN_XR_Latency_Init(struct CAN_XR_Latency *lat)
+{
+    int c, s;
+
+    memset(lat, 0, sizeof(*lat));
+    for(c = 0; c < CAN_XR_LATENCY_CLASSES; c++)
+        for(s = 0; s < CAN_XR_LATENCY_STAGES; s++)
+            lat->hist[c][s].min = UINT32_MAX;
+}
+
+void CAN_XR_Latency_Record(
+    struct CAN_XR_Latency *lat, int cls, enum CAN_XR_Latency_Stage stage,
+    unsigned long nodeclocks)
+{
+    struct CAN_XR_Latency_Hist *h = &lat->hist[cls][stage];
+    uint32_t t = (uint32_t)nodeclocks;
+    int b = (t > 1) ? 31 - __builtin_clz(t) : 0;
+
+    if(b >= CAN_XR_LATENCY_BUCKETS)
+        b = CAN_XR_LATENCY_BUCKETS - 1;
+
+    h->bucket[b]++;
+    h->count++;
+    if(t < h->min)
+        h->min = t;
+    if(t > h->max)
+        h->max = t;
+}
+
+int CAN_XR_Latency_Pack(
+    const struct CAN_XR_Latency *lat, int cls, enum CAN_XR_Latency_Stage stage,
+    int first, uint8_t *buf)
+{
+    const struct CAN_XR_Latency_Hist *h = &lat->hist[cls][stage];
+    int i;
+
+    buf[0] = (uint8_t)((cls << 4) | stage);
+    buf[1] = (uint8_t)first;
+    for(i = 0; i < 3; i++)
+    {
+        uint32_t n = (first + i < CAN_XR_LATENCY_BUCKETS) ? h->bucket[first + i] : 0;
+
+        if(n > 0xFFFF)
+            n = 0xFFFF;
+        buf[2 + 2 * i] = (uint8_t)n;
+        buf[3 + 2 * i] = (uint8_t)(n >> 8);
+    }
+
+    return (first + 3 < CAN_XR_LATENCY_BUCKETS) ? first + 3 : 0;
+}
+
+/* Upper bound of the bucket holding the 'per_mille' quantile of 'h' */
+static unsigned long quantile(const struct CAN_XR_Latency_Hist *h, int per_mille)
+{
+    uint64_t rank = ((uint64_t)h->count * per_mille + 999) / 1000;
+    uint64_t seen = 0;
+    int b;
+
+    for(b = 0; b < CAN_XR_LATENCY_BUCKETS - 1; b++)
+    {
+        seen += h->bucket[b];
+        if(seen >= rank)
+            break;
+    }
+
+    if(b == CAN_XR_LATENCY_BUCKETS - 1 || (2UL << b) - 1 > h->max)
+        return h->max;
+    return (2UL << b) - 1;
+}
+
+void CAN_XR_Latency_Dump(
+    FILE *f, const char *desc, const struct CAN_XR_Latency *lat)
+{
+    int c, s, b;
+
+    fprintf(f, "%s, latency in nodeclocks\n", desc);
+    fprintf(f, "class stage        count      min      max      p50      p99  log2 buckets\n");
+
+    for(c = 0; c < CAN_XR_LATENCY_CLASSES; c++)
+    {
+        for(s = 0; s < CAN_XR_LATENCY_STAGES; s++)
+        {
+            const struct CAN_XR_Latency_Hist *h = &lat->hist[c][s];
+
+            if(h->count == 0)
+                continue;
+
+            if(c == CAN_XR_LATENCY_UNAUTHENTICATED)
+                fprintf(f, "unau. ");
+            else
+                fprintf(f, "%5d ", c);
+            fprintf(f, "%-8s %9lu %8lu %8lu %8lu %8lu ",
+                    stage_name[s], (unsigned long)h->count,
+                    (unsigned long)h->min, (unsigned long)h->max,
+                    quantile(h, 500), quantile(h, 990));
+            for(b = 0; b < CAN_XR_LATENCY_BUCKETS; b++)
+                fprintf(f, " %lu", (unsigned long)h->bucket[b]);
+            fputc('\n', f);
+        }
+    }
+}
@@ -34,16 +34,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <LED_Config.h>
+#include <CAN_XR_PMA.h>
 #include <CAN_XR_PCS.h>
 #include <CAN_XR_MAC.h>
+#define CAN_XR_TRACE_MODULE MAC
 #include <CAN_XR_Trace.h>
+#include <CAN_XR_Profile.h>
+#include <CAN_XR_Metrics.h>
+#include <CAN_XR_Capture.h>
+#include <CAN_XR_Latency.h>
+#include "../../lib/bpmac/bpmac.h"  /* For MAC_LEN */
 
-// ###
-// EVALUATION STUFF
-// + line 524
-// ###
-extern uint64_t transmission_attempts;
-extern uint8_t cnt_transmission_attempts;
+#if CAN_XR_AUTH_MAC_LEN_MAX > MAC_LEN
+#error "Data MAC longer than the bpmac tag"
+#endif
 
 #define shift_in(v, b) (((v) << 1) | ((b) & 0x1))
 
@@ -62,6 +66,58 @@ extern uint8_t cnt_transmission_attempts;
     } while(0)
 
 
+/* Choose the mailbox to be transmitted at the next SOF, the one
+   whose identifier would win arbitration, ties going to the oldest
+   request.  Authenticated frames must reach the bus in the order
+   their nonces were drawn, that is, in request order, so only the
+   oldest of them takes part.  This is invoked whenever the contents
+   of the mailboxes change, so that at SOF the transmit automaton
+   only has to look at .tx_next.
+*/
+static void select_mailbox(struct CAN_XR_MAC_State *state)
+{
+    uint32_t full = state->mailbox_full;
+    int oldest_auth = -1;
+    int next = -1;
+    int i;
+
+    for(i = 0; i < CAN_XR_MAC_MAILBOXES; i++)
+    {
+        if((full & (1UL << i)) && state->mailbox[i].mac_len &&
+           (oldest_auth < 0 ||
+            (int32_t)(state->mailbox[i].seq - state->mailbox[oldest_auth].seq) < 0))
+        {
+            oldest_auth = i;
+        }
+    }
+
+    for(i = 0; i < CAN_XR_MAC_MAILBOXES; i++)
+    {
+        struct CAN_XR_MAC_Mailbox *mb = &state->mailbox[i];
+
+        if(!(full & (1UL << i)) || (mb->mac_len && i != oldest_auth))
+            continue;
+
+        if(next < 0 ||
+           mb->identifier < state->mailbox[next].identifier ||
+           (mb->identifier == state->mailbox[next].identifier &&
+            (int32_t)(mb->seq - state->mailbox[next].seq) < 0))
+        {
+            next = i;
+        }
+    }
+
+    state->tx_next = next;
+    state->data_req_pending = (full != 0);
+}
+
+/* Free the mailbox being transmitted. */
+static void release_mailbox(struct CAN_XR_MAC_State *state)
+{
+    state->mailbox_full &= ~(1UL << state->tx_mailbox);
+    select_mailbox(state);
+}
+
 /* MAC_Data.Request primitive invoked by upper later (typically LLC) to
    request the transmission of a frame.
 */
@@ -71,10 +127,10 @@ static void mac_data_req(
 {
     TRACE(2, "MAC Common::mac_data_req(%lu, ...)", (unsigned long)identifier);
 
-    /* Check if there is a pending transmission request already, of
-       any kind.  This would be an LLC handshake error.
+    /* Check if there is a free mailbox.  If not, this is an LLC
+       handshake error.
     */
-    if(mac->state.data_req_pending)
+    if(mac->state.mailbox_full == CAN_XR_MAC_MAILBOX_ALL)
     {
         if(mac->primitives.data_conf)
         {
@@ -85,27 +141,47 @@ static void mac_data_req(
 
     else
     {
+        /* Lowest free mailbox */
+        int i = __builtin_ctz(~mac->state.mailbox_full);
+        struct CAN_XR_MAC_Mailbox *mb = &mac->state.mailbox[i];
+
         /* Check format, complain immediately if it is unsupported */
         switch(format)
         {
         case CAN_XR_FORMAT_CBFF:
-            /* Save arguments in MAC state for later use. */
-            mac->state.tx_identifier = identifier;
-            mac->state.tx_format = format; /* TBD: We'll support more */
-            mac->state.tx_dlc = dlc;
-            /* Clear tx_data completely, then fill the right amount */
-            memset(mac->state.tx_data, 0, sizeof(mac->state.tx_data));
-            memset(mac->state.tx_data_mac, 0, 3);
-            if (dlc > 3 && identifier < 256) {
-                memcpy(mac->state.tx_data, data, dlc - 3);
-                mac->state.tx_data_mac[0] = data_mac[1];
-                mac->state.tx_data_mac[1] = data_mac[2];
-                mac->state.tx_data_mac[2] = data_mac[3];
+        case CAN_XR_FORMAT_CEFF:
+        case CAN_XR_FORMAT_FBFF:
+        case CAN_XR_FORMAT_FEFF:
+            /* Save arguments in the mailbox for later use. */
+            mb->identifier = identifier;
+            mb->format = format;
+            mb->dlc = dlc;
+            /* Clear data completely, then fill the right amount */
+            memset(mb->data, 0, sizeof(mb->data));
+            memset(mb->data_mac, 0, sizeof(mb->data_mac));
+
+            /* The authentication policy is consulted here once, the
+               transmit automaton only looks at .tx_mac_len.  The data
+               MAC is made of the last .mac_len bytes of the tag.  It
+               covers classical frames only, FD frames are not
+               authenticated.
+            */
+            mb->mac_len = CAN_XR_Format_Is_FD(format) ? 0 :
+                CAN_XR_Auth_Policy_MAC_Len(
+                    mac->policy,
+                    CAN_XR_Auth_Policy_Key(identifier, CAN_XR_Format_Is_Extended(format)), dlc);
+
+            if (mb->mac_len) {
+                memcpy(mb->data, data, dlc - mb->mac_len);
+                memcpy(mb->data_mac, data_mac + MAC_LEN - mb->mac_len, mb->mac_len);
             }
             else {
-                memcpy(mac->state.tx_data, data, dlc);
+                memcpy(mb->data, data, CAN_XR_DLC_Len(format, dlc));
             }
-            mac->state.data_req_pending = 1;
+            mb->seq = mac->state.tx_seq++;
+            mb->req_ts = mac->pcs->state.nodeclock_ts;
+            mac->state.mailbox_full |= 1UL << i;
+            select_mailbox(&mac->state);
             break;
 
         default:
@@ -136,6 +212,140 @@ static uint16_t crc_nxtbit(uint16_t crc, uint16_t nxtbit)
     return crc;
 }
 
+#define CRC17_POLYNOMIAL 0x1685B  /* FD frames up to 16 data bytes */
+#define CRC21_POLYNOMIAL 0x102899 /* FD frames with more */
+
+/* Same as crc_nxtbit(), for the 'width'-bit CRCs of FD frames, [1]
+   10.4.2.6.
+*/
+static uint32_t crc_fd_nxtbit(
+    uint32_t crc, int nxtbit, int width, uint32_t polynomial)
+{
+    int crcnxt = ((crc >> (width - 1)) & 1) ^ nxtbit;
+    crc = (crc << 1) & ((1UL << width) - 1); /* Shift in 0 */
+    if(crcnxt)  crc ^= polynomial;
+    return crc;
+}
+
+/* The CRCs of FD frames cover the stuffed bit stream from SOF to the
+   end of the data field.  Which one the frame uses depends on the
+   DLC, so both are computed until then.
+*/
+static void crc_fd_update(struct CAN_XR_MAC_State *state, int bit)
+{
+    state->crc17 = crc_fd_nxtbit(state->crc17, bit, 17, CRC17_POLYNOMIAL);
+    state->crc21 = crc_fd_nxtbit(state->crc21, bit, 21, CRC21_POLYNOMIAL);
+}
+
+/* Stuff count field of FD frames, [1] 10.4.2.6: the number of dynamic
+   stuff bits modulo 8, Gray-coded, followed by an even parity bit.
+*/
+static int stuff_count_field(int stuff_bits)
+{
+    static const uint8_t gray[8] = { 0, 1, 3, 2, 6, 7, 5, 4 };
+    int g = gray[stuff_bits & 0x7];
+
+    return (g << 1) | ((g ^ (g >> 1) ^ (g >> 2)) & 0x1);
+}
+
+/* Start receiving the CRC field of an FD frame, made of the stuff
+   count and a 17- or 21-bit CRC.  It is not dynamically stuffed;
+   instead, a fixed stuff bit comes first and then after every fourth
+   bit [1] 10.5.  .nc_bits counts the bits since the last one, see
+   pcs_data_ind().  The first fixed stuff bit also takes the place of
+   a dynamic stuff bit that may be due after the data field.
+*/
+static void rx_fd_crc_field(struct CAN_XR_MAC_State *state)
+{
+    state->field_bits = 4 + ((state->rx_len > 16) ? 21 : 17) - 1;
+    state->rx_stuff_count = 0;
+    state->nc_bits = 4;
+    state->rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_FD_CRC;
+}
+
+/* Choose where the data field of the frame being received goes.  With
+   a receive ring, it goes in place into the next free slot, which is
+   committed by rx_frame_ind(); without one, or if the ring is full,
+   into .rx_data.
+*/
+static void rx_frame_begin(struct CAN_XR_MAC *mac)
+{
+    mac->state.rx_slot = mac->rx_ring
+        ? (struct CAN_XR_MAC_Rx_Frame *)CAN_XR_SPSC_Slot(mac->rx_ring) : NULL;
+    mac->state.rx_buf = mac->state.rx_slot
+        ? mac->state.rx_slot->data : mac->state.rx_data;
+}
+
+/* Identifier class of a frame, for the latency histograms.  FD
+   frames are not authenticated.
+*/
+static int latency_class(
+    const struct CAN_XR_MAC *mac, uint32_t identifier, int extended, int fd)
+{
+    if(fd)
+        return CAN_XR_LATENCY_UNAUTHENTICATED;
+    return CAN_XR_Latency_Class(
+        mac->policy, CAN_XR_Auth_Policy_Key(identifier, extended));
+}
+
+/* A frame has been validated at EOF.  Account the time its payload,
+   data field and the whole frame took since SOF.
+*/
+static void rx_latency(struct CAN_XR_MAC *mac, unsigned long ts)
+{
+    struct CAN_XR_MAC_State *state = &mac->state;
+    int cls = latency_class(mac, state->rx_identifier, state->rx_ide, state->rx_fdf);
+
+    CAN_XR_Latency_Record(mac->latency, cls, CAN_XR_LATENCY_DATA,
+                          state->rx_data_ts - state->rx_sof_ts);
+    CAN_XR_Latency_Record(mac->latency, cls, CAN_XR_LATENCY_MAC,
+                          state->rx_mac_ts - state->rx_sof_ts);
+    CAN_XR_Latency_Record(mac->latency, cls, CAN_XR_LATENCY_EOF,
+                          ts - state->rx_sof_ts);
+}
+
+/* A frame has been received correctly.  Commit it into the receive
+   ring, if any, or generate Data_Ind for LLC.  A frame that finds the
+   ring full is lost and counted as an overflow of the ring.
+*/
+static void rx_frame_ind(struct CAN_XR_MAC *mac, unsigned long ts)
+{
+    struct CAN_XR_MAC_Rx_Frame *frame = mac->state.rx_slot;
+    enum CAN_XR_Format format = mac->state.rx_fdf
+        ? (mac->state.rx_ide ? CAN_XR_FORMAT_FEFF : CAN_XR_FORMAT_FBFF)
+        : (mac->state.rx_ide ? CAN_XR_FORMAT_CEFF : CAN_XR_FORMAT_CBFF);
+
+    if(mac->rx_ring == NULL)
+    {
+        if(mac->primitives.data_ind)
+            mac->primitives.data_ind(
+                mac->llc, ts, mac->state.rx_identifier,
+                format, mac->state.rx_dlc, mac->state.rx_data);
+        return;
+    }
+
+    if(frame == NULL)
+    {
+        mac->rx_ring->overflows++;
+        return;
+    }
+
+    /* The data field is already there.  FD frames are not
+       authenticated.
+    */
+    frame->ts = ts;
+    frame->sof_ts = mac->state.rx_sof_ts;
+    frame->identifier = mac->state.rx_identifier;
+    frame->format = format;
+    frame->dlc = mac->state.rx_dlc;
+    frame->mac_len = mac->state.rx_fdf ? 0 : CAN_XR_Auth_Policy_MAC_Len(
+        mac->policy,
+        CAN_XR_Auth_Policy_Key(mac->state.rx_identifier, mac->state.rx_ide),
+        mac->state.rx_dlc);
+    mac->state.rx_slot = NULL;
+    CAN_XR_SPSC_Commit(mac->rx_ring);
+}
+
 /* Static primitive invoked on all de-stuffed bits after SOF while the
    MAC is receiving.  It performs CRC calculation using crc_nextibt
    and deserialization and recompiling of the frame structure, [1]
@@ -143,10 +353,9 @@ static uint16_t crc_nxtbit(uint16_t crc, uint16_t nxtbit)
 
    TBD:
 
-   - We currently support only CBFF
    - We don't implement OF
-   - We don't handle intermission
-   - We allow hard synchronization even in the first bit of intermission
+   - FD frames: the protocol exception state is unsupported, res is
+     not checked
 */
 static void de_stuffed_data_ind(
     struct CAN_XR_MAC *mac, unsigned long ts, int input_unit)
@@ -163,14 +372,29 @@ static void de_stuffed_data_ind(
            because they must consider the de-stuffed data stream.
         */
         TRACE(2, "MAC @%lu SOF received (%d)", ts, input_unit);
+        CAPTURE_EVENT(CAN_XR_CAPTURE_SOF);
+        mac->state.rx_sof_ts = ts;
 
         /* Disable hard synchronization per [1] 11.3.2.1 c) */
         CAN_XR_PCS_Hard_Sync_Allowed_Req(mac->pcs, 0);
 
-        /* Initialize CRC and start receiving the identifier field */
+        /* Initialize CRCs and start receiving the identifier field.
+           The CRCs of FD frames start with their MSb set [1] 10.4.2.6.
+        */
         mac->state.crc = crc_nxtbit(0x0000, input_unit);
+        mac->state.crc17 = 1UL << 16;
+        mac->state.crc21 = 1UL << 20;
+        crc_fd_update(&mac->state, input_unit);
+        mac->state.stuff_bits = 0;
         mac->state.field_bits = 10;
         mac->state.rx_identifier = 0;
+        mac->state.rx_ide = 0;
+        mac->state.rx_fdf = 0;
+
+        /* All filter banks set may accept the frame, until some bit
+           of its identifier tells otherwise.
+        */
+        mac->state.rx_filter_match = mac->state.filter_enabled;
         mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_IDENTIFIER;
         break;
 
@@ -187,6 +411,13 @@ static void de_stuffed_data_ind(
         mac->state.rx_identifier =
             shift_in(mac->state.rx_identifier, input_unit);
 
+        /* Drop the filter banks that reject this identifier bit, bit
+           #0 is the MSb.  One lookup per bit, whatever the number of
+           banks.
+        */
+        mac->state.rx_filter_match &=
+            ~mac->state.filter_reject[input_unit][10 - mac->state.field_bits];
+
         /* Update CRC and switch to the control field if needed. */
         mac->state.crc = crc_nxtbit(mac->state.crc, input_unit);
         if(mac->state.field_bits-- == 0)
@@ -202,27 +433,35 @@ static void de_stuffed_data_ind(
     case CAN_XR_MAC_RX_FSM_RX_RTR:
         TRACE(2, "MAC @%lu RTR bit (%d)", ts, input_unit);
 
-        /* TBD: RTR bit unchecked, shall be dominant because we do not
+        /* The bit after the base identifier is RTR in CBFF and SRR in
+           CEFF, IDE will tell.  In CEFF, the RTR bit follows the
+           identifier extension and .rx_ide is already set when we get
+           here the second time.  SRR is sent recessive, but receivers
+           shall accept both values [1] 10.4.2.3.  In FD frames this
+           bit is RRS, which is dominant.
+
+           TBD: RTR bit unchecked, shall be dominant because we do not
            support RTR frames at this time.
         */
         mac->state.rx_rtr = input_unit;
         mac->state.crc = crc_nxtbit(mac->state.crc, input_unit);
-        mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_IDE;
+        if(mac->state.rx_ide != 0)
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_FDF;
+        else
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_IDE;
         break;
 
     case CAN_XR_MAC_RX_FSM_RX_IDE:
         TRACE(2, "MAC @%lu IDE bit (%d)", ts, input_unit);
         mac->state.rx_ide = input_unit;
         mac->state.crc = crc_nxtbit(mac->state.crc, input_unit);
+        mac->state.rx_filter_match &= ~mac->state.filter_reject_ide[input_unit];
 
-        /* TBD: We currently support only CBFF, it must be IDE=0. */
         if(mac->state.rx_ide != 0)
         {
-            TRACE(2, "MAC @%lu xEFF formats unsupported", ts);
-            CAN_XR_PCS_Data_Req(mac->pcs, 0);
-            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
-            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_ERROR;
-            mac->state.field_bits = 5;
+            /* CEFF, the 18-bit identifier extension follows */
+            mac->state.field_bits = 17;
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_ID_EXT;
         }
         else
         {
@@ -230,19 +469,38 @@ static void de_stuffed_data_ind(
         }
         break;
 
+    case CAN_XR_MAC_RX_FSM_RX_ID_EXT:
+        TRACE(2, "MAC @%lu identifier extension bit #%d (%d)",
+              ts, mac->state.field_bits, input_unit);
+
+        /* Shifted in after the base identifier, which becomes the 11
+           MSbs of the 29-bit identifier.
+        */
+        mac->state.rx_identifier =
+            shift_in(mac->state.rx_identifier, input_unit);
+        mac->state.rx_filter_match &=
+            ~mac->state.filter_reject[input_unit][28 - mac->state.field_bits];
+        mac->state.crc = crc_nxtbit(mac->state.crc, input_unit);
+        if(mac->state.field_bits-- == 0)
+        {
+            TRACE(2, "MAC @%lu rx_identifier=%lu (CEFF)", ts,
+              (unsigned long)mac->state.rx_identifier);
+
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_RTR;
+        }
+        break;
+
     case CAN_XR_MAC_RX_FSM_RX_FDF:
         TRACE(2, "MAC @%lu FDF bit (%d)", ts, input_unit);
         mac->state.rx_fdf = input_unit;
         mac->state.crc = crc_nxtbit(mac->state.crc, input_unit);
 
-        /* TBD: We currently support only CBFF, it must be FDF=0. */
-        if(mac->state.rx_ide != 0)
+        /* CEFF has one more reserved bit, r0, and FD frames have res
+           before BRS and ESI.
+        */
+        if(mac->state.rx_fdf != 0 || mac->state.rx_ide != 0)
         {
-            TRACE(2, "MAC @%lu FBFF format unsupported", ts);
-            CAN_XR_PCS_Data_Req(mac->pcs, 0);
-            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
-            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_ERROR;
-            mac->state.field_bits = 5;
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_R0;
         }
 
         else
@@ -253,6 +511,44 @@ static void de_stuffed_data_ind(
         }
         break;
 
+    case CAN_XR_MAC_RX_FSM_RX_R0:
+        TRACE(2, "MAC @%lu r0 bit (%d)", ts, input_unit);
+
+        /* Reserved bit, receivers shall accept both values [1]
+           10.4.2.4.
+        */
+        mac->state.crc = crc_nxtbit(mac->state.crc, input_unit);
+        if(mac->state.rx_fdf != 0)
+        {
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_BRS;
+            break;
+        }
+        mac->state.field_bits= 3;
+        mac->state.rx_dlc = 0;
+        mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_DLC;
+        break;
+
+    case CAN_XR_MAC_RX_FSM_RX_BRS:
+        TRACE(2, "MAC @%lu BRS bit (%d)", ts, input_unit);
+
+        /* The data phase starts at this sample point, at the data bit
+           time if BRS is recessive.  It ends at the sample point of
+           CDEL or when an error is detected.
+        */
+        mac->state.rx_brs = input_unit;
+        if(mac->state.rx_brs != 0)
+            CAN_XR_PCS_Bit_Rate_Switch_Req(mac->pcs, 1);
+        mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_ESI;
+        break;
+
+    case CAN_XR_MAC_RX_FSM_RX_ESI:
+        TRACE(2, "MAC @%lu ESI bit (%d)", ts, input_unit);
+        mac->state.rx_esi = input_unit;
+        mac->state.field_bits= 3;
+        mac->state.rx_dlc = 0;
+        mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_DLC;
+        break;
+
     case CAN_XR_MAC_RX_FSM_RX_DLC:
         TRACE(2, "MAC @%lu DLC bit #%d (%d)",
               ts, mac->state.field_bits, input_unit);
@@ -266,15 +562,41 @@ static void de_stuffed_data_ind(
             /* Calculate how many bits the data field has.  It may be
                empty, skip directly to the CRC in that case.
             */
-            mac->state.field_bits = 8 * ((mac->state.rx_dlc > 8) ? 8 : mac->state.rx_dlc) - 1;
+            mac->state.rx_len = CAN_XR_DLC_Len(
+                mac->state.rx_fdf ? CAN_XR_FORMAT_FBFF : CAN_XR_FORMAT_CBFF,
+                mac->state.rx_dlc);
+            mac->state.field_bits = 8 * mac->state.rx_len - 1;
+
+            /* Latency marks, the data MAC takes the last
+               .rx_payload_bits of the data field.  Both stay here if
+               the data field is empty.
+            */
+            mac->state.rx_data_ts = mac->state.rx_mac_ts = ts;
+            mac->state.rx_payload_bits = (mac->latency && !mac->state.rx_fdf)
+                ? 8 * CAN_XR_Auth_Policy_MAC_Len(
+                    mac->policy,
+                    CAN_XR_Auth_Policy_Key(mac->state.rx_identifier, mac->state.rx_ide),
+                    mac->state.rx_dlc)
+                : 0;
+
+            /* The identifier is complete.  A frame that no filter
+               bank accepts is still received to check it and
+               acknowledge it, but it is neither buffered nor
+               indicated to the LLC.
+            */
+            mac->state.rx_accept = mac->state.filter_enabled == 0
+                || mac->state.rx_filter_match != 0;
+            if(mac->state.rx_accept)
+                rx_frame_begin(mac);
 
             if(mac->state.field_bits > 0)
             {
-                /* Clear the whole .rx_data[] buffer, initialize byte
-                   buffer .rx_byte and byte index .rx_byte_index
-                   within rx_data[]
+                /* Clear the whole data buffer .rx_buf[], initialize
+                   byte buffer .rx_byte and byte index .rx_byte_index
+                   within it
                 */
-                memset(mac->state.rx_data, 0, sizeof(mac->state.rx_data));
+                if(mac->state.rx_accept)
+                    memset(mac->state.rx_buf, 0, CAN_XR_DATA_LEN_MAX);
                 mac->state.rx_byte = 0;
                 mac->state.rx_byte_index = 0;
                 mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_DATA;
@@ -288,7 +610,7 @@ static void de_stuffed_data_ind(
                    tx_byte_index and prepare tx_data[0] for
                    transmission in tx_shift_reg.
                 */
-                if(mac->primitives.ext_tx_data_ind)
+                if(mac->primitives.ext_tx_data_ind && mac->state.rx_accept)
                 {
                     mac->state.tx_byte_index = 0;
                     mac->state.tx_shift_reg = shift_prepare(mac->state.tx_data[0], 8);
@@ -297,6 +619,11 @@ static void de_stuffed_data_ind(
                 }
             }
 
+            else if(mac->state.rx_fdf != 0)
+            {
+                rx_fd_crc_field(&mac->state);
+            }
+
             else
             {
                 mac->state.field_bits = 14;
@@ -311,22 +638,29 @@ static void de_stuffed_data_ind(
 
         mac->state.rx_byte = shift_in(mac->state.rx_byte, input_unit);
         mac->state.crc = crc_nxtbit(mac->state.crc, input_unit);
-        if(mac->state.field_bits % 8 == 0)
+        if(mac->state.field_bits % 8 == 0 && mac->state.rx_accept)
         {
             /* Byte boundary, move reassembled byte from .rx_byte into
                .rx_data[] at the right position.  Even though bits
                within a byte are transmitted big-endian, bytes within
                the data field are transmitted little-endian.  See [1],
                Figures 12-17.Interesting.
-
-               TBD: Are we sure we don't read rx_data[8] in this way?
             */
-            mac->state.rx_data[mac->state.rx_byte_index++] = mac->state.rx_byte;
+            mac->state.rx_buf[mac->state.rx_byte_index++] = mac->state.rx_byte;
             mac->state.rx_byte = 0;
         }
 
+        if(mac->state.field_bits == mac->state.rx_payload_bits)
+            mac->state.rx_data_ts = ts;
+
         if(mac->state.field_bits-- == 0)
         {
+            mac->state.rx_mac_ts = ts;
+            if(mac->state.rx_fdf != 0)
+            {
+                rx_fd_crc_field(&mac->state);
+                break;
+            }
             mac->state.field_bits = 14;
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_CRC;
 //            mac->state.field_bits = 8;
@@ -351,6 +685,8 @@ static void de_stuffed_data_ind(
                 TRACE(9, ">>> MAC @%lu CRC error id=%lu dlc=%d", ts,
                       (unsigned long)mac->state.rx_identifier,
                       mac->state.rx_dlc);
+                METRIC_INC(CAN_XR_METRIC_CRC_ERRORS);
+                CAPTURE_EVENT(CAN_XR_CAPTURE_CRC_ERROR);
                 CAN_XR_PCS_Data_Req(mac->pcs, 0);
                 mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
                 mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_ERROR;
@@ -365,12 +701,65 @@ static void de_stuffed_data_ind(
         }
         break;
 
+    case CAN_XR_MAC_RX_FSM_RX_FD_CRC:
+        TRACE(2, "MAC @%lu FD CRC field bit #%d (%d)",
+              ts, mac->state.field_bits, input_unit);
+
+        /* Stuff count first, then the CRC, both covered by the CRC.
+           As above, the CRC must be 0 at the end.  A wrong stuff count
+           is a CRC error, too.
+        */
+        if(mac->state.rx_len > 16)
+        {
+            mac->state.crc21 = crc_fd_nxtbit(
+                mac->state.crc21, input_unit, 21, CRC21_POLYNOMIAL);
+            if(mac->state.field_bits >= 21)
+                mac->state.rx_stuff_count =
+                    shift_in(mac->state.rx_stuff_count, input_unit);
+        }
+        else
+        {
+            mac->state.crc17 = crc_fd_nxtbit(
+                mac->state.crc17, input_unit, 17, CRC17_POLYNOMIAL);
+            if(mac->state.field_bits >= 17)
+                mac->state.rx_stuff_count =
+                    shift_in(mac->state.rx_stuff_count, input_unit);
+        }
+
+        if(mac->state.field_bits-- == 0)
+        {
+            if(((mac->state.rx_len > 16) ? mac->state.crc21 : mac->state.crc17) != 0
+               || mac->state.rx_stuff_count != stuff_count_field(mac->state.stuff_bits))
+            {
+                TRACE(9, ">>> MAC @%lu FD CRC error id=%lu dlc=%d", ts,
+                      (unsigned long)mac->state.rx_identifier,
+                      mac->state.rx_dlc);
+                METRIC_INC(CAN_XR_METRIC_CRC_ERRORS);
+                CAPTURE_EVENT(CAN_XR_CAPTURE_CRC_ERROR);
+                CAN_XR_PCS_Data_Req(mac->pcs, 0);
+                mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
+                mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_ERROR;
+                mac->state.field_bits = 5;
+            }
+
+            else
+            {
+                mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_RX_CDEL;
+            }
+        }
+        break;
+
     case CAN_XR_MAC_RX_FSM_RX_CDEL: // INFO: RCR delimiter
         TRACE(2, "MAC @%lu CDEL bit (%d)", ts, input_unit);
 
+        /* End of the data phase of FD frames */
+        CAN_XR_PCS_Bit_Rate_Switch_Req(mac->pcs, 0);
+
         if(input_unit != 1)
         {
             TRACE(9, ">>> MAC @%lu CDEL form error", ts);
+            METRIC_INC(CAN_XR_METRIC_FORM_ERRORS);
+            CAPTURE_EVENT(CAN_XR_CAPTURE_FORM_ERROR);
             CAN_XR_PCS_Data_Req(mac->pcs, 0);
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
             mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_ERROR;
@@ -401,6 +790,8 @@ static void de_stuffed_data_ind(
         if(input_unit != 0)
         {
             TRACE(9, ">>> MAC @%lu ACK bit error", ts);
+            METRIC_INC(CAN_XR_METRIC_BIT_ERRORS);
+            CAPTURE_EVENT(CAN_XR_CAPTURE_BIT_ERROR);
             CAN_XR_PCS_Data_Req(mac->pcs, 0);
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
             mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_ERROR;
@@ -421,6 +812,8 @@ static void de_stuffed_data_ind(
         if(input_unit != 1)
         {
             TRACE(9, ">>> MAC @%lu ADEL form error", ts);
+            METRIC_INC(CAN_XR_METRIC_FORM_ERRORS);
+            CAPTURE_EVENT(CAN_XR_CAPTURE_FORM_ERROR);
             CAN_XR_PCS_Data_Req(mac->pcs, 0);
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
             mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_ERROR;
@@ -452,6 +845,8 @@ static void de_stuffed_data_ind(
         {
             TRACE(9, ">>> MAC @%lu EOF bit #%d form error", ts,
               mac->state.field_bits);
+            METRIC_INC(CAN_XR_METRIC_FORM_ERRORS);
+            CAPTURE_EVENT(CAN_XR_CAPTURE_FORM_ERROR);
             CAN_XR_PCS_Data_Req(mac->pcs, 0);
             mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
             mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_ERROR;
@@ -463,21 +858,20 @@ static void de_stuffed_data_ind(
             TRACE(2, "MAC @%lu Frame OK id=%lu dlc=%d", ts,
               (unsigned long)mac->state.rx_identifier,
               mac->state.rx_dlc);
+            METRIC_INC(CAN_XR_METRIC_RX_FRAMES);
+            CAPTURE_EVENT(CAN_XR_CAPTURE_FRAME_OK);
+            if(mac->latency)
+                rx_latency(mac, ts);
 
-            /* We got a frame, eventually.  Generate Data_Ind for LLC. */
-            if(mac->primitives.data_ind)
-            {
-                mac->primitives.data_ind(
-                    mac->llc, ts, mac->state.rx_identifier,
-                    CAN_XR_FORMAT_CBFF, mac->state.rx_dlc, mac->state.rx_data);
-            }
-
-            /* TBD: We don't handle intermission properly.  Moreover,
-               we shouldn't allow hard synchronization in the first
-               bit of intermission 11.3.2.1 c)
+            /* We got a frame, eventually, unless no filter bank
+               accepted it.
             */
-            CAN_XR_PCS_Hard_Sync_Allowed_Req(mac->pcs, 1);
-            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_IDLE;
+            if(mac->state.rx_accept)
+                rx_frame_ind(mac, ts);
+
+            /* Intermission follows, see pcs_data_ind() */
+            mac->state.field_bits = 2;
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_INTERMISSION;
         }
         break;
 
@@ -489,6 +883,67 @@ static void de_stuffed_data_ind(
     }
 }
 
+/* Ask the PCS to transmit 'bit' at the next bit boundary on behalf of
+   the tx automaton, and remember it for bit monitoring [1] 10.9.6.
+   Whether the bit is monitored depends on the state it is sent from:
+   the bits from SOF to the CRC delimiter are, except the data MAC
+   that authenticators overwrite.  The rx automaton has no data MAC
+   state of its own, so it cannot tell.  Not monitored either are the
+   ACK slot and what ext_tx_data_ind transmits.
+*/
+static void tx_data_req(struct CAN_XR_MAC *mac, int bit)
+{
+    switch(mac->state.tx_fsm_state)
+    {
+    case CAN_XR_MAC_TX_FSM_TX_IDENTIFIER:
+    case CAN_XR_MAC_TX_FSM_TX_SRR:
+    case CAN_XR_MAC_TX_FSM_TX_RTR:
+    case CAN_XR_MAC_TX_FSM_TX_IDE:
+    case CAN_XR_MAC_TX_FSM_TX_ID_EXT:
+    case CAN_XR_MAC_TX_FSM_TX_FDF:
+    case CAN_XR_MAC_TX_FSM_TX_R0:
+    case CAN_XR_MAC_TX_FSM_TX_BRS:
+    case CAN_XR_MAC_TX_FSM_TX_ESI:
+    case CAN_XR_MAC_TX_FSM_TX_DLC:
+    case CAN_XR_MAC_TX_FSM_TX_DATA:
+    case CAN_XR_MAC_TX_FSM_TX_CRC_LATCH:
+    case CAN_XR_MAC_TX_FSM_TX_CRC:
+    case CAN_XR_MAC_TX_FSM_TX_FD_CRC:
+    case CAN_XR_MAC_TX_FSM_TX_CDEL:
+        mac->state.tx_monitor = 1;
+        break;
+
+    default:
+        mac->state.tx_monitor = 0;
+        break;
+    }
+
+    mac->state.tx_level = bit;
+    CAN_XR_PCS_Data_Req(mac->pcs, bit);
+}
+
+/* Return 1 if the bit just sampled was sent by the tx automaton and is
+   subject to bit monitoring.  Once the tx automaton is back to idle,
+   after losing arbitration, or handling an error, what it sent last
+   does not count any more.
+*/
+static int tx_monitored(struct CAN_XR_MAC *mac)
+{
+    return mac->state.tx_monitor
+        && mac->state.tx_fsm_state != CAN_XR_MAC_TX_FSM_IDLE
+        && mac->state.tx_fsm_state != CAN_XR_MAC_TX_FSM_ERROR;
+}
+
+/* Prepare the transmission of the DLC, which follows r0 in CEFF, ESI
+   in FD frames and FDF otherwise.
+*/
+static void tx_prepare_dlc(struct CAN_XR_MAC *mac)
+{
+    mac->state.tx_shift_reg = shift_prepare(mac->state.tx_dlc, 4);
+    mac->state.tx_bit_count = 3;
+    mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_DLC;
+}
+
 static void tx_processing_ind(
     struct CAN_XR_MAC *mac, unsigned long ts, int input_unit)
 {
@@ -499,60 +954,148 @@ static void tx_processing_ind(
     switch(mac->state.tx_fsm_state)
     {
     case CAN_XR_MAC_TX_FSM_IDLE:
-        /* Transmit SOF.  At the next sample point, this will also
-           cause the rx automaton to exit from the idle state.
-        */
-        CAN_XR_PCS_Data_Req(mac->pcs, 0);
+        /* Load the mailbox chosen in advance by select_mailbox() */
+        {
+            struct CAN_XR_MAC_Mailbox *mb = &mac->state.mailbox[mac->state.tx_next];
+
+            mac->state.tx_mailbox = mac->state.tx_next;
+            mac->state.tx_identifier = mb->identifier;
+            mac->state.tx_format = mb->format;
+            mac->state.tx_dlc = mb->dlc;
+            mac->state.tx_mac_len = mb->mac_len;
+            memcpy(mac->state.tx_data, mb->data, CAN_XR_DLC_Len(mb->format, mb->dlc));
+            memcpy(mac->state.tx_data_mac, mb->data_mac, sizeof(mac->state.tx_data_mac));
+        }
 
-        /* Prepare for transmitting the identifier */
-        mac->state.tx_shift_reg = shift_prepare(mac->state.tx_identifier, 11);
+        /* Prepare for transmitting the identifier, or the base
+           identifier (its 11 MSbs) in CEFF.
+        */
+        if(CAN_XR_Format_Is_Extended(mac->state.tx_format))
+            mac->state.tx_shift_reg = shift_prepare(mac->state.tx_identifier >> 18, 11);
+        else
+            mac->state.tx_shift_reg = shift_prepare(mac->state.tx_identifier, 11);
         mac->state.tx_bit_count = 10;
         mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_IDENTIFIER;
+
+        if(mac->state.rx_fsm_state == CAN_XR_MAC_RX_FSM_IDLE)
+        {
+            /* Transmit SOF.  At the next sample point, this will also
+               cause the rx automaton to exit from the idle state.
+            */
+            tx_data_req(mac, 0);
+        }
+
+        else
+        {
+            /* SOF sampled at the third bit of intermission, go on
+               with the first identifier bit [1] 10.4.2.2.
+            */
+            tx_processing_ind(mac, ts, input_unit);
+        }
         break;
 
     case CAN_XR_MAC_TX_FSM_TX_IDENTIFIER:
         shift_out(bit, mac->state.tx_shift_reg);
-        CAN_XR_PCS_Data_Req(mac->pcs, bit);
+        tx_data_req(mac, bit);
 
         if(mac->state.tx_bit_count-- == 0)
         {
-            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_RTR;
-            // EVALUATION
-            if (cnt_transmission_attempts) {
-                transmission_attempts++;
-            }
+            if(CAN_XR_Format_Is_Extended(mac->state.tx_format))
+                mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_SRR;
+            else
+                mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_RTR;
+            METRIC_INC(CAN_XR_METRIC_TX_ATTEMPTS);
         }
         break;
 
-    case CAN_XR_MAC_TX_FSM_TX_RTR:
-        /* TBD: RTR is dominant in CBFF frames, other frame formats
-           are unsupported for now.
+    case CAN_XR_MAC_TX_FSM_TX_SRR:
+        /* CEFF only, SRR is recessive and takes the place of RTR, so
+           a CBFF data frame wins over a CEFF frame with the same base
+           identifier.
         */
-        CAN_XR_PCS_Data_Req(mac->pcs, 0);
+        tx_data_req(mac, 1);
         mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_IDE;
         break;
 
+    case CAN_XR_MAC_TX_FSM_TX_RTR:
+        /* TBD: RTR is dominant in data frames, remote frames are
+           unsupported for now.  In CEFF, RTR comes after the
+           identifier extension.  FD frames have RRS in its place,
+           dominant as well.
+        */
+        tx_data_req(mac, 0);
+        if(CAN_XR_Format_Is_Extended(mac->state.tx_format))
+            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_FDF;
+        else
+            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_IDE;
+        break;
+
     case CAN_XR_MAC_TX_FSM_TX_IDE:
-        /* TBD: IDE is dominant in CBFF frames, other frame formats
-           are unsupported for now.
+        /* IDE is dominant in CBFF and recessive in CEFF, where the
+           identifier extension follows.
         */
-        CAN_XR_PCS_Data_Req(mac->pcs, 0);
-        mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_FDF;
+        if(CAN_XR_Format_Is_Extended(mac->state.tx_format))
+        {
+            tx_data_req(mac, 1);
+            mac->state.tx_shift_reg = shift_prepare(mac->state.tx_identifier & 0x3FFFF, 18);
+            mac->state.tx_bit_count = 17;
+            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_ID_EXT;
+        }
+        else
+        {
+            tx_data_req(mac, 0);
+            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_FDF;
+        }
+        break;
+
+    case CAN_XR_MAC_TX_FSM_TX_ID_EXT:
+        shift_out(bit, mac->state.tx_shift_reg);
+        tx_data_req(mac, bit);
+
+        if(mac->state.tx_bit_count-- == 0)
+            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_RTR;
         break;
 
     case CAN_XR_MAC_TX_FSM_TX_FDF:
-        /* TBD: FDF is dominant in CBFF frames, other frame formats
-           are unsupported for now.
+        /* FDF is dominant in classical frames, recessive in FD frames.
+           A reserved bit follows in CEFF (r0) and in FD frames (res).
         */
-        CAN_XR_PCS_Data_Req(mac->pcs, 0);
-        mac->state.tx_shift_reg = shift_prepare(mac->state.tx_dlc, 4);
-        mac->state.tx_bit_count = 3;
-        mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_DLC;
+        tx_data_req(mac, CAN_XR_Format_Is_FD(mac->state.tx_format));
+        if(CAN_XR_Format_Is_FD(mac->state.tx_format) ||
+           CAN_XR_Format_Is_Extended(mac->state.tx_format))
+            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_R0;
+        else
+            tx_prepare_dlc(mac);
+        break;
+
+    case CAN_XR_MAC_TX_FSM_TX_R0:
+        /* Reserved bit, transmitted dominant [1] 10.4.2.4 */
+        tx_data_req(mac, 0);
+        if(CAN_XR_Format_Is_FD(mac->state.tx_format))
+            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_BRS;
+        else
+            tx_prepare_dlc(mac);
+        break;
+
+    case CAN_XR_MAC_TX_FSM_TX_BRS:
+        /* The bit rate switch itself is done by the rx automaton,
+           which receives our frame, too.
+        */
+        tx_data_req(mac, mac->state.brs);
+        mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_ESI;
+        break;
+
+    case CAN_XR_MAC_TX_FSM_TX_ESI:
+        /* TBD: Fault confinement is not implemented, we are always
+           error active and ESI is dominant.
+        */
+        tx_data_req(mac, 0);
+        tx_prepare_dlc(mac);
         break;
 
     case CAN_XR_MAC_TX_FSM_TX_DLC:
         shift_out(bit, mac->state.tx_shift_reg);
-        CAN_XR_PCS_Data_Req(mac->pcs, bit);
+        tx_data_req(mac, bit);
 
         if(mac->state.tx_bit_count-- == 0)
         {
@@ -560,17 +1103,9 @@ static void tx_processing_ind(
             {
                 mac->state.tx_byte_index = 0;
                 mac->state.tx_shift_reg = shift_prepare(mac->state.tx_data[0], 8);
-                if (mac->state.tx_identifier < 256)
-                {
-                    mac->state.tx_bit_count =
-                            8 * ((mac->state.tx_dlc > 8) ? 5 : mac->state.tx_dlc - 3 ) - 1; /* reduced by three, as last three bytes are data MAC */
-                }
-                /* Identifier > 256 are not authenticated */
-                else
-                {
-                    mac->state.tx_bit_count =
-                            8 * ((mac->state.tx_dlc > 8) ? 8 : mac->state.tx_dlc) - 1;
-                }
+                /* reduced by the data MAC length, 0 if not authenticated */
+                mac->state.tx_bit_count =
+                        8 * (CAN_XR_DLC_Len(mac->state.tx_format, mac->state.tx_dlc) - mac->state.tx_mac_len) - 1;
                 mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_DATA;
             }
 
@@ -581,22 +1116,22 @@ static void tx_processing_ind(
 
     case CAN_XR_MAC_TX_FSM_TX_DATA:
         shift_out(bit, mac->state.tx_shift_reg);
-        CAN_XR_PCS_Data_Req(mac->pcs, bit);
+        tx_data_req(mac, bit);
 
         if(mac->state.tx_bit_count == 0)
         {
             /* Done with data bits */
-            if (mac->state.tx_identifier < 256)
+            if (mac->state.tx_mac_len)
             {
                 mac->state.mac_byte_index = 0;
                 mac->state.tx_shift_reg =
                         shift_prepare(mac->state.tx_data_mac[mac->state.mac_byte_index++], 8);
-                mac->state.tx_bit_count = 23;
+                mac->state.tx_bit_count = 8 * mac->state.tx_mac_len - 1;
 
                 mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_DATA_MAC;
             }
             else
-            /* Identifier > 256 are not authenticated */
+            /* Not authenticated */
             {
                 mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_CRC_LATCH;
             }
@@ -613,7 +1148,7 @@ static void tx_processing_ind(
 
     case CAN_XR_MAC_TX_FSM_TX_DATA_MAC:
         shift_out(bit, mac->state.tx_shift_reg);
-        CAN_XR_PCS_Data_Req(mac->pcs, bit);
+        tx_data_req(mac, bit);
         if(mac->state.tx_bit_count == 0)
         {
             mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_CRC_LATCH;
@@ -630,6 +1165,31 @@ static void tx_processing_ind(
         The result is stored in mac->state.crc, so we can latch it
         into tx_shift_reg and start transmitting it.
      */
+        if(CAN_XR_Format_Is_FD(mac->state.tx_format))
+        {
+            /* In FD frames, the stuff count goes first and is covered
+               by the CRC.  The receiver has also counted the dynamic
+               stuff bits for us.  The field starts with a fixed stuff
+               bit, the complement of the last data bit, just sampled.
+            */
+            int width =
+                (CAN_XR_DLC_Len(mac->state.tx_format, mac->state.tx_dlc) > 16) ? 21 : 17;
+            uint32_t polynomial = (width == 21) ? CRC21_POLYNOMIAL : CRC17_POLYNOMIAL;
+            uint32_t crc = (width == 21) ? mac->state.crc21 : mac->state.crc17;
+            int stuff_count = stuff_count_field(mac->state.stuff_bits);
+            int i;
+
+            for(i = 3; i >= 0; i--)
+                crc = crc_fd_nxtbit(crc, (stuff_count >> i) & 0x1, width, polynomial);
+
+            mac->state.tx_shift_reg =
+                shift_prepare(((uint32_t)stuff_count << width) | crc, 4 + width);
+            mac->state.tx_bit_count = 4 + width - 1;
+            tx_data_req(mac, 1 - input_unit);
+            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_FD_CRC;
+            break;
+        }
+
         mac->state.tx_shift_reg = shift_prepare(mac->state.crc, 15);
         mac->state.tx_bit_count = 14;
 
@@ -639,14 +1199,25 @@ static void tx_processing_ind(
            accordingly.
         */
         shift_out(bit, mac->state.tx_shift_reg);
-        CAN_XR_PCS_Data_Req(mac->pcs, bit);
+        tx_data_req(mac, bit);
         mac->state.tx_bit_count--;
         mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_CRC;
         break;
 
     case CAN_XR_MAC_TX_FSM_TX_CRC:
         shift_out(bit, mac->state.tx_shift_reg);
-        CAN_XR_PCS_Data_Req(mac->pcs, bit);
+        tx_data_req(mac, bit);
+
+        if(mac->state.tx_bit_count-- == 0)
+        {
+            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_CDEL;
+        }
+        break;
+
+    case CAN_XR_MAC_TX_FSM_TX_FD_CRC:
+        /* Fixed stuff bits are inserted by pcs_data_ind() */
+        shift_out(bit, mac->state.tx_shift_reg);
+        tx_data_req(mac, bit);
 
         if(mac->state.tx_bit_count-- == 0)
         {
@@ -656,7 +1227,7 @@ static void tx_processing_ind(
 
     case CAN_XR_MAC_TX_FSM_TX_CDEL: // INFO: RCR delimiter
         TRACE(2, ">>> MAC @%lu Sending CDEL", ts);
-        CAN_XR_PCS_Data_Req(mac->pcs, 1);
+        tx_data_req(mac, 1);
         mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_ACK;
         break;
 
@@ -665,25 +1236,25 @@ static void tx_processing_ind(
            dominant, otherwise an ACK error occurs [1] 10.4.2.7.
 
            Here we issue
-           CAN_XR_PCS_Data_Req(mac->pcs, 1);
+           tx_data_req(mac, 1);
 
            because we don't want to self-acknowledge the frame, but
            the receive automaton just asked to transmit a dominant ACK
            at the next bit boundary if it received the frame
            successfully.
         */
-        CAN_XR_PCS_Data_Req(mac->pcs, 1);
+        tx_data_req(mac, 1);
         mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_ADEL;
         break;
 
     case CAN_XR_MAC_TX_FSM_TX_ADEL: // INFO: ACK delimiter
-        CAN_XR_PCS_Data_Req(mac->pcs, 1);
+        tx_data_req(mac, 1);
         mac->state.tx_bit_count = 6;
         mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_TX_EOF;
         break;
 
     case CAN_XR_MAC_TX_FSM_TX_EOF:
-        CAN_XR_PCS_Data_Req(mac->pcs, 1);
+        tx_data_req(mac, 1);
         if(mac->state.tx_bit_count-- == 0)
         {
             /* Delay the return to TX_FSM_IDLE by one bit, to have
@@ -697,13 +1268,25 @@ static void tx_processing_ind(
         /* At this sampling point, the last bit of EOF has been
            sampled.
 
-           TBD: No intermission, the transmitter returns to the IDLE
-           state immediately after sampling the last bit of EOF.
+           The transmitter returns to the IDLE state immediately.
+           It waits for the rx automaton to go through intermission
+           before transmitting again.
         */
         TRACE(2, ">>> MAC @%lu back to TX_FSM_IDLE", ts);
 
-        mac->state.data_req_pending = 0;
+        /* From the request to the validation of the frame */
+        if(mac->latency)
+            CAN_XR_Latency_Record(
+                mac->latency,
+                latency_class(mac, mac->state.tx_identifier,
+                              CAN_XR_Format_Is_Extended(mac->state.tx_format),
+                              CAN_XR_Format_Is_FD(mac->state.tx_format)),
+                CAN_XR_LATENCY_TX,
+                ts - mac->state.mailbox[mac->state.tx_mailbox].req_ts);
+
+        release_mailbox(&mac->state);
         mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_IDLE;
+        METRIC_INC(CAN_XR_METRIC_TX_FRAMES);
 
         if(mac->primitives.data_conf)
         {
@@ -725,7 +1308,7 @@ static void tx_processing_ind(
            itself (which is probably incorrect behavior anyway, but
            better safe than sorry).
         */
-        CAN_XR_PCS_Data_Req(mac->pcs, 1);
+        tx_data_req(mac, 1);
 
         if(mac->primitives.ext_tx_data_ind)
         {
@@ -759,12 +1342,23 @@ static void tx_processing_ind(
    This is the starting point for MAC-layer processing.
 
    Bus off condition unchecked / recovery unsupported.
-   FD tolerant / FD enabled MAC unsupported.
+
+   TBD: FD frames, bit monitoring in the data phase is done at the
+   sample point, there is no transmitter delay compensation.  The loop
+   delay must be shorter than prop_seg + phase_seg1 of the data bit
+   time.
 */
 static void pcs_data_ind(
     struct CAN_XR_MAC *mac, unsigned long ts, int input_unit)
 {
+    int sof_in_intermission = 0;
+
     TRACE(2, "MAC @%lu Common::pcs_data_ind(%d)", ts, input_unit);
+    /* The receive FSM changed state at the previous bit */
+    if(mac->state.rx_fsm_state != mac->state.rx_fsm_entry)
+        CAPTURE(CAN_XR_CAPTURE_RX_STATE, mac->state.rx_fsm_state);
+    mac->state.rx_fsm_entry = mac->state.rx_fsm_state;
+    PROFILE_STATE(mac->state.rx_fsm_state);
 
     /* Handle rx FSM first */
     switch(mac->state.rx_fsm_state)
@@ -797,6 +1391,39 @@ static void pcs_data_ind(
         }
 	    break;
 
+    case CAN_XR_MAC_RX_FSM_INTERMISSION:
+        /* Intermission, 3 recessive bits after EOF [1] 10.4.5.  Hard
+           synchronization is allowed again after the first one [1]
+           11.3.2.1 c).  A dominant bit at the third bit is a SOF, [1]
+           10.4.2.2, and a node with a pending frame transmits it from the
+           first identifier bit on.  A dominant bit at the first or second
+           bit calls for an OF, which we don't implement.  We handle it like
+           an error, an OF has the same form as an error frame.
+        */
+        if(input_unit == 1)
+        {
+            if(mac->state.field_bits == 2)
+                CAN_XR_PCS_Hard_Sync_Allowed_Req(mac->pcs, 1);
+
+            if(mac->state.field_bits-- == 0)
+                mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_IDLE;
+            break;
+        }
+
+        if(mac->state.field_bits != 0)
+        {
+            TRACE(9, ">>> MAC @%lu overload condition", ts);
+            CAN_XR_PCS_Data_Req(mac->pcs, 0);
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
+            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_ERROR;
+            mac->state.field_bits = 5;
+            break;
+        }
+
+        TRACE(2, ">>> MAC @%lu SOF in intermission", ts);
+        sof_in_intermission = 1;
+        mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_IDLE;
+        /* Fall through */
     case CAN_XR_MAC_RX_FSM_IDLE:
         if(input_unit == 0)
         {
@@ -814,7 +1441,11 @@ static void pcs_data_ind(
     case CAN_XR_MAC_RX_FSM_RX_IDENTIFIER:
     case CAN_XR_MAC_RX_FSM_RX_RTR:
     case CAN_XR_MAC_RX_FSM_RX_IDE:
+    case CAN_XR_MAC_RX_FSM_RX_ID_EXT:
     case CAN_XR_MAC_RX_FSM_RX_FDF:
+    case CAN_XR_MAC_RX_FSM_RX_R0:
+    case CAN_XR_MAC_RX_FSM_RX_BRS:
+    case CAN_XR_MAC_RX_FSM_RX_ESI:
     case CAN_XR_MAC_RX_FSM_RX_DLC:
     case CAN_XR_MAC_RX_FSM_RX_DATA:
     case CAN_XR_MAC_RX_FSM_RX_CRC:
@@ -827,11 +1458,51 @@ static void pcs_data_ind(
            after the last bit of CRC, as it must not be considered as
            CDEL by itself.
 
-           TBD: This is probably also a good place to implement bit
-           monitoring and detect arbitration loss.  Neither of those
-           are implemented for now.
+           Bit monitoring and arbitration are done here, too.  A
+           recessive bit of the arbitration field (identifier and RTR
+           in CBFF; base identifier, SRR, IDE, identifier extension
+           and RTR in CEFF) overwritten by a dominant one means that
+           another node is transmitting a higher-priority frame.  The tx
+           automaton goes back to idle and the rx automaton keeps
+           receiving the frame.  The frame stays in its mailbox, with
+           its data and data MAC unchanged, and it will be transmitted
+           again after the bus becomes idle.  Any other mismatch,
+           including one on a stuff bit, is a bit error [1] 10.9.6.
+
+           The CRCs of FD frames include the stuff bits, so they are
+           updated here.  Past the data field, the bits fed to them
+           are not used.
         */
+        if(tx_monitored(mac) && input_unit != mac->state.tx_level)
+        {
+            if(input_unit == 0 && mac->state.nc_bits != 5 &&
+               (mac->state.rx_fsm_state == CAN_XR_MAC_RX_FSM_RX_IDENTIFIER ||
+                mac->state.rx_fsm_state == CAN_XR_MAC_RX_FSM_RX_RTR ||
+                mac->state.rx_fsm_state == CAN_XR_MAC_RX_FSM_RX_IDE ||
+                mac->state.rx_fsm_state == CAN_XR_MAC_RX_FSM_RX_ID_EXT))
+            {
+                TRACE(2, ">>> MAC @%lu arbitration lost", ts);
+                mac->state.arbitration_lost++;
+                METRIC_INC(CAN_XR_METRIC_ARBITRATION_LOST);
+                CAPTURE_EVENT(CAN_XR_CAPTURE_ARBITRATION_LOST);
+                mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_IDLE;
+            }
+
+            else
+            {
+                TRACE(9, ">>> MAC @%lu bit error", ts);
+                METRIC_INC(CAN_XR_METRIC_BIT_ERRORS);
+                CAPTURE_EVENT(CAN_XR_CAPTURE_BIT_ERROR);
+                CAN_XR_PCS_Data_Req(mac->pcs, 0);
+                mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
+                mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_ERROR;
+                mac->state.field_bits = 5;
+                break;
+            }
+        }
+
         mac->state.bus_bits++;
+        crc_fd_update(&mac->state, input_unit);
 
         if(mac->state.nc_bits == 5)
         {
@@ -839,6 +1510,8 @@ static void pcs_data_ind(
             if(input_unit == mac->state.nc_pol)
             {
                 TRACE(9, ">>> MAC @%lu stuff error", ts);
+                METRIC_INC(CAN_XR_METRIC_STUFF_ERRORS);
+                CAPTURE_EVENT(CAN_XR_CAPTURE_STUFF_ERROR);
                 TRACE_FUNCTION(9, CAN_XR_MAC_Dump, "[after stuff error]", mac);
                 CAN_XR_PCS_Data_Req(mac->pcs, 0);
                 mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
@@ -850,6 +1523,7 @@ static void pcs_data_ind(
                 TRACE(2, ">>> MAC @%lu discarding stuff bit @%d", ts, input_unit);
                 mac->state.nc_bits = 1;
                 mac->state.nc_pol = input_unit;
+                mac->state.stuff_bits++;
             }
         }
 
@@ -873,6 +1547,52 @@ static void pcs_data_ind(
 
         break;
 
+    case CAN_XR_MAC_RX_FSM_RX_FD_CRC:
+        /* Fixed stuff bits, see rx_fd_crc_field().  One with the
+           wrong value is a form error.  Bit monitoring as above.
+        */
+        if(tx_monitored(mac) && input_unit != mac->state.tx_level)
+        {
+            TRACE(9, ">>> MAC @%lu bit error", ts);
+            METRIC_INC(CAN_XR_METRIC_BIT_ERRORS);
+            CAPTURE_EVENT(CAN_XR_CAPTURE_BIT_ERROR);
+            CAN_XR_PCS_Data_Req(mac->pcs, 0);
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
+            mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_ERROR;
+            mac->state.field_bits = 5;
+            break;
+        }
+
+        mac->state.bus_bits++;
+
+        if(mac->state.nc_bits == 4)
+        {
+            if(input_unit == mac->state.nc_pol)
+            {
+                TRACE(9, ">>> MAC @%lu fixed stuff bit form error", ts);
+                METRIC_INC(CAN_XR_METRIC_FORM_ERRORS);
+                CAPTURE_EVENT(CAN_XR_CAPTURE_FORM_ERROR);
+                CAN_XR_PCS_Data_Req(mac->pcs, 0);
+                mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_ERROR_FLAG;
+                mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_ERROR;
+                mac->state.field_bits = 5;
+            }
+            else
+            {
+                mac->state.nc_bits = 0;
+                mac->state.nc_pol = input_unit;
+            }
+        }
+
+        else
+        {
+            mac->state.nc_bits++;
+            mac->state.nc_pol = input_unit;
+            mac->state.de_stuffed_bits++;
+            de_stuffed_data_ind(mac, ts, input_unit);
+        }
+        break;
+
     case CAN_XR_MAC_RX_FSM_RX_ACK:
         /* TBD: This is probably a good place to detect ACK errors.
            The transmitter transmits a recessive bit, we should sample
@@ -906,9 +1626,18 @@ static void pcs_data_ind(
         }
         CAN_XR_PCS_Data_Req(mac->pcs, 1);
         if (mac->state.field_bits-- == 0) {
+            /* Intermission follows [1] 10.4.4.3, as after EOF.  Nodes
+               that left the data phase of an FD frame at different
+               times may now be out of phase by a fraction of a bit,
+               the SOF in intermission brings them back in step by
+               hard synchronization.  Waiting for 11 recessive bits
+               instead would let the SOF of the earliest node restart
+               the bus integration of the others.
+            */
             CAN_XR_PCS_Data_Req(mac->pcs, 1);
             CAN_XR_PCS_Hard_Sync_Allowed_Req(mac->pcs, 1);
-            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_BUS_INTEGRATION;
+            mac->state.field_bits = 2;
+            mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_INTERMISSION;
             mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_IDLE;
         }
         break;
@@ -931,6 +1660,12 @@ static void pcs_data_ind(
         break;
     }
 
+    /* Error flags go at the nominal bit rate, switch back to it as
+       soon as an error is detected.
+    */
+    if(mac->state.rx_fsm_state == CAN_XR_MAC_RX_FSM_ERROR_FLAG)
+        CAN_XR_PCS_Bit_Rate_Switch_Req(mac->pcs, 0);
+
     /* Handle tx FSM next */
     switch(mac->state.tx_fsm_state)
     {
@@ -946,34 +1681,39 @@ static void pcs_data_ind(
 
            In this way, the rx automaton can keep track of stuff bit
            insertion, receive messages being transmitted by the tx
-           automaton and perform bit monitoring (TBD: although bit
-           monitoring is not implemented at this time).  It also
-           calculates the CRC to transmit for us.
+           automaton and perform bit monitoring.  It also calculates
+           the CRC to transmit for us.
            // INFO: Note that the CRC to transmit is calculated based on what is received, not on what should be transmitted
            // INFO: this results in the fact that if there is a bit error during the transmission, it will not be detected by the CRC validation
 
-           TBD: According to [1], 10.4.2.2 we should bypass sending
-           SOF if we sample a SOF at the third bit of intermission and
-           several other conditions are met.  At this time we do not
-           implement intermission.  So, we stay with the stricter
-           constraint that we honor a pending transmission request
-           only if the bus was sampled idle.  We transmit the SOF at
-           the next bit boundary.
+           A pending transmission request is honored if the bus
+           was sampled idle, which includes the third bit of
+           intermission, by transmitting the SOF at the next bit
+           boundary.  If a SOF was sampled at the third bit of
+           intermission instead, [1] 10.4.2.2 says we bypass sending
+           SOF and transmit the first identifier bit at the next bit
+           boundary.
 
            The transmission-related processing is implemented in
            tx_processing_ind().
         */
         if(mac->state.data_req_pending &&
-           mac->state.rx_fsm_state == CAN_XR_MAC_RX_FSM_IDLE)
+           (mac->state.rx_fsm_state == CAN_XR_MAC_RX_FSM_IDLE
+            || sof_in_intermission))
         {
             tx_processing_ind(mac, ts, input_unit);
         }
         break;
 
     case CAN_XR_MAC_TX_FSM_TX_IDENTIFIER:
+    case CAN_XR_MAC_TX_FSM_TX_SRR:
     case CAN_XR_MAC_TX_FSM_TX_RTR:
     case CAN_XR_MAC_TX_FSM_TX_IDE:
+    case CAN_XR_MAC_TX_FSM_TX_ID_EXT:
     case CAN_XR_MAC_TX_FSM_TX_FDF:
+    case CAN_XR_MAC_TX_FSM_TX_R0:
+    case CAN_XR_MAC_TX_FSM_TX_BRS:
+    case CAN_XR_MAC_TX_FSM_TX_ESI:
     case CAN_XR_MAC_TX_FSM_TX_DLC:
     case CAN_XR_MAC_TX_FSM_TX_DATA:
     case CAN_XR_MAC_TX_FSM_TX_DATA_MAC:
@@ -997,7 +1737,7 @@ static void pcs_data_ind(
             TRACE(2, ">>> MAC %lu inserting stuff bit @%d", ts,
               1 - mac->state.nc_pol);
 
-            CAN_XR_PCS_Data_Req(mac->pcs, 1 - mac->state.nc_pol);
+            tx_data_req(mac, 1 - mac->state.nc_pol);
         }
 
         else
@@ -1007,6 +1747,22 @@ static void pcs_data_ind(
 
         break;
 
+    case CAN_XR_MAC_TX_FSM_TX_FD_CRC:
+        /* Fixed stuff bits in the CRC field of FD frames, where the
+           rx automaton says.  The one before the stuff count is sent
+           by TX_CRC_LATCH.
+        */
+        if(mac->state.nc_bits == 4)
+        {
+            tx_data_req(mac, 1 - mac->state.nc_pol);
+        }
+
+        else
+        {
+            tx_processing_ind(mac, ts, input_unit);
+        }
+        break;
+
     case CAN_XR_MAC_TX_FSM_TX_EXT_TAIL:
         /* This is a transient state entered after transmitting the
            last payload bit by means of ext_tx_data_ind.  It makes
@@ -1050,16 +1806,16 @@ static void pcs_data_ind(
     default:
         /* The transmitting FSM should never enter this state.
 
-           TBD: Very simple error recovery: clear data_req_pending,
-           notify LLC, ask the PCS to transmit recessive at next bit
-           boundary, enable hard synchronization, bring the tx
-           automaton to idle and the rx automaton to the bus
+           TBD: Very simple error recovery: drop the frame being
+           transmitted, notify LLC, ask the PCS to transmit recessive
+           at next bit boundary, enable hard synchronization, bring
+           the tx automaton to idle and the rx automaton to the bus
            integration state.
         */
         TRACE(9, ">>> MAC @%lu Common::pcs_data_ind invalid tx_fsm_state %d",
               ts, mac->state.tx_fsm_state);
 
-        mac->state.data_req_pending = 0;
+        release_mailbox(&mac->state);
         if(mac->primitives.data_conf)
         {
             mac->primitives.data_conf(
@@ -1074,6 +1830,15 @@ static void pcs_data_ind(
     }
 }
 
+/* state_ind primitive of the PMA, see CAN_XR_PMA_Overrun().  The PMA
+   detects an overrun after the chain of callbacks that caused it, so
+   this returns the state the MAC was in when it was last invoked.
+*/
+static int rx_state_ind(struct CAN_XR_PCS *pcs)
+{
+    return pcs->mac->state.rx_fsm_entry;
+}
+
 void CAN_XR_MAC_Common_Init(
     struct CAN_XR_MAC *mac,
     struct CAN_XR_PCS *pcs)
@@ -1089,10 +1854,32 @@ void CAN_XR_MAC_Common_Init(
 
     */
     mac->state.rx_fsm_state = CAN_XR_MAC_RX_FSM_BUS_INTEGRATION;
+    mac->state.rx_fsm_entry = CAN_XR_MAC_RX_FSM_BUS_INTEGRATION;
     mac->state.bus_integration_counter = 0;
 
     mac->state.tx_fsm_state = CAN_XR_MAC_TX_FSM_IDLE;
     mac->state.data_req_pending = 0;
+    mac->state.mailbox_full = 0;
+    mac->state.tx_next = -1;
+    mac->state.tx_mailbox = 0;
+    mac->state.tx_seq = 0;
+    mac->state.tx_level = 1;
+    mac->state.tx_monitor = 0;
+    mac->state.arbitration_lost = 0;
+    mac->state.brs = 0;
+
+    /* No filter bank set, all frames are accepted */
+    memset(mac->state.filter_reject, 0, sizeof(mac->state.filter_reject));
+    memset(mac->state.filter_reject_ide, 0, sizeof(mac->state.filter_reject_ide));
+    mac->state.filter_enabled = 0;
+    mac->state.rx_filter_match = 0;
+    mac->state.rx_accept = 1;
+    mac->state.rx_buf = mac->state.rx_data;
+    mac->state.rx_slot = NULL;
+
+    mac->policy = CAN_XR_Auth_Policy_Default();
+    mac->rx_ring = NULL;
+    mac->latency = NULL;
 
     /* No data_ind, data_conf for now.  Link the common, static
        data_req, may be overridden by implementation-specific
@@ -1106,6 +1893,10 @@ void CAN_XR_MAC_Common_Init(
     /* Link PCS to MAC, register the common, static data_ind */
     CAN_XR_PCS_Set_MAC(pcs, mac);
     CAN_XR_PCS_Set_Data_Ind(pcs, pcs_data_ind);
+
+    /* Account the overruns of the PMA to the receive states */
+    if(pcs->pma)
+        CAN_XR_PMA_Set_State_Ind(pcs->pma, rx_state_ind);
 }
 
 void CAN_XR_MAC_Set_LLC(struct CAN_XR_MAC *mac, struct CAN_XR_LLC *llc)
@@ -1113,6 +1904,76 @@ void CAN_XR_MAC_Set_LLC(struct CAN_XR_MAC *mac, struct CAN_XR_LLC *llc)
     mac->llc = llc;
 }
 
+void CAN_XR_MAC_Set_Auth_Policy(
+    struct CAN_XR_MAC *mac, const struct CAN_XR_Auth_Policy *policy)
+{
+    mac->policy = policy;
+}
+
+void CAN_XR_MAC_Set_Bit_Rate_Switch(struct CAN_XR_MAC *mac, int brs)
+{
+    mac->state.brs = brs;
+}
+
+int CAN_XR_MAC_Set_Filter(
+    struct CAN_XR_MAC *mac, int bank,
+    enum CAN_XR_Format format, uint32_t identifier, uint32_t mask)
+{
+    int bits = CAN_XR_Format_Is_Extended(format) ? CAN_XR_MAC_ID_BITS : 11;
+    uint32_t bank_bit;
+    int n;
+
+    if(CAN_XR_MAC_Clear_Filter(mac, bank) < 0)
+        return -1;
+
+    /* Bit #n of the identifier, MSb first, rejects the frame if its
+       value differs from the one of 'identifier' there and the bit
+       is set in 'mask'.  IDE must tell the format of the bank.
+    */
+    bank_bit = 1UL << bank;
+    for(n = 0; n < bits; n++)
+    {
+        uint32_t id_bit = 1UL << (bits - 1 - n);
+
+        if(mask & id_bit)
+            mac->state.filter_reject[(identifier & id_bit) ? 0 : 1][n] |= bank_bit;
+    }
+    mac->state.filter_reject_ide[bits == 11 ? 1 : 0] |= bank_bit;
+    mac->state.filter_enabled |= bank_bit;
+    return 0;
+}
+
+int CAN_XR_MAC_Clear_Filter(struct CAN_XR_MAC *mac, int bank)
+{
+    uint32_t bank_bit;
+    int n;
+
+    if(bank < 0 || bank >= CAN_XR_MAC_FILTERS)
+        return -1;
+
+    bank_bit = 1UL << bank;
+    for(n = 0; n < CAN_XR_MAC_ID_BITS; n++)
+    {
+        mac->state.filter_reject[0][n] &= ~bank_bit;
+        mac->state.filter_reject[1][n] &= ~bank_bit;
+    }
+    mac->state.filter_reject_ide[0] &= ~bank_bit;
+    mac->state.filter_reject_ide[1] &= ~bank_bit;
+    mac->state.filter_enabled &= ~bank_bit;
+    return 0;
+}
+
+void CAN_XR_MAC_Set_Rx_Ring(struct CAN_XR_MAC *mac, struct CAN_XR_SPSC *rx_ring)
+{
+    mac->rx_ring = rx_ring;
+    mac->state.rx_slot = NULL;
+}
+
+void CAN_XR_MAC_Set_Latency(struct CAN_XR_MAC *mac, struct CAN_XR_Latency *lat)
+{
+    mac->latency = lat;
+}
+
 void CAN_XR_MAC_Set_Data_Ind(
     struct CAN_XR_MAC *mac, CAN_XR_MAC_Data_Ind_t data_ind)
 {
@@ -1142,3 +2003,68 @@ void CAN_XR_MAC_Data_Req(
         mac->primitives.data_req(mac, identifier, format, dlc, data, data_mac);
     }
 }
+
+int CAN_XR_MAC_Flush_Auth(struct CAN_XR_MAC *mac)
+{
+    int i, n = 0;
+
+    for(i = 0; i < CAN_XR_MAC_MAILBOXES; i++)
+    {
+        struct CAN_XR_MAC_Mailbox *mb = &mac->state.mailbox[i];
+
+        if(!(mac->state.mailbox_full & (1UL << i)) || !mb->mac_len)
+            continue;
+
+        mac->state.mailbox_full &= ~(1UL << i);
+        n++;
+
+        if(mac->primitives.data_conf)
+        {
+            mac->primitives.data_conf(
+                    mac->llc, mac->pcs->state.nodeclock_ts, mb->identifier,
+                    CAN_XR_MAC_TX_STATUS_NO_SUCCESS);
+        }
+    }
+
+    select_mailbox(&mac->state);
+    return n;
+}
+
+#ifdef ENABLE_PROFILE
+/* Names of the receive FSM states, for CAN_XR_Profile_Dump().  They
+   are what ties the rows of a dump to a state, the values of the
+   states differ from one node to another.
+*/
+static const char *const rx_fsm_state_name[] = {
+    [CAN_XR_MAC_RX_FSM_BUS_INTEGRATION] = "BUS_INTEGRATION",
+    [CAN_XR_MAC_RX_FSM_IDLE]            = "IDLE",
+    [CAN_XR_MAC_RX_FSM_RX_IDENTIFIER]   = "RX_IDENTIFIER",
+    [CAN_XR_MAC_RX_FSM_RX_RTR]          = "RX_RTR",
+    [CAN_XR_MAC_RX_FSM_RX_IDE]          = "RX_IDE",
+    [CAN_XR_MAC_RX_FSM_RX_ID_EXT]       = "RX_ID_EXT",
+    [CAN_XR_MAC_RX_FSM_RX_FDF]          = "RX_FDF",
+    [CAN_XR_MAC_RX_FSM_RX_R0]           = "RX_R0",
+    [CAN_XR_MAC_RX_FSM_RX_BRS]          = "RX_BRS",
+    [CAN_XR_MAC_RX_FSM_RX_ESI]          = "RX_ESI",
+    [CAN_XR_MAC_RX_FSM_RX_DLC]          = "RX_DLC",
+    [CAN_XR_MAC_RX_FSM_RX_DATA]         = "RX_DATA",
+    [CAN_XR_MAC_RX_FSM_RX_DATA_MAC]     = "RX_DATA_MAC",
+    [CAN_XR_MAC_RX_FSM_RX_CRC]          = "RX_CRC",
+    [CAN_XR_MAC_RX_FSM_RX_FD_CRC]       = "RX_FD_CRC",
+    [CAN_XR_MAC_RX_FSM_RX_CDEL]         = "RX_CDEL",
+    [CAN_XR_MAC_RX_FSM_RX_ACK]          = "RX_ACK",
+    [CAN_XR_MAC_RX_FSM_RX_ADEL]         = "RX_ADEL",
+    [CAN_XR_MAC_RX_FSM_RX_EOF]          = "RX_EOF",
+    [CAN_XR_MAC_RX_FSM_INTERMISSION]    = "INTERMISSION",
+    [CAN_XR_MAC_RX_FSM_ERROR]           = "ERROR",
+    [CAN_XR_MAC_RX_FSM_ERROR_FLAG]      = "ERROR_FLAG",
+    [CAN_XR_MAC_RX_FSM_ERROR_DEL]       = "ERROR_DEL"
+};
+
+const char *CAN_XR_Profile_State_Name(int state)
+{
+    if(state < 0 || state >= (int)(sizeof(rx_fsm_state_name) / sizeof(rx_fsm_state_name[0])))
+        return "OTHER";
+    return rx_fsm_state_name[state];
+}
+#endif
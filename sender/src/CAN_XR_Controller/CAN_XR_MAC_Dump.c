@@ -55,7 +55,8 @@ void CAN_XR_MAC_Dump(
 	    "  crc=0x%04x,\n"
 	    "  field_bits=%d, bus_bits=%d, de_stuffed_bits=%d,\n"
 	    "  rx_identifier=%u, rx_rtr=%d, rx_ide=%d, rx_fdf=%d, rx_dlc=%d,\n"
-	    "  rx_byte=0x%02x, rx_byte_index=%d,\n",
+	    "  rx_byte=0x%02x, rx_byte_index=%d,\n"
+	    "  filter_enabled=0x%08lx, rx_filter_match=0x%08lx, rx_accept=%d,\n",
 	    desc,
 	    state->rx_fsm_state,
 	    state->bus_integration_counter,
@@ -64,22 +65,26 @@ void CAN_XR_MAC_Dump(
 	    state->field_bits, state->bus_bits, state->de_stuffed_bits,
 	    (unsigned int)state->rx_identifier, state->rx_rtr,
 	    state->rx_ide, state->rx_fdf, state->rx_dlc,
-	    state->rx_byte, state->rx_byte_index
+	    state->rx_byte, state->rx_byte_index,
+	    (unsigned long)state->filter_enabled,
+	    (unsigned long)state->rx_filter_match, state->rx_accept
 	);
-    dump_array(stderr, "  rx_data[]= ", state->rx_data,
-	       state->rx_dlc <= 8 ? state->rx_dlc : 8);
+    dump_array(stderr, "  rx_buf[]= ", state->rx_buf,
+	       CAN_XR_DLC_Len(state->rx_fdf ? CAN_XR_FORMAT_FBFF : CAN_XR_FORMAT_CBFF,
+			      state->rx_dlc));
 
     fprintf(stderr,
 	    "\n"
 	    "  tx_fsm_state=%d,\n"
-	    "  data_req_pending=%d,\n"
+	    "  data_req_pending=%d, mailbox_full=0x%08lx, tx_next=%d, tx_mailbox=%d,\n"
 	    "  tx_identifier=%u, tx_format=%d, tx_dlc=%d,\n",
 	    state->tx_fsm_state,
-	    state->data_req_pending,
+	    state->data_req_pending, (unsigned long)state->mailbox_full,
+	    state->tx_next, state->tx_mailbox,
 	    (unsigned int)state->tx_identifier, state->tx_format, state->tx_dlc
 	);
     dump_array(stderr, "  tx_data[]= ", state->tx_data,
-	       state->tx_dlc <= 8 ? state->tx_dlc : 8);
+	       CAN_XR_DLC_Len(state->tx_format, state->tx_dlc));
     fprintf(stderr,
 	    "  tx_byte_index=%d, tx_bit_count=%d, tx_shift_reg=0x%02x\n"
 	    "}\n",
@@ -0,0 +1,222 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Bridge between the bit engine and the foreground loop, see
+   CAN_XR_MAC_Queue.h.
+
+   Errors are emitted at TRACE level 9.
+*/
+
+#include <string.h>
+#include <CAN_XR_PCS.h>
+#include <CAN_XR_MAC_Queue.h>
+#define CAN_XR_TRACE_MODULE MAC
+#include <CAN_XR_Trace.h>
+
+/* The queue is the LLC of the MAC */
+#define QUEUE(llc) ((struct CAN_XR_MAC_Queue *)(llc))
+
+/* Bit engine side of the event queue.  If it is full, the
+   confirmation is lost and counted in .event.overflows.
+*/
+static void queue_data_conf(
+    struct CAN_XR_LLC *llc, unsigned long ts, uint32_t identifier,
+    enum CAN_XR_MAC_Tx_Status transmission_status)
+{
+    struct CAN_XR_MAC_Queue_Event event;
+
+    event.ts = ts;
+    event.identifier = identifier;
+    event.transmission_status = transmission_status;
+
+    CAN_XR_SPSC_Put(&QUEUE(llc)->event, &event);
+}
+
+void CAN_XR_MAC_Queue_Init(
+    struct CAN_XR_MAC_Queue *queue, struct CAN_XR_MAC *mac)
+{
+    queue->mac = mac;
+    CAN_XR_SPSC_Init(&queue->req, queue->req_buf,
+                     sizeof(queue->req_buf[0]), CAN_XR_MAC_QUEUE_LEN);
+    CAN_XR_SPSC_Init(&queue->rx, queue->rx_buf,
+                     sizeof(queue->rx_buf[0]), CAN_XR_MAC_QUEUE_LEN);
+    CAN_XR_SPSC_Init(&queue->event, queue->event_buf,
+                     sizeof(queue->event_buf[0]), CAN_XR_MAC_QUEUE_LEN);
+    queue->flush_req = 0;
+    queue->flush_tail = 0;
+    queue->flush_done = 0;
+    queue->data_ind = NULL;
+    queue->data_conf = NULL;
+
+    CAN_XR_MAC_Set_LLC(mac, (struct CAN_XR_LLC *)queue);
+    CAN_XR_MAC_Set_Rx_Ring(mac, &queue->rx);
+    CAN_XR_MAC_Set_Data_Conf(mac, queue_data_conf);
+}
+
+void CAN_XR_MAC_Queue_Set_Data_Ind(
+    struct CAN_XR_MAC_Queue *queue, CAN_XR_MAC_Data_Ind_t data_ind)
+{
+    queue->data_ind = data_ind;
+}
+
+void CAN_XR_MAC_Queue_Set_Data_Conf(
+    struct CAN_XR_MAC_Queue *queue, CAN_XR_MAC_Data_Conf_t data_conf)
+{
+    queue->data_conf = data_conf;
+}
+
+int CAN_XR_MAC_Queue_Data_Req(
+    struct CAN_XR_MAC_Queue *queue,
+    uint32_t identifier, enum CAN_XR_Format format, int dlc, uint8_t *data, uint8_t *data_mac)
+{
+    struct CAN_XR_MAC_Queue_Req req;
+
+    req.identifier = identifier;
+    req.format = format;
+    req.dlc = dlc;
+    req.flushed = 0;
+    memset(req.data, 0, sizeof(req.data));
+    memcpy(req.data, data, CAN_XR_DLC_Len(format, dlc));
+
+    /* The MAC only looks at the tag of authenticated frames */
+    if(CAN_XR_Auth_Policy_MAC_Len(
+           queue->mac->policy,
+           CAN_XR_Auth_Policy_Key(identifier, CAN_XR_Format_Is_Extended(format)), dlc))
+    {
+        memcpy(req.data_mac, data_mac, sizeof(req.data_mac));
+    }
+
+    if(!CAN_XR_SPSC_Put(&queue->req, &req))
+    {
+        TRACE(9, "CAN_XR_MAC_Queue_Data_Req: queue full (%lu)", (unsigned long)identifier);
+        return 0;
+    }
+
+    return 1;
+}
+
+void CAN_XR_MAC_Queue_Flush_Auth(struct CAN_XR_MAC_Queue *queue)
+{
+    /* .req.tail is exact on the producer side */
+    queue->flush_tail = queue->req.tail;
+    __atomic_store_n(&queue->flush_req, queue->flush_req + 1, __ATOMIC_RELEASE);
+}
+
+const struct CAN_XR_MAC_Rx_Frame *CAN_XR_MAC_Queue_Rx_Frame(
+    struct CAN_XR_MAC_Queue *queue)
+{
+    return (const struct CAN_XR_MAC_Rx_Frame *)CAN_XR_SPSC_Peek(&queue->rx);
+}
+
+void CAN_XR_MAC_Queue_Rx_Release(struct CAN_XR_MAC_Queue *queue)
+{
+    CAN_XR_SPSC_Release(&queue->rx);
+}
+
+int CAN_XR_MAC_Queue_Dispatch(struct CAN_XR_MAC_Queue *queue)
+{
+    struct CAN_XR_MAC_Rx_Frame *frame;
+    struct CAN_XR_MAC_Queue_Event event;
+    int n = 0;
+
+    /* The upcall looks at the frame in place, in its slot */
+    while((frame = CAN_XR_SPSC_Peek(&queue->rx)) != NULL)
+    {
+        if(queue->data_ind)
+        {
+            queue->data_ind((struct CAN_XR_LLC *)queue, frame->ts,
+                            frame->identifier, frame->format, frame->dlc, frame->data);
+        }
+
+        CAN_XR_SPSC_Release(&queue->rx);
+        n++;
+    }
+
+    while(CAN_XR_SPSC_Get(&queue->event, &event))
+    {
+        if(queue->data_conf)
+        {
+            queue->data_conf((struct CAN_XR_LLC *)queue, event.ts,
+                             event.identifier, event.transmission_status);
+        }
+
+        n++;
+    }
+
+    return n;
+}
+
+/* Bit engine side of CAN_XR_MAC_Queue_Flush_Auth().  No request is
+   handed to the MAC while a flush is pending, so the ones made before
+   it are still queued, up to .flush_tail.  They are marked in place,
+   in slots the producer does not reuse before they are consumed.
+*/
+static void flush_auth(struct CAN_XR_MAC_Queue *queue)
+{
+    uint32_t i;
+
+    CAN_XR_MAC_Flush_Auth(queue->mac);
+
+    for(i = queue->req.head; i != queue->flush_tail; i++)
+    {
+        struct CAN_XR_MAC_Queue_Req *req = &queue->req_buf[i & queue->req.mask];
+
+        if(CAN_XR_Auth_Policy_MAC_Len(
+               queue->mac->policy,
+               CAN_XR_Auth_Policy_Key(req->identifier, CAN_XR_Format_Is_Extended(req->format)),
+               req->dlc))
+        {
+            req->flushed = 1;
+        }
+    }
+}
+
+int CAN_XR_MAC_Queue_NodeClock_Ind(struct CAN_XR_PCS *pcs)
+{
+    struct CAN_XR_MAC *mac = pcs->mac;
+    struct CAN_XR_MAC_Queue *queue = QUEUE(mac->llc);
+    struct CAN_XR_MAC_Queue_Req req;
+    uint32_t flush_req = __atomic_load_n(&queue->flush_req, __ATOMIC_ACQUIRE);
+
+    /* A flush waits for the transmit automaton to be idle, when no
+       mailbox is on the bus.
+    */
+    if(flush_req != queue->flush_done)
+    {
+        if(mac->state.tx_fsm_state != CAN_XR_MAC_TX_FSM_IDLE)
+            return 0;
+
+        flush_auth(queue);
+        queue->flush_done = flush_req;
+    }
+
+    /* One request per nodeclock, as long as the MAC has a free
+       mailbox for it.
+    */
+    if(mac->state.mailbox_full != CAN_XR_MAC_MAILBOX_ALL &&
+       CAN_XR_SPSC_Get(&queue->req, &req) && !req.flushed)
+    {
+        CAN_XR_MAC_Data_Req(mac, req.identifier, req.format, req.dlc, req.data, req.data_mac);
+    }
+
+    return 0;
+}
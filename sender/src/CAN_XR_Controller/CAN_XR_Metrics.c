@@ -0,0 +1,90 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Metrics registry of the node, see CAN_XR_Metrics.h. */
+
+#include <CAN_XR_Metrics.h>
+
+struct CAN_XR_Metrics CAN_XR_Metrics_Data;
+
+static const char *const metric_name[CAN_XR_METRICS] = {
+    "rx_frames", "tx_frames", "tx_attempts", "arbitration_lost",
+    "bit_errors", "stuff_errors", "form_errors", "crc_errors",
+    "ack_errors", "auth_ok", "auth_fail", "nonce_cache_hits",
+    "nonce_cache_misses", "resyncs", "overruns", "late_tags",
+    "nonce_delta", "work_queue", "auth_fail_run"
+};
+
+uint32_t CAN_XR_Metrics_Get(enum CAN_XR_Metric metric)
+{
+    return __atomic_load_n(&CAN_XR_Metrics_Data.value[metric], __ATOMIC_RELAXED);
+}
+
+void CAN_XR_Metrics_Clear(enum CAN_XR_Metric metric)
+{
+    int m;
+
+    for(m = 0; m < CAN_XR_METRICS; m++)
+    {
+        if(metric == CAN_XR_METRICS || m == (int)metric)
+            __atomic_store_n(&CAN_XR_Metrics_Data.value[m], 0, __ATOMIC_RELAXED);
+    }
+}
+
+void CAN_XR_Metrics_Snapshot(struct CAN_XR_Metrics_Snapshot *s)
+{
+    int m;
+
+    for(m = 0; m < CAN_XR_METRICS; m++)
+        s->value[m] = CAN_XR_Metrics_Get(m);
+}
+
+int CAN_XR_Metrics_Pack(const struct CAN_XR_Metrics_Snapshot *s,
+                        int first, uint8_t *buf, int len)
+{
+    int m, n = 0;
+
+    for(m = first; m < CAN_XR_METRICS && len >= 4; m++, n++, len -= 4)
+    {
+        *buf++ = (uint8_t)s->value[m];
+        *buf++ = (uint8_t)(s->value[m] >> 8);
+        *buf++ = (uint8_t)(s->value[m] >> 16);
+        *buf++ = (uint8_t)(s->value[m] >> 24);
+    }
+
+    return n;
+}
+
+const char *CAN_XR_Metrics_Name(enum CAN_XR_Metric metric)
+{
+    return (metric < CAN_XR_METRICS) ? metric_name[metric] : "?";
+}
+
+void CAN_XR_Metrics_Dump(FILE *f, const struct CAN_XR_Metrics_Snapshot *s)
+{
+    int m;
+
+    for(m = 0; m < CAN_XR_METRICS; m++)
+        fprintf(f, "%-20s %10lu%s\n", metric_name[m],
+                (unsigned long)s->value[m],
+                (m >= CAN_XR_METRIC_FIRST_GAUGE) ? " (gauge)" : "");
+}
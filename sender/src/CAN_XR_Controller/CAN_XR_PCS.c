@@ -35,16 +35,25 @@
 #include <stdlib.h>
 #include <CAN_XR_PMA.h>
 #include <CAN_XR_PCS.h>
+#define CAN_XR_TRACE_MODULE PCS
 #include <CAN_XR_Trace.h>
+#include <CAN_XR_Profile.h>
 #include <LED_Config.h>
 
+/* Number of time quanta in a bit, [1] 11.3.1.1. */
+static int quanta_per_bit(
+    const struct CAN_XR_PCS_Bit_Time_Parameters *parameters)
+{
+    return parameters->sync_seg + parameters->prop_seg
+        + parameters->phase_seg1 + parameters->phase_seg2;
+}
+
 /* Initialize PCS state. */
 static void init_state(struct CAN_XR_PCS *pcs)
 {
     /* State information derived from parameters */
-    pcs->state.quanta_per_bit =
-	pcs->parameters.sync_seg + pcs->parameters.prop_seg
-	+ pcs->parameters.phase_seg1 + pcs->parameters.phase_seg2;
+    pcs->state.quanta_per_bit = quanta_per_bit(&pcs->parameters);
+    pcs->state.data_phase = 0;
 
     /* Fixed state information */
     pcs->state.nodeclock_ts = (unsigned long)0;
@@ -237,7 +246,9 @@ static void quantumclock_m_ind(
     {
         if(pcs->primitives.data_ind)
         {
+            PROFILE_ENTER(CAN_XR_PROFILE_MAC);
             pcs->primitives.data_ind(pcs->mac, ts, bus_level);
+            PROFILE_EXIT(CAN_XR_PROFILE_MAC);
         }
 
         /* Per [1] 11.3.2.1 a) reset sync_inhibit when the bus state
@@ -295,7 +306,9 @@ static void nodeclock_ind(struct CAN_XR_PCS *pcs, int bus_level)
     if(pcs->state.prescaler_m_cnt == 0)
     {
         /* At m quantum edge */
+        PROFILE_ENTER(CAN_XR_PROFILE_PCS);
         quantumclock_m_ind(pcs, pcs->state.nodeclock_ts, bus_level);
+        PROFILE_EXIT(CAN_XR_PROFILE_PCS);
     }
 
 }
@@ -312,6 +325,8 @@ void CAN_XR_PCS_Init(
     pcs->pma = pma;
 
     pcs->parameters = *parameters; /* Copy, just in case. */
+    pcs->nominal_parameters = *parameters;
+    pcs->data_parameters = *parameters;
 
     init_state(pcs); /* May use parameters */
 
@@ -324,6 +339,13 @@ void CAN_XR_PCS_Init(
     CAN_XR_PMA_Set_NodeClock_Ind(pma, nodeclock_ind);
 }
 
+void CAN_XR_PCS_Set_Data_Bit_Time(
+    struct CAN_XR_PCS *pcs,
+    const struct CAN_XR_PCS_Bit_Time_Parameters *parameters)
+{
+    pcs->data_parameters = *parameters;
+}
+
 void CAN_XR_PCS_Set_MAC(struct CAN_XR_PCS *pcs, struct CAN_XR_MAC *mac)
 {
     pcs->mac = mac;
@@ -354,3 +376,23 @@ void CAN_XR_PCS_Disable_Sync(
 {
     pcs->state.sync_disabled = sync_disabled;
 }
+
+void CAN_XR_PCS_Bit_Rate_Switch_Req(
+    struct CAN_XR_PCS *pcs, int data_phase)
+{
+    if(data_phase == pcs->state.data_phase)
+        return;
+
+    pcs->state.data_phase = data_phase;
+    pcs->parameters =
+        data_phase ? pcs->data_parameters : pcs->nominal_parameters;
+    pcs->state.quanta_per_bit = quanta_per_bit(&pcs->parameters);
+
+    /* We are at the sample point, the quantum counter is brought to
+       the sample point of the new bit time.  The prescaler counter is
+       at zero, so the next quantum already has the new length.
+    */
+    pcs->state.quantum_m_cnt =
+        pcs->parameters.sync_seg + pcs->parameters.prop_seg
+        + pcs->parameters.phase_seg1 - 1;
+}
@@ -0,0 +1,176 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Signing pipeline of the sender, see CAN_XR_Signer.h.
+
+   Errors are emitted at TRACE level 9.
+*/
+
+#include <string.h>
+#include <CAN_XR_Config.h>
+#include <CAN_XR_Signer.h>
+#define CAN_XR_TRACE_MODULE BPMAC
+#include <CAN_XR_Trace.h>
+
+/* Compute the tag of 'identifier' and 'len' bytes of 'data' with
+   'ctx' into 'tag', then advance 'nonce'.  The identifier is covered
+   by the MAC, all 29 bits of it in CEFF.
+*/
+static void sign(bpmac_ctx_t *ctx, uint64_t nonce[2],
+                 uint32_t identifier, enum CAN_XR_Format format,
+                 const uint8_t *data, int len, uint8_t *tag)
+{
+    bpmac_pre(ctx, (uint8_t *) nonce, (char *) tag);
+    bpmac_update_id(ctx, identifier,
+                    (format == CAN_XR_FORMAT_CEFF) ? 29 : 11, (char *) tag);
+    bpmac_sign(ctx, (char *) data, len, (char *) tag);
+    if (++nonce[0] == 0)
+    {
+        nonce[1]++;
+    }
+}
+
+void CAN_XR_Signer_Init(
+    struct CAN_XR_Signer *signer, const struct CAN_XR_Auth_Policy *policy,
+    const uint8_t *grp_key, const uint8_t *grp_key_nonce,
+    const uint8_t *src_key, const uint8_t *src_key_nonce)
+{
+    signer->policy = policy;
+
+    bpmac_init((char *) grp_key, (char *) grp_key_nonce, CAN_XR_AUTH_MSG_MAX_SIZE, &signer->ctx_grp);
+    bpmac_init((char *) src_key, (char *) src_key_nonce, CAN_XR_AUTH_MSG_MAX_SIZE, &signer->ctx_src);
+    memset(signer->nonce_grp, 0, sizeof(signer->nonce_grp));
+    memset(signer->nonce_src, 0, sizeof(signer->nonce_src));
+
+    CAN_XR_SPSC_Init(&signer->ready, signer->ready_buf,
+                     sizeof(signer->ready_buf[0]), CAN_XR_SIGNER_LEN);
+    CAN_XR_Signer_Flush(signer);
+}
+
+int CAN_XR_Signer_Sign(
+    struct CAN_XR_Signer *signer,
+    uint32_t identifier, enum CAN_XR_Format format, int len, const uint8_t *data)
+{
+    const struct CAN_XR_Auth_Rule *rule = CAN_XR_Auth_Policy_Rule(
+        signer->policy,
+        CAN_XR_Auth_Policy_Key(identifier, format == CAN_XR_FORMAT_CEFF));
+    struct CAN_XR_Signer_Frame frame;
+    int mac_len = 0;
+
+    if (CAN_XR_SPSC_Count(&signer->ready) == CAN_XR_SIGNER_LEN)
+        return 0;
+
+    /* aggregated mode: fixed payload length, one checkpoint with the
+       full MAC every rule->aggregate frames */
+    uint8_t *agg = NULL;
+    int checkpoint = 1;
+
+    if (rule && rule->aggregate)
+    {
+        agg = signer->agg_mac[rule - signer->policy->rule];
+        checkpoint = (signer->agg_cnt[rule - signer->policy->rule] + 1 == rule->aggregate);
+        mac_len = checkpoint ? rule->mac_len : rule->mac_len_short;
+        if (len != rule->payload_len)
+        {
+            TRACE(9, "CAN_XR_Signer_Sign: aggregated payload must be %d bytes (%d)", rule->payload_len, len);
+            return 0;
+        }
+    }
+    else if (rule)
+    {
+        mac_len = rule->mac_len;
+    }
+
+    if (len < 1 || len + mac_len > 8)
+    {
+        TRACE(9, "CAN_XR_Signer_Sign: frame does not fit (%d + %d)", len, mac_len);
+        return 0;
+    }
+
+    frame.identifier = identifier;
+    frame.format = format;
+    frame.dlc = len + mac_len;
+    memset(frame.data, 0, sizeof(frame.data));
+    memcpy(frame.data, data, len);
+    memset(frame.data_mac, 0, sizeof(frame.data_mac));
+
+    if (rule)
+    {
+        uint8_t src_mac[16] = {0};
+
+#if CAN_XR_NONCE_HINT_BITS > 0
+        frame.data[0] = CAN_XR_NONCE_HINT(signer->nonce_src[0], signer->nonce_grp[0]);
+#endif
+
+        /* GROUP MAC, SOURCE MAC */
+        sign(&signer->ctx_grp, signer->nonce_grp, identifier, format, frame.data, len, frame.data_mac);
+        sign(&signer->ctx_src, signer->nonce_src, identifier, format, frame.data, len, src_mac);
+        xor_tags(frame.data_mac, src_mac);
+
+        if (agg)
+        {
+            if (checkpoint)
+            {
+                xor_tags(frame.data_mac, agg);
+                memset(agg, 0, 16);
+                signer->agg_cnt[rule - signer->policy->rule] = 0;
+            }
+            else
+            {
+                xor_tags(agg, frame.data_mac);
+                signer->agg_cnt[rule - signer->policy->rule]++;
+            }
+        }
+    }
+
+    return CAN_XR_SPSC_Put(&signer->ready, &frame);
+}
+
+int CAN_XR_Signer_Ready(struct CAN_XR_Signer *signer)
+{
+    return CAN_XR_SPSC_Count(&signer->ready);
+}
+
+int CAN_XR_Signer_Release(
+    struct CAN_XR_Signer *signer, struct CAN_XR_MAC_Queue *queue)
+{
+    struct CAN_XR_Signer_Frame frame;
+
+    /* Check first, the frame must not be lost */
+    if (CAN_XR_SPSC_Count(&queue->req) == CAN_XR_MAC_QUEUE_LEN
+        || !CAN_XR_SPSC_Get(&signer->ready, &frame))
+        return 0;
+
+    return CAN_XR_MAC_Queue_Data_Req(queue, frame.identifier, frame.format,
+                                     frame.dlc, frame.data, frame.data_mac);
+}
+
+void CAN_XR_Signer_Flush(struct CAN_XR_Signer *signer)
+{
+    struct CAN_XR_Signer_Frame frame;
+
+    while (CAN_XR_SPSC_Get(&signer->ready, &frame))
+        ;
+
+    memset(signer->agg_mac, 0, sizeof(signer->agg_mac));
+    memset(signer->agg_cnt, 0, sizeof(signer->agg_cnt));
+}
@@ -0,0 +1,124 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+
+/* Binary backend of TRACE, see CAN_XR_Trace.h.
+
+   The ring has many producers, the bit engine in the timer interrupt
+   and the foreground loop, which it may preempt at any point.  Each
+   producer reserves its record by an atomic increment of .tail, so
+   that it has nothing to share with the others, then fills it.  The
+   consumer is CAN_XR_Trace_Dump() and takes the records whose .seq
+   is the expected one both before and after copying them.
+*/
+
+#include <CAN_XR_Trace.h>
+
+#if defined(ENABLE_TRACE) && defined(ENABLE_TRACE_BINARY)
+
+#if (CAN_XR_TRACE_RECORDS & (CAN_XR_TRACE_RECORDS - 1)) != 0
+#error "CAN_XR_TRACE_RECORDS must be a power of two"
+#endif
+
+/* Provided by the linker, the can_xr_trace section holds the TRACE
+   formats.
+*/
+extern const char __start_can_xr_trace[];
+
+struct CAN_XR_Trace_Ring CAN_XR_Trace_Buffer;
+
+/* Header of CAN_XR_Trace_Dump(), followed by the records, with .args
+   arguments each, up to the end of the stream.  All in the byte order
+   of the board.
+*/
+struct dump_header
+{
+    char magic[4];      /* "CXTR" */
+    uint32_t args;
+};
+
+void CAN_XR_Trace_Init(void)
+{
+#ifdef __arm__
+    *(volatile uint32_t *)0xE000EDFC |= 1UL << 24;  /* DEMCR.TRCENA */
+    *(volatile uint32_t *)0xE0001004 = 0;           /* DWT_CYCCNT */
+    *(volatile uint32_t *)0xE0001000 |= 1UL;        /* DWT_CTRL.CYCCNTENA */
+#endif
+}
+
+void CAN_XR_Trace_Put(
+    int level, const char *format, const uint32_t *arg, int nargs)
+{
+    uint32_t pos = __atomic_fetch_add(&CAN_XR_Trace_Buffer.tail, 1, __ATOMIC_RELAXED);
+    struct CAN_XR_Trace_Record *r =
+        &CAN_XR_Trace_Buffer.record[pos & (CAN_XR_TRACE_RECORDS - 1)];
+    int i;
+
+    if(nargs > CAN_XR_TRACE_ARGS)
+        nargs = CAN_XR_TRACE_ARGS;
+
+    /* Invalidate the record before touching it */
+    __atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    r->ts = CAN_XR_TRACE_TIMESTAMP();
+    r->format = (uint32_t)(format - __start_can_xr_trace);
+    r->level = (uint8_t)level;
+    r->nargs = (uint8_t)nargs;
+    for(i = 0; i < nargs; i++)
+        r->arg[i] = arg[i];
+
+    __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+int CAN_XR_Trace_Dump(FILE *f)
+{
+    static const struct dump_header header = {
+        { 'C', 'X', 'T', 'R' }, CAN_XR_TRACE_ARGS
+    };
+    struct CAN_XR_Trace_Record r;
+    uint32_t tail = __atomic_load_n(&CAN_XR_Trace_Buffer.tail, __ATOMIC_ACQUIRE);
+    uint32_t pos = (tail > CAN_XR_TRACE_RECORDS) ? tail - CAN_XR_TRACE_RECORDS : 0;
+    int n = 0;
+
+    fwrite(&header, sizeof(header), 1, f);
+
+    for(; pos != tail; pos++)
+    {
+        const struct CAN_XR_Trace_Record *src =
+            &CAN_XR_Trace_Buffer.record[pos & (CAN_XR_TRACE_RECORDS - 1)];
+
+        if(__atomic_load_n(&src->seq, __ATOMIC_ACQUIRE) != pos + 1)
+            continue;
+        r = *src;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&src->seq, __ATOMIC_RELAXED) != pos + 1)
+            continue;
+
+        fwrite(&r, sizeof(r), 1, f);
+        n++;
+    }
+
+    return n;
+}
+
+#endif
@@ -0,0 +1,184 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Workload generator of the sender, see CAN_XR_Workload.h. */
+
+#include <CAN_XR_Workload.h>
+
+/* xorshift32, one state per stream.  The state is never 0. */
+static uint32_t prng_next(uint32_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+/* Uniform in [0, n), 0 if n is 0 */
+static unsigned long draw(uint32_t *x, unsigned long n)
+{
+    uint32_t r = prng_next(x);
+
+    return n ? r % n : 0;
+}
+
+/* First state of the PRNG of stream 'index', mixed so that nearby
+   seeds and indices give unrelated sequences.
+*/
+static uint32_t stream_seed(uint32_t seed, int index)
+{
+    uint32_t x = seed ^ ((uint32_t)(index + 1) * 0x9E3779B9u);
+
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    return x ? x : 1;
+}
+
+/* Longest payload of a frame with 'identifier' in 'format' that
+   leaves room for its data MAC.
+*/
+static int room(const struct CAN_XR_Workload *workload,
+                uint32_t identifier, enum CAN_XR_Format format)
+{
+    if(workload->policy == NULL)
+        return 8;
+    return 8 - CAN_XR_Auth_Policy_MAC_Len(
+        workload->policy,
+        CAN_XR_Auth_Policy_Key(identifier, format == CAN_XR_FORMAT_CEFF), 8);
+}
+
+static int draw_len(uint32_t *x, const struct CAN_XR_Workload_Stream *stream, int max)
+{
+    unsigned long total = 0, r;
+    int len;
+
+    for(len = 0; len <= max; len++)
+        total += stream->len_weight[len];
+    if(total == 0)
+        return 1 + (int) draw(x, max);
+
+    r = draw(x, total);
+    for(len = 0; r >= stream->len_weight[len]; len++)
+        r -= stream->len_weight[len];
+    return len;
+}
+
+/* Schedule the release after 'release' of stream 's', not before the
+   previous frame.
+*/
+static void schedule(struct CAN_XR_Workload *workload, int s, unsigned long release)
+{
+    const struct CAN_XR_Workload_Stream *stream = &workload->streams[s];
+
+    workload->state[s].release = release;
+    workload->state[s].due = release + draw(&workload->state[s].prng, stream->jitter + 1);
+    workload->state[s].left = stream->burst;
+    if((long)(workload->state[s].due - workload->now) < 0)
+        workload->state[s].due = workload->now;
+}
+
+int CAN_XR_Workload_Init(
+    struct CAN_XR_Workload *workload,
+    const struct CAN_XR_Workload_Stream *streams, int n_streams,
+    uint32_t seed, int saturate, const struct CAN_XR_Auth_Policy *policy)
+{
+    int s;
+
+    if(n_streams < 1 || n_streams > CAN_XR_WORKLOAD_STREAMS)
+        return -1;
+
+    for(s = 0; s < n_streams; s++)
+    {
+        const struct CAN_XR_Workload_Stream *stream = &streams[s];
+        uint32_t last = (stream->format == CAN_XR_FORMAT_CEFF) ? 0x1FFFFFFF : 0x7FF;
+
+        if((stream->format != CAN_XR_FORMAT_CBFF && stream->format != CAN_XR_FORMAT_CEFF)
+            || stream->identifiers < 1 || stream->identifier > last
+            || stream->identifiers - 1 > last - stream->identifier
+            || stream->period < 1 || stream->jitter >= stream->period
+            || stream->burst < 1)
+            return -1;
+    }
+
+    workload->streams = streams;
+    workload->n_streams = n_streams;
+    workload->seed = seed;
+    workload->saturate = saturate;
+    workload->policy = policy;
+    CAN_XR_Workload_Reset(workload);
+    return 0;
+}
+
+void CAN_XR_Workload_Reset(struct CAN_XR_Workload *workload)
+{
+    int s;
+
+    workload->now = 0;
+    for(s = 0; s < workload->n_streams; s++)
+    {
+        workload->state[s].prng = stream_seed(workload->seed, s);
+        schedule(workload, s, workload->streams[s].phase);
+    }
+}
+
+void CAN_XR_Workload_Next(
+    struct CAN_XR_Workload *workload, struct CAN_XR_Workload_Frame *frame)
+{
+    const struct CAN_XR_Workload_Stream *stream;
+    uint32_t *x;
+    int s, next = 0, i;
+
+    /* Earliest release, relative to the previous frame, which is
+       never later than any of them.  This keeps working when the
+       nodeclock count wraps around.
+    */
+    for(s = 1; s < workload->n_streams; s++)
+    {
+        if(workload->state[s].due - workload->now < workload->state[next].due - workload->now)
+            next = s;
+    }
+
+    stream = &workload->streams[next];
+    x = &workload->state[next].prng;
+
+    frame->identifier = stream->identifier + (uint32_t) draw(x, stream->identifiers);
+    frame->format = stream->format;
+    frame->len = draw_len(x, stream, room(workload, frame->identifier, frame->format));
+    for(i = 0; i < 8; i += 4)
+    {
+        uint32_t r = prng_next(x);
+
+        frame->data[i] = (uint8_t) r;
+        frame->data[i + 1] = (uint8_t)(r >> 8);
+        frame->data[i + 2] = (uint8_t)(r >> 16);
+        frame->data[i + 3] = (uint8_t)(r >> 24);
+    }
+    frame->stream = next;
+    frame->gap = workload->saturate ? 0 : workload->state[next].due - workload->now;
+
+    workload->now = workload->state[next].due;
+    if(--workload->state[next].left == 0)
+        schedule(workload, next, workload->state[next].release + stream->period);
+}
@@ -51,8 +51,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <CAN_XR_PMA_GPIO.h>
+#define CAN_XR_TRACE_MODULE PMA
 #include <CAN_XR_Trace.h>
+#include <CAN_XR_Profile.h>
 #include <LED_Config.h>
 
 
@@ -96,6 +99,18 @@
 #define T0TC		REG32(0x40004008)
 #define T0PC		REG32(0x40004010)
 
+#define T0IR		REG32(0x40004000)
+#define T0IR_MR0                 0x1
+
+#define T0MR0		REG32(0x40004018)
+#define T0MCR_MR0I               0x1
+#define T0MCR_MR0R               0x2
+
+/* NVIC registers (UM 10360 p.75) */
+#define NVIC_ISER0	REG32(0xE000E100)
+#define NVIC_IPR0	REG32(0xE000E400)
+#define TIMER0_IRQN              1
+
 /* FreeRTOS knows better what's the CCLK frequency.  In our
    configuration, Timer 0 is driven directly by CCLK.
 */
@@ -239,10 +254,19 @@ void CAN_XR_PMA_GPIO_Init(struct CAN_XR_PMA *pma, int prescaler)
     /* Set up nodeclock for use. */
     setup_ts(prescaler);
 
+    /* Timer 0 counts CCLK periods, a nodeclock period lasts
+       'prescaler' cycles.
+    */
+    PROFILE_INIT(prescaler);
+
     pma->primitives.nodeclock_ind = NULL; /* Set by upper layer. */
     pma->primitives.data_req = data_req;
+    pma->primitives.state_ind = NULL; /* Set by the MAC. */
+    memset(&pma->overrun, 0, sizeof(pma->overrun));
 
     pma->state.gpio.app_nodeclock_ind = NULL;
+    pma->state.gpio.prescaler = prescaler;
+    pma->state.gpio.nodeclocks = 0;
 }
 
 void CAN_XR_PMA_GPIO_Set_App_NodeClock_Ind(
@@ -253,7 +277,7 @@ void CAN_XR_PMA_GPIO_Set_App_NodeClock_Ind(
 
 void CAN_XR_PMA_GPIO_NodeClock_Ind(struct CAN_XR_PMA *pma)
 {
-    uint32_t x;
+    uint32_t x, now;
 
     TRACE(0, "CAN_XR_PMA_GPIO_NodeClock_Ind");
 
@@ -266,9 +290,12 @@ void CAN_XR_PMA_GPIO_NodeClock_Ind(struct CAN_XR_PMA *pma)
     {
         /* Synchronize with TIMER0, which is the source of nodeclock */
         while(x == read_ts());
+        PROFILE_ENTER(CAN_XR_PROFILE_PMA);
+
         /* Sample bus level and generate a nodeclock indication for
            the upper layer.  We assume that the whole chain of
-           indication callbacks takes less than one nodeclock period.
+           indication callbacks takes less than one nodeclock period,
+           the check below tells when it does not.
         */
         if(pma->primitives.nodeclock_ind)
         {
@@ -285,7 +312,92 @@ void CAN_XR_PMA_GPIO_NodeClock_Ind(struct CAN_XR_PMA *pma)
             }
         }
 
+        PROFILE_EXIT(CAN_XR_PROFILE_PMA);
+        PROFILE_PERIOD();
         x++;
 
+        /* Timer 0 must not have advanced past the tick just handled,
+           otherwise the chain of indication callbacks took longer
+           than one nodeclock period.  The ticks in between are not
+           skipped, they are replayed late, back to back, with the bus
+           level sampled at the wrong time.
+        */
+        now = read_ts();
+        if(now != x)
+            CAN_XR_PMA_Overrun(pma, now, now - x);
     }
 }
+
+/* PMA started by CAN_XR_PMA_GPIO_Start() */
+static struct CAN_XR_PMA *irq_pma;
+
+/* Timer 0 interrupt handler, invoked once per nodeclock period.  It
+   replaces the body of the loop of CAN_XR_PMA_GPIO_NodeClock_Ind().
+   Here, Timer 0 is not read, the interrupt itself is the time
+   reference.  The whole chain of indication callbacks must still take
+   less than one nodeclock period, but an overrun only delays the next
+   interrupt instead of accumulating.
+*/
+void TIMER0_IRQHandler(void)
+{
+    struct CAN_XR_PMA *pma = irq_pma;
+
+    /* Sample as early as possible, to keep jitter low */
+    int bus_level = gpio_rx_pin();
+
+    PROFILE_ENTER(CAN_XR_PROFILE_PMA);
+
+    T0IR = T0IR_MR0;
+    pma->state.gpio.nodeclocks++;
+
+    if(pma->primitives.nodeclock_ind)
+    {
+        pma->primitives.nodeclock_ind(pma->pcs, bus_level);
+    }
+
+    if(pma->state.gpio.app_nodeclock_ind)
+    {
+        pma->state.gpio.app_nodeclock_ind(pma->pcs);
+    }
+
+    /* The next match already occurred, the chain of indication
+       callbacks took longer than one nodeclock period.  The interrupt
+       is still pending and will run late, the ticks beyond it are
+       lost.  Only one is counted, there is no telling how many.
+    */
+    if(T0IR & T0IR_MR0)
+        CAN_XR_PMA_Overrun(pma, pma->state.gpio.nodeclocks, 1);
+
+    PROFILE_EXIT(CAN_XR_PROFILE_PMA);
+    PROFILE_PERIOD();
+}
+
+void CAN_XR_PMA_GPIO_Start(struct CAN_XR_PMA *pma)
+{
+    TRACE(0, "CAN_XR_PMA_GPIO_Start");
+
+    irq_pma = pma;
+
+    /* Reprogram Timer 0 so that it counts CCLK periods and matches
+       (then resets) once per nodeclock period.  Timestamps are no
+       longer available through read_ts() in this mode.
+    */
+    T0TCR = T0TCR_RESET;
+    T0PR = 0;
+    T0MR0 = pma->state.gpio.prescaler - 1;
+    T0MCR = T0MCR_MR0I | T0MCR_MR0R;
+    T0IR = T0IR_MR0;
+
+    /* Highest priority, then enable */
+    NVIC_IPR0 &= ~(0xFF << (8 * TIMER0_IRQN));
+    NVIC_ISER0 = 1 << TIMER0_IRQN;
+
+    T0TCR = T0TCR_ENABLE;
+
+    TRACE(0, ">>> Nodeclock interrupt enabled");
+}
+
+unsigned long CAN_XR_PMA_GPIO_NodeClocks(struct CAN_XR_PMA *pma)
+{
+    return pma->state.gpio.nodeclocks;
+}
@@ -34,7 +34,12 @@
 #include <CAN_XR_PMA_GPIO.h>
 #include <CAN_XR_PCS.h>
 #include <CAN_XR_MAC.h>
+#include <CAN_XR_MAC_Queue.h>
+#include <CAN_XR_Signer.h>
+#include <CAN_XR_Workload.h>
 #include <CAN_XR_Trace.h>
+#include <CAN_XR_Metrics.h>
+#include <CAN_XR_Capture.h>
 #include <aes.h>
 
 //#include "bpmac.h"
@@ -67,23 +72,80 @@ const struct CAN_XR_PCS_Bit_Time_Parameters pcs_parameters = {
 struct CAN_XR_MAC mac;
 struct CAN_XR_PCS pcs;
 struct CAN_XR_PMA pma;
+struct CAN_XR_MAC_Queue queue;
 // MAC stuff
-bpmac_ctx_t ctx_grp;
-bpmac_ctx_t ctx_src;
-uint64_t nonce_src[2] = {0, 0};
-uint64_t nonce_grp[2] = {0, 0};
+struct CAN_XR_Signer signer;   /* bpmac contexts, nonces and frames signed ahead of time */
 uint8_t grp_key[] = {0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00};
 uint8_t grp_key_nonce[] = {0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF};
 uint8_t src_key[] = {0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07};
 uint8_t src_key_nonce[] = {0x22, 0x11, 0x27, 0x09, 0x22, 0x11, 0x27, 0x09, 0x22, 0x11, 0x27, 0x09 ,0x22, 0x11, 0x27, 0x09};
 
+/* Workload, see CAN_XR_Workload.h.  By default, one frame every
+   APP_TASK_PERIOD nodeclocks, with an identifier in [0, 255] and a
+   payload from 1 byte to the longest that leaves room for the data
+   MAC.  -DWORKLOAD_MIX gives streams with their own periods, jitter
+   and lengths, -DWORKLOAD_BURST bursts of 16 frames over a periodic
+   stream, and -DWORKLOAD_SATURATE sends the frames of any of them
+   back to back.  The same WORKLOAD_SEED gives the same frames, with
+   the same timing, on every run.
+*/
+#ifndef WORKLOAD_SEED
+#define WORKLOAD_SEED 1
+#endif
+
+#ifdef WORKLOAD_SATURATE
+#define WORKLOAD_SATURATING 1
+#else
+#define WORKLOAD_SATURATING 0
+#endif
+
+#define APP_TASK_PERIOD 60000   // approx. one message every ~ 20 ms @ 40kbs
+#define NODECLOCKS_PER_MS (CAN_XR_BIT_RATE * 8 / 1000)  /* 8 quanta per bit, see pcs_parameters */
+
+/* identifier, identifiers, format, period, phase, jitter, burst, len_weight */
+const struct CAN_XR_Workload_Stream workload_streams[] = {
+#if defined(WORKLOAD_MIX)
+    { 0x010, 1, CAN_XR_FORMAT_CBFF, 20 * NODECLOCKS_PER_MS, 0, NODECLOCKS_PER_MS, 1,
+      { 0, 0, 0, 0, 0, 1 } },
+    { 0x020, 8, CAN_XR_FORMAT_CBFF, 50 * NODECLOCKS_PER_MS, 0, 5 * NODECLOCKS_PER_MS, 1,
+      { 0, 1, 1, 1, 1, 1 } },
+    { 0x080, 1, CAN_XR_FORMAT_CBFF, 100 * NODECLOCKS_PER_MS, 7 * NODECLOCKS_PER_MS, 0, 4,
+      { 0, 0, 1, 0, 2 } },
+    { 0x0F0, 1, CAN_XR_FORMAT_CBFF, 1000 * NODECLOCKS_PER_MS, 0, 0, 1,
+      { 0, 1 } },
+#elif defined(WORKLOAD_BURST)
+    { 0x010, 1, CAN_XR_FORMAT_CBFF, 20 * NODECLOCKS_PER_MS, 0, NODECLOCKS_PER_MS, 1,
+      { 0, 0, 0, 0, 0, 1 } },
+    { 0x040, 16, CAN_XR_FORMAT_CBFF, 500 * NODECLOCKS_PER_MS, 0, 0, 16,
+      { 0 } },
+#else
+    { 0x000, 256, CAN_XR_FORMAT_CBFF, APP_TASK_PERIOD, 0, 0, 1,
+      { 0 } },
+#endif
+};
+
+struct CAN_XR_Workload workload;
+
+/* Gap of each frame in the ready ring of 'signer' to the previous
+   one, in the same order.
+*/
+unsigned long ready_gap[CAN_XR_SIGNER_LEN];
+unsigned int gaps_signed = 0, gaps_released = 0;
+unsigned long gap_carry = 0;    /* Of frames that could not be signed */
+unsigned long last_release = 0; /* Nodeclock of the previous release, gaps included */
+
 // EVAL stuff
-uint64_t transmission_attempts = 0;
-uint8_t cnt_transmission_attempts = 1;
+#ifndef EVAL_ROUND
+#define EVAL_ROUND 10000        /* Messages per evaluation round */
+#endif
+#ifndef EVAL_LIMIT
+#define EVAL_LIMIT 1001000      /* Messages after which the sender stops */
+#endif
+
+uint64_t transmission_attempts = 0;     /* CAN_XR_METRIC_TX_ATTEMPTS when the end of round signal was sent */
 uint16_t transmission_state = 0;
 
 int signal_cnt = 5;
-int msg_limit = 1001000;
 int msg_cnt = 0;
 
 void dummy_data_ind(
@@ -93,15 +155,17 @@ void dummy_data_ind(
     switch (identifier) {
         case 384:   /* nonce reset, triggered by one receiver */
             led_on(led3);
-            nonce_src[1] = (nonce_src[1] & ~((uint64_t) 0xffffff)) + 0x1000000;
-            nonce_src[0] = 0;
-            nonce_grp[1] = (nonce_grp[1] & ~((uint64_t) 0xffffff)) + 0x1000000;
-            nonce_grp[0] = 0;
+            signer.nonce_src[1] = (signer.nonce_src[1] & ~((uint64_t) 0xffffff)) + 0x1000000;
+            signer.nonce_src[0] = 0;
+            signer.nonce_grp[1] = (signer.nonce_grp[1] & ~((uint64_t) 0xffffff)) + 0x1000000;
+            signer.nonce_grp[0] = 0;
+            CAN_XR_Signer_Flush(&signer);   /* frames signed ahead with the old nonces */
+            CAN_XR_MAC_Queue_Flush_Auth(&queue);    /* and those already released to the MAC */
+            gaps_released = gaps_signed;
             transmission_state = 385;
             break;
 
         case 383:   /* (2) #correct received */
-            cnt_transmission_attempts = 0;
             transmission_state = 279;
             break;
 
@@ -111,10 +175,11 @@ void dummy_data_ind(
 
         case 418:   /* (5) continue received */
             transmission_attempts = 0;
+            CAN_XR_Metrics_Clear(CAN_XR_METRIC_TX_ATTEMPTS);
             signal_cnt = 5;
-            cnt_transmission_attempts = 1;
             transmission_state = 0;
             msg_cnt = 0;
+            last_release = CAN_XR_PMA_GPIO_NodeClocks(&pma);    /* no catching up on the pause */
             break;
 
         default:
@@ -134,166 +199,190 @@ void dummy_data_conf(
     }
 }
 
-/* This indication is generated by the GPIO PMA on every nodeclock
-   cycle and can be used to trigger requests at the application layer
-   (which at this time is layered directly upon the MAC).
+/* Sign the next frame of 'workload' and add it to the ready ring
+   of 'signer'.  Invoked by the foreground loop whenever there is
+   room, so that release_due() finds frames already signed.
+*/
+void sign_ahead(void)
+{
+    struct CAN_XR_Workload_Frame frame;
+    const struct CAN_XR_Auth_Rule *rule;
+    uint8_t len;
+    uint64_t data = 0;
+
+    CAN_XR_Workload_Next(&workload, &frame);
+    gap_carry += frame.gap;
+
+    uint32_t key = CAN_XR_Auth_Policy_Key(frame.identifier, frame.format == CAN_XR_FORMAT_CEFF);
+    rule = CAN_XR_Auth_Policy_Rule(mac.policy, key);
+    len = frame.len;
+    memcpy(&data, frame.data, sizeof(data));
+
+    /* aggregated mode: fixed payload length */
+    if (rule && rule->aggregate)
+    {
+        len = rule->payload_len;
+    }
+
+#if CAN_XR_NONCE_HINT_BITS > 0
+    uint8_t mac_len = CAN_XR_Auth_Policy_MAC_Len(mac.policy, key, 8);
 
-   This function is time-critical because PCS/bus synchronization
-   depends on the accuracy of the GPIO PMA cycle.  Please don't
-   printf() here unless there is an error.
+    /* the first payload byte is reserved for the nonce hint, followed by at least one random byte when
+     * the MAC leaves room for it */
+    if (rule && len < 8 - mac_len && !rule->aggregate)
+    {
+        len++;
+    }
+    if (rule)
+    {
+        data <<= 8;
+    }
+#endif
+
+    if (CAN_XR_Signer_Sign(&signer, frame.identifier, frame.format, len, (uint8_t *) &data))
+    {
+        ready_gap[gaps_signed++ % CAN_XR_SIGNER_LEN] = gap_carry;
+        gap_carry = 0;
+    }
+}
+
+/* Release the oldest ready frame to 'queue' once its gap to the
+   previous one has elapsed at nodeclock 'now'.  A release delayed by
+   a full queue does not delay the following ones.  Return 1 if a
+   frame has been queued.
 */
-int app_nodeclock_ind(
-    struct CAN_XR_PCS *pcs)
+int release_due(unsigned long now)
 {
+    unsigned long gap = ready_gap[gaps_released % CAN_XR_SIGNER_LEN];
 
-    static int msg_intervals = 1;
-
-    if (msg_intervals++ % 60000 == 0) {     // approx. one message every ~ 20 ms @ 40kbs
-        uint16_t id;
-        uint8_t data_mac[16] = {0};
-        uint64_t data = 0;
-
-        switch (transmission_state) {
-            case 0:     /* normal transmission */
-                if (msg_cnt == 10000)     /* (1) signalize 10k messages */
-                {
-                    uint8_t data = 0xFF;
-                    transmission_state = 999;
-                    cnt_transmission_attempts = 0;
-                    CAN_XR_MAC_Data_Req(&mac, 555, CAN_XR_FORMAT_CBFF, 1, &data, &data);
-                    return 1;
-                }
-                else if (msg_cnt < msg_limit)
-                {
-                    reset_leds();
-
-                    /* create random values */
-                    uint8_t len = (rand() % 5) + 1; /* random length in [1, 5] */
-                    data = rand();  /* random data */
-                    id = rand() % 256;  /* IDs > 256 reserved for signalling purposes and not authenticated */
-
-                    /* GROUP MAC */
-                    bpmac_pre(&ctx_grp, (uint8_t *) nonce_grp, (char *) data_mac);
-                    /* msg id is covert by MAC */
-                    for (int8_t i = 10; i >= 0; i--) {
-                        bpmac_update(&ctx_grp, (id & (1 << i)), (char *) data_mac);
-                    }
-                    bpmac_sign(&ctx_grp, (char *) &data, len, (char *) data_mac);
-                    if (++nonce_grp[0] == 0)
-                    {
-                        nonce_grp[1]++;
-                    }
-
-                    /* SOURCE MAC */
-                    uint8_t src_mac[16] = {0};
-                    bpmac_pre(&ctx_src, (uint8_t *) nonce_src, (char *) src_mac);
-                    for (int8_t i = 10; i >= 0; i--) {
-                        bpmac_update(&ctx_src, (id & (1 << i)), (char *) src_mac);
-                    }
-                    bpmac_sign(&ctx_src, (char *) &data, len, (char *) src_mac);
-                    if (++nonce_src[0] == 0)
-                    {
-                        nonce_src[1]++;
-                    }
-
-                    /* XOR MACS and send data */
-                    ((uint32_t *) data_mac)[0] ^= ((uint32_t *) src_mac)[0];
-                    CAN_XR_MAC_Data_Req(&mac, id, CAN_XR_FORMAT_CBFF, len + 3, (uint8_t *) &data, (uint8_t *) data_mac);
-                    msg_cnt++;
-                    return 1;
-                }
-
-            case 279:   /* (3) send #transmission attempts */
-                transmission_state = 999;
-                CAN_XR_MAC_Data_Req(&mac, 279, CAN_XR_FORMAT_CBFF, 8, (uint8_t *) &transmission_attempts,
-                                    (uint8_t *) &transmission_attempts);
-                led_set_all();
-                return 1;
+    if (CAN_XR_Signer_Ready(&signer) == 0 || now - last_release < gap)
+    {
+        return 0;
+    }
 
-            case 385:   /* send new nonce value to authenticator */
-                id = 385;
-                led_on(led1);
-                data = 0;
-                for (uint8_t i = 0; i < 5; i++)
-                {
-                    ((uint8_t *) &data)[i] = ((uint8_t *) &nonce_src[1])[i + 3];
-                }
-
-                /* one-to-one communication, thus single source MAC is sufficient */
-                bpmac_pre(&ctx_src, (uint8_t *) nonce_src, (char *) data_mac);
-                for (int8_t i = 10; i >= 0; i--) {
-                    bpmac_update(&ctx_src, (id & (1 << i)), (char *) data_mac);
-                }
-                bpmac_sign(&ctx_src, (char *) &data, 5, (char *) data_mac);
-                if (++nonce_src[0] == 0)
-                {
-                    nonce_src[1]++;
-                }
-
-                for (uint8_t i = 5; i < 8; i++)
-                {
-                    ((uint8_t *) &data)[i] = data_mac[i - 4];
-                }
-
-                CAN_XR_MAC_Data_Req(&mac, id, CAN_XR_FORMAT_CBFF, 8, (uint8_t *) &data, (uint8_t *) data_mac);
-
-                transmission_state = 200;
-                return 1;
+    if (CAN_XR_Signer_Release(&signer, &queue))
+    {
+        last_release += gap;
+        gaps_released++;
+        msg_cnt++;
+        return 1;
+    }
+    return 0;
+}
 
-            case 200:   /* send new nonce value to all receivers */
-                id = 200;
-                led_on(led2);
-                data = 0;
-                for (uint8_t i = 0; i < 5; i++)
-                {
-                    ((uint8_t *) &data)[i] = ((uint8_t *) &nonce_grp[1])[i + 3];
-                }
-
-                /* one-to-many communication and authenticator has updated, thus CAIBA secured */
-                /* GROUP MAC */
-                bpmac_pre(&ctx_grp, (uint8_t *) nonce_grp, (char *) data_mac);
-                for (int8_t i = 10; i >= 0; i--) {
-                    bpmac_update(&ctx_grp, (id & (1 << i)), (char *) data_mac);
-                }
-                bpmac_sign(&ctx_grp, (char *) &data, 5, (char *) data_mac);
-                if (++nonce_grp[0] == 0)
-                {
-                    nonce_grp[1]++;
-                }
-
-                /* SOURCE MAC */
-                uint8_t src_mac[16] = {0};
-                bpmac_pre(&ctx_src, (uint8_t *) nonce_src, (char *) src_mac);
-                for (int8_t i = 10; i >= 0; i--) {
-                    bpmac_update(&ctx_src, (id & (1 << i)), (char *) src_mac);
-                }
-                bpmac_sign(&ctx_src, (char *) &data, 5, (char *) src_mac);
-                if (++nonce_src[0] == 0)
-                {
-                    nonce_src[1]++;
-                }
-
-                ((uint32_t *) data_mac)[0] ^= ((uint32_t *) src_mac)[0];
-                CAN_XR_MAC_Data_Req(&mac, id, CAN_XR_FORMAT_CBFF, 8, (uint8_t *) &data, (uint8_t *) data_mac);
-                transmission_state = 0;
+/* Application task, invoked by the foreground loop in main() every
+   APP_TASK_PERIOD nodeclock cycles.  It is not time-critical: the bit
+   engine runs in the Timer 0 interrupt handler and frames are handed
+   over to it through 'queue', so computing MACs here does not steal
+   any time from it.  Regular frames are not even signed or released
+   here, see release_due().  Return 1 if a frame has been queued.
+*/
+int app_task(void)
+{
+    uint16_t id;
+    uint8_t data_mac[16] = {0};
+    uint64_t data = 0;
+
+    switch (transmission_state) {
+        case 0:     /* normal transmission */
+            if (msg_cnt == EVAL_ROUND)     /* (1) signalize end of round */
+            {
+                uint8_t data = 0xFF;
+                transmission_state = 999;
+                transmission_attempts = CAN_XR_Metrics_Get(CAN_XR_METRIC_TX_ATTEMPTS);
+                CAN_XR_MAC_Queue_Data_Req(&queue, 555, CAN_XR_FORMAT_CBFF, 1, &data, &data);
                 return 1;
-
-            default:
+            }
+            else if (msg_cnt < EVAL_LIMIT)
+            {
+                reset_leds();
                 return 0;
-        }
+            }
+
+        case 279:   /* (3) send #transmission attempts */
+            transmission_state = 999;
+            CAN_XR_MAC_Queue_Data_Req(&queue, 279, CAN_XR_FORMAT_CBFF, 8, (uint8_t *) &transmission_attempts,
+                                (uint8_t *) &transmission_attempts);
+            led_set_all();
+            return 1;
+
+        case 385:   /* send new nonce value to authenticator */
+            id = 385;
+            led_on(led1);
+            data = 0;
+            for (uint8_t i = 0; i < 5; i++)
+            {
+                ((uint8_t *) &data)[i] = ((uint8_t *) &signer.nonce_src[1])[i + 3];
+            }
+
+            /* one-to-one communication, thus single source MAC is sufficient */
+            bpmac_pre(&signer.ctx_src, (uint8_t *) signer.nonce_src, (char *) data_mac);
+            bpmac_update_id(&signer.ctx_src, id, 11, (char *) data_mac);
+            bpmac_sign(&signer.ctx_src, (char *) &data, 5, (char *) data_mac);
+            if (++signer.nonce_src[0] == 0)
+            {
+                signer.nonce_src[1]++;
+            }
+
+            for (uint8_t i = 5; i < 8; i++)
+            {
+                ((uint8_t *) &data)[i] = data_mac[i - 4];
+            }
+
+            CAN_XR_MAC_Queue_Data_Req(&queue, id, CAN_XR_FORMAT_CBFF, 8, (uint8_t *) &data, (uint8_t *) data_mac);
+
+            transmission_state = 200;
+            return 1;
+
+        case 200:   /* send new nonce value to all receivers */
+            id = 200;
+            led_on(led2);
+            data = 0;
+            for (uint8_t i = 0; i < 5; i++)
+            {
+                ((uint8_t *) &data)[i] = ((uint8_t *) &signer.nonce_grp[1])[i + 3];
+            }
+
+            /* one-to-many communication and authenticator has updated, thus CAIBA secured */
+            /* GROUP MAC */
+            bpmac_pre(&signer.ctx_grp, (uint8_t *) signer.nonce_grp, (char *) data_mac);
+            bpmac_update_id(&signer.ctx_grp, id, 11, (char *) data_mac);
+            bpmac_sign(&signer.ctx_grp, (char *) &data, 5, (char *) data_mac);
+            if (++signer.nonce_grp[0] == 0)
+            {
+                signer.nonce_grp[1]++;
+            }
+
+            /* SOURCE MAC */
+            uint8_t src_mac[16] = {0};
+            bpmac_pre(&signer.ctx_src, (uint8_t *) signer.nonce_src, (char *) src_mac);
+            bpmac_update_id(&signer.ctx_src, id, 11, (char *) src_mac);
+            bpmac_sign(&signer.ctx_src, (char *) &data, 5, (char *) src_mac);
+            if (++signer.nonce_src[0] == 0)
+            {
+                signer.nonce_src[1]++;
+            }
+
+            xor_tags(data_mac, src_mac);
+            CAN_XR_MAC_Queue_Data_Req(&queue, id, CAN_XR_FORMAT_CBFF, 8, (uint8_t *) &data, (uint8_t *) data_mac);
+            transmission_state = 0;
+            return 1;
 
+        default:
+            return 0;
     }
-    return 0;
 }
 
 
 
 int main(int argc, char *argv[])
 {
-    enable_leds();
+    unsigned long last_task = 0;
+#ifdef ENABLE_CAPTURE
+    int capture_sent = 0;
+#endif
 
-    bpmac_init((char *) grp_key, (char *) grp_key_nonce, 8, &ctx_grp);
-    bpmac_init((char *) src_key, (char *) src_key_nonce, 8, &ctx_src);
+    enable_leds();
 
     CAN_XR_PMA_GPIO_Init(&pma, GPIO_PRESCALER);
     CAN_XR_PCS_Init(&pcs, &pcs_parameters, &pma);
@@ -302,15 +391,80 @@ int main(int argc, char *argv[])
        function when there's one. */
     CAN_XR_MAC_Common_Init(&mac, &pcs);
 
-    /* Register app_nodeclock_ind to trigger the transmission */
-    CAN_XR_PMA_GPIO_Set_App_NodeClock_Ind(&pma, app_nodeclock_ind);
+    /* Accept only the signals dummy_data_ind looks at, the others,
+       our own authenticated frames included, are neither buffered nor
+       queued. */
+    CAN_XR_MAC_Set_Filter(&mac, 0, CAN_XR_FORMAT_CBFF, 384, 0x7FF);
+    CAN_XR_MAC_Set_Filter(&mac, 1, CAN_XR_FORMAT_CBFF, 383, 0x7FF);
+    CAN_XR_MAC_Set_Filter(&mac, 2, CAN_XR_FORMAT_CBFF, 525, 0x7FF);
+    CAN_XR_MAC_Set_Filter(&mac, 3, CAN_XR_FORMAT_CBFF, 418, 0x7FF);
+
+    CAN_XR_Signer_Init(&signer, mac.policy, grp_key, grp_key_nonce, src_key, src_key_nonce);
 
-    /* Register dummy data_ind and data_conf primitives in 'mac'. */
-    CAN_XR_MAC_Set_Data_Ind(&mac, dummy_data_ind);
+    if (CAN_XR_Workload_Init(&workload, workload_streams,
+                             sizeof(workload_streams) / sizeof(workload_streams[0]),
+                             WORKLOAD_SEED, WORKLOAD_SATURATING, mac.policy) < 0)
+    {
+        printf("Workload out of range\n");
+        return EXIT_FAILURE;
+    }
 
-    /* Start the controller, feeding it with nodeclock indications. */
+    /* Connect the MAC to the foreground loop, the queue feeds it with
+       transmission requests on every nodeclock cycle. */
+    CAN_XR_MAC_Queue_Init(&queue, &mac);
+    CAN_XR_PMA_GPIO_Set_App_NodeClock_Ind(&pma, CAN_XR_MAC_Queue_NodeClock_Ind);
+
+    /* Register dummy data_ind primitive in 'queue'. */
+    CAN_XR_MAC_Queue_Set_Data_Ind(&queue, dummy_data_ind);
+
+    /* Start the controller, feeding it with nodeclock indications
+       from the Timer 0 interrupt. */
+    TRACE_INIT();
     SET_TRACE_TRESHOLD(3);
-    CAN_XR_PMA_GPIO_NodeClock_Ind(&pma);
+
+    /* Stop the capture in the middle of the ring after the first bit
+       or stuff error */
+    CAPTURE_INIT(configCPU_CLOCK_HZ);
+    CAPTURE_TRIGGER(CAN_XR_CAPTURE_MASK(CAN_XR_CAPTURE_BIT_ERROR)
+                    | CAN_XR_CAPTURE_MASK(CAN_XR_CAPTURE_STUFF_ERROR),
+                    CAN_XR_CAPTURE_RECORDS / 2);
+
+    CAN_XR_PMA_GPIO_Start(&pma);
+
+    /* Foreground loop */
+    while (1)
+    {
+        CAN_XR_MAC_Queue_Dispatch(&queue);
+
+        /* Keep the ready ring full during normal transmission */
+        if (transmission_state == 0 && CAN_XR_Signer_Ready(&signer) < CAN_XR_SIGNER_LEN)
+        {
+            sign_ahead();
+        }
+
+        /* Release the frames as the workload dictates, up to the end
+           of the round */
+        if (transmission_state == 0 && msg_cnt < EVAL_ROUND && msg_cnt < EVAL_LIMIT)
+        {
+            release_due(CAN_XR_PMA_GPIO_NodeClocks(&pma));
+        }
+
+        if (CAN_XR_PMA_GPIO_NodeClocks(&pma) - last_task >= APP_TASK_PERIOD)
+        {
+            last_task += APP_TASK_PERIOD;
+            app_task();
+        }
+
+#ifdef ENABLE_CAPTURE
+        /* Send the capture around the trigger to the host, once,
+           see tools/capture_vcd.c */
+        if (!capture_sent && CAN_XR_Capture_Stopped())
+        {
+            CAN_XR_Capture_Dump(stderr);
+            capture_sent = 1;
+        }
+#endif
+    }
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,399 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Maximum bit rate each node can sustain, from the per-state cycle
+   costs of its nodeclock callback chain.
+
+   Usage: bitrate_find [-C HZ] [-q NODECLOCKS] [-u PERCENT] [-o CYCLES]
+                       [-x SCALE] [-a] [-s BUS_SIM] ROLE=FILE...
+
+   Each FILE holds the profile of the node ROLE, as printed by
+   CAN_XR_Profile_Dump() on the board (ENABLE_PROFILE) or by bus_sim -p
+   on the host, see profile_costs.h.  The GPIO PMA runs the chain once
+   every GPIO_PRESCALER cycles of a CPU clocked at HZ, 96 MHz by
+   default, with NODECLOCKS nodeclock periods per bit, 8 by default:
+   prescaler_m times the sum of the bit time segments.  The chain must
+   fit into PERCENT of the period, 90 by default, OVERHEAD cycles of the
+   polling loop included, 0 by default.
+
+   The costs are those of the worst period of each state, or, with -a,
+   of an average period with sample point: the minimum of the state
+   plus the average time of its MAC.  A host profile calls for -a, its
+   maxima are those of the preemptions of the operating system, and
+   for a SCALE turning time-stamp counter ticks into cycles of the
+   board, 1 by default.
+
+   For each node, and for the bus as a whole, it prints the state that
+   needs the longest period, the smallest GPIO_PRESCALER that fits it,
+   the bit rate that follows, the fastest CiA bit rate below it, and
+   the share of the period taken at CAN_XR_BIT_RATE.
+
+   With -s, the costs are then injected into the bus simulator BUS_SIM,
+   a bus_sim binary, on two nodes, see bus_sim.c: first at the bit rate
+   found, then bisecting GPIO_PRESCALER to find the fastest bit rate at
+   which the bus still carries all frames with no error, even though
+   some periods overrun.  That one depends on where the overruns fall
+   and is no design target; it tells how much margin the first one
+   has.  bus_sim runs the MAC of the sender for all roles, the costs
+   are those of the role.
+
+   Build with:
+
+   cc -O2 -I../sender/include -o bitrate_find bitrate_find.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <CAN_XR_Config.h>
+
+#include "profile_costs.h"
+
+#define MAX_ROLES 8
+
+/* Those of bus_sim.c */
+#define SIM_NODES 2
+#define SIM_NODECLOCK_PER_BIT 8
+
+struct role
+{
+    const char *name;
+    const char *file;
+    struct profile_costs costs;     /* Effective, see effective_costs() */
+    int state;                      /* Of the longest period */
+    unsigned long worst;
+    unsigned long prescaler;        /* Smallest that fits */
+};
+
+static struct role roles[MAX_ROLES];
+static int n_roles;
+
+static unsigned long cpu_hz = 96000000;     /* -C */
+static unsigned long nodeclocks = 8;        /* -q */
+static unsigned long percent = 90;          /* -u */
+static unsigned long overhead;              /* -o */
+static double scale = 1.0;                  /* -x */
+static int average;                         /* -a */
+static const char *bus_sim;                 /* -s */
+
+static const unsigned long cia_rates[] = {
+    1000000, 800000, 500000, 250000, 125000, 50000, 20000, 10000
+};
+
+/* Turn the profile 'in' into the costs of bus_sim -k, in cycles of
+   the board with the polling loop included: the minimum of a state
+   for a period without sample point, the maximum for one with.
+*/
+static void effective_costs(const struct profile_costs *in, struct profile_costs *out)
+{
+    int s;
+
+    *out = *in;
+    for(s = 0; s < in->states; s++)
+    {
+        unsigned long sampled = average ? in->min[s] + in->mac_avg[s] : in->max[s];
+
+        if(!in->valid[s])
+            continue;
+        out->min[s] = (unsigned long)(in->min[s] * scale + 0.5) + overhead;
+        out->max[s] = (unsigned long)(sampled * scale + 0.5) + overhead;
+        out->avg[s] = (unsigned long)(in->avg[s] * scale + 0.5) + overhead;
+    }
+}
+
+/* Same format as CAN_XR_Profile_Dump(), PMA rows only */
+static void write_costs(FILE *f, const struct profile_costs *c, unsigned long budget)
+{
+    int s;
+
+    fprintf(f, "Profile, budget %lu per nodeclock period\n", budget);
+    for(s = 0; s < c->states; s++)
+        if(c->valid[s])
+            fprintf(f, "%5d %-16s %-5s %12lu %8lu %8lu %8lu\n",
+                    s, profile_costs_state_name[s], "PMA",
+                    c->periods[s], c->min[s], c->avg[s], c->max[s]);
+}
+
+static unsigned long rate_of(unsigned long prescaler)
+{
+    return cpu_hz / (prescaler * nodeclocks);
+}
+
+/* GPIO_PRESCALER of the programs at 'rate' */
+static unsigned long prescaler_of(unsigned long rate)
+{
+    return cpu_hz / (rate * nodeclocks);
+}
+
+struct sim_result
+{
+    double frames;      /* Per second */
+    unsigned long errors;
+    unsigned long overruns;
+};
+
+/* Run bus_sim at 'prescaler' with the costs in 'path', or none if
+   NULL.  Returns 0 on success.
+*/
+static int simulate(const char *path, unsigned long prescaler, struct sim_result *r)
+{
+    char cmd[1024], line[256];
+    unsigned long arb, errors, seq, data, overruns = 0;
+    double frames, highest, lowest, payload;
+    int nodes, found = 0;
+    FILE *p;
+
+    snprintf(cmd, sizeof(cmd), "'%s' -n %d -C %lu -b %lu%s%s%s",
+             bus_sim, SIM_NODES, cpu_hz, rate_of(prescaler),
+             path ? " -k '" : "", path ? path : "", path ? "'" : "");
+    if((p = popen(cmd, "r")) == NULL)
+    {
+        perror(bus_sim);
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), p))
+    {
+        int n = sscanf(line, "%d %lf %lf %lf %lf %lu %lu %lu %lu %lu",
+                       &nodes, &frames, &highest, &lowest, &payload,
+                       &arb, &errors, &seq, &data, &overruns);
+
+        if(n >= 9 && nodes == SIM_NODES)
+        {
+            r->frames = frames;
+            r->errors = errors + seq + data;
+            r->overruns = (n == 10) ? overruns : 0;
+            found = 1;
+        }
+    }
+
+    if(pclose(p) != 0 || !found)
+    {
+        fprintf(stderr, "%s failed\n", cmd);
+        return -1;
+    }
+    return 0;
+}
+
+/* Whether the bus carried all frames with no error at 'prescaler'.
+   'per_bit' is the frame rate without costs, per bit/s.
+*/
+static int sim_ok(const char *path, unsigned long prescaler, double per_bit,
+                  struct sim_result *r)
+{
+    if(simulate(path, prescaler, r) != 0)
+        return -1;
+    return r->errors == 0 && r->frames >= 0.99 * per_bit * rate_of(prescaler);
+}
+
+static int verify(struct role *r, double per_bit)
+{
+    char path[] = "/tmp/bitrate_find_XXXXXX";
+    struct sim_result res;
+    unsigned long lo = 1, hi = r->prescaler;
+    int fd = mkstemp(path), ok;
+    FILE *f;
+
+    if(fd < 0 || (f = fdopen(fd, "w")) == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    write_costs(f, &r->costs, r->prescaler);
+    fclose(f);
+
+    ok = sim_ok(path, r->prescaler, per_bit, &res);
+    if(ok < 0)
+        goto fail;
+    printf("%-14s %8lu bit/s: %s, %.1f frames/s, %lu overruns, %lu errors\n",
+           r->name, rate_of(r->prescaler), ok ? "ok" : "FAILED",
+           res.frames, res.overruns, res.errors);
+
+    /* Smallest prescaler that still works, assuming that all larger
+       ones do.
+    */
+    if(ok)
+    {
+        while(lo < hi)
+        {
+            unsigned long mid = (lo + hi) / 2;
+
+            ok = sim_ok(path, mid, per_bit, &res);
+            if(ok < 0)
+                goto fail;
+            if(ok)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+
+        sim_ok(path, hi, per_bit, &res);
+        printf("%-14s %8lu bit/s: simulated limit, GPIO_PRESCALER %lu, %lu overruns\n",
+               "", rate_of(hi), hi, res.overruns);
+    }
+
+    unlink(path);
+    return 0;
+
+fail:
+    unlink(path);
+    return -1;
+}
+
+static void print_row(const char *name, int state, unsigned long worst, unsigned long prescaler)
+{
+    unsigned long rate = rate_of(prescaler), cia = 0;
+    size_t i;
+
+    for(i = 0; i < sizeof(cia_rates) / sizeof(cia_rates[0]) && cia == 0; i++)
+        if(cia_rates[i] <= rate && prescaler_of(cia_rates[i]) >= prescaler)
+            cia = cia_rates[i];
+
+    printf("%-14s %-16s %9lu %9lu %11lu ", name,
+           (state >= 0) ? profile_costs_state_name[state] : "-", worst, prescaler, rate);
+    if(cia)
+        printf("%9lu ", cia);
+    else
+        printf("%9s ", "-");
+    printf("%8.1f%%\n", 100.0 * worst / prescaler_of(CAN_XR_BIT_RATE));
+}
+
+int main(int argc, char *argv[])
+{
+    struct profile_costs profile;
+    unsigned long bus_prescaler = 0, bus_worst = 0;
+    const char *bus_role = NULL;
+    int bus_state = -1, opt, i;
+
+    while((opt = getopt(argc, argv, "C:q:u:o:x:as:")) != -1)
+    {
+        switch(opt)
+        {
+        case 'C':
+            cpu_hz = strtoul(optarg, NULL, 0);
+            break;
+        case 'q':
+            nodeclocks = strtoul(optarg, NULL, 0);
+            break;
+        case 'u':
+            percent = strtoul(optarg, NULL, 0);
+            break;
+        case 'o':
+            overhead = strtoul(optarg, NULL, 0);
+            break;
+        case 'x':
+            scale = atof(optarg);
+            break;
+        case 'a':
+            average = 1;
+            break;
+        case 's':
+            bus_sim = optarg;
+            break;
+        default:
+            goto usage;
+        }
+    }
+
+    if(optind == argc || nodeclocks == 0 || percent == 0 || percent > 100 || scale <= 0)
+        goto usage;
+
+    for(i = optind; i < argc && n_roles < MAX_ROLES; i++)
+    {
+        struct role *r = &roles[n_roles];
+        char *eq = strchr(argv[i], '=');
+
+        if(eq == NULL)
+            goto usage;
+        *eq = '\0';
+        r->name = argv[i];
+        r->file = eq + 1;
+
+        if(profile_costs_read(r->file, &profile) <= 0)
+        {
+            fprintf(stderr, "No profile in %s, see CAN_XR_Profile_Dump()\n", r->file);
+            return EXIT_FAILURE;
+        }
+        effective_costs(&profile, &r->costs);
+
+        r->worst = profile_costs_worst(&r->costs, &r->state);
+        r->prescaler = (r->worst * 100 + percent - 1) / percent;
+        if(r->prescaler == 0)
+            r->prescaler = 1;
+        n_roles++;
+    }
+
+    printf("%lu Hz, %lu nodeclocks per bit, %lu%% of each period, %s periods\n\n",
+           cpu_hz, nodeclocks, percent, average ? "average" : "worst");
+    printf("role           state               cycles prescaler   max bit/s       CiA  at %d\n",
+           CAN_XR_BIT_RATE);
+
+    for(i = 0; i < n_roles; i++)
+    {
+        struct role *r = &roles[i];
+
+        print_row(r->name, r->state, r->worst, r->prescaler);
+        if(r->prescaler > bus_prescaler)
+        {
+            bus_prescaler = r->prescaler;
+            bus_worst = r->worst;
+            bus_state = r->state;
+            bus_role = r->name;
+        }
+    }
+
+    if(n_roles > 1)
+    {
+        printf("\nThe bus is bound by %s:\n", bus_role);
+        print_row("bus", bus_state, bus_worst, bus_prescaler);
+    }
+
+    if(bus_sim)
+    {
+        struct sim_result ref;
+
+        if(nodeclocks != SIM_NODECLOCK_PER_BIT)
+        {
+            fprintf(stderr, "bus_sim has %d nodeclocks per bit\n", SIM_NODECLOCK_PER_BIT);
+            return EXIT_FAILURE;
+        }
+
+        printf("\nSimulated with %d nodes on %s\n", SIM_NODES, bus_sim);
+
+        /* Frames per bit of a bus that never overruns */
+        if(simulate(NULL, prescaler_of(CAN_XR_BIT_RATE), &ref) != 0)
+            return EXIT_FAILURE;
+
+        for(i = 0; i < n_roles; i++)
+            if(verify(&roles[i], ref.frames / rate_of(prescaler_of(CAN_XR_BIT_RATE))) != 0)
+                return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+usage:
+    fprintf(stderr, "Usage: %s [-C HZ] [-q NODECLOCKS] [-u PERCENT] [-o CYCLES] "
+            "[-x SCALE] [-a] [-s BUS_SIM] ROLE=FILE...\n", argv[0]);
+    return EXIT_FAILURE;
+}
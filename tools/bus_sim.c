@@ -0,0 +1,636 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Host simulation of a bus shared by several senders.
+
+   NODES instances of the real PCS and MAC of the sender are connected
+   to a wired-AND bus and clocked together, one nodeclock at a time.
+   Each node keeps all of its transmit mailboxes full, so the bus is
+   saturated and every SOF starts an arbitration.  Node i transmits
+   unauthenticated frames with identifier 0x300 + i and, every fourth
+   frame, an authenticated one with identifier 0x20 + i whose first
+   data byte is its sequence number.
+
+   The nodes acknowledge each other's frames.  With a single node, an
+   extra receiver drives the ACK slot.  Every node checks that the
+   authenticated frames of every other node arrive in sequence, that
+   is, that a frame that lost arbitration has been transmitted again
+   unchanged and before the later ones.
+
+   For each number of nodes, it prints the frames per second at
+   CAN_XR_BIT_RATE, or -b, in total and for the lowest and highest priority
+   node, the payload bytes per second, the arbitration losses, the
+   error frames, the sequence errors and the frames whose payload was
+   not the one sent.
+
+   With -f, the nodes send FBFF frames with 64 data bytes instead of
+   CBFF frames with 8, and switch to a data bit time half the nominal
+   one.  FD frames are not authenticated, those with identifier 0x20 +
+   i just carry the sequence number.
+
+   Build with:
+
+   cc -O2 -I../sender/include -o bus_sim bus_sim.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_MAC_Common.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_PCS.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_PMA_Common.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_Auth_Policy.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_Metrics.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_Latency.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_Workload.c
+
+   With -DENABLE_TRACE -DENABLE_TRACE_BINARY, CAN_XR_Trace.c and
+   CAN_XR_MAC_Dump.c of the same directory added, -t FILE traces
+   the MAC and dumps the last records of the trace ring into FILE at
+   the end, for trace_decode.c.
+
+   With -DENABLE_PROFILE and CAN_XR_Profile.c, -p prints the time the
+   nodeclock callback chain of a node takes, per receive state, see
+   CAN_XR_Profile.h.  The budget is the one of the board, see -k
+   below, in cycles of its CCLK, which host time-stamp counter ticks
+   only roughly compare with.
+
+   With -DENABLE_CAPTURE and CAN_XR_Capture.c, -c FILE dumps the last
+   records of the capture ring into FILE at the end, for
+   capture_vcd.c.  All nodes share the ring, the bus level goes into
+   channel DEBUG1 and the timestamps count nodeclock periods.
+
+   With -m, it also prints the metrics registry at the end of each run,
+   see CAN_XR_Metrics.h.  All nodes share it, so the counters are the
+   sum of those of the nodes.
+
+   With -k FILE, each node takes the time of the board to run its
+   nodeclock callback chain, per receive state, from the profile dump
+   in FILE, see profile_costs.h.  The nodeclock period is the one of
+   the GPIO PMA, GPIO_PRESCALER cycles of a CPU clocked at -C HZ, 96
+   MHz by default, at the bit rate given by -b, CAN_XR_BIT_RATE by
+   default.  A period that takes longer makes the node miss the
+   following nodeclocks, with its transmitter left as it was, and is
+   accounted as an overrun, in an extra column.  bitrate_find.c uses
+   this to verify the bit rates it computes.
+
+   With -w SEED, each node takes its frames from a workload instead,
+   see CAN_XR_Workload.h, seeded with SEED plus its index: a stream
+   of unauthenticated frames with identifier 0x300 + i every 20 ms, 8
+   authenticated identifiers from 0x40 + 8 i every 50 ms, both with
+   jitter, and bursts of 4 authenticated frames with identifier 0x100
+   + i every 100 ms, with payload lengths drawn from a distribution.
+   The bus carries what they offer; with -W SEED the same frames are
+   sent back to back and saturate it.  Their payload is random, so
+   there is no sequence or data check, their columns show -, and no
+   FD frames.
+
+   -n N runs only with N nodes.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <CAN_XR_Config.h>
+#include <CAN_XR_PMA.h>
+#include <CAN_XR_PCS.h>
+#include <CAN_XR_MAC.h>
+#include <CAN_XR_Trace.h>
+#include <CAN_XR_Profile.h>
+#include <CAN_XR_Metrics.h>
+#include <CAN_XR_Capture.h>
+#include <CAN_XR_Workload.h>
+
+#include "profile_costs.h"
+
+#define NODECLOCK_PER_BIT 8
+#define MAX_NODES 8
+#define BITS 400000
+#define WORKLOAD_STREAMS 3
+
+static const struct CAN_XR_PCS_Bit_Time_Parameters pcs_parameters = {
+    .prescaler_m = 1,
+    .sync_seg = 1,
+    .prop_seg = 3,
+    .phase_seg1 = 2,
+    .phase_seg2 = 2,
+    .sjw = 1
+};
+
+/* Data bit time of FD frames, 4 quanta.  There is no loop delay on
+   the simulated bus, the sample point can be early.
+*/
+static const struct CAN_XR_PCS_Bit_Time_Parameters pcs_data_parameters = {
+    .prescaler_m = 1,
+    .sync_seg = 1,
+    .prop_seg = 1,
+    .phase_seg1 = 1,
+    .phase_seg2 = 1,
+    .sjw = 1
+};
+
+struct node
+{
+    struct CAN_XR_MAC mac;
+    struct CAN_XR_PCS pcs;
+    struct CAN_XR_PMA pma;
+    int index;
+    int outstanding;
+    unsigned long submitted;
+    unsigned long confirmed;
+    uint8_t auth_sent;
+    uint8_t auth_expected[MAX_NODES];   /* Next sequence number of each node */
+    int sampled;                        /* The MAC ran in this period */
+    unsigned long stall;                /* Nodeclocks still to miss, -k */
+    struct CAN_XR_Workload workload;    /* -w */
+    struct CAN_XR_Workload_Stream streams[WORKLOAD_STREAMS];
+    struct CAN_XR_Workload_Frame next;
+    unsigned long due;                  /* Nodeclock of 'next' */
+};
+
+static struct node nodes[MAX_NODES];
+static unsigned long sequence_errors;
+static unsigned long data_errors;
+static unsigned long payload_bytes;    /* Received by node 0 */
+static int fd;                         /* -f */
+static const char *trace_file;         /* -t */
+static int profile;                    /* -p */
+static int metrics;                    /* -m */
+static const char *capture_file;       /* -c */
+static const char *costs_file;         /* -k */
+static int workload;                   /* -w, -W */
+static int saturate;                   /* -W */
+static uint32_t workload_seed;
+static struct profile_costs costs;
+static unsigned long cpu_hz = 96000000;            /* -C */
+static unsigned long bit_rate = CAN_XR_BIT_RATE;   /* -b */
+static unsigned long budget;                       /* GPIO_PRESCALER */
+static CAN_XR_PCS_Data_Ind_t mac_data_ind;
+#ifdef ENABLE_CAPTURE
+static int capture_bus_level = 1;
+#endif
+static struct CAN_XR_Metrics_Snapshot snapshot[MAX_NODES + 1];
+
+static void bus_data_req(struct CAN_XR_PMA *pma, int level)
+{
+    pma->state.sim.tx_bus_level = level;
+}
+
+static void data_conf(struct CAN_XR_LLC *llc, unsigned long ts,
+                      uint32_t identifier,
+                      enum CAN_XR_MAC_Tx_Status transmission_status)
+{
+    struct node *n = (struct node *)llc;
+
+    (void)ts;
+    (void)identifier;
+
+    n->outstanding--;
+    if(transmission_status == CAN_XR_MAC_TX_STATUS_SUCCESS)
+        n->confirmed++;
+}
+
+static void data_ind(struct CAN_XR_LLC *llc, unsigned long ts,
+                     uint32_t identifier, enum CAN_XR_Format format,
+                     int dlc, uint8_t *data)
+{
+    struct node *n = (struct node *)llc;
+    int from = (int)identifier - 0x20;
+    int len = CAN_XR_DLC_Len(format, dlc);
+    int i;
+
+    (void)ts;
+
+    /* All bytes but the first are filled by submit().  Authenticated
+       frames end with the data MAC instead.
+    */
+    /* Node 0 indicates its own frames, too */
+    if(n->index == 0)
+        payload_bytes += len;
+
+    if(workload)
+        return;
+
+    for(i = 1; i < len && (fd || identifier >= 0x300); i++)
+    {
+        if(data[i] != (uint8_t)(i ^ identifier))
+        {
+            data_errors++;
+            break;
+        }
+    }
+
+    if(from >= 0 && from < MAX_NODES && from != n->index)
+    {
+        if(data[0] != n->auth_expected[from])
+            sequence_errors++;
+        n->auth_expected[from] = data[0] + 1;
+    }
+}
+
+/* Between the PCS and the MAC of each node, to tell the periods with
+   a sample point.  The MAC comes first in struct node.
+*/
+static void sampled_data_ind(
+    struct CAN_XR_MAC *mac, unsigned long ts, int input_unit)
+{
+    ((struct node *)mac)->sampled = 1;
+    mac_data_ind(mac, ts, input_unit);
+}
+
+/* Clock node 'n', missing the nodeclock if the previous periods
+   overran, see -k.
+*/
+static void clock(struct node *n, unsigned long nc, int bus_level)
+{
+    int state = n->mac.state.rx_fsm_state;
+    unsigned long cost;
+
+    if(n->stall)
+    {
+        n->stall--;
+        return;
+    }
+
+    n->sampled = 0;
+    n->pma.state.sim.rx_bus_level = bus_level;
+    PROFILE_ENTER(CAN_XR_PROFILE_PMA);
+    n->pma.primitives.nodeclock_ind(&n->pcs, bus_level);
+    PROFILE_EXIT(CAN_XR_PROFILE_PMA);
+    PROFILE_PERIOD();
+
+    if(costs_file == NULL)
+        return;
+
+    cost = profile_costs_period(&costs, state, n->sampled);
+    if(cost > budget)
+    {
+        n->stall = (cost - 1) / budget;
+        CAN_XR_PMA_Overrun(&n->pma, nc, n->stall);
+    }
+}
+
+static void submit(struct node *n)
+{
+    uint8_t data[CAN_XR_DATA_LEN_MAX];
+    uint8_t data_mac[16]; /* A whole bpmac tag */
+    uint32_t identifier;
+    int i;
+
+    memset(data_mac, 0xAA, sizeof(data_mac));
+
+    if(n->submitted++ % 4 == 3)
+        identifier = 0x20 + n->index;
+    else
+        identifier = 0x300 + n->index;
+
+    for(i = 0; i < CAN_XR_DATA_LEN_MAX; i++)
+        data[i] = (uint8_t)(i ^ identifier);
+    if(identifier < 0x300)
+        data[0] = n->auth_sent++;
+
+    n->outstanding++;
+    if(fd)
+        CAN_XR_MAC_Data_Req(&n->mac, identifier, CAN_XR_FORMAT_FBFF, 15, data, data_mac);
+    else
+        CAN_XR_MAC_Data_Req(&n->mac, identifier, CAN_XR_FORMAT_CBFF, 8, data, data_mac);
+}
+
+/* Streams of node 'n' at the current bit rate, see -w above.
+   identifier, identifiers, format, period, phase, jitter, burst,
+   len_weight.
+*/
+static void init_workload(struct node *n)
+{
+    unsigned long ms = bit_rate * NODECLOCK_PER_BIT / 1000;
+    const struct CAN_XR_Workload_Stream streams[WORKLOAD_STREAMS] = {
+        { 0x300 + n->index, 1, CAN_XR_FORMAT_CBFF, 20 * ms, 0, ms, 1,
+          { 0, 0, 1, 0, 0, 0, 0, 0, 4 } },
+        { 0x040 + 8 * n->index, 8, CAN_XR_FORMAT_CBFF, 50 * ms, 0, 5 * ms, 1,
+          { 0, 1, 1, 1, 1, 1 } },
+        { 0x100 + n->index, 1, CAN_XR_FORMAT_CBFF, 100 * ms, 10 * ms, 0, 4,
+          { 0, 0, 1, 0, 2 } },
+    };
+
+    memcpy(n->streams, streams, sizeof(streams));
+    if(CAN_XR_Workload_Init(&n->workload, n->streams, WORKLOAD_STREAMS,
+                            workload_seed + n->index, saturate, n->mac.policy) < 0)
+    {
+        fprintf(stderr, "Workload out of range at %lu bit/s\n", bit_rate);
+        exit(EXIT_FAILURE);
+    }
+    CAN_XR_Workload_Next(&n->workload, &n->next);
+    n->due = n->next.gap;
+}
+
+/* Queue the frames of the workload of 'n' due at nodeclock 'nc', as
+   long as there is a free mailbox.
+*/
+static void submit_workload(struct node *n, unsigned long nc)
+{
+    static uint8_t data_mac[16] = { 0 };
+    struct CAN_XR_Workload_Frame *f = &n->next;
+
+    while(n->outstanding < CAN_XR_MAC_MAILBOXES && (long)(nc - n->due) >= 0)
+    {
+        int mac_len = CAN_XR_Auth_Policy_MAC_Len(
+            n->mac.policy,
+            CAN_XR_Auth_Policy_Key(f->identifier, f->format == CAN_XR_FORMAT_CEFF), 8);
+
+        n->outstanding++;
+        n->submitted++;
+        CAN_XR_MAC_Data_Req(&n->mac, f->identifier, f->format, f->len + mac_len, f->data, data_mac);
+
+        CAN_XR_Workload_Next(&n->workload, f);
+        n->due += f->gap;
+    }
+}
+
+static void run(int n_nodes)
+{
+    unsigned long nc, arbitration_lost = 0, error_frames = 0, total = 0, overruns = 0;
+    enum CAN_XR_MAC_RX_FSM_State prev_rx = CAN_XR_MAC_RX_FSM_BUS_INTEGRATION;
+    int bus_level = 1;
+    int i;
+
+    memset(nodes, 0, sizeof(nodes));
+    CAN_XR_Metrics_Clear(CAN_XR_METRICS);
+    sequence_errors = 0;
+    data_errors = 0;
+    payload_bytes = 0;
+
+    for(i = 0; i < n_nodes; i++)
+    {
+        struct node *n = &nodes[i];
+
+        n->index = i;
+        CAN_XR_PCS_Init(&n->pcs, &pcs_parameters, &n->pma);
+        CAN_XR_PCS_Set_Data_Bit_Time(&n->pcs, &pcs_data_parameters);
+        n->pma.primitives.data_req = bus_data_req;
+        n->pma.state.sim.tx_bus_level = 1;
+        CAN_XR_MAC_Common_Init(&n->mac, &n->pcs);
+        CAN_XR_MAC_Set_LLC(&n->mac, (struct CAN_XR_LLC *)n);
+        CAN_XR_MAC_Set_Data_Ind(&n->mac, data_ind);
+        CAN_XR_MAC_Set_Data_Conf(&n->mac, data_conf);
+        CAN_XR_MAC_Set_Bit_Rate_Switch(&n->mac, fd);
+
+        mac_data_ind = n->pcs.primitives.data_ind;
+        CAN_XR_PCS_Set_Data_Ind(&n->pcs, sampled_data_ind);
+
+        if(workload)
+            init_workload(n);
+    }
+
+    for(nc = 0; nc < (unsigned long)BITS * NODECLOCK_PER_BIT; nc++)
+    {
+        for(i = 0; i < n_nodes; i++)
+        {
+            if(workload)
+                submit_workload(&nodes[i], nc);
+            else
+            {
+                while(nodes[i].outstanding < CAN_XR_MAC_MAILBOXES)
+                    submit(&nodes[i]);
+            }
+        }
+
+        /* Wired AND of all transmitters, plus the extra receiver */
+        bus_level = 1;
+        for(i = 0; i < n_nodes; i++)
+            bus_level &= nodes[i].pma.state.sim.tx_bus_level;
+        if(n_nodes == 1 && nodes[0].mac.state.rx_fsm_state == CAN_XR_MAC_RX_FSM_RX_ACK)
+            bus_level = 0;
+
+#ifdef ENABLE_CAPTURE
+        CAN_XR_Capture_Clock++;
+        if(bus_level != capture_bus_level)
+            CAPTURE(CAN_XR_CAPTURE_DEBUG1, bus_level);
+        capture_bus_level = bus_level;
+#endif
+
+        for(i = 0; i < n_nodes; i++)
+            clock(&nodes[i], nc, bus_level);
+
+        if(nodes[0].mac.state.rx_fsm_state == CAN_XR_MAC_RX_FSM_ERROR_FLAG &&
+           prev_rx != CAN_XR_MAC_RX_FSM_ERROR_FLAG)
+            error_frames++;
+        prev_rx = nodes[0].mac.state.rx_fsm_state;
+    }
+
+    for(i = 0; i < n_nodes; i++)
+    {
+        total += nodes[i].confirmed;
+        arbitration_lost += nodes[i].mac.state.arbitration_lost;
+        overruns += nodes[i].pma.overrun.overruns;
+    }
+
+    printf("%5d %10.1f %10.1f %10.1f %10.1f %8lu %6lu",
+           n_nodes,
+           total * (double)bit_rate / BITS,
+           nodes[0].confirmed * (double)bit_rate / BITS,
+           nodes[n_nodes - 1].confirmed * (double)bit_rate / BITS,
+           payload_bytes * (double)bit_rate / BITS,
+           arbitration_lost, error_frames);
+    /* The frames of a workload carry no sequence number to check */
+    if(workload)
+        printf(" %6s %6s", "-", "-");
+    else
+        printf(" %6lu %6lu", sequence_errors, data_errors);
+    if(costs_file)
+        printf(" %8lu", overruns);
+    printf("\n");
+
+    CAN_XR_Metrics_Snapshot(&snapshot[n_nodes]);
+}
+
+/* One column per run, one row per metric */
+static void print_metrics(const int *n_nodes, int runs)
+{
+    int m, r;
+
+    printf("\n%-20s", "metric / nodes");
+    for(r = 0; r < runs; r++)
+        printf(" %10d", n_nodes[r]);
+    printf("\n");
+
+    for(m = 0; m < CAN_XR_METRICS; m++)
+    {
+        printf("%-20s", CAN_XR_Metrics_Name(m));
+        for(r = 0; r < runs; r++)
+            printf(" %10lu", (unsigned long)snapshot[n_nodes[r]].value[m]);
+        printf("\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static const int all_nodes[] = { 1, 2, 3, 4, MAX_NODES };
+    const int *n_nodes = all_nodes;
+    int runs = sizeof(all_nodes) / sizeof(all_nodes[0]);
+    int only_nodes, i, a;
+
+    for(a = 1; a < argc; a++)
+    {
+        if(strcmp(argv[a], "-f") == 0)
+            fd = 1;
+        else if(strcmp(argv[a], "-t") == 0 && a + 1 < argc)
+            trace_file = argv[++a];
+        else if(strcmp(argv[a], "-p") == 0)
+            profile = 1;
+        else if(strcmp(argv[a], "-m") == 0)
+            metrics = 1;
+        else if(strcmp(argv[a], "-c") == 0 && a + 1 < argc)
+            capture_file = argv[++a];
+        else if(strcmp(argv[a], "-k") == 0 && a + 1 < argc)
+            costs_file = argv[++a];
+        else if(strcmp(argv[a], "-C") == 0 && a + 1 < argc)
+            cpu_hz = strtoul(argv[++a], NULL, 0);
+        else if(strcmp(argv[a], "-b") == 0 && a + 1 < argc)
+            bit_rate = strtoul(argv[++a], NULL, 0);
+        else if((strcmp(argv[a], "-w") == 0 || strcmp(argv[a], "-W") == 0) && a + 1 < argc)
+        {
+            workload = 1;
+            saturate = (argv[a][1] == 'W');
+            workload_seed = strtoul(argv[++a], NULL, 0);
+        }
+        else if(strcmp(argv[a], "-n") == 0 && a + 1 < argc)
+        {
+            only_nodes = atoi(argv[++a]);
+            if(only_nodes < 1 || only_nodes > MAX_NODES)
+            {
+                fprintf(stderr, "-n takes 1 to %d nodes\n", MAX_NODES);
+                return EXIT_FAILURE;
+            }
+            n_nodes = &only_nodes;
+            runs = 1;
+        }
+    }
+
+    budget = (bit_rate > 0) ? cpu_hz / (bit_rate * NODECLOCK_PER_BIT) : 0;
+    if(budget == 0)
+    {
+        fprintf(stderr, "No nodeclock period at %lu bit/s with a %lu Hz clock\n", bit_rate, cpu_hz);
+        return EXIT_FAILURE;
+    }
+
+    if(workload && fd)
+    {
+        fprintf(stderr, "-w has no FD frames\n");
+        return EXIT_FAILURE;
+    }
+
+    if(costs_file && profile_costs_read(costs_file, &costs) <= 0)
+    {
+        fprintf(stderr, "No profile in %s, see CAN_XR_Profile_Dump()\n", costs_file);
+        return EXIT_FAILURE;
+    }
+
+#ifdef ENABLE_TRACE_BINARY
+    if(trace_file)
+    {
+        CAN_XR_Trace_Init();
+        SET_TRACE_TRESHOLD(2);
+    }
+    else
+        SET_TRACE_TRESHOLD(10);
+#else
+    if(trace_file)
+    {
+        fprintf(stderr, "-t needs the binary trace, see above\n");
+        return EXIT_FAILURE;
+    }
+#endif
+
+#ifdef ENABLE_CAPTURE
+    CAPTURE_INIT(bit_rate * NODECLOCK_PER_BIT);
+#else
+    if(capture_file)
+    {
+        fprintf(stderr, "-c needs the capture, see above\n");
+        return EXIT_FAILURE;
+    }
+#endif
+
+#ifdef ENABLE_PROFILE
+    PROFILE_INIT(budget);
+#else
+    if(profile)
+    {
+        fprintf(stderr, "-p needs the profiler, see above\n");
+        return EXIT_FAILURE;
+    }
+#endif
+
+    if(workload)
+        printf("%lu bit/s, %d bits per run, workload seed %lu%s\n", bit_rate, BITS,
+               (unsigned long)workload_seed, saturate ? ", saturating" : "");
+    else
+        printf("%lu bit/s, %d bits per run, %s\n", bit_rate, BITS,
+               fd ? "FBFF 64 bytes, data bit rate x2" : "CBFF 8 bytes");
+    if(costs_file)
+        printf("Costs of %s, %lu cycles per nodeclock at %lu Hz\n", costs_file, budget, cpu_hz);
+    printf("\nnodes   frames/s    highest     lowest  payload/s  arb.lost errors    seq   data%s\n",
+           costs_file ? " overruns" : "");
+
+    for(i = 0; i < runs; i++)
+        run(n_nodes[i]);
+
+    if(metrics)
+        print_metrics(n_nodes, runs);
+
+#ifdef ENABLE_TRACE_BINARY
+    if(trace_file)
+    {
+        FILE *f = fopen(trace_file, "wb");
+
+        if(f == NULL)
+        {
+            perror(trace_file);
+            return EXIT_FAILURE;
+        }
+        printf("\n%d trace records in %s\n", CAN_XR_Trace_Dump(f), trace_file);
+        fclose(f);
+    }
+#endif
+
+#ifdef ENABLE_CAPTURE
+    if(capture_file)
+    {
+        FILE *f = fopen(capture_file, "wb");
+
+        if(f == NULL)
+        {
+            perror(capture_file);
+            return EXIT_FAILURE;
+        }
+        printf("\n%d capture records in %s\n", CAN_XR_Capture_Dump(f), capture_file);
+        fclose(f);
+    }
+#endif
+
+#ifdef ENABLE_PROFILE
+    if(profile)
+    {
+        printf("\n");
+        CAN_XR_Profile_Dump(stdout);
+    }
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,573 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Host simulation of a CAIBA bus under saturating load.
+
+   Connects to a simulated wired-AND bus the real MAC and PCS of one
+   authenticated sender, of the authenticator and of a receiver,
+   plus BACKGROUND unauthenticated senders that keep the bus busy.
+   All of them are clocked together, one nodeclock at a time.
+
+   The authenticated sender works like 02_can_sw_transmitter.c: frames
+   are signed ahead of time by CAN_XR_Signer, released to
+   CAN_XR_MAC_Queue and pulled from there by the MAC.  It sends as
+   fast as it can, with a sequence number in the first two payload
+   bytes.  Each background sender queues a frame with a higher
+   priority every BACKGROUND_PERIOD bits, so that the authenticated
+   sender loses arbitration from time to time and retransmits its
+   frames.
+
+   The authenticator overwrites the data MAC of every authenticated
+   frame on the fly, and the receiver verifies the group tag that is
+   left on the bus and the sequence numbers.  With intermission and
+   SOF in intermission, frames follow each other with no idle bit in
+   between and no time for the nodes to catch up, so any missed
+   overwrite or a frame not verified shows up as a wrong tag or a
+   sequence gap.
+
+   For each number of background senders, it prints the frames per
+   second at CAN_XR_BIT_RATE in total and for the authenticated
+   sender, the idle bits, the arbitration losses of the authenticated
+   sender, the authenticated frames verified correctly and not, the
+   sequence gaps and the error frames seen by the receiver and the
+   authenticator.
+
+   With -x, the authenticated sender uses CEFF frames, with the base
+   identifier of the CBFF ones and a non-zero identifier extension, so
+   that all 29 identifier bits are covered by the tags.
+
+   With -f, the background senders send unauthenticated FBFF frames
+   with 64 data bytes and a data bit time half the nominal one, which
+   the authenticator and the receiver must follow to stay in step.
+
+   With -s K, the sender moves its nonces forward by one before every
+   K-th authenticated frame, as if it had signed a frame that never
+   made it to the bus.  Authenticator and receiver can only keep up
+   when all nodes are built with nonce hints, with
+
+   ./caiba_sim.sh cc "-O2 -DCAN_XR_NONCE_HINT_BITS=4"
+
+   see CAN_XR_Config.h.  Then the nonce skips, the frames verified
+   after a realignment and the payload bytes per second the sequence
+   number and the data MAC leave to the application are printed, too.
+   Without hints, the frames after the first skip do not verify.
+
+   With -e as well, the first transmission of the frame after each
+   skip is destroyed by ERROR_BITS dominant bits forced on the bus as
+   soon as the authenticator has realigned its nonce with the hint,
+   and the frame is retransmitted.  The retransmission must verify
+   like any other realigned frame; the errors injected are printed.
+
+   With -l, it also prints the latency histograms of the sender, the
+   authenticator and the receiver in the last run, the most loaded
+   one, see CAN_XR_Latency.h.  The sender accounts the time from the
+   transmission request CAN_XR_MAC_Queue gives to its MAC to the
+   validation of the frame, the others the time from SOF to the end of the payload, of the data
+   field and of the frame, and the receiver to the verification of
+   the group tag.
+
+   With -a K, all runs are made twice, first with a MAC in every
+   authenticated frame, then with the rule in aggregated mode, a
+   checkpoint every K frames, see CAN_XR_Auth_Policy.h and
+   CAIBA_SIM_AGG_PAYLOAD_LEN.  The payload bytes per second of the
+   frames authenticated, that is, whose window ended with a
+   verified checkpoint, are printed for both, and -l gives the
+   latency histograms of both, the receiver accounting the time from
+   SOF to the verification of the checkpoint for every frame of the
+   window.
+
+   With -r, it first reports on stderr the authentication policy of
+   the nodes and the payload throughput it allows at CAN_XR_BIT_RATE,
+   see CAN_XR_Auth_Policy_Report().
+
+   Before the runs, it checks the AES-128 bpmac computes one round at
+   a time for the masking tags, see bpmac_pre_begin(), against the
+   example of FIPS-197 appendix C.1 and against
+   mbedtls_aes_crypt_ecb() for AES_CHECK_BLOCKS more nonces, and
+   exits with an error if they differ.
+
+   The nodes are built from their own directories, build with
+   caiba_sim.sh.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <CAN_XR_Config.h>
+#include <CAN_XR_PMA.h>
+#include <CAN_XR_PCS.h>
+#include <CAN_XR_MAC.h>
+#include <CAN_XR_MAC_Queue.h>
+#include <CAN_XR_Signer.h>
+#include <CAN_XR_Latency.h>
+#include <mbedtls/aes.h>
+#include <bpmac.h>
+
+#include "caiba_sim.h"
+
+#define NODECLOCK_PER_BIT 8
+#define MAX_BACKGROUND 4
+#define BITS 400000
+
+#define BACKGROUND_PERIOD 1000
+#define ERROR_BITS 7            /* -e, more than a stuff error takes */
+#define AES_CHECK_BLOCKS 64
+
+#define AUTH_IDENTIFIER 0x140
+#define AUTH_EXTENSION 0x2D2B4      /* -x, identifier extension */
+#define BACKGROUND_IDENTIFIER 0x080   /* + background sender index */
+
+static const struct CAN_XR_PCS_Bit_Time_Parameters pcs_parameters = {
+    .prescaler_m = 1,
+    .sync_seg = 1,
+    .prop_seg = 3,
+    .phase_seg1 = 2,
+    .phase_seg2 = 2,
+    .sjw = 1
+};
+
+/* Data bit time of FD frames, -f.  There is no loop delay on the
+   simulated bus, the sample point can be early.
+*/
+static const struct CAN_XR_PCS_Bit_Time_Parameters pcs_data_parameters = {
+    .prescaler_m = 1,
+    .sync_seg = 1,
+    .prop_seg = 1,
+    .phase_seg1 = 1,
+    .phase_seg2 = 1,
+    .sjw = 1
+};
+
+static const uint8_t grp_key[] = {0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00};
+static const uint8_t grp_key_nonce[] = {0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF};
+static const uint8_t src_key[] = {0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07};
+static const uint8_t src_key_nonce[] = {0x22, 0x11, 0x27, 0x09, 0x22, 0x11, 0x27, 0x09, 0x22, 0x11, 0x27, 0x09 ,0x22, 0x11, 0x27, 0x09};
+
+struct node
+{
+    struct CAN_XR_MAC mac;
+    struct CAN_XR_PCS pcs;
+    struct CAN_XR_PMA pma;
+    int outstanding;
+    unsigned long submitted;
+    unsigned long confirmed;
+};
+
+/* nodes[0] is the authenticated sender */
+static struct node nodes[1 + MAX_BACKGROUND];
+static struct CAN_XR_MAC_Queue queue;
+static struct CAN_XR_Signer signer;
+static uint16_t seq;
+static enum CAN_XR_Format auth_format = CAN_XR_FORMAT_CBFF;
+static uint32_t auth_identifier = AUTH_IDENTIFIER;
+static int background_fd;       /* -f */
+static int latency;             /* -l */
+static struct CAN_XR_Latency sender_latency;
+static unsigned long skip_every;    /* -s */
+static unsigned long skips;
+static int error_hinted;        /* -e */
+static unsigned long injected;
+static int aggregate_k;         /* -a */
+static int aggregate;           /* Window of the runs, 0 for the per-frame rule */
+
+static void bus_data_req(struct CAN_XR_PMA *pma, int level)
+{
+    pma->state.sim.tx_bus_level = level;
+}
+
+static void data_conf(struct CAN_XR_LLC *llc, unsigned long ts,
+                      uint32_t identifier,
+                      enum CAN_XR_MAC_Tx_Status transmission_status)
+{
+    struct node *n = (struct node *)llc;
+
+    (void)ts;
+    (void)identifier;
+
+    n->outstanding--;
+    if(transmission_status == CAN_XR_MAC_TX_STATUS_SUCCESS)
+        n->confirmed++;
+}
+
+static void queue_data_conf(struct CAN_XR_LLC *llc, unsigned long ts,
+                            uint32_t identifier,
+                            enum CAN_XR_MAC_Tx_Status transmission_status)
+{
+    (void)llc;
+    data_conf((struct CAN_XR_LLC *)&nodes[0], ts, identifier, transmission_status);
+}
+
+static void submit(struct node *n)
+{
+    uint8_t data[CAN_XR_DATA_LEN_MAX];
+    uint8_t data_mac[16];   /* Not authenticated */
+
+    memset(data, 0x55, sizeof(data));
+    memset(data_mac, 0, sizeof(data_mac));
+
+    n->outstanding++;
+    n->submitted++;
+    if(background_fd)
+        CAN_XR_MAC_Data_Req(&n->mac, BACKGROUND_IDENTIFIER + (int)(n - nodes),
+                            CAN_XR_FORMAT_FBFF, 15, data, data_mac);
+    else
+        CAN_XR_MAC_Data_Req(&n->mac, BACKGROUND_IDENTIFIER + (int)(n - nodes),
+                            CAN_XR_FORMAT_CBFF, 8, data, data_mac);
+}
+
+/* Foreground loop of the authenticated sender, see
+   02_can_sw_transmitter.c.  Payload: sequence number and three more
+   bytes, the data MAC fills the rest of the frame.
+*/
+static void foreground(void)
+{
+    uint8_t data[CAIBA_SIM_AGG_PAYLOAD_LEN] = { 0, 0, 0xA5, 0x5A, 0xA5 };
+    uint8_t *seq_byte = data + CAIBA_SIM_SEQ_BYTE(CAN_XR_NONCE_HINT_BITS);
+
+    CAN_XR_MAC_Queue_Dispatch(&queue);
+
+    if(CAN_XR_Signer_Ready(&signer) < CAN_XR_SIGNER_LEN)
+    {
+        /* Nonce skip, see -s */
+        if(skip_every && seq % skip_every == skip_every - 1 && skips == seq / skip_every)
+        {
+            if(++signer.nonce_src[0] == 0)
+                signer.nonce_src[1]++;
+            if(++signer.nonce_grp[0] == 0)
+                signer.nonce_grp[1]++;
+            skips++;
+        }
+
+        seq_byte[0] = seq & 0xFF;
+        seq_byte[1] = seq >> 8;
+        if(CAN_XR_Signer_Sign(&signer, auth_identifier, auth_format, sizeof(data), data))
+            seq++;
+    }
+
+    if(CAN_XR_Signer_Release(&signer, &queue))
+    {
+        nodes[0].outstanding++;
+        nodes[0].submitted++;
+    }
+}
+
+static void init_node(struct node *n)
+{
+    CAN_XR_PCS_Init(&n->pcs, &pcs_parameters, &n->pma);
+    CAN_XR_PCS_Set_Data_Bit_Time(&n->pcs, &pcs_data_parameters);
+    n->pma.primitives.data_req = bus_data_req;
+    n->pma.state.sim.tx_bus_level = 1;
+    CAN_XR_MAC_Common_Init(&n->mac, &n->pcs);
+    CAN_XR_MAC_Set_LLC(&n->mac, (struct CAN_XR_LLC *)n);
+    CAN_XR_MAC_Set_Data_Conf(&n->mac, data_conf);
+    CAN_XR_MAC_Set_Bit_Rate_Switch(&n->mac, 1);
+}
+
+/* Authentication policy of all nodes: the identifiers between
+   CAIBA_SIM_AUTH_FIRST and CAIBA_SIM_AUTH_LAST follow rule 0, the
+   others are not authenticated.  Rule 0 is aggregated when
+   'aggregate' is not 0.
+*/
+static struct CAN_XR_Auth_Policy *set_policy(void)
+{
+    struct CAN_XR_Auth_Policy *policy = CAN_XR_Auth_Policy_Default();
+
+    CAN_XR_Auth_Policy_Set_Rule(policy, 0, CAN_XR_AUTH_MAC_LEN_DEFAULT, 0);
+    if(aggregate)
+        CAN_XR_Auth_Policy_Set_Aggregation(policy, 0, aggregate,
+                                           CAIBA_SIM_AGG_MAC_LEN_SHORT, CAIBA_SIM_AGG_PAYLOAD_LEN);
+    CAN_XR_Auth_Policy_Map(policy, 0, CAN_XR_AUTH_POLICY_IDS - 1, CAN_XR_AUTH_NO_RULE);
+    CAN_XR_Auth_Policy_Map(policy, CAIBA_SIM_AUTH_FIRST, CAIBA_SIM_AUTH_LAST, 0);
+    return policy;
+}
+
+static void run(int n_background)
+{
+    struct caiba_sim_recv_stats stats;
+    unsigned long nc, idle_bits = 0, total = 0;
+    int n_nodes = 1 + n_background;
+    int wired, bus_level, level, idle, was_idle = 0;
+    int forced = 0;             /* Nodeclocks left in an injected error */
+    int hinted, was_hinted = 0, retransmission = 0;
+    int i;
+
+    set_policy();
+
+    memset(nodes, 0, sizeof(nodes));
+    seq = 0;
+    skips = 0;
+    injected = 0;
+
+    for(i = 0; i < n_nodes; i++)
+        init_node(&nodes[i]);
+
+    CAN_XR_Signer_Init(&signer, nodes[0].mac.policy, grp_key, grp_key_nonce, src_key, src_key_nonce);
+    CAN_XR_MAC_Queue_Init(&queue, &nodes[0].mac);
+    CAN_XR_Latency_Init(&sender_latency);
+    CAN_XR_MAC_Set_Latency(&nodes[0].mac, &sender_latency);
+    CAN_XR_MAC_Queue_Set_Data_Conf(&queue, queue_data_conf);
+
+    caiba_sim_auth_init(aggregate);
+    caiba_sim_recv_init(aggregate);
+
+    for(nc = 0; nc < (unsigned long)BITS * NODECLOCK_PER_BIT; nc++)
+    {
+        foreground();
+        for(i = 1; i < n_nodes; i++)
+        {
+            /* Spread the background senders over the period */
+            if(nc % ((unsigned long)BACKGROUND_PERIOD * NODECLOCK_PER_BIT)
+               == (unsigned long)i * BACKGROUND_PERIOD * NODECLOCK_PER_BIT / n_nodes
+               && nodes[i].outstanding < CAN_XR_MAC_MAILBOXES)
+                submit(&nodes[i]);
+        }
+
+        /* Wired AND of all transmitters, unless the authenticator is
+           overwriting the bus.  The authenticator drives its
+           transceivers within the quantum it samples, like the GPIO
+           PMA, so it goes first and the others see the outcome.
+        */
+        wired = caiba_sim_recv_level();
+        for(i = 0; i < n_nodes; i++)
+            wired &= nodes[i].pma.state.sim.tx_bus_level;
+
+        /* Error in the first transmission of a realigned frame, see
+           -e.  The authenticator realigns again in the retransmission,
+           which is left alone.
+        */
+        hinted = caiba_sim_auth_hinted();
+        if(error_hinted && hinted && !was_hinted)
+        {
+            if(!retransmission)
+            {
+                forced = ERROR_BITS * NODECLOCK_PER_BIT;
+                injected++;
+            }
+            retransmission = !retransmission;
+        }
+        was_hinted = hinted;
+        if(forced)
+        {
+            wired = 0;
+            forced--;
+        }
+
+        bus_level = caiba_sim_auth_drive(&level) ? level : wired;
+        caiba_sim_auth_clock(bus_level);
+        bus_level = caiba_sim_auth_drive(&level) ? level : wired;
+
+        for(i = 0; i < n_nodes; i++)
+        {
+            nodes[i].pma.state.sim.rx_bus_level = bus_level;
+            nodes[i].pma.primitives.nodeclock_ind(&nodes[i].pcs, bus_level);
+        }
+        CAN_XR_MAC_Queue_NodeClock_Ind(&nodes[0].pcs);
+        caiba_sim_recv_clock(bus_level);
+
+        /* Bits sampled idle by the authenticated sender, after the
+           idle state has been entered: neither SOF nor the last bit
+           of intermission.  Its quantum counter wraps at the end of
+           the bit. */
+        if(nodes[0].pcs.state.quantum_m_cnt == 0)
+        {
+            idle = (nodes[0].mac.state.rx_fsm_state == CAN_XR_MAC_RX_FSM_IDLE);
+            if(idle && was_idle)
+                idle_bits++;
+            was_idle = idle;
+        }
+    }
+
+    caiba_sim_recv_stats(&stats);
+    for(i = 0; i < n_nodes; i++)
+        total += nodes[i].confirmed;
+
+    printf("%5d %10.1f %10.1f %6lu %8lu %8lu %6lu %5lu %6lu %6lu\n",
+           n_background,
+           total * (double)CAN_XR_BIT_RATE / BITS,
+           nodes[0].confirmed * (double)CAN_XR_BIT_RATE / BITS,
+           idle_bits, nodes[0].mac.state.arbitration_lost,
+           stats.correct, stats.incorrect, stats.gaps,
+           stats.errors, caiba_sim_auth_errors());
+    if(skip_every && error_hinted)
+        printf("      %lu nonce skips, %lu errors injected, %lu frames realigned,",
+               skips, injected, stats.realigned);
+    else if(skip_every)
+        printf("      %lu nonce skips, %lu frames realigned,", skips, stats.realigned);
+    else if(aggregate_k)
+        printf("     ");
+    if(skip_every || aggregate_k)
+        printf(" %.1f payload bytes/s\n",
+               stats.authenticated
+               * (double)(CAIBA_SIM_AGG_PAYLOAD_LEN - CAIBA_SIM_SEQ_BYTE(CAN_XR_NONCE_HINT_BITS))
+               * CAN_XR_BIT_RATE / BITS);
+}
+
+/* 0 if bpmac_pre_begin() and bpmac_pre_step() compute the FIPS-197
+   example and then agree with mbedtls_aes_crypt_ecb() on a chain of
+   nonces, each one the previous ciphertext with the bits bpmac uses to
+   index the nonce cache cleared, so that each one misses the cache */
+static int aes_check(void)
+{
+    static const uint8_t key[16] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+    static const uint8_t plaintext[16] = {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+        0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+    static const uint8_t ciphertext[16] = {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+        0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a};
+    uint64_t nonce[2];      /* bpmac reads nonces as 64-bit words */
+    uint8_t expected[16];
+    char mac_key[16] = {0};
+    bpmac_ctx_t ctx;
+    mbedtls_aes_context aes_ctx;
+    int block, rounds;
+    int bad = 0;
+
+    bpmac_init(mac_key, (char *)key, 1, &ctx);
+    mbedtls_aes_init(&aes_ctx);
+    mbedtls_aes_setkey_enc(&aes_ctx, key, 128);
+
+    memcpy(nonce, plaintext, 16);
+    for(block = 0; block <= AES_CHECK_BLOCKS && !bad; block++)
+    {
+        mbedtls_aes_crypt_ecb(&aes_ctx, MBEDTLS_AES_ENCRYPT, (uint8_t *)nonce, expected);
+
+        rounds = 0;
+        if(bpmac_pre_begin(&ctx, (uint8_t *)nonce, NULL) != 0)
+            bad = 1;
+        else
+            while(!bpmac_pre_step(&ctx, NULL))
+                rounds++;
+
+        if(bad || rounds != 9 || memcmp(ctx.nonce_cache, expected, 16) != 0 ||
+           (block == 0 && memcmp(ctx.nonce_cache, ciphertext, 16) != 0))
+        {
+            fprintf(stderr, "caiba_sim: bpmac AES-128 differs from %s for nonce %d\n",
+                    (block == 0) ? "FIPS-197" : "mbedtls_aes_crypt_ecb()", block);
+            bad = 1;
+        }
+
+        memcpy(nonce, expected, 16);
+        ((uint8_t *)nonce)[0] &= ~3;
+    }
+
+    mbedtls_aes_free(&aes_ctx);
+    bpmac_deinit(&ctx);
+    return bad;
+}
+
+/* All runs, from no background sender to MAX_BACKGROUND */
+static void sweep(void)
+{
+    int n_background;
+
+    printf("bg.   frames/s   auth f/s   idle arb.lost  correct  wrong   gaps "
+           "rx.err au.err\n");
+
+    for(n_background = 0; n_background <= MAX_BACKGROUND; n_background++)
+        run(n_background);
+
+    if(latency)
+    {
+        printf("\n");
+        CAN_XR_Latency_Dump(stdout, "Sender", &sender_latency);
+        printf("\n");
+        caiba_sim_auth_latency(stdout, "Authenticator");
+        printf("\n");
+        caiba_sim_recv_latency(stdout, "Receiver");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int report = 0;
+    int i;
+
+    for(i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-x") == 0)
+        {
+            auth_format = CAN_XR_FORMAT_CEFF;
+            auth_identifier = ((uint32_t)AUTH_IDENTIFIER << 18) | AUTH_EXTENSION;
+        }
+        else if(strcmp(argv[i], "-f") == 0)
+            background_fd = 1;
+        else if(strcmp(argv[i], "-l") == 0)
+            latency = 1;
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            skip_every = strtoul(argv[++i], NULL, 0);
+        else if(strcmp(argv[i], "-e") == 0)
+            error_hinted = 1;
+        else if(strcmp(argv[i], "-r") == 0)
+            report = 1;
+        else if(strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+            aggregate_k = atoi(argv[++i]);
+    }
+
+    if(aggregate_k && (aggregate_k < 2 || aggregate_k > CAIBA_SIM_AGG_MAX))
+    {
+        fprintf(stderr, "caiba_sim: -a K needs K in [2, %d]\n", CAIBA_SIM_AGG_MAX);
+        return EXIT_FAILURE;
+    }
+
+    if(error_hinted && !skip_every)
+    {
+        fprintf(stderr, "caiba_sim: -e needs -s K\n");
+        return EXIT_FAILURE;
+    }
+
+    if(aes_check())
+        return EXIT_FAILURE;
+
+    aggregate = aggregate_k;
+    if(report)
+        CAN_XR_Auth_Policy_Report("caiba_sim", set_policy(), CAN_XR_BIT_RATE);
+
+    printf("%d bit/s, %d bits per run, authenticated frames %s, background %s",
+           CAN_XR_BIT_RATE, BITS,
+           (auth_format == CAN_XR_FORMAT_CEFF) ? "CEFF" : "CBFF",
+           background_fd ? "FBFF" : "CBFF");
+    if(skip_every)
+        printf(", nonce skip every %lu frames, %d hint bits", skip_every, CAN_XR_NONCE_HINT_BITS);
+    printf("\n\n");
+
+    if(!aggregate_k)
+    {
+        sweep();
+        return EXIT_SUCCESS;
+    }
+
+    aggregate = 0;
+    printf("MAC in every frame, %d bytes\n", CAN_XR_AUTH_MAC_LEN_DEFAULT);
+    sweep();
+
+    aggregate = aggregate_k;
+    printf("\nAggregated, checkpoint every %d frames, %d MAC bytes, %d in the others\n",
+           aggregate, CAN_XR_AUTH_MAC_LEN_DEFAULT, CAIBA_SIM_AGG_MAC_LEN_SHORT);
+    sweep();
+
+    return EXIT_SUCCESS;
+}
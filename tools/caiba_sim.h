@@ -0,0 +1,107 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Interface between caiba_sim.c and the authenticator and receiver
+   it connects to the bus.  The node directories share type names
+   with different layouts, so each node is built in its own
+   translation unit, against the headers of its own directory, and
+   exports nothing but these functions, see caiba_sim.sh.  Nothing
+   here depends on the CAN_XR headers.
+*/
+
+#ifndef CAIBA_SIM_H
+#define CAIBA_SIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Identifiers authenticated by all nodes, with the default rule.
+   The authentication policy of every node is changed accordingly.
+*/
+#define CAIBA_SIM_AUTH_FIRST 0x100
+#define CAIBA_SIM_AUTH_LAST  0x1FF
+
+/* First payload byte of the sequence number of authenticated frames.
+   With nonce hints, the sender puts the hint in the first one.  All
+   nodes are built with the same CAN_XR_NONCE_HINT_BITS.
+*/
+#define CAIBA_SIM_SEQ_BYTE(hint_bits) ((hint_bits) > 0 ? 1 : 0)
+
+/* Aggregated mode of the rule, caiba_sim -a: payload bytes of all
+   authenticated frames, MAC bytes of the frames that are not
+   checkpoints and longest window.  Checkpoints keep the default MAC
+   length.  The nodes get the window length as the 'aggregate'
+   argument of their _Init(), 0 for a MAC in every frame.
+*/
+#define CAIBA_SIM_AGG_PAYLOAD_LEN 5
+#define CAIBA_SIM_AGG_MAC_LEN_SHORT 1
+#define CAIBA_SIM_AGG_MAX 32
+
+/* The authenticator.  _Clock() feeds it with the bus level sampled
+   at one nodeclock edge.  _Drive() returns 1 and the forced level in
+   '*bus_level' while it overwrites the bus, 0 otherwise.
+*/
+void caiba_sim_auth_init(int aggregate);
+void caiba_sim_auth_clock(int bus_level);
+int caiba_sim_auth_drive(int *bus_level);
+unsigned long caiba_sim_auth_errors(void);
+
+/* 1 from the first payload byte of an authenticated frame to the
+   next SOF if the authenticator moved its nonce forward by the nonce
+   hint of the frame, 0 otherwise.
+*/
+int caiba_sim_auth_hinted(void);
+
+/* Print on 'f' the latency histograms of the authenticator since
+   _Init(), see CAN_XR_Latency_Dump().
+*/
+void caiba_sim_auth_latency(FILE *f, const char *desc);
+
+/* The receiver.  It verifies the group tag of every authenticated
+   frame like 01_can_sw_receiver.c, nonce hints and aggregated mode
+   included, and checks that the sequence number grows by one from
+   frame to frame.  In aggregated mode, the frames of a window are
+   authenticated when the tag of its checkpoint is verified.
+   _Level() is the bus level it drives, to acknowledge frames.
+*/
+struct caiba_sim_recv_stats
+{
+    unsigned long frames;       /* All frames received */
+    unsigned long correct;      /* Authenticated frames, tag verified */
+    unsigned long incorrect;    /* Authenticated frames, wrong tag */
+    unsigned long gaps;         /* Sequence numbers skipped or repeated */
+    unsigned long realigned;    /* Verified after moving the nonce forward by the hint */
+    unsigned long authenticated;    /* Frames whose window ended with a tag verified */
+    unsigned long errors;       /* Error frames seen */
+};
+
+void caiba_sim_recv_init(int aggregate);
+void caiba_sim_recv_clock(int bus_level);
+int caiba_sim_recv_level(void);
+void caiba_sim_recv_stats(struct caiba_sim_recv_stats *stats);
+
+/* The same for the receiver, which also accounts the time from SOF
+   to the verification of the group tag.
+*/
+void caiba_sim_recv_latency(FILE *f, const char *desc);
+
+#endif
@@ -0,0 +1,67 @@
+#!/bin/sh
+# Build caiba_sim, see caiba_sim.c.
+#
+# The sender, the authenticator and the receiver are each compiled
+# against the headers of their own directory and linked into a
+# relocatable object whose symbols are all made local, except the
+# caiba_sim_* interface of caiba_sim.h.  The host/ directory provides
+# a stand-in for LED_Config.h and the mbed TLS AES functions bpmac
+# needs, on top of OpenSSL.
+#
+# Usage: ./caiba_sim.sh [CC [CFLAGS]]
+
+set -e
+
+cd "$(dirname "$0")"
+
+CC=${1:-cc}
+CFLAGS=${2:--O2}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# node DIR ADAPTER SOURCES...
+node()
+{
+    dir=$1
+    adapter=$2
+    shift 2
+    for src in "$adapter" "$@" "../$dir/lib/bpmac/bpmac.c"; do
+        $CC $CFLAGS -Ihost -I"../$dir/include" -I"../$dir/lib/bpmac" -c "$src" \
+            -o "$TMP/$dir-$(basename "$src" .c).o"
+    done
+    ld -r -o "$TMP/$dir.o" "$TMP/$dir"-*.o
+    objcopy --wildcard --keep-global-symbol='caiba_sim_*' "$TMP/$dir.o"
+}
+
+C=src/CAN_XR_Controller
+
+node authenticator caiba_sim_auth.c \
+    ../authenticator/$C/CAN_XR_MAC_Common.c \
+    ../authenticator/$C/CAN_XR_PCS.c \
+    ../authenticator/$C/CAN_XR_PMA_Common.c \
+    ../authenticator/$C/CAN_XR_Auth_Policy.c \
+    ../authenticator/$C/CAN_XR_Metrics.c \
+    ../authenticator/$C/CAN_XR_Latency.c
+
+node receiver caiba_sim_recv.c \
+    ../receiver/$C/CAN_XR_MAC_Common.c \
+    ../receiver/$C/CAN_XR_MAC_Queue.c \
+    ../receiver/$C/CAN_XR_PCS.c \
+    ../receiver/$C/CAN_XR_PMA_Common.c \
+    ../receiver/$C/CAN_XR_Auth_Policy.c \
+    ../receiver/$C/CAN_XR_Metrics.c \
+    ../receiver/$C/CAN_XR_Latency.c
+
+$CC $CFLAGS -Ihost -I../sender/include -I../sender/lib/bpmac -o caiba_sim caiba_sim.c \
+    ../sender/$C/CAN_XR_MAC_Common.c \
+    ../sender/$C/CAN_XR_MAC_Queue.c \
+    ../sender/$C/CAN_XR_Signer.c \
+    ../sender/$C/CAN_XR_PCS.c \
+    ../sender/$C/CAN_XR_PMA_Common.c \
+    ../sender/$C/CAN_XR_Auth_Policy.c \
+    ../sender/$C/CAN_XR_Auth_Policy_Report.c \
+    ../sender/$C/CAN_XR_Metrics.c \
+    ../sender/$C/CAN_XR_Latency.c \
+    ../sender/lib/bpmac/bpmac.c \
+    host/mbedtls_aes.c \
+    "$TMP/authenticator.o" "$TMP/receiver.o" -lcrypto
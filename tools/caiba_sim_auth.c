@@ -0,0 +1,141 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* The authenticator of caiba_sim.c, see caiba_sim.h.
+
+   Its PMA has no transmitter of its own: in the data MAC field the
+   PCS samples the bus one quantum after the synchronization segment
+   and overwrites it for the rest of the bit, like the GPIO PMA does
+   with its two transceivers, until the bus is released.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <CAN_XR_Config.h>
+#include <CAN_XR_PMA.h>
+#include <CAN_XR_PCS.h>
+#include <CAN_XR_MAC.h>
+#include <CAN_XR_Auth_Policy.h>
+#include <CAN_XR_Latency.h>
+
+#include "caiba_sim.h"
+
+static const struct CAN_XR_PCS_Bit_Time_Parameters pcs_parameters = {
+    .prescaler_m = 1,
+    .sync_seg = 1,
+    .prop_seg = 3,
+    .phase_seg1 = 2,
+    .phase_seg2 = 2,
+    .sjw = 1
+};
+
+/* Data bit time of FD frames, see caiba_sim.c */
+static const struct CAN_XR_PCS_Bit_Time_Parameters pcs_data_parameters = {
+    .prescaler_m = 1,
+    .sync_seg = 1,
+    .prop_seg = 1,
+    .phase_seg1 = 1,
+    .phase_seg2 = 1,
+    .sjw = 1
+};
+
+/* Not on the stack, the key slots of the MAC are too large for it. */
+static struct CAN_XR_MAC mac;
+static struct CAN_XR_PCS pcs;
+static struct CAN_XR_PMA pma;
+
+static int overwriting;
+static int overwrite_level;
+static enum CAN_XR_MAC_RX_FSM_State prev_rx;
+static unsigned long errors;
+static struct CAN_XR_Latency latency;
+
+static void data_mac_req(struct CAN_XR_PMA *pma, int bus_level)
+{
+    (void)pma;
+    overwriting = 1;
+    overwrite_level = bus_level;
+}
+
+static void tx_reset()
+{
+    overwriting = 0;
+}
+
+void caiba_sim_auth_init(int aggregate)
+{
+    struct CAN_XR_Auth_Policy *policy = CAN_XR_Auth_Policy_Default();
+
+    CAN_XR_Auth_Policy_Set_Rule(policy, 0, CAN_XR_AUTH_MAC_LEN_DEFAULT, 0);
+    if(aggregate)
+        CAN_XR_Auth_Policy_Set_Aggregation(policy, 0, aggregate,
+                                           CAIBA_SIM_AGG_MAC_LEN_SHORT, CAIBA_SIM_AGG_PAYLOAD_LEN);
+    CAN_XR_Auth_Policy_Map(policy, 0, CAN_XR_AUTH_POLICY_IDS - 1, CAN_XR_AUTH_NO_RULE);
+    CAN_XR_Auth_Policy_Map(policy, CAIBA_SIM_AUTH_FIRST, CAIBA_SIM_AUTH_LAST, 0);
+
+    CAN_XR_PCS_Init(&pcs, &pcs_parameters, &pma);
+    CAN_XR_PCS_Set_Data_Bit_Time(&pcs, &pcs_data_parameters);
+    pma.primitives.data_req = NULL;
+    pma.primitives.data_mac_req = data_mac_req;
+    pma.primitives.tx_reset = tx_reset;
+    CAN_XR_MAC_Common_Init(&mac, &pcs);
+    CAN_XR_Latency_Init(&latency);
+    CAN_XR_MAC_Set_Latency(&mac, &latency);
+
+    overwriting = 0;
+    prev_rx = mac.state.rx_fsm_state;
+    errors = 0;
+}
+
+void caiba_sim_auth_clock(int bus_level)
+{
+    pma.primitives.nodeclock_ind(&pcs, bus_level);
+
+    if(mac.state.rx_fsm_state == CAN_XR_MAC_RX_FSM_ERROR
+       && prev_rx != CAN_XR_MAC_RX_FSM_ERROR)
+        errors++;
+    prev_rx = mac.state.rx_fsm_state;
+}
+
+int caiba_sim_auth_drive(int *bus_level)
+{
+    *bus_level = overwrite_level;
+    return overwriting;
+}
+
+unsigned long caiba_sim_auth_errors(void)
+{
+    return errors;
+}
+
+int caiba_sim_auth_hinted(void)
+{
+    return mac.state.nonce_delta != 0;
+}
+
+void caiba_sim_auth_latency(FILE *f, const char *desc)
+{
+    CAN_XR_Latency_Dump(f, desc, &latency);
+}
@@ -0,0 +1,238 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* The receiver of caiba_sim.c, see caiba_sim.h.
+
+   Frames reach the verification through CAN_XR_MAC_Queue, like in
+   01_can_sw_receiver.c, and the queue is drained on every nodeclock.
+   The verification is the one of 01_can_sw_receiver.c, realignment
+   with the nonce hint and aggregated mode included, without the explicit nonce
+   resynchronization and the signalling frames.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <CAN_XR_Config.h>
+#include <CAN_XR_PMA.h>
+#include <CAN_XR_PCS.h>
+#include <CAN_XR_MAC.h>
+#include <CAN_XR_MAC_Queue.h>
+#include <CAN_XR_Auth_Policy.h>
+#include <CAN_XR_Latency.h>
+#include "../receiver/lib/bpmac/bpmac.h"
+
+#include "caiba_sim.h"
+
+static const struct CAN_XR_PCS_Bit_Time_Parameters pcs_parameters = {
+    .prescaler_m = 1,
+    .sync_seg = 1,
+    .prop_seg = 3,
+    .phase_seg1 = 2,
+    .phase_seg2 = 2,
+    .sjw = 1
+};
+
+/* Data bit time of FD frames, see caiba_sim.c */
+static const struct CAN_XR_PCS_Bit_Time_Parameters pcs_data_parameters = {
+    .prescaler_m = 1,
+    .sync_seg = 1,
+    .prop_seg = 1,
+    .phase_seg1 = 1,
+    .phase_seg2 = 1,
+    .sjw = 1
+};
+
+static struct CAN_XR_MAC mac;
+static struct CAN_XR_PCS pcs;
+static struct CAN_XR_PMA pma;
+static struct CAN_XR_MAC_Queue queue;
+
+static bpmac_ctx_t ctx_grp;
+static uint64_t grp_nonce[2];
+static const uint8_t grp_key[] = {0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00,0xFF, 0x00};
+static const uint8_t grp_key_nonce[] = {0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF,0x00, 0xFF};
+
+static struct caiba_sim_recv_stats stats;
+static uint16_t seq_expected;
+static enum CAN_XR_MAC_RX_FSM_State prev_rx;
+static struct CAN_XR_Latency latency;
+
+/* Aggregated mode: XOR of the group tags since the last checkpoint
+   and SOF of the frames it covers, authenticated with the checkpoint
+*/
+static uint8_t agg_grp_mac[16];
+static unsigned long agg_sof_ts[CAIBA_SIM_AGG_MAX];
+static int agg_frames;
+
+static void bus_data_req(struct CAN_XR_PMA *pma, int level)
+{
+    pma->state.sim.tx_bus_level = level;
+}
+
+static void data_ind(
+    struct CAN_XR_LLC *llc, unsigned long ts, uint32_t identifier,
+    enum CAN_XR_Format format, int dlc, uint8_t *data)
+{
+    uint32_t key = CAN_XR_Auth_Policy_Key(identifier, format == CAN_XR_FORMAT_CEFF);
+    int mac_len = CAN_XR_Auth_Policy_MAC_Len(mac.policy, key, dlc);
+    const struct CAN_XR_Auth_Rule *rule = CAN_XR_Auth_Policy_Rule(mac.policy, key);
+    int cls = CAN_XR_Latency_Class(mac.policy, key);
+    /* The frame is still in the receive ring */
+    unsigned long sof_ts = CAN_XR_MAC_Queue_Rx_Frame(&queue)->sof_ts;
+    uint8_t grp_mac[16] = {0};
+    uint64_t nonce[2] = { grp_nonce[0], grp_nonce[1] };
+    const uint8_t *seq_byte = data + CAIBA_SIM_SEQ_BYTE(CAN_XR_NONCE_HINT_BITS);
+    uint64_t delta = 0;
+    uint16_t seq;
+    int checkpoint;
+    int i;
+
+    (void)llc;
+    (void)ts;
+
+    stats.frames++;
+    if(mac_len == 0)
+        return;
+    checkpoint = CAN_XR_Auth_Policy_Is_Checkpoint(rule, mac_len);
+
+#if CAN_XR_NONCE_HINT_BITS > 0
+    /* The new nonce is only kept if the tag is correct */
+    delta = CAN_XR_NONCE_HINT_DELTA(CAN_XR_NONCE_HINT_GRP(data[0]), nonce[0]);
+    if((nonce[0] += delta) < delta)
+        nonce[1]++;
+#endif
+
+    bpmac_pre(&ctx_grp, (uint8_t *) nonce, (char *) grp_mac);
+
+    /* msg id is covered by MAC, all 29 bits of it in CEFF */
+    bpmac_update_id(&ctx_grp, identifier, (format == CAN_XR_FORMAT_CEFF) ? 29 : 11, (char *) grp_mac);
+    bpmac_sign(&ctx_grp, (char *) data, dlc - mac_len, (char *) grp_mac);
+
+    /* A checkpoint carries the cumulative tag of the window */
+    if(rule->aggregate && checkpoint)
+        xor_tags(grp_mac, agg_grp_mac);
+
+    if(memcmp(data + dlc - mac_len, grp_mac + MAC_LEN - mac_len, mac_len) == 0)
+    {
+        stats.correct++;
+        if(delta)
+            stats.realigned++;
+        grp_nonce[0] = nonce[0];
+        grp_nonce[1] = nonce[1];
+
+        if(checkpoint)
+        {
+            for(i = 0; i < agg_frames; i++)
+                CAN_XR_Latency_Record(&latency, cls, CAN_XR_LATENCY_VERIFIED,
+                                      pcs.state.nodeclock_ts - agg_sof_ts[i]);
+            CAN_XR_Latency_Record(&latency, cls, CAN_XR_LATENCY_VERIFIED,
+                                  pcs.state.nodeclock_ts - sof_ts);
+            stats.authenticated += agg_frames + 1;
+        }
+    }
+    else
+        stats.incorrect++;
+
+    if(rule->aggregate)
+    {
+        if(checkpoint)
+        {
+            memset(agg_grp_mac, 0, sizeof(agg_grp_mac));
+            agg_frames = 0;
+        }
+        else
+        {
+            xor_tags(agg_grp_mac, grp_mac);
+            if(agg_frames < CAIBA_SIM_AGG_MAX)
+                agg_sof_ts[agg_frames++] = sof_ts;
+        }
+    }
+
+    if(++grp_nonce[0] == 0)
+        grp_nonce[1]++;
+
+    seq = seq_byte[0] | (seq_byte[1] << 8);
+    if(seq != seq_expected)
+        stats.gaps++;
+    seq_expected = seq + 1;
+}
+
+void caiba_sim_recv_init(int aggregate)
+{
+    struct CAN_XR_Auth_Policy *policy = CAN_XR_Auth_Policy_Default();
+
+    CAN_XR_Auth_Policy_Set_Rule(policy, 0, CAN_XR_AUTH_MAC_LEN_DEFAULT, 0);
+    if(aggregate)
+        CAN_XR_Auth_Policy_Set_Aggregation(policy, 0, aggregate,
+                                           CAIBA_SIM_AGG_MAC_LEN_SHORT, CAIBA_SIM_AGG_PAYLOAD_LEN);
+    CAN_XR_Auth_Policy_Map(policy, 0, CAN_XR_AUTH_POLICY_IDS - 1, CAN_XR_AUTH_NO_RULE);
+    CAN_XR_Auth_Policy_Map(policy, CAIBA_SIM_AUTH_FIRST, CAIBA_SIM_AUTH_LAST, 0);
+
+    bpmac_init((char *) grp_key, (char *) grp_key_nonce, CAN_XR_AUTH_MSG_MAX_SIZE, &ctx_grp);
+    memset(grp_nonce, 0, sizeof(grp_nonce));
+    memset(agg_grp_mac, 0, sizeof(agg_grp_mac));
+    agg_frames = 0;
+
+    CAN_XR_PCS_Init(&pcs, &pcs_parameters, &pma);
+    CAN_XR_PCS_Set_Data_Bit_Time(&pcs, &pcs_data_parameters);
+    pma.primitives.data_req = bus_data_req;
+    pma.state.sim.tx_bus_level = 1;
+    CAN_XR_MAC_Common_Init(&mac, &pcs);
+    CAN_XR_MAC_Queue_Init(&queue, &mac);
+    CAN_XR_MAC_Queue_Set_Data_Ind(&queue, data_ind);
+    CAN_XR_Latency_Init(&latency);
+    CAN_XR_MAC_Set_Latency(&mac, &latency);
+
+    memset(&stats, 0, sizeof(stats));
+    seq_expected = 0;
+    prev_rx = mac.state.rx_fsm_state;
+}
+
+void caiba_sim_recv_clock(int bus_level)
+{
+    pma.state.sim.rx_bus_level = bus_level;
+    pma.primitives.nodeclock_ind(&pcs, bus_level);
+    CAN_XR_MAC_Queue_Dispatch(&queue);
+
+    if(mac.state.rx_fsm_state == CAN_XR_MAC_RX_FSM_ERROR
+       && prev_rx != CAN_XR_MAC_RX_FSM_ERROR)
+        stats.errors++;
+    prev_rx = mac.state.rx_fsm_state;
+}
+
+int caiba_sim_recv_level(void)
+{
+    return pma.state.sim.tx_bus_level;
+}
+
+void caiba_sim_recv_stats(struct caiba_sim_recv_stats *s)
+{
+    *s = stats;
+}
+
+void caiba_sim_recv_latency(FILE *f, const char *desc)
+{
+    CAN_XR_Latency_Dump(f, desc, &latency);
+}
@@ -0,0 +1,231 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Converter of the software logic analyzer, see CAN_XR_Capture.h.
+
+   Reads a dump written by CAN_XR_Capture_Dump() and writes it on
+   standard output as a Value Change Dump, for GTKWave and other
+   waveform viewers.  Level channels become wires, 1 bit wide for the
+   DEBUG channels and 8 for the receive FSM state, the others VCD
+   events.  Times are in nanoseconds from the first record; the 32-bit
+   timestamps are unwrapped, which takes at least one record per
+   counter period, about 44 s on the board.  Records reserved by a
+   context and preempted by another may come slightly out of order
+   and are sorted.
+
+   Build, from this directory:
+
+     cc -O2 -o capture_vcd capture_vcd.c
+
+   Usage: capture_vcd capture.bin > capture.vcd
+
+   On the board the dump goes over the serial port, see
+   01_can_sw_receiver.c, or can be taken with the debugger.  On the
+   host, bus_sim.c writes one with -c when built with -DENABLE_CAPTURE
+   and CAN_XR_Capture.c, see there.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CHANNELS_MAX 32
+
+struct channel
+{
+    char name[13];
+    uint32_t width;     /* 0 for events */
+    char id;
+};
+
+struct record
+{
+    uint64_t ts;        /* Unwrapped */
+    uint32_t pos;       /* Position in the dump, to keep the sort stable */
+    int channel;
+    uint32_t value;
+};
+
+static void *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    char *buf;
+    long n;
+
+    if(f == NULL || fseek(f, 0, SEEK_END) != 0 || (n = ftell(f)) < 0)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    rewind(f);
+    buf = malloc(n + 1);
+    if(buf == NULL || fread(buf, 1, n, f) != (size_t)n)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    fclose(f);
+    *size = n;
+    return buf;
+}
+
+static int by_time(const void *a, const void *b)
+{
+    const struct record *ra = a, *rb = b;
+
+    if(ra->ts != rb->ts)
+        return (ra->ts < rb->ts) ? -1 : 1;
+    return (ra->pos < rb->pos) ? -1 : (ra->pos > rb->pos);
+}
+
+static void print_value(const struct channel *c, uint32_t value)
+{
+    int b;
+
+    if(c->width == 0)
+        printf("1%c\n", c->id);
+    else if(c->width == 1)
+        printf("%d%c\n", value != 0, c->id);
+    else
+    {
+        putchar('b');
+        for(b = c->width - 1; b >= 0; b--)
+            putchar((value >> b) & 1 ? '1' : '0');
+        printf(" %c\n", c->id);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    struct channel channel[CHANNELS_MAX];
+    struct record *record;
+    const char *dump;
+    size_t size, pos, n = 0, i;
+    uint32_t hz, channels, prev = 0;
+    uint64_t high = 0, t, last = UINT64_MAX;
+
+    if(argc != 2)
+    {
+        fprintf(stderr, "Usage: %s capture.bin > capture.vcd\n", argv[0]);
+        return 1;
+    }
+
+    dump = read_file(argv[1], &size);
+
+    /* "CXCA", timestamp frequency, number of channels, then the
+       channels: name and width, then the records: timestamp, channel
+       and value.
+    */
+    if(size < 12 || memcmp(dump, "CXCA", 4) != 0)
+    {
+        fprintf(stderr, "%s: not a capture dump\n", argv[1]);
+        return 1;
+    }
+
+    memcpy(&hz, dump + 4, 4);
+    memcpy(&channels, dump + 8, 4);
+    if(hz == 0 || channels > CHANNELS_MAX || size < 12 + 16 * (size_t)channels)
+    {
+        fprintf(stderr, "%s: bad header\n", argv[1]);
+        return 1;
+    }
+
+    for(i = 0; i < channels; i++)
+    {
+        memcpy(channel[i].name, dump + 12 + 16 * i, 12);
+        channel[i].name[12] = '\0';
+        memcpy(&channel[i].width, dump + 12 + 16 * i + 12, 4);
+        if(channel[i].width > 24)
+            channel[i].width = 24;
+        channel[i].id = '!' + i;
+    }
+
+    pos = 12 + 16 * (size_t)channels;
+    record = malloc((size - pos) / 8 * sizeof(*record) + 1);
+    if(record == NULL)
+    {
+        perror("malloc");
+        return 1;
+    }
+
+    /* A timestamp much smaller than the previous one has wrapped */
+    for(; pos + 8 <= size; pos += 8)
+    {
+        uint32_t ts, word;
+
+        memcpy(&ts, dump + pos, 4);
+        memcpy(&word, dump + pos + 4, 4);
+        if(n > 0 && ts < prev && prev - ts > UINT32_MAX / 2)
+            high += 1ULL << 32;
+        else if(n > 0 && ts > prev && ts - prev > UINT32_MAX / 2 && high > 0)
+            high -= 1ULL << 32;  /* Late record from before the wrap */
+
+        record[n].ts = high + ts;
+        record[n].pos = n;
+        record[n].channel = word >> 24;
+        record[n].value = word & 0xFFFFFF;
+        if(record[n].channel >= (int)channels)
+            continue;
+        prev = ts;
+        n++;
+    }
+
+    qsort(record, n, sizeof(*record), by_time);
+
+    printf("$version capture_vcd %s $end\n", argv[1]);
+    printf("$comment %lu records, timestamps at %lu Hz $end\n",
+           (unsigned long)n, (unsigned long)hz);
+    printf("$timescale 1 ns $end\n");
+    printf("$scope module can_xr $end\n");
+    for(i = 0; i < channels; i++)
+        printf("$var %s %lu %c %s $end\n",
+               channel[i].width ? "wire" : "event",
+               (unsigned long)(channel[i].width ? channel[i].width : 1),
+               channel[i].id, channel[i].name);
+    printf("$upscope $end\n$enddefinitions $end\n");
+
+    /* Levels are unknown up to their first record */
+    printf("$dumpvars\n");
+    for(i = 0; i < channels; i++)
+    {
+        if(channel[i].width == 1)
+            printf("x%c\n", channel[i].id);
+        else if(channel[i].width > 1)
+            printf("bx %c\n", channel[i].id);
+    }
+    printf("$end\n");
+
+    for(i = 0; i < n; i++)
+    {
+        t = (uint64_t)((double)(record[i].ts - record[0].ts) * 1e9 / hz + 0.5);
+        if(t != last)
+            printf("#%llu\n", (unsigned long long)t);
+        last = t;
+        print_value(&channel[record[i].channel], record[i].value);
+    }
+
+    fprintf(stderr, "%lu records\n", (unsigned long)n);
+    return 0;
+}
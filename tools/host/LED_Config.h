@@ -0,0 +1,29 @@
+/* Host stand-in for the LED_Config.h of the nodes, whose macros write
+   to the GPIO registers of the LPC1768.  Put this directory first in
+   the include path when building the node sources on a host.
+*/
+
+#ifndef SDCC_LED_CONFIG_H
+#define SDCC_LED_CONFIG_H
+
+#define led1        18
+#define led2        20
+#define led3        21
+#define led4        23
+
+#define enable_leds()
+#define led_on(x)
+#define led_off(x)
+#define reset_leds()
+#define led_set_all()
+#define led_status(x)    0
+
+#define enable_debug_pins()
+#define dbug_on()
+#define dbug2_on()
+#define dbug3_on()
+#define dbug_off()
+#define dbug2_off()
+#define dbug3_off()
+
+#endif //SDCC_LED_CONFIG_H
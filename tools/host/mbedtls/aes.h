@@ -0,0 +1,25 @@
+/* Host stand-in for the part of the mbed TLS AES interface used by
+   bpmac, implemented on top of OpenSSL by ../mbedtls_aes.c.  Only
+   encryption in ECB mode is supported.
+*/
+
+#ifndef MBEDTLS_AES_H
+#define MBEDTLS_AES_H
+
+#include <openssl/aes.h>
+
+#define MBEDTLS_AES_ENCRYPT 1
+
+typedef struct
+{
+    AES_KEY key;
+} mbedtls_aes_context;
+
+void mbedtls_aes_init(mbedtls_aes_context *ctx);
+void mbedtls_aes_free(mbedtls_aes_context *ctx);
+int mbedtls_aes_setkey_enc(mbedtls_aes_context *ctx, const unsigned char *key,
+                           unsigned int keybits);
+int mbedtls_aes_crypt_ecb(mbedtls_aes_context *ctx, int mode,
+                          const unsigned char input[16], unsigned char output[16]);
+
+#endif
@@ -0,0 +1,11 @@
+/* Host stand-in.  bpmac uses nothing from it, but relies on it for
+   <stdint.h>, like the real one.
+*/
+
+#ifndef MBEDTLS_MD_H
+#define MBEDTLS_MD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#endif
@@ -0,0 +1,387 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Host emulation of the interrupt-driven execution model of the GPIO
+   PMA (CAN_XR_PMA_GPIO_Start()), to test the queue semantics and
+   measure worst-case latencies on Linux.
+
+   The Timer 0 interrupt is emulated by a thread running at the
+   highest SCHED_FIFO priority, when permitted, woken up once per
+   nodeclock period.  In each period it invokes
+   CAN_XR_MAC_Queue_NodeClock_Ind(), like the PMA does, then advances
+   an emulated MAC.  The emulated MAC transmits each frame it is given
+   for FRAME_NODECLOCKS periods, then confirms it, and receives a frame
+   every RX_PERIOD periods.  Like the real one, it receives the data
+   field in place in a slot of the receive ring, one byte per period,
+   and commits the slot at the end; each frame carries its sequence
+   number and its complement, so that a frame seen before it is
+   complete does not go unnoticed.  The main thread is the foreground
+   loop: it dispatches indications and confirmations and keeps the
+   request queue full, spinning for a configurable time per frame to
+   emulate MAC computation.
+
+   Like the GPIO PMA, the interrupt thread checks that one nodeclock
+   period has elapsed since its previous wakeup and accounts the
+   periods it missed with CAN_XR_PMA_Overrun(), to the state of the
+   emulated MAC: 1 while it receives a frame, 0 otherwise.
+
+   The real CAN_XR_MAC_Queue.c and CAN_XR_SPSC.h of the sender are
+   used.  Sequence numbers carried in the frames detect lost,
+   duplicated or reordered frames; the program exits with status 1 if
+   there are any, besides those counted as queue overflows.
+
+   Build, from this directory:
+
+     cc -O2 -pthread -I../sender/include -o host_irq host_irq.c \
+        ../sender/src/CAN_XR_Controller/CAN_XR_MAC_Queue.c \
+        ../sender/src/CAN_XR_Controller/CAN_XR_Auth_Policy.c \
+        ../sender/src/CAN_XR_Controller/CAN_XR_PMA_Common.c \
+        ../sender/src/CAN_XR_Controller/CAN_XR_Metrics.c
+
+   Usage: host_irq [nodeclock_hz [seconds [work_us]]]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <CAN_XR_PMA.h>
+#include <CAN_XR_PCS.h>
+#include <CAN_XR_MAC_Queue.h>
+
+#define FRAME_NODECLOCKS 100
+#define RX_PERIOD 150
+#define RX_IDENTIFIER 300
+
+static struct CAN_XR_MAC mac;
+static struct CAN_XR_PCS pcs;
+static struct CAN_XR_PMA pma;
+static struct CAN_XR_MAC_Queue queue;
+
+static long period_ns;
+static int running = 1;
+static unsigned long nodeclocks;
+
+#define NODECLOCKS() __atomic_load_n(&nodeclocks, __ATOMIC_RELAXED)
+
+/* Emulated MAC and statistics of the interrupt thread */
+static int tx_left;
+static int rx_active;
+static struct CAN_XR_MAC_Rx_Frame *rx_slot;
+static uint32_t tx_identifier;
+static uint32_t rx_seq;
+static long max_late_ns;
+static unsigned long max_req_wait;
+
+/* Statistics of the foreground loop */
+static uint32_t tx_seq;
+static uint32_t conf_seq;
+static uint32_t ind_seq;
+static unsigned long max_latency;
+static unsigned long sum_latency;
+static unsigned long events;
+static unsigned long seq_errors;
+
+/* --- MAC, stubbed: the interrupt thread is the bit engine --- */
+
+void CAN_XR_MAC_Set_LLC(struct CAN_XR_MAC *m, struct CAN_XR_LLC *llc)
+{
+    m->llc = llc;
+}
+
+void CAN_XR_MAC_Set_Rx_Ring(struct CAN_XR_MAC *m, struct CAN_XR_SPSC *rx_ring)
+{
+    m->rx_ring = rx_ring;
+}
+
+void CAN_XR_MAC_Set_Data_Conf(struct CAN_XR_MAC *m, CAN_XR_MAC_Data_Conf_t data_conf)
+{
+    m->primitives.data_conf = data_conf;
+}
+
+/* The payload carries the sequence number and the nodeclock at which
+   the request has been queued.
+*/
+void CAN_XR_MAC_Data_Req(
+    struct CAN_XR_MAC *m,
+    uint32_t identifier, enum CAN_XR_Format format, int dlc, uint8_t *data, uint8_t *data_mac)
+{
+    uint32_t queued;
+
+    (void)format;
+    (void)dlc;
+    (void)data_mac;
+
+    if(m->state.data_req_pending)
+    {
+        fprintf(stderr, "MAC handshake error\n");
+        exit(1);
+    }
+
+    memcpy(&queued, data + 4, sizeof(queued));
+    if(nodeclocks - queued > max_req_wait)
+        max_req_wait = nodeclocks - queued;
+
+    /* A single mailbox, reported as all of them being full */
+    m->state.data_req_pending = 1;
+    m->state.mailbox_full = CAN_XR_MAC_MAILBOX_ALL;
+    tx_identifier = identifier;
+    tx_left = FRAME_NODECLOCKS;
+}
+
+/* Never invoked, the foreground loop does not flush */
+int CAN_XR_MAC_Flush_Auth(struct CAN_XR_MAC *m)
+{
+    (void)m;
+    return 0;
+}
+
+static void emulated_mac(void)
+{
+    int byte = nodeclocks % RX_PERIOD;
+
+    if(mac.state.data_req_pending && --tx_left == 0)
+    {
+        mac.state.data_req_pending = 0;
+        mac.state.mailbox_full = 0;
+        mac.primitives.data_conf(mac.llc, nodeclocks, tx_identifier,
+                                 CAN_XR_MAC_TX_STATUS_SUCCESS);
+    }
+
+    /* Data field, one byte per period: the sequence number, then its
+       complement.  A full ring loses the frame.
+    */
+    if(byte == 0)
+    {
+        rx_active = 1;
+        rx_slot = CAN_XR_SPSC_Slot(mac.rx_ring);
+    }
+
+    if(byte < 8 && rx_slot)
+    {
+        uint32_t v = (byte < 4) ? rx_seq : ~rx_seq;
+
+        rx_slot->data[byte] = (uint8_t)(v >> (8 * (byte % 4)));
+    }
+
+    if(byte == 8 && rx_active)
+    {
+        if(rx_slot)
+        {
+            rx_slot->ts = nodeclocks;
+            rx_slot->identifier = RX_IDENTIFIER;
+            rx_slot->format = CAN_XR_FORMAT_CBFF;
+            rx_slot->dlc = 8;
+            rx_slot->mac_len = 0;
+            CAN_XR_SPSC_Commit(mac.rx_ring);
+        }
+        else
+            mac.rx_ring->overflows++;
+
+        rx_active = 0;
+        rx_seq++;
+    }
+}
+
+/* state_ind primitive of the PMA */
+static int emulated_mac_state(struct CAN_XR_PCS *p)
+{
+    (void)p;
+    return rx_active;
+}
+
+static void *interrupt_thread(void *arg)
+{
+    struct timespec next, now, last;
+
+    (void)arg;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    last = next;
+
+    while(__atomic_load_n(&running, __ATOMIC_RELAXED))
+    {
+        next.tv_nsec += period_ns;
+        if(next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long late = (now.tv_sec - next.tv_sec) * 1000000000L + now.tv_nsec - next.tv_nsec;
+        if(late > max_late_ns)
+            max_late_ns = late;
+
+        long periods = ((now.tv_sec - last.tv_sec) * 1000000000L + now.tv_nsec - last.tv_nsec) / period_ns;
+        if(periods > 1)
+            CAN_XR_PMA_Overrun(&pma, nodeclocks, periods - 1);
+        last = now;
+
+        __atomic_store_n(&nodeclocks, nodeclocks + 1, __ATOMIC_RELAXED);
+        CAN_XR_MAC_Queue_NodeClock_Ind(&pcs);
+        emulated_mac();
+    }
+
+    return NULL;
+}
+
+/* --- Foreground loop --- */
+
+static void latency(unsigned long ts)
+{
+    unsigned long l = NODECLOCKS() - ts;
+
+    if(l > max_latency)
+        max_latency = l;
+    sum_latency += l;
+    events++;
+}
+
+static void fg_data_ind(
+    struct CAN_XR_LLC *llc, unsigned long ts, uint32_t identifier,
+    enum CAN_XR_Format format, int dlc, uint8_t *data)
+{
+    uint32_t seq, check;
+
+    (void)llc;
+    (void)format;
+    (void)dlc;
+
+    latency(ts);
+    memcpy(&seq, data, sizeof(seq));
+    memcpy(&check, data + 4, sizeof(check));
+    if(identifier != RX_IDENTIFIER || seq < ind_seq || check != ~seq)
+        seq_errors++;
+
+    /* Gaps are checked against the overflow count at the end */
+    ind_seq = seq + 1;
+}
+
+static void fg_data_conf(
+    struct CAN_XR_LLC *llc, unsigned long ts, uint32_t identifier,
+    enum CAN_XR_MAC_Tx_Status transmission_status)
+{
+    (void)llc;
+
+    latency(ts);
+    if(identifier != (conf_seq++ & 0x7FF)
+       || transmission_status != CAN_XR_MAC_TX_STATUS_SUCCESS)
+        seq_errors++;
+}
+
+static void spin(long us)
+{
+    struct timespec start, now;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    while((now.tv_sec - start.tv_sec) * 1000000L
+          + (now.tv_nsec - start.tv_nsec) / 1000 < us);
+}
+
+int main(int argc, char *argv[])
+{
+    long hz = (argc > 1) ? atol(argv[1]) : 20000;
+    long seconds = (argc > 2) ? atol(argv[2]) : 5;
+    long work_us = (argc > 3) ? atol(argv[3]) : 200;
+    pthread_t thread;
+    pthread_attr_t attr;
+    struct sched_param param;
+    uint8_t data_mac[16] = {0};
+    time_t end;
+
+    period_ns = 1000000000L / hz;
+
+    pcs.mac = &mac;
+    pcs.pma = &pma;
+    pma.pcs = &pcs;
+    CAN_XR_PMA_Set_State_Ind(&pma, emulated_mac_state);
+    CAN_XR_PMA_Latch_Overrun(&pma);
+    mac.policy = CAN_XR_Auth_Policy_Default();
+    CAN_XR_MAC_Queue_Init(&queue, &mac);
+    CAN_XR_MAC_Queue_Set_Data_Ind(&queue, fg_data_ind);
+    CAN_XR_MAC_Queue_Set_Data_Conf(&queue, fg_data_conf);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &param);
+
+    if(pthread_create(&thread, &attr, interrupt_thread, NULL) != 0)
+    {
+        fprintf(stderr, "SCHED_FIFO not permitted, interrupt thread at normal priority\n");
+        pthread_create(&thread, NULL, interrupt_thread, NULL);
+    }
+
+    end = time(NULL) + seconds;
+    while(time(NULL) < end)
+    {
+        uint8_t data[8];
+        uint32_t now = NODECLOCKS();
+
+        CAN_XR_MAC_Queue_Dispatch(&queue);
+
+        if(CAN_XR_SPSC_Count(&queue.req) == CAN_XR_MAC_QUEUE_LEN)
+            continue;
+
+        /* Prepare the next frame, MAC included, and queue it */
+        memcpy(data, &tx_seq, sizeof(tx_seq));
+        memcpy(data + 4, &now, sizeof(now));
+        spin(work_us);
+        if(CAN_XR_MAC_Queue_Data_Req(&queue, tx_seq & 0x7FF, CAN_XR_FORMAT_CBFF, 8, data, data_mac))
+            tx_seq++;
+    }
+
+    __atomic_store_n(&running, 0, __ATOMIC_RELAXED);
+    pthread_join(thread, NULL);
+    CAN_XR_MAC_Queue_Dispatch(&queue);
+
+    /* Lost indications must all be overflows */
+    if(rx_seq - queue.rx.overflows != events - conf_seq)
+        seq_errors++;
+
+    printf("nodeclock %ld Hz, %lu periods, worst wakeup lateness %ld ns (%.1f%% of a period)\n",
+           hz, nodeclocks, max_late_ns, 100.0 * max_late_ns / period_ns);
+    printf("frames: %lu transmitted, %lu received, %lu lost to receive ring overflow\n",
+           (unsigned long)conf_seq, (unsigned long)rx_seq, (unsigned long)queue.rx.overflows);
+    printf("request queue: worst wait %lu periods, %lu refused while full\n",
+           max_req_wait, (unsigned long)queue.req.overflows);
+    printf("receive ring and event queue: latency avg %.1f, worst %lu periods, %lu confirmations lost\n",
+           events ? (double)sum_latency / events : 0.0, max_latency,
+           (unsigned long)queue.event.overflows);
+    printf("overruns: %lu, %lu periods missed, %lu while receiving\n",
+           pma.overrun.overruns, pma.overrun.ticks, pma.overrun.state[1]);
+    if(pma.overrun.record.valid)
+        printf("first overrun: nodeclock %lu, %lu periods missed, state %d\n",
+               pma.overrun.record.nodeclock, pma.overrun.record.ticks,
+               pma.overrun.record.state);
+    printf("sequence errors: %lu\n", seq_errors);
+
+    return seq_errors ? 1 : 0;
+}
@@ -0,0 +1,423 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Microbenchmarks of the hot paths of the three nodes: the bpmac
+   kernels and the CRC, and the bit engine of each MAC, per bit and
+   per frame, on a fixed workload.  See hot_bench_node.c for what is
+   measured and how.  Build with hot_bench.sh.
+
+   Usage: hot_bench [-o FILE] [-b BASELINE] [-t PERCENT] [-n PASSES]
+
+   The process is pinned to the CPU it starts on, and the whole suite
+   runs PASSES times, 31 by default, PASS_PAUSE_MS apart, after a
+   warm-up pass.  Each result is the best of its passes: spread over
+   about a second, they sample the states a shared host goes
+   through, and the best one is much more stable from run to run than
+   their median.  Its noise is estimated as the distance of the best
+   from the one ranking PASSES / NOISE_RANK, as a percentage of the
+   result: the fewer the passes close to the best, the less likely
+   another run is to meet it again.  Each pass also times a reference
+   chain of multiplications, which tracks the clock of the host.
+
+   The results go to FILE, or standard output, in JSON, one result
+   per line.  With -b, they are compared with those of a previous run
+   saved in BASELINE, and the exit status is 1 if any of them is
+   slower by more than PERCENT, 10 by default, or NOISE_FACTOR times
+   the larger noise of the two runs if that is more, plus how much
+   slower the reference got from one run to the other.  Regressions are
+   confirmed by up to CONFIRM_RUNS further runs, each result keeping
+   its best, so that a host busy for a whole run does not flag them.
+   The figures are those of the host and only comparable on the same
+   one; the costs relative to each other are what carries over to the
+   board.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "hot_bench.h"
+
+#define MAX_RESULTS 128
+#define MAX_PASSES 101
+#define PASS_PAUSE_MS 20
+#define NOISE_FACTOR 2.0
+#define NOISE_RANK 8
+#define REFERENCE_ROUNDS 100000
+#define CONFIRM_RUNS 2
+
+struct result
+{
+    char role[16];
+    char name[32];
+    char param[16];
+    double value;       /* Best of the passes */
+    double noise;       /* passes / NOISE_RANK-th best - best, percent */
+};
+
+static struct result results[MAX_RESULTS];
+static int n_results;
+
+/* Samples of the results, one per pass */
+static double samples[MAX_RESULTS][MAX_PASSES];
+static int pass, next_result;
+
+uint64_t hot_bench_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000U + t.tv_nsec;
+#endif
+}
+
+const char *hot_bench_unit(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return "tsc";
+#else
+    return "ns";
+#endif
+}
+
+/* The results are accounted in the same order in every pass, the
+   first one of the first run adds them.  Pass -1 is the warm-up.
+*/
+void hot_bench_result(
+    const char *role, const char *name, const char *param, double value)
+{
+    struct result *r = &results[next_result];
+
+    if(pass < 0)
+        return;
+
+    if(pass == 0 && next_result == n_results)
+    {
+        if(n_results == MAX_RESULTS)
+        {
+            fprintf(stderr, "hot_bench: too many results\n");
+            exit(2);
+        }
+        snprintf(r->role, sizeof(r->role), "%s", role);
+        snprintf(r->name, sizeof(r->name), "%s", name);
+        snprintf(r->param, sizeof(r->param), "%s", param);
+        n_results++;
+    }
+
+    samples[next_result++][pass] = value;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Best of the samples of each result over 'passes' and its noise.
+   When 'merge' is set, the results keep the best of this run and of
+   the previous ones.
+*/
+static void summarize(int passes, int merge)
+{
+    static double sorted[MAX_PASSES];
+    int i;
+
+    for(i = 0; i < n_results; i++)
+    {
+        double value;
+
+        memcpy(sorted, samples[i], passes * sizeof(double));
+        qsort(sorted, passes, sizeof(double), cmp_double);
+
+        value = sorted[0];
+        if(merge && results[i].value <= value)
+            continue;
+        results[i].value = value;
+        results[i].noise = (value > 0) ? 100.0 * (sorted[passes / NOISE_RANK] - value) / value : 0;
+    }
+}
+
+/* A dependent chain of multiplications, which runs at the clock of
+   the CPU whatever the state of its caches.  The difference between
+   the reference of two runs is how much the clock of the host moved
+   from one to the other; when it slowed down, that widens the limit
+   of the comparison.
+*/
+static void reference(void)
+{
+    volatile uint32_t seed = 1;
+    uint32_t x = seed;
+    uint64_t t0, t1;
+    int i;
+
+    t0 = hot_bench_now();
+    for(i = 0; i < REFERENCE_ROUNDS; i++)
+        x = x * 1103515245U + 12345U;
+    t1 = hot_bench_now();
+    seed = x;
+
+    hot_bench_result("host", "reference", "chain", (double)(t1 - t0) / REFERENCE_ROUNDS);
+}
+
+/* Pin the process to the CPU it runs on, if possible, so that the
+   passes do not migrate from one cache to another.
+*/
+static void pin_cpu(void)
+{
+#if defined(__linux__)
+    int cpu = sched_getcpu();
+    cpu_set_t set;
+
+    if(cpu < 0)
+        return;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if(sched_setaffinity(0, sizeof(set), &set) != 0)
+        perror("hot_bench: sched_setaffinity");
+#endif
+}
+
+static void write_json(FILE *f)
+{
+    int i;
+
+    fprintf(f, "{\n  \"unit\": \"%s\",\n  \"results\": [\n", hot_bench_unit());
+    for(i = 0; i < n_results; i++)
+        fprintf(f, "    {\"role\": \"%s\", \"name\": \"%s\", \"param\": \"%s\", \"value\": %.2f, \"noise\": %.1f}%s\n",
+                results[i].role, results[i].name, results[i].param, results[i].value,
+                results[i].noise, (i < n_results - 1) ? "," : "");
+    fprintf(f, "  ]\n}\n");
+}
+
+/* Read the results of 'path', as written by write_json().  Returns
+   their number, or -1 if 'path' cannot be read or has another unit.
+   Baselines without a noise estimate get 0.
+*/
+static int read_json(const char *path, struct result *base)
+{
+    FILE *f = fopen(path, "r");
+    char line[256], unit[16];
+    int n = 0, unit_ok = 0;
+
+    if(f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), f) && n < MAX_RESULTS)
+    {
+        struct result *r = &base[n];
+
+        if(sscanf(line, " \"unit\": \"%15[^\"]\"", unit) == 1)
+            unit_ok = (strcmp(unit, hot_bench_unit()) == 0);
+
+        else if(sscanf(line, " {\"role\": \"%15[^\"]\", \"name\": \"%31[^\"]\", \"param\": \"%15[^\"]\", \"value\": %lf, \"noise\": %lf",
+                       r->role, r->name, r->param, &r->value, &r->noise) >= 4)
+        {
+            if(strstr(line, "\"noise\"") == NULL)
+                r->noise = 0;
+            n++;
+        }
+    }
+    fclose(f);
+
+    if(!unit_ok)
+    {
+        fprintf(stderr, "hot_bench: %s not in %s\n", path, hot_bench_unit());
+        return -1;
+    }
+    return n;
+}
+
+/* Index of the result 'role' 'name' 'param' in 'r', or -1 */
+static int find(const struct result *r, int n, const char *role, const char *name, const char *param)
+{
+    int i;
+
+    for(i = 0; i < n; i++)
+        if(strcmp(r[i].role, role) == 0 && strcmp(r[i].name, name) == 0
+           && strcmp(r[i].param, param) == 0)
+            return i;
+    return -1;
+}
+
+/* Print the results next to those of 'base' to 'out', if not NULL,
+   and return the number of those slower by more than 'threshold'
+   percent and NOISE_FACTOR times the larger noise of the two, plus
+   how much slower the clock of the host got from one run to the
+   other.
+*/
+static int compare(const struct result *base, int n_base, double threshold, FILE *out)
+{
+    int i, j, regressions = 0;
+    int ref = find(results, n_results, "host", "reference", "chain");
+    int base_ref = find(base, n_base, "host", "reference", "chain");
+    double drift = 0;
+
+    if(ref >= 0 && base_ref >= 0 && base[base_ref].value > 0)
+        drift = 100.0 * (results[ref].value - base[base_ref].value) / base[base_ref].value;
+    if(out)
+        fprintf(out, "Host clock drift from the baseline: %+.1f%%\n\n", -drift);
+
+    if(out)
+        fprintf(out, "%-14s %-20s %-12s %10s %10s %8s %7s\n",
+                "role", "name", "param", "baseline", "current", "delta", "limit");
+
+    for(i = 0; i < n_results; i++)
+    {
+        const struct result *r = &results[i];
+
+        if(i == ref)
+            continue;
+
+        j = find(base, n_base, r->role, r->name, r->param);
+        if(j < 0 || base[j].value <= 0)
+        {
+            if(out)
+                fprintf(out, "%-14s %-20s %-12s %10s %10.2f\n",
+                        r->role, r->name, r->param, "-", r->value);
+            continue;
+        }
+
+        double delta = 100.0 * (r->value - base[j].value) / base[j].value;
+        double noise = NOISE_FACTOR * ((r->noise > base[j].noise) ? r->noise : base[j].noise);
+        double limit = ((noise > threshold) ? noise : threshold) + ((drift > 0) ? drift : 0);
+
+        if(out)
+            fprintf(out, "%-14s %-20s %-12s %10.2f %10.2f %+7.1f%% %6.1f%%%s\n",
+                    r->role, r->name, r->param, base[j].value, r->value, delta, limit,
+                    (delta > limit) ? "  REGRESSION" : "");
+        if(delta > limit)
+            regressions++;
+    }
+
+    return regressions;
+}
+
+/* Run the suite 'passes' times after a warm-up pass and summarize it,
+   keeping the best of the previous runs if 'merge' is set.
+*/
+static void run(int passes, int merge)
+{
+    for(pass = -1; pass < passes; pass++)
+    {
+        struct timespec pause = { 0, PASS_PAUSE_MS * 1000000L };
+
+        if(pass > -1)
+            nanosleep(&pause, NULL);
+        next_result = 0;
+        reference();
+        hot_bench_sender();
+        hot_bench_receiver();
+        hot_bench_authenticator();
+    }
+    summarize(passes, merge);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct result base[MAX_RESULTS];
+    const char *output = NULL, *baseline = NULL;
+    double threshold = 10.0;
+    int passes = 31;
+    int opt, i, n_base = 0, regressions = 0;
+
+    while((opt = getopt(argc, argv, "o:b:t:n:")) != -1)
+    {
+        switch(opt)
+        {
+        case 'o':
+            output = optarg;
+            break;
+        case 'b':
+            baseline = optarg;
+            break;
+        case 't':
+            threshold = atof(optarg);
+            break;
+        case 'n':
+            passes = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-o FILE] [-b BASELINE] [-t PERCENT] [-n PASSES]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if(passes < 1 || passes > MAX_PASSES)
+    {
+        fprintf(stderr, "hot_bench: PASSES must be in [1, %d]\n", MAX_PASSES);
+        return 2;
+    }
+
+    /* Before running, a wrong baseline is better known early */
+    if(baseline && (n_base = read_json(baseline, base)) < 0)
+        return 2;
+
+    pin_cpu();
+    run(passes, 0);
+
+    /* A host busy for a whole run slows everything down at once, a
+       regression is confirmed by the best of the further runs.
+    */
+    if(baseline)
+        for(i = 0; i < CONFIRM_RUNS && compare(base, n_base, threshold, NULL) > 0; i++)
+            run(passes, 1);
+
+    if(output)
+    {
+        FILE *f = fopen(output, "w");
+
+        if(f == NULL)
+        {
+            perror(output);
+            return 2;
+        }
+        write_json(f);
+        fclose(f);
+    }
+    else if(!baseline)
+        write_json(stdout);
+
+    if(baseline)
+    {
+        regressions = compare(base, n_base, threshold, stdout);
+        printf("%d regression(s) above %.1f%% or %.0f times the noise, plus the slowdown\n",
+               regressions, threshold, NOISE_FACTOR);
+    }
+
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,56 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Interface between hot_bench.c and the three benchmarked nodes, one
+   object per role built by hot_bench.sh from hot_bench_node.c.  It
+   does not depend on the CAN_XR headers, whose contents differ from
+   one role to the other.
+*/
+
+#ifndef HOT_BENCH_H
+#define HOT_BENCH_H
+
+#include <stdint.h>
+
+/* Free-running timestamp, the time stamp counter on x86, nanoseconds
+   elsewhere.  See hot_bench_unit().
+*/
+uint64_t hot_bench_now(void);
+
+/* Unit of hot_bench_now(), "tsc" or "ns" */
+const char *hot_bench_unit(void);
+
+/* Account a result: the best mean cost of one 'param' unit of work
+   of 'name', in the unit of hot_bench_now().
+*/
+void hot_bench_result(
+    const char *role, const char *name, const char *param, double value);
+
+/* Run the benchmarks of each node, once per pass.  The kernels
+   shared by all of them, bpmac and the CRC, are benchmarked by the
+   sender.
+*/
+void hot_bench_sender(void);
+void hot_bench_receiver(void);
+void hot_bench_authenticator(void);
+
+#endif
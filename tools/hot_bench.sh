@@ -0,0 +1,47 @@
+#!/bin/sh
+# Build hot_bench, see hot_bench.c.
+#
+# As in caiba_sim.sh, each node is compiled against the headers of its
+# own directory and linked into a relocatable object whose symbols are
+# all made local, except the hot_bench_* interface of hot_bench.h.
+# hot_bench_node.c includes the MAC of the node, from the source
+# directory of the node.  The PMA and the MAC are built without
+# ENABLE_PROFILE, ENABLE_TRACE or ENABLE_CAPTURE, as on the board.
+#
+# Usage: ./hot_bench.sh [CC [CFLAGS]]
+
+set -e
+
+cd "$(dirname "$0")"
+
+CC=${1:-cc}
+CFLAGS=${2:--O2}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+C=src/CAN_XR_Controller
+
+# node DIR DEFINE
+node()
+{
+    dir=$1
+    for src in hot_bench_node.c \
+        "../$dir/$C/CAN_XR_PCS.c" \
+        "../$dir/$C/CAN_XR_PMA_Common.c" \
+        "../$dir/$C/CAN_XR_Auth_Policy.c" \
+        "../$dir/$C/CAN_XR_Metrics.c" \
+        "../$dir/$C/CAN_XR_Latency.c" \
+        "../$dir/lib/bpmac/bpmac.c"; do
+        $CC $CFLAGS -D"$2" -Ihost -I"../$dir/include" -I"../$dir/lib/bpmac" -I"../$dir/$C" \
+            -c "$src" -o "$TMP/$dir-$(basename "$src" .c).o"
+    done
+    ld -r -o "$TMP/$dir.o" "$TMP/$dir"-*.o
+    objcopy --wildcard --keep-global-symbol='hot_bench_*' "$TMP/$dir.o"
+}
+
+node sender HOT_BENCH_SENDER
+node receiver HOT_BENCH_RECEIVER
+node authenticator HOT_BENCH_AUTHENTICATOR
+
+$CC $CFLAGS -Ihost -o hot_bench hot_bench.c host/mbedtls_aes.c \
+    "$TMP/sender.o" "$TMP/receiver.o" "$TMP/authenticator.o" -lcrypto
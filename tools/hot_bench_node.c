@@ -0,0 +1,521 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* One node of hot_bench.c, see hot_bench.h.  hot_bench.sh compiles it
+   once per role, with HOT_BENCH_SENDER, HOT_BENCH_RECEIVER or
+   HOT_BENCH_AUTHENTICATOR defined and the sources of that role on
+   the include path.
+
+   The MAC of the role is included here rather than linked, to reach
+   its static functions: pcs_data_ind(), the bit engine as the PCS
+   calls it at every sample point, de_stuffed_data_ind(), the framing
+   FSM behind it, and crc_nxtbit().
+
+   There are two workloads of FRAMES classical frames with random
+   identifiers, DLC and data from a fixed seed, one in the identifiers
+   the default authentication policy covers, one out of them.  Each
+   frame is passed once to pcs_data_ind() after bus
+   integration, inserting a stuff bit whenever the MAC expects one, so
+   that the stream follows the data MAC the authenticator overwrites.
+   The bits that went through, and those handed over to
+   de_stuffed_data_ind(), are recorded.  Then the recorded bits are
+   replayed, REPEAT times, each time from the state of the MAC after
+   bus integration, and the fastest replay is taken.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "CAN_XR_MAC_Common.c"
+
+#include "hot_bench.h"
+
+#if defined(HOT_BENCH_SENDER)
+#define ROLE "sender"
+#define ENTRY hot_bench_sender
+#elif defined(HOT_BENCH_RECEIVER)
+#define ROLE "receiver"
+#define ENTRY hot_bench_receiver
+#elif defined(HOT_BENCH_AUTHENTICATOR)
+#define ROLE "authenticator"
+#define ENTRY hot_bench_authenticator
+#else
+#error "Define HOT_BENCH_SENDER, HOT_BENCH_RECEIVER or HOT_BENCH_AUTHENTICATOR"
+#endif
+
+#define FRAMES 32
+#define REPEAT 15
+#define SEED 0xCA1BAU
+
+/* A CBFF frame with 8 data bytes has 108 bits up to the CRC
+   delimiter, 24 stuff bits at most, and 13 bits after it up to the
+   end of intermission.
+*/
+#define MAX_BITS 160
+
+/* Bits from the CRC delimiter to the end of intermission */
+static const uint8_t trailer[] = {
+    1,                      /* CRC delimiter */
+    0,                      /* ACK slot, another node acknowledges */
+    1,                      /* ACK delimiter */
+    1, 1, 1, 1, 1, 1, 1,    /* EOF */
+    1, 1, 1                 /* Intermission */
+};
+
+#define INTERMISSION_BITS 3
+
+struct workload
+{
+    const char *name;
+    int frames;
+    unsigned long bus_total;
+    unsigned long de_stuffed_total;
+    uint32_t identifier[FRAMES];
+    int dlc[FRAMES];
+    uint8_t data[FRAMES][8];
+    int crc_len[FRAMES];                    /* SOF to end of data field */
+    int bus_len[FRAMES];
+    int de_stuffed_len[FRAMES];
+    uint8_t bus[FRAMES][MAX_BITS];          /* Sample points, SOF to end of intermission */
+    uint8_t de_stuffed[FRAMES][MAX_BITS];   /* SOF to end of EOF */
+};
+
+/* Those of caiba_sim.c, the PCS is not benchmarked */
+static const struct CAN_XR_PCS_Bit_Time_Parameters pcs_parameters = {
+    .prescaler_m = 1,
+    .sync_seg = 1,
+    .prop_seg = 3,
+    .phase_seg1 = 2,
+    .phase_seg2 = 2,
+    .sjw = 1
+};
+
+/* Not on the stack, the key slots of the MAC are too large for it. */
+static struct CAN_XR_MAC mac;
+static struct CAN_XR_PCS pcs;
+static struct CAN_XR_PMA pma;
+static struct CAN_XR_Latency latency;
+
+/* State after bus integration, restored before each replay */
+static struct CAN_XR_MAC mac_idle;
+static struct CAN_XR_PCS pcs_idle;
+static struct CAN_XR_PMA pma_idle;
+static struct CAN_XR_Latency latency_idle;
+
+static struct workload plain = { .name = "plain" }, authenticated = { .name = "auth" };
+static unsigned long ts;
+static uint32_t rng = SEED;
+
+/* Keeps the compiler from dropping the results of the kernels */
+static volatile uint32_t sink;
+
+static uint32_t xorshift32(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+#if defined(HOT_BENCH_AUTHENTICATOR)
+static void data_mac_req(struct CAN_XR_PMA *pma, int bus_level)
+{
+    (void)pma;
+    (void)bus_level;
+}
+
+static void tx_reset()
+{
+}
+#else
+static void data_req(struct CAN_XR_PMA *pma, int bus_level)
+{
+    (void)pma;
+    (void)bus_level;
+}
+#endif
+
+static void save_idle(void)
+{
+    mac_idle = mac;
+    pcs_idle = pcs;
+    pma_idle = pma;
+    latency_idle = latency;
+}
+
+static void restore_idle(void)
+{
+    mac = mac_idle;
+    pcs = pcs_idle;
+    pma = pma_idle;
+    latency = latency_idle;
+}
+
+static void node_init(void)
+{
+    int i;
+
+    CAN_XR_PCS_Init(&pcs, &pcs_parameters, &pma);
+#if defined(HOT_BENCH_AUTHENTICATOR)
+    pma.primitives.data_req = NULL;
+    pma.primitives.data_mac_req = data_mac_req;
+    pma.primitives.tx_reset = tx_reset;
+#else
+    pma.primitives.data_req = data_req;
+#endif
+    CAN_XR_MAC_Common_Init(&mac, &pcs);
+    CAN_XR_Latency_Init(&latency);
+    CAN_XR_MAC_Set_Latency(&mac, &latency);
+
+    for(i = 0; i < 11; i++)
+        pcs_data_ind(&mac, ts++, 1);
+
+    if(mac.state.rx_fsm_state != CAN_XR_MAC_RX_FSM_IDLE)
+    {
+        fprintf(stderr, "hot_bench: " ROLE " MAC not idle after bus integration\n");
+        exit(1);
+    }
+}
+
+/* Whether the MAC takes the next bit for a stuff bit */
+static int stuff_expected(void)
+{
+    enum CAN_XR_MAC_RX_FSM_State s = mac.state.rx_fsm_state;
+
+    return s >= CAN_XR_MAC_RX_FSM_RX_IDENTIFIER && s <= CAN_XR_MAC_RX_FSM_RX_CDEL
+        && s != CAN_XR_MAC_RX_FSM_RX_FD_CRC && mac.state.nc_bits == 5;
+}
+
+/* Generate frame 'f' of 'w' and record it, see above */
+static void record_frame(struct workload *w, int f)
+{
+    uint8_t bits[MAX_BITS];
+    uint16_t crc = 0;
+    int n = 0, i, b;
+
+    bits[n++] = 0;                                  /* SOF */
+    for(b = 10; b >= 0; b--)
+        bits[n++] = (w->identifier[f] >> b) & 1;
+    bits[n++] = 0;                                  /* RTR */
+    bits[n++] = 0;                                  /* IDE */
+    bits[n++] = 0;                                  /* FDF, r0 in CAN 2.0 */
+    for(b = 3; b >= 0; b--)
+        bits[n++] = (w->dlc[f] >> b) & 1;
+    for(i = 0; i < w->dlc[f]; i++)
+        for(b = 7; b >= 0; b--)
+            bits[n++] = (w->data[f][i] >> b) & 1;
+
+    w->crc_len[f] = n;
+    for(i = 0; i < n; i++)
+        crc = crc_nxtbit(crc, bits[i]);
+    for(b = 14; b >= 0; b--)
+        bits[n++] = (crc >> b) & 1;
+
+    memcpy(bits + n, trailer, sizeof(trailer));
+    n += sizeof(trailer);
+
+    w->bus_len[f] = 0;
+    w->de_stuffed_len[f] = 0;
+    for(i = 0; i < n; )
+    {
+        int bit;
+
+        if(stuff_expected())
+            bit = !mac.state.nc_pol;
+        else
+        {
+            bit = bits[i];
+            if(i++ < n - INTERMISSION_BITS)
+                w->de_stuffed[f][w->de_stuffed_len[f]++] = bit;
+        }
+
+        w->bus[f][w->bus_len[f]++] = bit;
+        pcs_data_ind(&mac, ts++, bit);
+    }
+
+    if(mac.state.rx_fsm_state != CAN_XR_MAC_RX_FSM_IDLE)
+    {
+        fprintf(stderr, "hot_bench: " ROLE " MAC in state %d after frame %lx\n",
+                mac.state.rx_fsm_state, (unsigned long)w->identifier[f]);
+        exit(1);
+    }
+
+    w->bus_total += w->bus_len[f];
+    w->de_stuffed_total += w->de_stuffed_len[f];
+}
+
+/* Identifiers in [first, first + 256), DLC 1 to 8 */
+static void make_workload(struct workload *w, uint32_t first)
+{
+    int f, i;
+
+    rng = SEED;
+    w->frames = FRAMES;
+
+    restore_idle();
+    for(f = 0; f < FRAMES; f++)
+    {
+        w->identifier[f] = first + (xorshift32() & 0xFF);
+        w->dlc[f] = 1 + xorshift32() % 8;
+        for(i = 0; i < 8; i++)
+            w->data[f][i] = (uint8_t)xorshift32();
+        record_frame(w, f);
+    }
+}
+
+static const struct workload *cur;
+
+static void replay_pcs_data_ind(void)
+{
+    int f, i;
+
+    for(f = 0; f < cur->frames; f++)
+        for(i = 0; i < cur->bus_len[f]; i++)
+            pcs_data_ind(&mac, ts++, cur->bus[f][i]);
+}
+
+/* Set the MAC as pcs_data_ind() does at SOF, save for the
+   de-stuffing state
+*/
+static void prepare_sof(void)
+{
+    mac.state.rx_fsm_state = CAN_XR_MAC_RX_FSM_IDLE;
+#if defined(HOT_BENCH_AUTHENTICATOR)
+    mac.state.skip_mac = 0;
+    mac.state.nonce_delta = 0;
+#endif
+}
+
+static void replay_de_stuffed_data_ind(void)
+{
+    int f, i;
+
+    for(f = 0; f < cur->frames; f++)
+    {
+        prepare_sof();
+        for(i = 0; i < cur->de_stuffed_len[f]; i++)
+            de_stuffed_data_ind(&mac, ts++, cur->de_stuffed[f][i]);
+    }
+}
+
+/* Best time of REPEAT runs of 'fn', each from the idle MAC */
+static double best(void (*fn)(void))
+{
+    uint64_t min = UINT64_MAX;
+    int r;
+
+    for(r = 0; r < REPEAT; r++)
+    {
+        uint64_t t0, t;
+
+        restore_idle();
+        t0 = hot_bench_now();
+        fn();
+        t = hot_bench_now() - t0;
+        if(t < min)
+            min = t;
+    }
+
+    return (double)min;
+}
+
+static void bench_mac(const struct workload *w)
+{
+    char param[32];
+    double t;
+
+    cur = w;
+
+    t = best(replay_pcs_data_ind);
+    snprintf(param, sizeof(param), "%s_bit", w->name);
+    hot_bench_result(ROLE, "pcs_data_ind", param, t / w->bus_total);
+    snprintf(param, sizeof(param), "%s_frame", w->name);
+    hot_bench_result(ROLE, "pcs_data_ind", param, t / w->frames);
+
+    t = best(replay_de_stuffed_data_ind);
+    snprintf(param, sizeof(param), "%s_bit", w->name);
+    hot_bench_result(ROLE, "de_stuffed_data_ind", param, t / w->de_stuffed_total);
+    snprintf(param, sizeof(param), "%s_frame", w->name);
+    hot_bench_result(ROLE, "de_stuffed_data_ind", param, t / w->frames);
+}
+
+#if defined(HOT_BENCH_SENDER)
+
+/* The kernels, once for all roles.  The nonce cache of bpmac_pre()
+   holds a block of nonces, see bpmac.c: a hit takes the next nonce
+   in the block, a miss the first nonce of the next block.
+*/
+
+#define CALLS 1024
+
+static const uint8_t key[16] = {
+    0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07,
+    0x17, 0x07, 0x17, 0x07, 0x17, 0x07, 0x17, 0x07
+};
+static const uint8_t nonce_key[16] = {
+    0x22, 0x11, 0x27, 0x09, 0x22, 0x11, 0x27, 0x09,
+    0x22, 0x11, 0x27, 0x09, 0x22, 0x11, 0x27, 0x09
+};
+
+static bpmac_ctx_t ctx;
+static uint64_t nonce[2];
+static uint32_t tag[4];
+static int sign_len;
+
+static void kernel_pre_hit(void)
+{
+    int i;
+
+    for(i = 0; i < CALLS; i++)
+    {
+        nonce[0] = (nonce[0] & ~(uint64_t)3) | (i & 3);
+        bpmac_pre(&ctx, (uint8_t *) nonce, (char *) tag);
+    }
+}
+
+static void kernel_pre_miss(void)
+{
+    int i;
+
+    for(i = 0; i < CALLS; i++)
+    {
+        nonce[0] += 4;
+        bpmac_pre(&ctx, (uint8_t *) nonce, (char *) tag);
+    }
+}
+
+static void kernel_update(void)
+{
+    int f, i, b;
+
+    for(f = 0; f < cur->frames; f++)
+    {
+        ctx.bit_index = 0;
+        for(i = 0; i < cur->dlc[f]; i++)
+            for(b = 7; b >= 0; b--)
+                bpmac_update(&ctx, (cur->data[f][i] >> b) & 1, (char *) tag);
+    }
+}
+
+static void kernel_update_id(void)
+{
+    int f;
+
+    for(f = 0; f < cur->frames; f++)
+        bpmac_update_id(&ctx, cur->identifier[f], 11, (char *) tag);
+}
+
+static void kernel_sign(void)
+{
+    int f;
+
+    for(f = 0; f < cur->frames; f++)
+    {
+        ctx.bit_index = 0;
+        bpmac_sign(&ctx, (char *) cur->data[f], sign_len, (char *) tag);
+    }
+}
+
+static void kernel_crc(void)
+{
+    uint16_t crc = 0;
+    int f, i;
+
+    for(f = 0; f < cur->frames; f++)
+    {
+        crc = 0;
+        for(i = 0; i < cur->crc_len[f]; i++)
+            crc = crc_nxtbit(crc, cur->de_stuffed[f][i]);
+        sink += crc;
+    }
+}
+
+static void bench_kernels(const struct workload *w)
+{
+    unsigned long data_bits = 0;
+    uint64_t min = UINT64_MAX;
+    char param[32];
+    int f, r;
+
+    cur = w;
+    for(f = 0; f < w->frames; f++)
+        data_bits += 8 * w->dlc[f];
+
+    /* Not a batch, the tables it builds take a while */
+    for(r = 0; r < REPEAT; r++)
+    {
+        uint64_t t0 = hot_bench_now(), t;
+
+        bpmac_init((char *) key, (char *) nonce_key, CAN_XR_AUTH_MSG_MAX_SIZE, &ctx);
+        t = hot_bench_now() - t0;
+        bpmac_deinit(&ctx);
+        if(t < min)
+            min = t;
+    }
+    hot_bench_result("common", "bpmac_init", "call", (double)min);
+
+    bpmac_init((char *) key, (char *) nonce_key, CAN_XR_AUTH_MSG_MAX_SIZE, &ctx);
+    bpmac_pre(&ctx, (uint8_t *) nonce, (char *) tag);
+
+    hot_bench_result("common", "bpmac_pre", "hit", best(kernel_pre_hit) / CALLS);
+    hot_bench_result("common", "bpmac_pre", "miss", best(kernel_pre_miss) / CALLS);
+    hot_bench_result("common", "bpmac_update", "bit", best(kernel_update) / data_bits);
+    hot_bench_result("common", "bpmac_update_id", "cbff", best(kernel_update_id) / w->frames);
+
+    for(sign_len = 1; sign_len <= 8; sign_len++)
+    {
+        snprintf(param, sizeof(param), "dlc%d", sign_len);
+        hot_bench_result("common", "bpmac_sign", param, best(kernel_sign) / w->frames);
+    }
+
+    hot_bench_result("common", "crc_nxtbit", "frame", best(kernel_crc) / w->frames);
+
+    bpmac_deinit(&ctx);
+}
+
+#endif
+
+/* Called once per pass of hot_bench.c, the node and the workloads
+   are set up by the first call only.
+*/
+void ENTRY(void)
+{
+    static int ready;
+
+    if(!ready)
+    {
+        node_init();
+        save_idle();
+
+        make_workload(&plain, 0x300);
+        make_workload(&authenticated, 0x000);
+        ready = 1;
+    }
+
+#if defined(HOT_BENCH_SENDER)
+    bench_kernels(&authenticated);
+#endif
+    bench_mac(&plain);
+    bench_mac(&authenticated);
+}
@@ -0,0 +1,224 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Host benchmark of the transmit mailboxes of the sender MAC.
+
+   The real PCS and MAC of the sender run against a simulated bus,
+   one nodeclock at a time.  The bus model adds an acknowledging
+   receiver, nothing else competes for the bus.  The application is
+   modeled as a foreground loop that looks at the confirmations only
+   every DELAY nodeclocks, and then refills the MAC up to DEPTH
+   outstanding requests.  With DEPTH 1 this is the single-buffer MAC,
+   whose next request always comes too late for the SOF after
+   intermission, with DEPTH > 1 the next frame is already waiting in
+   a mailbox.
+
+   The result is the sustained frame rate at CAN_XR_BIT_RATE and the
+   fraction of the bits elapsed during which the node was
+   transmitting.  With data always ready, the frame rate approaches
+   the nominal capacity of the bus, computed with 3 bits of
+   intermission and printed for reference, and the fraction falls
+   short of 100% by the intermission bits.  Every fourth
+   request is an authenticated frame, the benchmark also checks that
+   those are confirmed in request order.
+
+   Build with:
+
+   cc -O2 -I../sender/include -o mailbox_bench mailbox_bench.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_MAC_Common.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_PCS.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_PMA_Common.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_Auth_Policy.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_Metrics.c \
+       ../sender/src/CAN_XR_Controller/CAN_XR_Latency.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <CAN_XR_Config.h>
+#include <CAN_XR_PMA.h>
+#include <CAN_XR_PCS.h>
+#include <CAN_XR_MAC.h>
+
+#define NODECLOCK_PER_BIT 8
+#define FRAMES 20000
+
+static const struct CAN_XR_PCS_Bit_Time_Parameters pcs_parameters = {
+    .prescaler_m = 1,
+    .sync_seg = 1,
+    .prop_seg = 3,
+    .phase_seg1 = 2,
+    .phase_seg2 = 2,
+    .sjw = 1
+};
+
+static struct CAN_XR_MAC mac;
+static struct CAN_XR_PCS pcs;
+static struct CAN_XR_PMA pma;
+
+static int bus_level = 1;
+static int outstanding;
+static unsigned long confirmed, failed;
+static uint32_t auth_sent, auth_confirmed, order_errors;
+
+static void bus_data_req(struct CAN_XR_PMA *pma, int level)
+{
+    (void)pma;
+    bus_level = level;
+}
+
+/* A receiver on the bus drives the ACK slot dominant.  The node does
+   not acknowledge its own frames.
+*/
+static int acking(void)
+{
+    return mac.state.rx_fsm_state == CAN_XR_MAC_RX_FSM_RX_ACK;
+}
+
+static void data_conf(struct CAN_XR_LLC *llc, unsigned long ts,
+                      uint32_t identifier,
+                      enum CAN_XR_MAC_Tx_Status transmission_status)
+{
+    (void)llc;
+    (void)ts;
+
+    if(transmission_status != CAN_XR_MAC_TX_STATUS_SUCCESS)
+    {
+        failed++;
+        return;
+    }
+
+    /* The first data byte of authenticated frames is their request
+       number, the confirmations carry the identifier only, so the
+       MAC state is peeked at instead.
+    */
+    if(CAN_XR_Auth_Policy_MAC_Len(mac.policy, identifier, 8))
+    {
+        if(mac.state.tx_data[0] != (uint8_t)auth_confirmed)
+            order_errors++;
+        auth_confirmed++;
+    }
+
+    outstanding--;
+    confirmed++;
+}
+
+static void data_ind(struct CAN_XR_LLC *llc, unsigned long ts,
+                     uint32_t identifier, enum CAN_XR_Format format,
+                     int dlc, uint8_t *data)
+{
+    (void)llc;
+    (void)ts;
+    (void)identifier;
+    (void)format;
+    (void)dlc;
+    (void)data;
+}
+
+static void submit(unsigned long n)
+{
+    uint8_t data[8];
+    uint8_t data_mac[16]; /* A whole bpmac tag */
+    uint32_t identifier;
+
+    memset(data, 0x55, sizeof(data));
+    memset(data_mac, 0xAA, sizeof(data_mac));
+
+    if(n % 4 == 3)
+    {
+        /* Authenticated, numbered */
+        identifier = 0x20;
+        data[0] = (uint8_t)auth_sent++;
+    }
+    else
+        identifier = 0x300 + (uint32_t)(rand() % 16);
+
+    CAN_XR_MAC_Data_Req(&mac, identifier, CAN_XR_FORMAT_CBFF, 8, data, data_mac);
+    outstanding++;
+}
+
+static double run(int depth, int delay)
+{
+    unsigned long nc = 0, busy = 0, submitted = 0;
+    double bits, frame_bits;
+
+    srand(1);
+    CAN_XR_PCS_Init(&pcs, &pcs_parameters, &pma);
+    pma.primitives.data_req = bus_data_req;
+    CAN_XR_MAC_Common_Init(&mac, &pcs);
+    CAN_XR_MAC_Set_Data_Ind(&mac, data_ind);
+    CAN_XR_MAC_Set_Data_Conf(&mac, data_conf);
+
+    bus_level = 1;
+    outstanding = 0;
+    confirmed = failed = 0;
+    auth_sent = auth_confirmed = order_errors = 0;
+
+    while(confirmed < FRAMES && failed == 0)
+    {
+        if(delay == 0 || nc % delay == 0)
+        {
+            while(outstanding < depth)
+                submit(submitted++);
+        }
+
+        if(mac.state.tx_fsm_state != CAN_XR_MAC_TX_FSM_IDLE)
+            busy++;
+
+        pma.primitives.nodeclock_ind(&pcs, bus_level && !acking());
+        nc++;
+    }
+
+    bits = (double)nc / NODECLOCK_PER_BIT;
+    frame_bits = (double)busy / NODECLOCK_PER_BIT / confirmed;
+
+    printf("%5d %6d %9.1f %10.1f %7.1f%% %6lu %6u\n",
+           depth, delay / NODECLOCK_PER_BIT, frame_bits,
+           confirmed * (double)CAN_XR_BIT_RATE / bits,
+           100.0 * busy / nc, failed, (unsigned)order_errors);
+
+    return frame_bits;
+}
+
+int main(void)
+{
+    static const int depths[] = { 1, 2, 4, CAN_XR_MAC_MAILBOXES };
+    static const int delays[] = { 0, 4, 32, 128 };
+    double frame_bits = 0.0;
+    size_t i, j;
+
+    printf("%d mailboxes, %d bit/s, %d frames per run\n\n",
+           CAN_XR_MAC_MAILBOXES, CAN_XR_BIT_RATE, FRAMES);
+    printf("depth delay  bits/frm   frames/s    busy   fail  order\n");
+
+    for(j = 0; j < sizeof(delays) / sizeof(delays[0]); j++)
+        for(i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+            frame_bits = run(depths[i], delays[j] * NODECLOCK_PER_BIT);
+
+    printf("\nNominal capacity: %.1f frames/s\n",
+           (double)CAN_XR_BIT_RATE / (frame_bits + 3.0));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,157 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+/* Per-state costs of the nodeclock callback chain, as printed by
+   CAN_XR_Profile_Dump() on the board or by bus_sim -p, for bus_sim.c
+   and bitrate_find.c.  Only the PMA rows are used, they cover the
+   whole period.  The minimum of a state is taken for the cost of a
+   period without sample point, the maximum for that of a period with
+   one, in which the MAC runs.  The average of the MAC rows is kept
+   too, for bitrate_find.c.
+
+   The rows are tied to a receive state by its name, not its value:
+   the receive FSMs of the three nodes do not have the same states.
+   They are mapped onto those of the sender, whose MAC bus_sim runs
+   and which has all of them; rows of states it does not have are
+   skipped.
+
+   The header holds the code as well, so that both tools keep being
+   built from a single C file.
+*/
+
+#ifndef PROFILE_COSTS_H
+#define PROFILE_COSTS_H
+
+#include <stdio.h>
+#include <string.h>
+
+#define PROFILE_COSTS_STATES 32     /* CAN_XR_PROFILE_STATES */
+
+/* enum CAN_XR_MAC_RX_FSM_State of the sender, in sender/include/CAN_XR_MAC.h */
+static const char *const profile_costs_state_name[] = {
+    "BUS_INTEGRATION", "IDLE", "RX_IDENTIFIER", "RX_RTR", "RX_IDE",
+    "RX_ID_EXT", "RX_FDF", "RX_R0", "RX_BRS", "RX_ESI", "RX_DLC",
+    "RX_DATA", "RX_DATA_MAC", "RX_CRC", "RX_FD_CRC", "RX_CDEL",
+    "RX_ACK", "RX_ADEL", "RX_EOF", "INTERMISSION", "ERROR",
+    "ERROR_FLAG", "ERROR_DEL"
+};
+
+#define PROFILE_COSTS_STATE_NAMES \
+    ((int)(sizeof(profile_costs_state_name) / sizeof(profile_costs_state_name[0])))
+
+/* Sender state called 'name', -1 if none */
+static inline int profile_costs_state(const char *name)
+{
+    int s;
+
+    for(s = 0; s < PROFILE_COSTS_STATE_NAMES; s++)
+        if(strcmp(profile_costs_state_name[s], name) == 0)
+            return s;
+    return -1;
+}
+
+struct profile_costs
+{
+    unsigned long budget;           /* Of the profiled run, 0 if not found */
+    int states;                     /* Highest state with a row, plus one */
+    int valid[PROFILE_COSTS_STATES];
+    unsigned long periods[PROFILE_COSTS_STATES];
+    unsigned long min[PROFILE_COSTS_STATES];
+    unsigned long avg[PROFILE_COSTS_STATES];
+    unsigned long max[PROFILE_COSTS_STATES];
+    unsigned long mac_avg[PROFILE_COSTS_STATES];
+};
+
+/* Read the PMA and MAC rows of the dump in 'path' into 'c', skipping any
+   other line.  Returns the number of PMA rows, -1 if 'path' cannot be
+   read.  The profiled node may be any of them.
+*/
+static inline int profile_costs_read(const char *path, struct profile_costs *c)
+{
+    FILE *f = fopen(path, "r");
+    char line[256], name[32], layer[8];
+    unsigned long periods, min, avg, max;
+    int s, rows = 0;
+
+    memset(c, 0, sizeof(*c));
+    if(f == NULL)
+        return -1;
+
+    while(fgets(line, sizeof(line), f))
+    {
+        if(sscanf(line, "Profile, budget %lu", &c->budget) == 1)
+            continue;
+
+        if(sscanf(line, "%d %31s %7s %lu %lu %lu %lu", &s, name, layer, &periods, &min, &avg, &max) != 7
+           || (s = profile_costs_state(name)) < 0)
+            continue;
+
+        if(strcmp(layer, "MAC") == 0)
+            c->mac_avg[s] = avg;
+        if(strcmp(layer, "PMA") != 0)
+            continue;
+
+        c->valid[s] = 1;
+        c->periods[s] = periods;
+        c->min[s] = min;
+        c->avg[s] = avg;
+        c->max[s] = max;
+        if(s >= c->states)
+            c->states = s + 1;
+        rows++;
+    }
+
+    fclose(f);
+    return rows;
+}
+
+/* Cost of a period spent in receive state 'state', with a sample
+   point if 'sampled'.  States not profiled cost nothing.
+*/
+static inline unsigned long profile_costs_period(
+    const struct profile_costs *c, int state, int sampled)
+{
+    if(state < 0 || state >= PROFILE_COSTS_STATES || !c->valid[state])
+        return 0;
+    return sampled ? c->max[state] : c->min[state];
+}
+
+/* Worst period of all states, and the state it belongs to */
+static inline unsigned long profile_costs_worst(const struct profile_costs *c, int *state)
+{
+    unsigned long worst = 0;
+    int s;
+
+    *state = -1;
+    for(s = 0; s < c->states; s++)
+    {
+        if(c->valid[s] && c->max[s] > worst)
+        {
+            worst = c->max[s];
+            *state = s;
+        }
+    }
+
+    return worst;
+}
+
+#endif
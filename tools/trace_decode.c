@@ -0,0 +1,276 @@
+/*+
+    SDCC - A Software-Defined CAN Controller
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The use of the program may be restricted in certain countries by
+    intellectual property rights owned by Bosch.  For more information, see:
+
+    http://www.bosch-semiconductors.com/ip-modules/can-ip-modules/can-protocol/
++*/
+
+
+/* Decoder of the binary trace, see CAN_XR_Trace.h.
+
+   Reads a dump written by CAN_XR_Trace_Dump() and prints one line per
+   record, like the text backend of TRACE would have, preceded by the
+   record number and timestamp.  The formats are taken from the
+   can_xr_trace section of the ELF file of the program that wrote the
+   dump, 32 or 64 bit, so the dump and the ELF file must match.  The
+   arguments are rendered from their 32-bit values with the
+   conversions of the format: signed for %d and %i, floating point for
+   %e, %f and %g, unsigned otherwise.
+
+   Build, from this directory:
+
+     cc -O2 -o trace_decode trace_decode.c
+
+   Usage: trace_decode program.elf trace.bin
+
+   On the board the dump goes over the serial port, or can be taken
+   with the debugger.  On the host, bus_sim.c writes one with -t when
+   built with -DENABLE_TRACE -DENABLE_TRACE_BINARY and CAN_XR_Trace.c,
+   see there.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <elf.h>
+
+#define SECTION "can_xr_trace"
+
+static const char *formats;
+static size_t formats_size;
+
+static void *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    char *buf;
+    long n;
+
+    if(f == NULL || fseek(f, 0, SEEK_END) != 0 || (n = ftell(f)) < 0)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    rewind(f);
+    buf = malloc(n + 1);
+    if(buf == NULL || fread(buf, 1, n, f) != (size_t)n)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    buf[n] = '\0';
+    fclose(f);
+    *size = n;
+    return buf;
+}
+
+/* Look for the can_xr_trace section.  The ELF class is the only thing
+   that tells the 32- and 64-bit cases apart, the host and the board
+   are both little endian.
+*/
+#define FIND_SECTION(Ehdr, Shdr)                                        \
+    do {                                                                \
+        const Ehdr *eh = (const Ehdr *)elf;                             \
+        const Shdr *sh = (const Shdr *)(elf + eh->e_shoff);             \
+        const char *names = elf + sh[eh->e_shstrndx].sh_offset;         \
+        int i;                                                          \
+                                                                        \
+        for(i = 0; i < eh->e_shnum; i++)                                \
+        {                                                               \
+            if(strcmp(names + sh[i].sh_name, SECTION) == 0)             \
+            {                                                           \
+                formats = elf + sh[i].sh_offset;                        \
+                formats_size = sh[i].sh_size;                           \
+            }                                                           \
+        }                                                               \
+    } while(0)
+
+static void load_formats(const char *path)
+{
+    size_t size;
+    const char *elf = read_file(path, &size);
+
+    if(size < EI_NIDENT || memcmp(elf, ELFMAG, SELFMAG) != 0)
+    {
+        fprintf(stderr, "%s: not an ELF file\n", path);
+        exit(1);
+    }
+
+    if(elf[EI_CLASS] == ELFCLASS64)
+        FIND_SECTION(Elf64_Ehdr, Elf64_Shdr);
+    else
+        FIND_SECTION(Elf32_Ehdr, Elf32_Shdr);
+
+    if(formats == NULL)
+    {
+        fprintf(stderr, "%s: no %s section, not built with ENABLE_TRACE_BINARY?\n",
+                path, SECTION);
+        exit(1);
+    }
+}
+
+/* Print 'format' with the arguments in 'arg', see above. */
+static void render(const char *format, const uint32_t *arg, int nargs)
+{
+    const char *p = format;
+    int i = 0;
+
+    while(*p)
+    {
+        char spec[32];
+        size_t n = 0;
+        char conv;
+        uint32_t v;
+
+        if(*p != '%')
+        {
+            putchar(*p++);
+            continue;
+        }
+
+        if(p[1] == '%')
+        {
+            putchar('%');
+            p += 2;
+            continue;
+        }
+
+        /* Flags, width and precision are kept, length modifiers are
+           replaced by l.
+        */
+        spec[n++] = *p++;
+        while(*p && strchr("-+ #0123456789.", *p) && n < sizeof(spec) - 3)
+            spec[n++] = *p++;
+        while(*p && strchr("hlLjzt", *p))
+            p++;
+        conv = *p ? *p++ : 'd';
+
+        if(i >= nargs)
+        {
+            fputs("<?>", stdout);
+            continue;
+        }
+        v = arg[i++];
+
+        switch(conv)
+        {
+        case 'd':
+        case 'i':
+            spec[n++] = 'l';
+            spec[n++] = conv;
+            spec[n] = '\0';
+            printf(spec, (long)(int32_t)v);
+            break;
+
+        case 'e':
+        case 'f':
+        case 'g':
+        case 'E':
+        case 'G':
+            spec[n++] = conv;
+            spec[n] = '\0';
+            printf(spec, (double)v);
+            break;
+
+        case 'c':
+            putchar((int)v);
+            break;
+
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            spec[n++] = 'l';
+            spec[n++] = conv;
+            spec[n] = '\0';
+            printf(spec, (unsigned long)v);
+            break;
+
+        default:
+            printf("<%%%c 0x%08lx>", conv, (unsigned long)v);
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t size, pos, record_size;
+    const char *dump;
+    uint32_t args;
+    unsigned long n = 0;
+
+    if(argc != 3)
+    {
+        fprintf(stderr, "Usage: %s program.elf trace.bin\n", argv[0]);
+        return 1;
+    }
+
+    load_formats(argv[1]);
+    dump = read_file(argv[2], &size);
+
+    /* "CXTR", number of arguments per record, then the records:
+       seq, ts, format, level, nargs, reserved, arguments.
+    */
+    if(size < 8 || memcmp(dump, "CXTR", 4) != 0)
+    {
+        fprintf(stderr, "%s: not a trace dump\n", argv[2]);
+        return 1;
+    }
+
+    memcpy(&args, dump + 4, sizeof(args));
+    if(args > 256)
+    {
+        fprintf(stderr, "%s: %lu arguments per record?\n", argv[2], (unsigned long)args);
+        return 1;
+    }
+    record_size = 16 + 4 * (size_t)args;
+
+    for(pos = 8; pos + record_size <= size; pos += record_size)
+    {
+        uint32_t seq, ts, format;
+        uint8_t level, nargs;
+        uint32_t arg[256];
+        int i;
+
+        memcpy(&seq, dump + pos, 4);
+        memcpy(&ts, dump + pos + 4, 4);
+        memcpy(&format, dump + pos + 8, 4);
+        level = (uint8_t)dump[pos + 12];
+        nargs = (uint8_t)dump[pos + 13];
+        if(nargs > args)
+            nargs = args;
+        memcpy(arg, dump + pos + 16, 4 * (size_t)nargs);
+
+        printf("%8lu %10lu ", (unsigned long)seq - 1, (unsigned long)ts);
+        for(i = 0; i < level * 4; i++)
+            putchar(' ');
+
+        if(format < formats_size)
+            render(formats + format, arg, nargs);
+        else
+            printf("<bad format offset 0x%08lx>", (unsigned long)format);
+        putchar('\n');
+        n++;
+    }
+
+    fprintf(stderr, "%lu records\n", n);
+    return 0;
+}